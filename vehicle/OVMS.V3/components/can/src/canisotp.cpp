@@ -0,0 +1,627 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "isotp";
+
+#include <string.h>
+#include "esp_timer.h"
+#include "canisotp.h"
+
+/**
+ * isotp_decode_stmin: translate ISO-TP STmin encoding to microseconds
+ *  0x00…0x7F = 0…127 ms, 0xF1…0xF9 = 100…900 us, reserved values = 127 ms
+ */
+uint32_t isotp_decode_stmin(uint8_t stmin)
+  {
+  if (stmin <= 0x7f)
+    return stmin * 1000;
+  else if (stmin >= 0xf1 && stmin <= 0xf9)
+    return (stmin - 0xf0) * 100;
+  else
+    return 127000;
+  }
+
+
+/**
+ * canisotp_channel
+ */
+
+canisotp_channel::canisotp_channel()
+  {
+  m_bus = NULL;
+  m_txid = 0;
+  m_rxid = 0;
+  m_protocol = ISOTP_STD;
+  m_blocksize = 0;
+  m_stmin = 0;
+  m_padding = 0;
+  m_timeout_ms = ISOTP_DEFAULT_TIMEOUT;
+  m_tx_messages = m_rx_messages = 0;
+  m_tx_frames = m_rx_frames = 0;
+  m_errors = 0;
+  m_engine = NULL;
+  m_txstate = TxIdle;
+  m_txdata = NULL;
+  m_txlen = m_txpos = 0;
+  m_txsn = m_txbs = m_txbscnt = m_txwait = 0;
+  m_txst_us = 0;
+  m_txdue = m_txlast = 0;
+  m_rxstate = RxIdle;
+  m_rxbuf = NULL;
+  m_rxsize = m_rxlen = m_rxpos = 0;
+  m_rxsn = m_rxbscnt = 0;
+  m_rxdue = 0;
+  }
+
+canisotp_channel::~canisotp_channel()
+  {
+  if (m_engine)
+    m_engine->Detach(this);
+  }
+
+/**
+ * Configure: set bus & addressing
+ *  bus: NULL = any bus (frames are sent via the engine's TransmitFrame())
+ *  txid/rxid: CAN IDs, with ISOTP_EXTADR: (CAN ID << 8 | address byte)
+ *  IDs > 0x7FF (after removing the address byte) are sent as 29 bit frames.
+ */
+void canisotp_channel::Configure(canbus* bus, uint32_t txid, uint32_t rxid, uint8_t protocol /*=ISOTP_STD*/)
+  {
+  m_bus = bus;
+  m_txid = txid;
+  m_rxid = rxid;
+  m_protocol = protocol;
+  }
+
+/**
+ * SetRxBuffer: set receive buffer (max message length accepted)
+ */
+void canisotp_channel::SetRxBuffer(uint8_t* buffer, uint16_t size)
+  {
+  m_rxbuf = buffer;
+  m_rxsize = size;
+  }
+
+/**
+ * SetFlowControl: set block size & separation time requested from the peer
+ *  blocksize: 0 = send all frames without further flow control
+ *  stmin: ISO-TP encoding, see isotp_decode_stmin()
+ */
+void canisotp_channel::SetFlowControl(uint8_t blocksize, uint8_t stmin)
+  {
+  m_blocksize = blocksize;
+  m_stmin = stmin;
+  }
+
+/**
+ * SetPadding: set padding byte for short frames (default 0x00), -1 = send short frames
+ */
+void canisotp_channel::SetPadding(int padbyte)
+  {
+  m_padding = (padbyte < 0) ? -1 : (padbyte & 0xff);
+  }
+
+void canisotp_channel::SetTimeout(uint16_t timeout_ms)
+  {
+  m_timeout_ms = timeout_ms;
+  }
+
+void canisotp_channel::SetCallback(canisotp_callback callback)
+  {
+  m_callback = callback;
+  }
+
+/**
+ * Send: start transmission of a message
+ *  The data is not copied, it needs to stay valid until ISOTP_EVENT_TXDONE.
+ *  Single frame messages are completed immediately.
+ *  Returns ISOTP_OK or an error code.
+ */
+int canisotp_channel::Send(const uint8_t* data, uint16_t length)
+  {
+  if (!m_engine)
+    return ISOTP_ERR_TXFAIL;
+  OvmsRecMutexLock lock(&m_engine->m_mutex);
+  if (m_txstate != TxIdle)
+    return ISOTP_ERR_BUSY;
+
+  uint8_t sfmax = (m_protocol == ISOTP_EXTADR) ? 6 : 7;
+  if (length == 0 || length > ISOTP_MAX_LENGTH)
+    return ISOTP_ERR_LENGTH;
+
+  uint8_t buf[8];
+  m_txdata = data;
+  m_txlen = length;
+  if (length <= sfmax)
+    {
+    buf[0] = (ISOTP_FT_SINGLE << 4) | length;
+    memcpy(&buf[1], data, length);
+    if (!Transmit(buf, 1 + length))
+      return ISOTP_ERR_TXFAIL;
+    m_txpos = length;
+    m_tx_messages++;
+    if (m_callback)
+      m_callback(this, ISOTP_EVENT_TXDONE, ISOTP_OK);
+    return ISOTP_OK;
+    }
+
+  uint8_t ffdata = sfmax - 1;
+  buf[0] = (ISOTP_FT_FIRST << 4) | (length >> 8);
+  buf[1] = length & 0xff;
+  memcpy(&buf[2], data, ffdata);
+  if (!Transmit(buf, 2 + ffdata))
+    return ISOTP_ERR_TXFAIL;
+  m_txpos = ffdata;
+  m_txsn = 1;
+  m_txwait = 0;
+  m_txstate = TxWaitFC;
+  m_txdue = esp_timer_get_time() + m_timeout_ms * 1000LL;
+  return ISOTP_OK;
+  }
+
+/**
+ * Abort: cancel running transmission & reception
+ */
+void canisotp_channel::Abort()
+  {
+  if (!m_engine)
+    return;
+  OvmsRecMutexLock lock(&m_engine->m_mutex);
+  if (m_txstate != TxIdle)
+    TxFinish(ISOTP_ERR_ABORTED);
+  if (m_rxstate != RxIdle)
+    RxFinish(ISOTP_ERR_ABORTED);
+  }
+
+/**
+ * Transmit: send a frame (internal)
+ *  data: PCI & payload (without the extended address byte)
+ */
+bool canisotp_channel::Transmit(const uint8_t* data, uint8_t len)
+  {
+  CAN_frame_t frame;
+  uint32_t msgid;
+  uint8_t dlc;
+  memset(&frame, 0, sizeof(frame));
+  frame.origin = m_bus;
+
+  if (m_protocol == ISOTP_EXTADR)
+    {
+    msgid = m_txid >> 8;
+    frame.data.u8[0] = m_txid & 0xff;
+    memcpy(&frame.data.u8[1], data, len);
+    dlc = len + 1;
+    }
+  else
+    {
+    msgid = m_txid;
+    memcpy(&frame.data.u8[0], data, len);
+    dlc = len;
+    }
+  if (m_padding >= 0 && dlc < 8)
+    {
+    memset(&frame.data.u8[dlc], m_padding, 8 - dlc);
+    dlc = 8;
+    }
+
+  frame.MsgID = msgid;
+  frame.FIR.B.FF = (msgid > 0x7ff) ? CAN_frame_ext : CAN_frame_std;
+  frame.FIR.B.DLC = dlc;
+
+  esp_err_t res = m_engine->TransmitFrame(&frame);
+  if (res != ESP_OK && res != ESP_QUEUED)
+    {
+    ESP_LOGD(TAG, "Transmit[%03X]: CAN write failed", m_txid);
+    return false;
+    }
+  m_tx_frames++;
+  return true;
+  }
+
+bool canisotp_channel::SendFlowControl(uint8_t status)
+  {
+  uint8_t buf[3];
+  buf[0] = (ISOTP_FT_FLOWCTRL << 4) | status;
+  buf[1] = m_blocksize;
+  buf[2] = m_stmin;
+  return Transmit(buf, 3);
+  }
+
+/**
+ * SendConsecutive: send due consecutive frames (internal)
+ *  Without separation time, up to ISOTP_MAX_BURST frames are sent per call, so
+ *  the CAN TX queue isn't flooded. If the TX queue is full, the frame is retried
+ *  every millisecond until the channel timeout.
+ */
+void canisotp_channel::SendConsecutive(int64_t now)
+  {
+  uint8_t cfmax = (m_protocol == ISOTP_EXTADR) ? 6 : 7;
+  uint8_t buf[8];
+  int burst = 0;
+  while (m_txstate == TxSending && m_txdue <= now)
+    {
+    if (++burst > ISOTP_MAX_BURST)
+      return;
+    uint16_t len = m_txlen - m_txpos;
+    if (len > cfmax) len = cfmax;
+    buf[0] = (ISOTP_FT_CONSECUTIVE << 4) | (m_txsn & 0x0f);
+    memcpy(&buf[1], m_txdata + m_txpos, len);
+    if (!Transmit(buf, 1 + len))
+      {
+      if (now - m_txlast > m_timeout_ms * 1000LL)
+        TxFinish(ISOTP_ERR_TXFAIL);
+      else
+        m_txdue = now + 1000;
+      return;
+      }
+    m_txlast = now;
+    m_txpos += len;
+    m_txsn++;
+
+    if (m_txpos >= m_txlen)
+      {
+      m_tx_messages++;
+      TxFinish(ISOTP_OK);
+      return;
+      }
+    if (m_txbs && --m_txbscnt == 0)
+      {
+      // block done, wait for next flow control:
+      m_txstate = TxWaitFC;
+      m_txdue = now + m_timeout_ms * 1000LL;
+      return;
+      }
+    m_txdue = now + m_txst_us;
+    }
+  }
+
+void canisotp_channel::TxFinish(int result)
+  {
+  m_txstate = TxIdle;
+  m_txdata = NULL;
+  if (result != ISOTP_OK)
+    {
+    m_errors++;
+    ESP_LOGD(TAG, "TxFinish[%03X]: transmission failed, result=%d", m_txid, result);
+    }
+  if (m_callback)
+    m_callback(this, ISOTP_EVENT_TXDONE, result);
+  }
+
+void canisotp_channel::RxFinish(int result)
+  {
+  m_rxstate = RxIdle;
+  if (result == ISOTP_OK)
+    {
+    m_rx_messages++;
+    }
+  else
+    {
+    m_errors++;
+    ESP_LOGD(TAG, "RxFinish[%03X]: reception failed, result=%d", m_rxid, result);
+    }
+  if (m_callback)
+    m_callback(this, ISOTP_EVENT_RXDONE, result);
+  }
+
+/**
+ * IncomingFrame: process frame if addressed to this channel (internal)
+ *  Returns true if the frame has been consumed.
+ */
+bool canisotp_channel::IncomingFrame(const CAN_frame_t* frame, int64_t now)
+  {
+  if (m_bus && frame->origin != m_bus)
+    return false;
+
+  const uint8_t* data;
+  uint8_t len = frame->FIR.B.DLC;
+  if (len > 8) len = 8;
+  if (m_protocol == ISOTP_EXTADR)
+    {
+    if (frame->MsgID != (m_rxid >> 8) || len < 2 || frame->data.u8[0] != (m_rxid & 0xff))
+      return false;
+    data = &frame->data.u8[1];
+    len--;
+    }
+  else
+    {
+    if (frame->MsgID != m_rxid || len < 1)
+      return false;
+    data = &frame->data.u8[0];
+    }
+
+  m_rx_frames++;
+  switch (data[0] >> 4)
+    {
+    case ISOTP_FT_SINGLE:
+      ReceiveSingle(data, len, now);
+      break;
+    case ISOTP_FT_FIRST:
+      ReceiveFirst(data, len, now);
+      break;
+    case ISOTP_FT_CONSECUTIVE:
+      ReceiveConsecutive(data, len, now);
+      break;
+    case ISOTP_FT_FLOWCTRL:
+      ReceiveFlowControl(data, len, now);
+      break;
+    default:
+      ESP_LOGD(TAG, "IncomingFrame[%03X]: ignoring invalid frame type %u", m_rxid, data[0] >> 4);
+      break;
+    }
+  return true;
+  }
+
+void canisotp_channel::ReceiveSingle(const uint8_t* data, uint8_t len, int64_t now)
+  {
+  uint8_t msglen = data[0] & 0x0f;
+  if (msglen == 0 || msglen > len - 1)
+    return;
+  if (m_rxstate != RxIdle)
+    RxFinish(ISOTP_ERR_ABORTED);
+  if (msglen > m_rxsize)
+    {
+    m_rxlen = msglen;
+    RxFinish(ISOTP_ERR_OVERFLOW);
+    return;
+    }
+  memcpy(m_rxbuf, &data[1], msglen);
+  m_rxlen = m_rxpos = msglen;
+  RxFinish(ISOTP_OK);
+  }
+
+void canisotp_channel::ReceiveFirst(const uint8_t* data, uint8_t len, int64_t now)
+  {
+  if (len < 8 - (m_protocol == ISOTP_EXTADR))
+    return;
+  uint16_t msglen = (data[0] & 0x0f) << 8 | data[1];
+  uint8_t ffdata = len - 2;
+  if (msglen <= ffdata)
+    return;
+  if (m_rxstate != RxIdle)
+    RxFinish(ISOTP_ERR_ABORTED);
+  m_rxlen = msglen;
+  if (msglen > m_rxsize)
+    {
+    SendFlowControl(ISOTP_FC_OVERFLOW);
+    RxFinish(ISOTP_ERR_OVERFLOW);
+    return;
+    }
+  memcpy(m_rxbuf, &data[2], ffdata);
+  m_rxpos = ffdata;
+  m_rxsn = 1;
+  m_rxbscnt = m_blocksize;
+  m_rxstate = RxReceiving;
+  m_rxdue = now + m_timeout_ms * 1000LL;
+  if (!SendFlowControl(ISOTP_FC_CTS))
+    RxFinish(ISOTP_ERR_TXFAIL);
+  }
+
+void canisotp_channel::ReceiveConsecutive(const uint8_t* data, uint8_t len, int64_t now)
+  {
+  if (m_rxstate != RxReceiving)
+    return;
+  if ((data[0] & 0x0f) != (m_rxsn & 0x0f))
+    {
+    RxFinish(ISOTP_ERR_SEQUENCE);
+    return;
+    }
+  uint16_t cflen = m_rxlen - m_rxpos;
+  if (cflen > len - 1) cflen = len - 1;
+  memcpy(m_rxbuf + m_rxpos, &data[1], cflen);
+  m_rxpos += cflen;
+  m_rxsn++;
+
+  if (m_rxpos >= m_rxlen)
+    {
+    RxFinish(ISOTP_OK);
+    return;
+    }
+  m_rxdue = now + m_timeout_ms * 1000LL;
+  if (m_blocksize && --m_rxbscnt == 0)
+    {
+    m_rxbscnt = m_blocksize;
+    if (!SendFlowControl(ISOTP_FC_CTS))
+      RxFinish(ISOTP_ERR_TXFAIL);
+    }
+  }
+
+void canisotp_channel::ReceiveFlowControl(const uint8_t* data, uint8_t len, int64_t now)
+  {
+  if (m_txstate != TxWaitFC || len < 3)
+    return;
+  switch (data[0] & 0x0f)
+    {
+    case ISOTP_FC_CTS:
+      m_txbs = m_txbscnt = data[1];
+      m_txst_us = isotp_decode_stmin(data[2]);
+      m_txwait = 0;
+      m_txstate = TxSending;
+      m_txdue = m_txlast = now;
+      SendConsecutive(now);
+      break;
+    case ISOTP_FC_WAIT:
+      if (++m_txwait > ISOTP_MAX_WAIT)
+        TxFinish(ISOTP_ERR_WAIT);
+      else
+        m_txdue = now + m_timeout_ms * 1000LL;
+      break;
+    case ISOTP_FC_OVERFLOW:
+      TxFinish(ISOTP_ERR_OVERFLOW);
+      break;
+    default:
+      break;
+    }
+  }
+
+/**
+ * Process: send due frames, check timeouts (internal)
+ */
+void canisotp_channel::Process(int64_t now)
+  {
+  if (m_txstate == TxSending)
+    SendConsecutive(now);
+  else if (m_txstate == TxWaitFC && m_txdue <= now)
+    TxFinish(ISOTP_ERR_TIMEOUT);
+  if (m_rxstate == RxReceiving && m_rxdue <= now)
+    RxFinish(ISOTP_ERR_TIMEOUT);
+  }
+
+int64_t canisotp_channel::NextDue()
+  {
+  int64_t due = INT64_MAX;
+  if (m_txstate != TxIdle)
+    due = m_txdue;
+  if (m_rxstate != RxIdle && m_rxdue < due)
+    due = m_rxdue;
+  return due;
+  }
+
+
+/**
+ * canisotp: engine
+ */
+
+canisotp::canisotp()
+  {
+  memset(m_channel, 0, sizeof(m_channel));
+  m_channels = 0;
+  }
+
+canisotp::~canisotp()
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  for (int i = 0; i < m_channels; i++)
+    m_channel[i]->m_engine = NULL;
+  m_channels = 0;
+  }
+
+/**
+ * Attach: add channel to the engine
+ *  Returns false if the channel limit has been reached.
+ */
+bool canisotp::Attach(canisotp_channel* channel)
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  if (channel->m_engine == this)
+    return true;
+  if (channel->m_engine || m_channels == ISOTP_MAX_CHANNELS)
+    return false;
+  channel->m_engine = this;
+  m_channel[m_channels++] = channel;
+  return true;
+  }
+
+void canisotp::Detach(canisotp_channel* channel)
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  for (int i = 0; i < m_channels; i++)
+    {
+    if (m_channel[i] == channel)
+      {
+      m_channel[i] = m_channel[--m_channels];
+      m_channel[m_channels] = NULL;
+      channel->m_engine = NULL;
+      return;
+      }
+    }
+  }
+
+/**
+ * IncomingFrame: pass a received frame to the channels
+ *  Returns true if the frame has been consumed by a channel.
+ */
+bool canisotp::IncomingFrame(const CAN_frame_t* frame)
+  {
+  if (frame->FIR.B.RTR == CAN_RTR)
+    return false;
+  OvmsRecMutexLock lock(&m_mutex);
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < m_channels; i++)
+    {
+    if (m_channel[i]->IncomingFrame(frame, now))
+      return true;
+    }
+  return false;
+  }
+
+/**
+ * Process: send due consecutive frames & handle timeouts
+ */
+void canisotp::Process()
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < m_channels; i++)
+    m_channel[i]->Process(now);
+  }
+
+/**
+ * NextDue: get time of next Process() call needed [us], INT64_MAX = idle
+ */
+int64_t canisotp::NextDue()
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  int64_t due = INT64_MAX;
+  for (int i = 0; i < m_channels; i++)
+    {
+    int64_t chdue = m_channel[i]->NextDue();
+    if (chdue < due)
+      due = chdue;
+    }
+  return due;
+  }
+
+/**
+ * NextDueTicks: get wait time until next Process() call in FreeRTOS ticks
+ *  for use as a queue receive timeout. Sub tick separation times round
+ *  down to 0 (= poll), idle engines return portMAX_DELAY.
+ */
+TickType_t canisotp::NextDueTicks()
+  {
+  int64_t due = NextDue();
+  if (due == INT64_MAX)
+    return portMAX_DELAY;
+  int64_t wait = due - esp_timer_get_time();
+  if (wait <= 0)
+    return 0;
+  return (TickType_t) (wait / (1000 * portTICK_PERIOD_MS));
+  }
+
+/**
+ * TransmitFrame: send a frame on the channel's bus
+ */
+esp_err_t canisotp::TransmitFrame(CAN_frame_t* frame)
+  {
+  if (!frame->origin)
+    return ESP_FAIL;
+  return frame->Write();
+  }
@@ -0,0 +1,217 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __CAN_ISOTP_H__
+#define __CAN_ISOTP_H__
+
+#include <stdint.h>
+#include <functional>
+#include "can.h"
+#include "ovms_mutex.h"
+
+// ISO TP:
+//  (see https://en.wikipedia.org/wiki/ISO_15765-2)
+
+#define ISOTP_FT_SINGLE                 0
+#define ISOTP_FT_FIRST                  1
+#define ISOTP_FT_CONSECUTIVE            2
+#define ISOTP_FT_FLOWCTRL               3
+
+// Protocol variant:
+#define ISOTP_STD                       0     // standard addressing (11 bit IDs)
+#define ISOTP_EXTADR                    1     // extended addressing (19 bit IDs)
+
+// Flow control status:
+#define ISOTP_FC_CTS                    0     // continue to send
+#define ISOTP_FC_WAIT                   1
+#define ISOTP_FC_OVERFLOW               2
+
+#define ISOTP_MAX_LENGTH                4095  // max message length
+#define ISOTP_MAX_CHANNELS              8     // max channels per engine
+#define ISOTP_MAX_WAIT                  10    // max consecutive FC WAIT frames accepted
+#define ISOTP_MAX_BURST                 8     // max frames sent per Process() call
+#define ISOTP_DEFAULT_TIMEOUT           1000  // N_Bs / N_Cr timeout [ms]
+
+// Transfer results:
+#define ISOTP_OK                        0
+#define ISOTP_ERR_BUSY                  -1    // channel busy with another transmission
+#define ISOTP_ERR_LENGTH                -2    // invalid message length
+#define ISOTP_ERR_TIMEOUT               -3    // no flow control / consecutive frame in time
+#define ISOTP_ERR_OVERFLOW              -4    // message too long for receiver
+#define ISOTP_ERR_SEQUENCE              -5    // unexpected consecutive frame sequence number
+#define ISOTP_ERR_WAIT                  -6    // too many FC WAIT frames
+#define ISOTP_ERR_TXFAIL                -7    // CAN frame transmission failed
+#define ISOTP_ERR_ABORTED               -8    // aborted by application / new message
+
+typedef enum
+  {
+  ISOTP_EVENT_TXDONE = 0,                     // transmission finished (result = ISOTP_OK / error)
+  ISOTP_EVENT_RXDONE,                         // reception finished (result = ISOTP_OK / error)
+  } canisotp_event_t;
+
+class canisotp;
+class canisotp_channel;
+
+/**
+ * canisotp_callback: transfer completion callback
+ *  Called by the engine (with the engine locked) on completion or failure of a
+ *  transmission or reception. On ISOTP_EVENT_RXDONE/ISOTP_OK, the message is
+ *  available in the channel's receive buffer (GetRxLength() bytes). The buffer
+ *  may be reused by the next reception after the callback returns.
+ */
+typedef std::function<void(canisotp_channel* channel, canisotp_event_t event, int result)> canisotp_callback;
+
+/**
+ * canisotp_channel: ISO-TP connection between the module and one peer
+ *  A channel sends to <txid> and receives from <rxid>. With extended addressing,
+ *  the IDs are (CAN ID << 8 | address byte), as with the vehicle poller.
+ *  The channel does no memory allocations: the application provides the receive
+ *  buffer, and the data passed to Send() needs to stay valid until the transfer
+ *  has finished (see callback). Transmission and reception are independent, so
+ *  a channel can receive a response while still sending a large request.
+ */
+class canisotp_channel
+  {
+  friend class canisotp;
+
+  public:
+    canisotp_channel();
+    ~canisotp_channel();
+
+  public:
+    void Configure(canbus* bus, uint32_t txid, uint32_t rxid, uint8_t protocol=ISOTP_STD);
+    void SetRxBuffer(uint8_t* buffer, uint16_t size);
+    void SetFlowControl(uint8_t blocksize, uint8_t stmin);
+    void SetPadding(int padbyte);
+    void SetTimeout(uint16_t timeout_ms);
+    void SetCallback(canisotp_callback callback);
+
+  public:
+    int Send(const uint8_t* data, uint16_t length);
+    void Abort();
+    bool IsSending() { return m_txstate != TxIdle; }
+    bool IsReceiving() { return m_rxstate != RxIdle; }
+    uint16_t GetRxLength() { return m_rxlen; }
+    const uint8_t* GetRxData() { return m_rxbuf; }
+
+  protected:
+    bool IncomingFrame(const CAN_frame_t* frame, int64_t now);
+    void Process(int64_t now);
+    int64_t NextDue();
+
+  protected:
+    void ReceiveSingle(const uint8_t* data, uint8_t len, int64_t now);
+    void ReceiveFirst(const uint8_t* data, uint8_t len, int64_t now);
+    void ReceiveConsecutive(const uint8_t* data, uint8_t len, int64_t now);
+    void ReceiveFlowControl(const uint8_t* data, uint8_t len, int64_t now);
+    void SendConsecutive(int64_t now);
+    bool SendFlowControl(uint8_t status);
+    bool Transmit(const uint8_t* data, uint8_t len);
+    void TxFinish(int result);
+    void RxFinish(int result);
+
+  public:
+    canbus*           m_bus;
+    uint32_t          m_txid;
+    uint32_t          m_rxid;
+    uint8_t           m_protocol;         // ISOTP_STD / ISOTP_EXTADR
+    uint8_t           m_blocksize;        // our FC block size (0 = no limit)
+    uint8_t           m_stmin;            // our FC separation time (ISO-TP encoding)
+    int16_t           m_padding;          // frame padding byte, -1 = send short frames
+    uint16_t          m_timeout_ms;
+
+    // Statistics:
+    uint32_t          m_tx_messages;
+    uint32_t          m_rx_messages;
+    uint32_t          m_tx_frames;
+    uint32_t          m_rx_frames;
+    uint32_t          m_errors;
+
+  protected:
+    canisotp*         m_engine;
+    canisotp_callback m_callback;
+
+    enum { TxIdle, TxWaitFC, TxSending } m_txstate;
+    const uint8_t*    m_txdata;
+    uint16_t          m_txlen;
+    uint16_t          m_txpos;
+    uint8_t           m_txsn;             // next sequence number
+    uint8_t           m_txbs;             // peer block size
+    uint8_t           m_txbscnt;          // frames left in current block
+    uint8_t           m_txwait;           // FC WAIT frames received
+    uint32_t          m_txst_us;          // peer separation time [us]
+    int64_t           m_txdue;            // next frame / timeout time [us]
+    int64_t           m_txlast;           // last frame sent [us]
+
+    enum { RxIdle, RxReceiving } m_rxstate;
+    uint8_t*          m_rxbuf;
+    uint16_t          m_rxsize;
+    uint16_t          m_rxlen;            // message length
+    uint16_t          m_rxpos;
+    uint8_t           m_rxsn;             // expected sequence number
+    uint8_t           m_rxbscnt;          // frames left until next FC
+    int64_t           m_rxdue;            // timeout time [us]
+  };
+
+/**
+ * canisotp: ISO-TP engine for a set of channels
+ *  Feed received frames into IncomingFrame() and call Process() when NextDue()
+ *  has been reached, e.g. from a task waiting on a CAN queue with a timeout.
+ *  Frames are sent by TransmitFrame(), which can be overridden to route frames
+ *  to a different transport (e.g. a loopback for tests).
+ */
+class canisotp
+  {
+  friend class canisotp_channel;
+
+  public:
+    canisotp();
+    virtual ~canisotp();
+
+  public:
+    bool Attach(canisotp_channel* channel);
+    void Detach(canisotp_channel* channel);
+    bool IncomingFrame(const CAN_frame_t* frame);
+    void Process();
+    int64_t NextDue();
+    TickType_t NextDueTicks();
+
+  protected:
+    virtual esp_err_t TransmitFrame(CAN_frame_t* frame);
+
+  protected:
+    OvmsRecMutex      m_mutex;
+    canisotp_channel* m_channel[ISOTP_MAX_CHANNELS];
+    int               m_channels;
+  };
+
+extern uint32_t isotp_decode_stmin(uint8_t stmin);
+
+#endif //#ifndef __CAN_ISOTP_H__
@@ -41,6 +41,7 @@ static const char *TAG = "canlog";
 #include "ovms_events.h"
 #include "ovms_peripherals.h"
 #include "metrics_standard.h"
+#include "ovms_mempool.h"
 
 ////////////////////////////////////////////////////////////////////////
 // Command Processing
@@ -202,7 +203,7 @@ canlog::~canlog()
         case CAN_LogInfo_Comment:
         case CAN_LogInfo_Config:
         case CAN_LogInfo_Event:
-          free(msg.text);
+          MyExtRamPool.Free(msg.text);
           break;
         default:
           break;
@@ -238,7 +239,7 @@ void canlog::RxTask(void *context)
         case CAN_LogInfo_Config:
         case CAN_LogInfo_Event:
           me->OutputMsg(msg);
-          free(msg.text);
+          MyExtRamPool.Free(msg.text);
           break;
         default:
           me->OutputMsg(msg);
@@ -378,7 +379,7 @@ void canlog::LogInfo(canbus* bus, CAN_log_type_t type, const char* text)
     msg.type = type;
     gettimeofday(&msg.timestamp,NULL);
     msg.origin = bus;
-    msg.text = strdup(text);
+    msg.text = MyExtRamPool.Strdup(text);
     m_msgcount++;
     if (xQueueSend(m_queue, &msg, 0) != pdTRUE) m_dropcount++;
     }
@@ -377,6 +377,7 @@ const std::string CANopen::GetResultString(const CANopenResult_t result)
     case COR_ERR_Timeout:               name = "Timeout"; break;
     case COR_ERR_SDO_Access:            name = "SDO access failed"; break;
     case COR_ERR_SDO_SegMismatch:       name = "SDO segment mismatch"; break;
+    case COR_ERR_SDO_CRCMismatch:       name = "SDO block CRC mismatch"; break;
 
     case COR_ERR_DeviceOffline:         name = "Device offline"; break;
     case COR_ERR_UnknownDevice:         name = "Unknown device"; break;
@@ -57,6 +57,7 @@ typedef enum __attribute__ ((__packed__))
   COR_ERR_Timeout,
   COR_ERR_SDO_Access,
   COR_ERR_SDO_SegMismatch,
+  COR_ERR_SDO_CRCMismatch,
   
   // General purpose application level:
   COR_ERR_DeviceOffline = 0x80,
@@ -245,9 +246,14 @@ class CANopenWorker
     CANopenResult_t ProcessWriteSDOJob();
   
   private:
-    void SendSDORequest();
+    void SendSDORequest(TickType_t maxqueuewait=0);
     void AbortSDORequest(uint32_t reason);
     CANopenResult_t ExecuteSDORequest();
+    bool ReceiveSDOBlockFrame(CANopenFrame_t& frame);
+    int UploadSDOBlock(CANopenResult_t& result);
+    int DownloadSDOBlock(CANopenResult_t& result);
+    bool IsSDOBlockSupported(uint8_t nodeid);
+    void SetSDOBlockSupported(uint8_t nodeid, bool supported);
 
   public:
     canbus*               m_bus;            // max one worker per bus
@@ -264,6 +270,13 @@ class CANopenWorker
     uint32_t              m_jobcnt_timeout;
     uint32_t              m_jobcnt_error;
     
+    uint32_t              m_sdo_rxbytes;    // SDO upload statistics…
+    uint64_t              m_sdo_rxtime_us;
+    uint32_t              m_sdo_txbytes;    // SDO download statistics…
+    uint64_t              m_sdo_txtime_us;
+    uint32_t              m_sdo_blockcnt;   // SDO transfers done in block mode
+    uint32_t              m_sdo_fallbackcnt; // SDO block transfers falling back to segmented mode
+    
     CANopenJob            m_job;            // job currently processed
     
     CANopenNodeMetricsMap m_nodemetrics;    // map: nodeid → node metrics
@@ -271,6 +284,9 @@ class CANopenWorker
   private:
     CANopenFrame_t        m_request;
     CANopenFrame_t        m_response;
+    volatile bool         m_blockmode;      // SDO block transfer running: responses go to m_blockqueue
+    QueueHandle_t         m_blockqueue;     // SDO block transfer rx queue
+    uint32_t              m_sdo_noblock[4]; // bitset: nodes not supporting SDO block transfers
   };
 
 
@@ -29,6 +29,7 @@ static const char *TAG = "canopen";
 #include "ovms_metrics.h"
 #include "metrics_standard.h"
 #include "ovms_events.h"
+#include "esp_timer.h"
 #include "canopen.h"
 
 
@@ -55,13 +56,72 @@ static const char *TAG = "canopen";
 #define SDO_SegmentUnusedMask       0b00001110
 #define SDO_SegmentEnd              0b00000001
 
+#define SDO_BlockUploadRequest      0b10100000
+#define SDO_BlockUploadResponse     0b11000000
+#define SDO_BlockDownloadRequest    0b11000000
+#define SDO_BlockDownloadResponse   0b10100000
+#define SDO_BlockCRC                0b00000100
+#define SDO_BlockSizeIndicated      0b00000010
+#define SDO_BlockSubcmdMask         0b00000011
+#define SDO_BlockUploadSubcmdMask   0b00000001    // server upload responses: ss is bit 0 only
+#define SDO_BlockInit               0b00000000
+#define SDO_BlockEnd                0b00000001
+#define SDO_BlockAck                0b00000010
+#define SDO_BlockStart              0b00000011
+#define SDO_BlockEndUnusedMask      0b00011100
+#define SDO_BlockSegmentLast        0b10000000
+#define SDO_BlockSeqnoMask          0b01111111
+
+// Block upload initiate response: scs=6, ss=0, CRC (sc) & size (s) bits may be set:
+#define SDO_IsBlockUploadInit(ctl)  (((ctl) & (SDO_CommandMask|SDO_BlockUploadSubcmdMask)) \
+                                      == (SDO_BlockUploadResponse|SDO_BlockInit))
+
+static_assert(SDO_IsBlockUploadInit(0xC0) && SDO_IsBlockUploadInit(0xC2)
+  && SDO_IsBlockUploadInit(0xC4) && SDO_IsBlockUploadInit(0xC6),
+  "block upload initiate response with CRC / size indication not accepted");
+static_assert(!SDO_IsBlockUploadInit(0xC1) && !SDO_IsBlockUploadInit(0x80)
+  && !SDO_IsBlockUploadInit(0x41),
+  "block upload end, abort or normal upload response accepted as initiate response");
+
+// SDO block transfer parameters:
+
+#define SDO_BlockSize               32    // segments per block requested on uploads (max 127)
+#define SDO_BlockThreshold          21    // min size for block transfers, protocol switch threshold
+
+#define SDO_BLOCK_DONE              0     // block transfer done (result valid)
+#define SDO_BLOCK_FALLBACK          1     // block transfer not supported, use segmented transfer
+#define SDO_BLOCK_SWITCHED          2     // server switched to expedited/segmented upload
+
 // SDO abort reasons:
 
 #define SDO_Abort_SegMismatch       0x05030000
 #define SDO_Abort_Timeout           0x05040000
+#define SDO_Abort_UnknownCommand    0x05040001
+#define SDO_Abort_SeqNo             0x05040003
+#define SDO_Abort_CRC               0x05040004
 #define SDO_Abort_OutOfMemory       0x05040005
 
 
+/**
+ * SDOBlockCRC: CRC-16-CCITT (polynomial 0x1021, initial value 0) as defined by CiA 301
+ */
+static uint16_t SDOBlockCRC(uint16_t crc, const uint8_t* data, size_t len)
+  {
+  static const uint16_t nibbletab[16] =
+    {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+    };
+  while (len--)
+    {
+    crc = (crc << 4) ^ nibbletab[(crc >> 12) ^ (*data >> 4)];
+    crc = (crc << 4) ^ nibbletab[(crc >> 12) ^ (*data & 0x0f)];
+    data++;
+    }
+  return crc;
+  }
+
+
 static void CANopenWorkerJobTask(void *pvParameters);
 
 
@@ -88,6 +148,17 @@ CANopenWorker::CANopenWorker(canbus* bus)
   m_jobcnt_timeout = 0;
   m_jobcnt_error = 0;
   
+  m_sdo_rxbytes = 0;
+  m_sdo_rxtime_us = 0;
+  m_sdo_txbytes = 0;
+  m_sdo_txtime_us = 0;
+  m_sdo_blockcnt = 0;
+  m_sdo_fallbackcnt = 0;
+  
+  m_blockmode = false;
+  m_blockqueue = xQueueCreate(SDO_BlockSize+2, sizeof(CANopenFrame_t));
+  memset(m_sdo_noblock, 0, sizeof(m_sdo_noblock));
+  
   m_jobqueue = xQueueCreate(20, sizeof(CANopenJob));
   snprintf(m_taskname, sizeof(m_taskname), "OVMS COwrk %s", bus->GetName());
   xTaskCreatePinnedToCore(CANopenWorkerJobTask, m_taskname,
@@ -104,6 +175,7 @@ CANopenWorker::~CANopenWorker()
   {
   vQueueDelete(m_jobqueue);
   vTaskDelete(m_jobtask);
+  vQueueDelete(m_blockqueue);
   }
 
 
@@ -132,6 +204,8 @@ bool CANopenWorker::IsClient(CANopenAsyncClient* client)
 
 void CANopenWorker::StatusReport(int verbosity, OvmsWriter* writer)
   {
+  float rxrate = m_sdo_rxtime_us ? m_sdo_rxbytes * 1000000.0f / m_sdo_rxtime_us : 0;
+  float txrate = m_sdo_txtime_us ? m_sdo_txbytes * 1000000.0f / m_sdo_txtime_us : 0;
   writer->printf(
     "  %s:\n"
     "    Active clients: %d\n"
@@ -141,6 +215,9 @@ void CANopenWorker::StatusReport(int verbosity, OvmsWriter* writer)
     "    - other errors: %d\n"
     "    NMT received  : %d\n"
     "    EMCY received : %d\n"
+    "    SDO read      : %u bytes, %.1f bytes/s\n"
+    "    SDO written   : %u bytes, %.1f bytes/s\n"
+    "    SDO block xfer: %u, fallbacks: %u\n"
     , m_bus->GetName()
     , m_clientcnt
     , (int)uxQueueMessagesWaiting(m_jobqueue)
@@ -148,7 +225,10 @@ void CANopenWorker::StatusReport(int verbosity, OvmsWriter* writer)
     , m_jobcnt_timeout
     , m_jobcnt_error
     , m_nmt_rxcnt
-    , m_emcy_rxcnt);
+    , m_emcy_rxcnt
+    , m_sdo_rxbytes, rxrate
+    , m_sdo_txbytes, txrate
+    , m_sdo_blockcnt, m_sdo_fallbackcnt);
   }
 
 
@@ -238,13 +318,29 @@ void CANopenWorker::JobTask()
             ESP_LOGV(TAG, "ReceiveHB result: %s", CANopen::GetResultString(m_job).c_str());
             break;
           case COJT_ReadSDO:
+            {
             ESP_LOGV(TAG, "ReadSDO: %s node=%d adr=%04x.%02x", m_bus->GetName(), m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex);
+            int64_t start = esp_timer_get_time();
             m_job.result = ProcessReadSDOJob();
+            if (m_job.result == COR_OK)
+              {
+              m_sdo_rxbytes += m_job.sdo.xfersize;
+              m_sdo_rxtime_us += esp_timer_get_time() - start;
+              }
+            }
             ESP_LOGV(TAG, "ReadSDO result: %s", CANopen::GetResultString(m_job).c_str());
             break;
           case COJT_WriteSDO:
+            {
             ESP_LOGV(TAG, "WriteSDO: %s node=%d adr=%04x.%02x", m_bus->GetName(), m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex);
+            int64_t start = esp_timer_get_time();
             m_job.result = ProcessWriteSDOJob();
+            if (m_job.result == COR_OK)
+              {
+              m_sdo_txbytes += m_job.sdo.xfersize;
+              m_sdo_txtime_us += esp_timer_get_time() - start;
+              }
+            }
             ESP_LOGV(TAG, "WriteSDO result: %s", CANopen::GetResultString(m_job).c_str());
             break;
           default:
@@ -282,7 +378,19 @@ void CANopenWorker::JobTask()
 void CANopenWorker::IncomingFrame(CAN_frame_t* p_frame)
   {
   // Message matching our current job?
-  if (m_job.type != COJT_None && p_frame->MsgID == m_job.rxid)
+  if (m_job.type != COJT_None && p_frame->MsgID == m_job.rxid && m_blockmode)
+    {
+    // SDO block transfer: the server sends segments without waiting, queue them:
+    CANopenFrame_t response;
+    int i;
+    for (i=0; i < p_frame->FIR.B.DLC; i++)
+      response.byte[i] = p_frame->data.u8[i];
+    for (; i < 8; i++)
+      response.byte[i] = 0;
+    if (xQueueSend(m_blockqueue, &response, 0) != pdTRUE)
+      ESP_LOGW(TAG, "%s SDO block transfer: rx queue overflow", m_bus->GetName());
+    }
+  else if (m_job.type != COJT_None && p_frame->MsgID == m_job.rxid)
     {
     // copy payload into m_response:
     int i;
@@ -456,7 +564,7 @@ CANopenResult_t CANopenWorker::ProcessReceiveHBJob()
 /**
  * SendSDORequest: asynchronous tx of prepared CANopen SDO request
  */
-void CANopenWorker::SendSDORequest()
+void CANopenWorker::SendSDORequest(TickType_t maxqueuewait /*=0*/)
   {
   // init tx frame:
   CAN_frame_t txframe;
@@ -470,7 +578,7 @@ void CANopenWorker::SendSDORequest()
   memcpy(txframe.data.u8, m_request.byte, 8);
   
   // send:
-  txframe.Write();
+  txframe.Write(NULL, maxqueuewait);
   }
 
 
@@ -523,6 +631,331 @@ CANopenResult_t CANopenWorker::ExecuteSDORequest()
   }
 
 
+/**
+ * IsSDOBlockSupported / SetSDOBlockSupported: remember nodes rejecting block transfers
+ */
+bool CANopenWorker::IsSDOBlockSupported(uint8_t nodeid)
+  {
+  return (m_sdo_noblock[(nodeid >> 5) & 3] & (1 << (nodeid & 31))) == 0;
+  }
+
+void CANopenWorker::SetSDOBlockSupported(uint8_t nodeid, bool supported)
+  {
+  if (supported)
+    m_sdo_noblock[(nodeid >> 5) & 3] &= ~(1 << (nodeid & 31));
+  else
+    m_sdo_noblock[(nodeid >> 5) & 3] |= (1 << (nodeid & 31));
+  }
+
+
+/**
+ * ReceiveSDOBlockFrame: wait for next frame of a block transfer
+ */
+bool CANopenWorker::ReceiveSDOBlockFrame(CANopenFrame_t& frame)
+  {
+  return (xQueueReceive(m_blockqueue, &frame, pdMS_TO_TICKS(m_job.timeout_ms)) == pdTRUE);
+  }
+
+
+/**
+ * UploadSDOBlock: read SDO using the block upload protocol (CiA 301 7.2.4.3.10)
+ *   - segments of a block are collected by IncomingFrame() in m_blockqueue
+ *     and acknowledged once per block, lost segments get repeated by the server
+ *   - data is verified by CRC if supported by the server
+ *   - returns SDO_BLOCK_FALLBACK if the server rejects block transfers, or
+ *     SDO_BLOCK_SWITCHED if the server responded with a normal upload
+ *     (size below protocol switch threshold), m_response then holds the response
+ */
+int CANopenWorker::UploadSDOBlock(CANopenResult_t& result)
+  {
+  CANopenFrame_t frame;
+  uint8_t *buf = m_job.sdo.buf;
+  
+  // initiate block upload:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.exp.control = SDO_BlockUploadRequest | SDO_BlockCRC | SDO_BlockInit;
+  m_request.exp.index = m_job.sdo.index;
+  m_request.exp.subindex = m_job.sdo.subindex;
+  m_request.exp.data[0] = SDO_BlockSize;
+  m_request.exp.data[1] = SDO_BlockThreshold;
+  if (ExecuteSDORequest() != COR_OK)
+    {
+    m_job.sdo.error = SDO_Abort_Timeout;
+    result = COR_ERR_Timeout;
+    return SDO_BLOCK_DONE;
+    }
+  
+  // check response:
+  if ((m_response.exp.control & SDO_CommandMask) == SDO_InitUploadResponse
+    && m_response.exp.index == m_request.exp.index
+    && m_response.exp.subindex == m_request.exp.subindex)
+    {
+    return SDO_BLOCK_SWITCHED;
+    }
+  if (!SDO_IsBlockUploadInit(m_response.exp.control)
+    || m_response.exp.index != m_request.exp.index
+    || m_response.exp.subindex != m_request.exp.subindex)
+    {
+    // not supported by node, or access error (will be reported by the segmented transfer):
+    if ((m_response.exp.control & SDO_CommandMask) != SDO_Abort
+      || m_response.ctl.data == SDO_Abort_UnknownCommand)
+      SetSDOBlockSupported(m_job.sdo.nodeid, false);
+    ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: block upload rejected, falling back to segmented",
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex);
+    return SDO_BLOCK_FALLBACK;
+    }
+  
+  bool crc = (m_response.exp.control & SDO_BlockCRC);
+  if (m_response.exp.control & SDO_BlockSizeIndicated)
+    m_job.sdo.contsize = m_response.ctl.data;
+  else
+    m_job.sdo.contsize = 0; // unknown size
+  
+  // start upload:
+  xQueueReset(m_blockqueue);
+  m_blockmode = true;
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.seg.control = SDO_BlockUploadRequest | SDO_BlockStart;
+  SendSDORequest();
+  
+  // receive blocks:
+  //  the last segment received is held back in seg[] until the end frame
+  //  tells us how many of its bytes are valid
+  uint8_t seg[7];
+  bool segvalid = false, last = false;
+  uint8_t ackseq = 0;
+  result = COR_OK;
+  
+  while (result == COR_OK && !last)
+    {
+    if (!ReceiveSDOBlockFrame(frame))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      result = COR_ERR_Timeout;
+      break;
+      }
+    if (frame.ctl.control == SDO_Abort)
+      {
+      m_job.sdo.error = frame.ctl.data;
+      result = COR_ERR_SDO_Access;
+      break;
+      }
+    
+    uint8_t seqno = frame.seg.control & SDO_BlockSeqnoMask;
+    if (seqno == ackseq + 1)
+      {
+      // next segment in sequence, flush previous:
+      if (segvalid)
+        {
+        if (m_job.sdo.xfersize + 7 > m_job.sdo.bufsize)
+          {
+          AbortSDORequest(SDO_Abort_OutOfMemory);
+          m_job.sdo.error = SDO_Abort_OutOfMemory;
+          result = COR_ERR_BufferTooSmall;
+          break;
+          }
+        memcpy(buf + m_job.sdo.xfersize, seg, 7);
+        m_job.sdo.xfersize += 7;
+        }
+      memcpy(seg, frame.seg.data, 7);
+      segvalid = true;
+      ackseq = seqno;
+      }
+    // else: segment lost, ignore all following segments of this block
+    
+    if (seqno == SDO_BlockSize || (frame.seg.control & SDO_BlockSegmentLast))
+      {
+      // end of block, acknowledge last segment received in sequence:
+      memset(&m_request, 0, sizeof(m_request));
+      m_request.byte[0] = SDO_BlockUploadRequest | SDO_BlockAck;
+      m_request.byte[1] = ackseq;
+      m_request.byte[2] = SDO_BlockSize;
+      SendSDORequest();
+      last = (ackseq == seqno && (frame.seg.control & SDO_BlockSegmentLast));
+      ackseq = 0;
+      }
+    }
+  
+  // end block upload:
+  if (result == COR_OK)
+    {
+    if (!ReceiveSDOBlockFrame(frame))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      result = COR_ERR_Timeout;
+      }
+    else if ((frame.ctl.control & (SDO_CommandMask|SDO_BlockSubcmdMask)) != (SDO_BlockUploadResponse|SDO_BlockEnd))
+      {
+      if (frame.ctl.control == SDO_Abort)
+        m_job.sdo.error = frame.ctl.data;
+      else
+        {
+        AbortSDORequest(SDO_Abort_UnknownCommand);
+        m_job.sdo.error = SDO_Abort_UnknownCommand;
+        }
+      result = COR_ERR_SDO_Access;
+      }
+    else
+      {
+      uint8_t n = 7 - ((frame.ctl.control & SDO_BlockEndUnusedMask) >> 2);
+      if (m_job.sdo.xfersize + n > m_job.sdo.bufsize)
+        {
+        AbortSDORequest(SDO_Abort_OutOfMemory);
+        m_job.sdo.error = SDO_Abort_OutOfMemory;
+        result = COR_ERR_BufferTooSmall;
+        }
+      else
+        {
+        memcpy(buf + m_job.sdo.xfersize, seg, n);
+        m_job.sdo.xfersize += n;
+        uint16_t srvcrc = frame.byte[1] | (frame.byte[2] << 8);
+        if (crc && SDOBlockCRC(0, buf, m_job.sdo.xfersize) != srvcrc)
+          {
+          ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: block CRC mismatch, readlen=%d",
+            m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.xfersize);
+          AbortSDORequest(SDO_Abort_CRC);
+          m_job.sdo.error = SDO_Abort_CRC;
+          result = COR_ERR_SDO_CRCMismatch;
+          }
+        else
+          {
+          memset(&m_request, 0, sizeof(m_request));
+          m_request.seg.control = SDO_BlockUploadRequest | SDO_BlockEnd;
+          SendSDORequest();
+          }
+        }
+      }
+    }
+  
+  m_blockmode = false;
+  m_sdo_blockcnt++;
+  return SDO_BLOCK_DONE;
+  }
+
+
+/**
+ * DownloadSDOBlock: write SDO using the block download protocol (CiA 301 7.2.4.3.9)
+ *   - sends blocks of the size requested by the server, repeats segments
+ *     not acknowledged by the server
+ *   - adds a CRC if supported by the server
+ *   - returns SDO_BLOCK_FALLBACK if the server rejects block transfers
+ */
+int CANopenWorker::DownloadSDOBlock(CANopenResult_t& result)
+  {
+  CANopenFrame_t frame;
+  uint8_t *buf = m_job.sdo.buf;
+  size_t size = m_job.sdo.bufsize;
+  
+  // initiate block download:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.exp.control = SDO_BlockDownloadRequest | SDO_BlockCRC | SDO_BlockSizeIndicated | SDO_BlockInit;
+  m_request.exp.index = m_job.sdo.index;
+  m_request.exp.subindex = m_job.sdo.subindex;
+  m_request.ctl.data = size;
+  if (ExecuteSDORequest() != COR_OK)
+    {
+    m_job.sdo.error = SDO_Abort_Timeout;
+    result = COR_ERR_Timeout;
+    return SDO_BLOCK_DONE;
+    }
+  
+  // check response:
+  if ((m_response.exp.control & (SDO_CommandMask|SDO_BlockSubcmdMask)) != (SDO_BlockDownloadResponse|SDO_BlockInit)
+    || m_response.exp.index != m_request.exp.index
+    || m_response.exp.subindex != m_request.exp.subindex
+    || m_response.exp.data[0] == 0 || m_response.exp.data[0] > 127)
+    {
+    if ((m_response.exp.control & SDO_CommandMask) != SDO_Abort
+      || m_response.ctl.data == SDO_Abort_UnknownCommand)
+      SetSDOBlockSupported(m_job.sdo.nodeid, false);
+    ESP_LOGD(TAG, "WriteSDO #%d 0x%04x.%02x: block download rejected, falling back to segmented",
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex);
+    return SDO_BLOCK_FALLBACK;
+    }
+  
+  bool crc = (m_response.exp.control & SDO_BlockCRC);
+  uint8_t blksize = m_response.exp.data[0];
+  
+  xQueueReset(m_blockqueue);
+  m_blockmode = true;
+  result = COR_OK;
+  
+  // send blocks:
+  size_t pos = 0;
+  while (result == COR_OK && pos < size)
+    {
+    size_t p = pos;
+    uint8_t seqno;
+    for (seqno = 1; seqno <= blksize && p < size; seqno++, p += 7)
+      {
+      size_t n = std::min((size_t)7, size - p);
+      memset(&m_request, 0, sizeof(m_request));
+      m_request.seg.control = seqno | ((p + n == size) ? SDO_BlockSegmentLast : 0);
+      memcpy(m_request.seg.data, buf + p, n);
+      SendSDORequest(pdMS_TO_TICKS(m_job.timeout_ms));
+      }
+    seqno--;
+    
+    // wait for block acknowledge:
+    if (!ReceiveSDOBlockFrame(frame))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      result = COR_ERR_Timeout;
+      }
+    else if (frame.ctl.control == SDO_Abort)
+      {
+      m_job.sdo.error = frame.ctl.data;
+      result = COR_ERR_SDO_Access;
+      }
+    else if ((frame.ctl.control & (SDO_CommandMask|SDO_BlockSubcmdMask)) != (SDO_BlockDownloadResponse|SDO_BlockAck)
+      || frame.byte[1] > seqno || frame.byte[2] == 0 || frame.byte[2] > 127)
+      {
+      AbortSDORequest(SDO_Abort_SeqNo);
+      m_job.sdo.error = SDO_Abort_SeqNo;
+      result = COR_ERR_SDO_SegMismatch;
+      }
+    else
+      {
+      // continue after last segment acknowledged:
+      pos = std::min(pos + frame.byte[1] * 7, size);
+      m_job.sdo.xfersize = pos;
+      blksize = frame.byte[2];
+      }
+    }
+  
+  // end block download:
+  if (result == COR_OK)
+    {
+    uint8_t unused = (7 - size % 7) % 7;
+    uint16_t crcval = crc ? SDOBlockCRC(0, buf, size) : 0;
+    memset(&m_request, 0, sizeof(m_request));
+    m_request.byte[0] = SDO_BlockDownloadRequest | SDO_BlockEnd | (unused << 2);
+    m_request.byte[1] = crcval & 0xff;
+    m_request.byte[2] = crcval >> 8;
+    SendSDORequest();
+    
+    if (!ReceiveSDOBlockFrame(frame))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      result = COR_ERR_Timeout;
+      }
+    else if ((frame.ctl.control & (SDO_CommandMask|SDO_BlockSubcmdMask)) != (SDO_BlockDownloadResponse|SDO_BlockEnd))
+      {
+      m_job.sdo.error = (frame.ctl.control == SDO_Abort) ? frame.ctl.data : CANopen_BusCollision;
+      result = (m_job.sdo.error == SDO_Abort_CRC) ? COR_ERR_SDO_CRCMismatch : COR_ERR_SDO_Access;
+      }
+    }
+  
+  m_blockmode = false;
+  m_sdo_blockcnt++;
+  return SDO_BLOCK_DONE;
+  }
+
+
 /**
  * ProcessReadSDOJob: read bytes from SDO server into buffer
  *   - reads data into m_job.sdo.buf (up to m_job.sdo.bufsize bytes)
@@ -554,12 +987,26 @@ CANopenResult_t CANopenWorker::ProcessReadSDOJob()
   uint8_t *buf = m_job.sdo.buf;
   m_job.sdo.xfersize = 0;
   
+  // try block upload for larger buffers:
+  bool switched = false;
+  if (m_job.sdo.bufsize > SDO_BlockThreshold && IsSDOBlockSupported(m_job.sdo.nodeid))
+    {
+    CANopenResult_t result;
+    int mode = UploadSDOBlock(result);
+    if (mode == SDO_BLOCK_DONE)
+      return result;
+    else if (mode == SDO_BLOCK_SWITCHED)
+      switched = true;
+    else
+      m_sdo_fallbackcnt++;
+    }
+  
   // request upload:
   memset(&m_request, 0, sizeof(m_request));
   m_request.exp.index = m_job.sdo.index;
   m_request.exp.subindex = m_job.sdo.subindex;
   m_request.exp.control = SDO_InitUploadRequest;
-  if (ExecuteSDORequest() != COR_OK)
+  if (!switched && ExecuteSDORequest() != COR_OK)
     {
     m_job.sdo.error = SDO_Abort_Timeout;
     return COR_ERR_Timeout;
@@ -684,6 +1131,15 @@ CANopenResult_t CANopenWorker::ProcessWriteSDOJob()
   uint8_t *buf = m_job.sdo.buf;
   m_job.sdo.xfersize = 0;
   
+  // try block download for larger transfers:
+  if (m_job.sdo.bufsize > SDO_BlockThreshold && IsSDOBlockSupported(m_job.sdo.nodeid))
+    {
+    CANopenResult_t result;
+    if (DownloadSDOBlock(result) == SDO_BLOCK_DONE)
+      return result;
+    m_sdo_fallbackcnt++;
+    }
+  
   // request download:
   memset(&m_request, 0, sizeof(m_request));
   m_request.exp.index = m_job.sdo.index;
@@ -51,6 +51,28 @@ const uint8_t cb64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz012345
 // Translation Table to decode (created by author)
 const uint8_t cd64[]="|$$$}rstuvwxyz{$$$$$$$>?@ABCDEFGHIJKLMNOPQRSTUVW$$$$$$XYZ[\\]^_`abcdefghijklmnopq";
 
+// Direct decode table for the fast path: 6 bit value or -1 for any
+// character not part of the RFC1113 alphabet (including '=' and NUL)
+static const int8_t dd64[256] =
+  {
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
+  52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+  -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+  15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+  -1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+  41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  };
+
 void encodeblock( uint8_t *in, uint8_t *out, int len )
   {
   out[0] = cb64[ in[0] >> 2 ];
@@ -63,24 +85,28 @@ char *base64encode(const uint8_t *inputData, int inputLen, uint8_t *outputData)
   {
   uint8_t in[4];
   uint8_t out[4];
-  int len = 0;
+  uint32_t v;
   int k;
-  for (k=0;k<inputLen;k++)
+
+  // Full blocks:
+  for (k = inputLen / 3; k > 0; k--)
     {
-    in[len++] = inputData[k];
-    if (len==3)
-      {
-      // Block is full
-      encodeblock(in, out, 3);
-      for (len=0;len<4;len++) *outputData++ = out[len];
-      len = 0;
-      }
+    v = (inputData[0] << 16) | (inputData[1] << 8) | inputData[2];
+    outputData[0] = cb64[v >> 18];
+    outputData[1] = cb64[(v >> 12) & 0x3f];
+    outputData[2] = cb64[(v >> 6) & 0x3f];
+    outputData[3] = cb64[v & 0x3f];
+    inputData += 3;
+    outputData += 4;
     }
+
+  // Padded tail block:
+  int len = inputLen % 3;
   if (len>0)
     {
-    for (k=len;k<3;k++) in[k]=0;
+    for (k=0;k<3;k++) in[k] = (k<len) ? inputData[k] : 0;
     encodeblock(in, out, len);
-    for (len=0;len<4;len++) *outputData++ = out[len];
+    for (k=0;k<4;k++) *outputData++ = out[k];
     }
   *outputData = 0;
   return (char*)outputData;
@@ -121,7 +147,7 @@ void decodeblock(uint8_t *in, uint8_t *out )
   out[ 2 ] = (unsigned char ) (((in[2] << 6) & 0xc0) | in[3]);
   }
 
-int base64decode(const char *inputData, uint8_t *outputData)
+static int base64decode_generic(const char *inputData, uint8_t *outputData)
   {
   uint8_t in[4];
   uint8_t out[4];
@@ -171,6 +197,39 @@ int base64decode(const char *inputData, uint8_t *outputData)
   return written;
   }
 
+/**
+ * base64decode: decodes as many clean 4 character groups as possible
+ * using the direct table, then hands over to the generic decoder at the
+ * first padding, line break or invalid character. The output never
+ * overtakes the input, so decoding in place (outputData == inputData)
+ * is safe.
+ */
+int base64decode(const char *inputData, uint8_t *outputData)
+  {
+  const uint8_t *in = (const uint8_t*) inputData;
+  int8_t a, b, c, d;
+  uint32_t v;
+  int written = 0;
+
+  while (true)
+    {
+    // Note: the table maps NUL to -1, so we never read beyond the end
+    if ((a = dd64[in[0]]) < 0) break;
+    if ((b = dd64[in[1]]) < 0) break;
+    if ((c = dd64[in[2]]) < 0) break;
+    if ((d = dd64[in[3]]) < 0) break;
+    v = (a << 18) | (b << 12) | (c << 6) | d;
+    outputData[0] = (uint8_t) (v >> 16);
+    outputData[1] = (uint8_t) (v >> 8);
+    outputData[2] = (uint8_t) v;
+    in += 4;
+    outputData += 3;
+    written += 3;
+    }
+
+  return written + base64decode_generic((const char*) in, outputData);
+  }
+
 std::string base64decode(const std::string inputData)
   {
   uint8_t in[4];
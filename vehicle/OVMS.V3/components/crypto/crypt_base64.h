@@ -33,7 +33,12 @@
 
 extern const uint8_t cb64[];
 
+// base64encode: encodes in place if inputData is placed at the end of the output
+//  area, i.e. inputData = outputData + howmany(inputLen,3)*4 - inputLen.
+//  Returns pointer to the terminating NUL.
 char *base64encode(const uint8_t *inputData, int inputLen, uint8_t *outputData);
+// base64decode: may decode in place (outputData == inputData).
+//  Returns number of bytes written (excluding the terminating NUL).
 int base64decode(const char *inputData, uint8_t *outputData);
 
 std::string base64encode(const std::string inputData);
@@ -63,29 +63,81 @@ void RC4_setup(RC4_CTX1 *ctx1, RC4_CTX2 *ctx2, const uint8_t *key, int length)
     }
   }
 
+// Advance the cipher state by one step, yielding the next keystream byte in k
+#define RC4_STEP(k) \
+  a = m[++x]; \
+  y += a; \
+  m[x] = b = m[y]; \
+  m[y] = a; \
+  k = m[(uint8_t)(a + b)]
+
 /**
  * Perform the encrypt/decrypt operation (can use it for either since
  * this is a stream cipher).
+ *
+ * The keystream is generated four bytes at a time and applied to the
+ * message as 32 bit words once the message pointer is word aligned.
  */
 void RC4_crypt(RC4_CTX1 *ctx1, RC4_CTX2 *ctx2, uint8_t *msg, int length)
   {
-  int i;
-  uint8_t *m, x, y, a, b;
+  uint8_t *m, x, y, a, b, k;
+  union { uint32_t w; uint8_t b[4]; } ks;
 
   x = ctx1->x;
   y = ctx1->y;
   m = ctx2->m;
 
-  for (i = 0; i < length; i++)
+  // Unaligned head:
+  while (length > 0 && ((uintptr_t)msg & 3) != 0)
+    {
+    RC4_STEP(k);
+    *msg++ ^= k;
+    length--;
+    }
+
+  // Aligned words:
+  uint32_t *w = (uint32_t*) msg;
+  while (length >= 4)
     {
-    a = m[++x];
-    y += a;
-    m[x] = b = m[y];
-    m[y] = a;
-    msg[i] ^= m[(uint8_t)(a + b)];
+    RC4_STEP(ks.b[0]);
+    RC4_STEP(ks.b[1]);
+    RC4_STEP(ks.b[2]);
+    RC4_STEP(ks.b[3]);
+    *w++ ^= ks.w;
+    length -= 4;
+    }
+
+  // Tail:
+  msg = (uint8_t*) w;
+  while (length > 0)
+    {
+    RC4_STEP(k);
+    *msg++ ^= k;
+    length--;
     }
 
   ctx1->x = x;
   ctx1->y = y;
   }
 
+/**
+ * Discard the next length bytes of the keystream (i.e. RC4-drop[n])
+ * without needing a buffer to encrypt.
+ */
+void RC4_skip(RC4_CTX1 *ctx1, RC4_CTX2 *ctx2, int length)
+  {
+  uint8_t *m, x, y, a, b, k;
+
+  x = ctx1->x;
+  y = ctx1->y;
+  m = ctx2->m;
+
+  while (length-- > 0)
+    {
+    RC4_STEP(k);
+    }
+  (void)k;
+
+  ctx1->x = x;
+  ctx1->y = y;
+  }
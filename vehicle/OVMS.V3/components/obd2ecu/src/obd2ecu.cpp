@@ -34,10 +34,12 @@ static const char *TAG = "obd2ecu";
 
 #include <string.h>
 #include <dirent.h>
+#include "esp_timer.h"
 #include "obd2ecu.h"
 #include "ovms_script.h"
 #include "ovms_config.h"
 #include "ovms_command.h"
+#include "ovms_events.h"
 #include "ovms_peripherals.h"
 #include "metrics_standard.h"
 
@@ -168,8 +170,15 @@ obd2ecu::obd2ecu(const char* name, canbus* can)
   m_rxqueue = xQueueCreate(20,sizeof(CAN_frame_t));
 
   m_starttime = time(NULL);
+  memset(m_cache, 0, sizeof(m_cache));
+  ResetStats();
   LoadMap();
 
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyMetrics.RegisterListener(TAG, "*", std::bind(&obd2ecu::MetricModified, this, _1));
+  MyEvents.RegisterEvent(TAG, "ticker.10", std::bind(&obd2ecu::Ticker10, this, _1, _2));
+
   xTaskCreatePinnedToCore(OBD2ECU_task, "OVMS OBDII ECU", 6144, (void*)this, 5, &m_task, CORE(1));
 
   MyCan.RegisterListener(m_rxqueue);
@@ -179,6 +188,8 @@ obd2ecu::~obd2ecu()
   {
   m_can->SetPowerMode(Off);
   MyCan.DeregisterListener(m_rxqueue);
+  MyEvents.DeregisterEvent(TAG);
+  MyMetrics.DeregisterListener(TAG);
 
   vQueueDelete(m_rxqueue);
   vTaskDelete(m_task);
@@ -281,6 +292,39 @@ void obd2ecu_reload(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
   writer->puts("OBDII ECU pid map reloaded");
   }
 
+void obd2ecu_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  obd2ecu* ecu = MyPeripherals->m_obd2ecu;
+  if (ecu == NULL)
+    {
+    writer->puts("Need to start ecu process first");
+    return;
+    }
+
+  if (argc > 0 && strcmp(argv[0], "reset") == 0)
+    {
+    ecu->ResetStats();
+    writer->puts("OBDII ECU statistics reset");
+    return;
+    }
+
+  uint32_t requests = ecu->m_stat_requests;
+  uint32_t cached = ecu->m_stat_cached;
+  uint32_t direct = requests - cached;
+
+  writer->printf("Running on:     %s\n", ecu->m_can->GetName());
+  writer->printf("Cached PIDs:    %d\n", ecu->CacheSize());
+  writer->printf("Cache updates:  %u\n", ecu->m_stat_updates);
+  writer->printf("Requests:       %u\n", requests);
+  writer->printf("  from cache:   %u (%.1f%%)\n", cached,
+    (requests > 0) ? (float) cached * 100 / requests : 0.0);
+  writer->printf("  computed:     %u\n", direct);
+  writer->printf("Requests/s:     %.1f (max %.1f)\n", ecu->m_stat_rate, ecu->m_stat_rate_max);
+  writer->printf("Turnaround:     %u us cached, %u us computed (average)\n",
+    (cached > 0) ? (unsigned)(ecu->m_stat_time_cached / cached) : 0,
+    (direct > 0) ? (unsigned)(ecu->m_stat_time_direct / direct) : 0);
+  }
+
 
   /* PID Format Table  (see: https://en.wikipedia.org/widi/OBD-II_PIDs )
 
@@ -485,6 +529,7 @@ void obd2ecu::IncomingFrame(CAN_frame_t* p_frame)
   uint8_t mapped_pid;
   float metric;
   char rtn_string[21];
+  int64_t starttime = esp_timer_get_time();
 
   uint8_t *p_d = p_frame->data.u8;  /* Incoming frame data from HUD / Dongle */
   uint8_t *r_d = r_frame.data.u8;  /* Response frame data being sent back to HUD / Dongle */
@@ -515,13 +560,41 @@ void obd2ecu::IncomingFrame(CAN_frame_t* p_frame)
     case 1:  /* Mode 1 (main real-time PIDs are here */
 
       mapped_pid = p_d[2];
+      m_stat_requests++;
+
+      /* serve from the precomputed response table if possible */
+      if (mapped_pid < OBD2ECU_CACHE_PIDS)
+        {
+        bool cached;
+          {
+          OvmsMutexLock lock(&m_cache_mutex);
+          cached = m_cache[mapped_pid].valid;
+          if (cached)
+            memcpy(r_d, m_cache[mapped_pid].data, 8);
+          }
+        if (cached)
+          {
+          r_frame.origin = NULL;
+          r_frame.FIR.U = 0;
+          r_frame.FIR.B.DLC = 8;
+          r_frame.FIR.B.FF = CAN_frame_format_t (reply != RESPONSE_PID);
+          r_frame.MsgID = reply;
+          m_can->Write(&r_frame);
+          m_stat_cached++;
+          m_stat_time_cached += esp_timer_get_time() - starttime;
+          break;
+          }
+        }
+
       if (m_pidmap.find(mapped_pid) != m_pidmap.end()) // m_pidmap[pid] contains the obd2pid object to work with
       { metric = m_pidmap[mapped_pid]->Execute();
       }
       else
       { if (MyConfig.GetParamValueBool("obd2ecu","autocreate"))
-          m_pidmap[mapped_pid] = new obd2pid(mapped_pid); // Creates it as Unimplemented, if enabled
-          // note: don't 'Addpid' the PID to the supported vectors.  Only done when support set by config.
+          { m_pidmap[mapped_pid] = new obd2pid(mapped_pid); // Creates it as Unimplemented, if enabled
+            // note: don't 'Addpid' the PID to the supported vectors.  Only done when support set by config.
+            CacheSetup(mapped_pid);
+          }
         metric = 0.0;
       }
 
@@ -633,6 +706,7 @@ void obd2ecu::IncomingFrame(CAN_frame_t* p_frame)
           m_can->Write(&r_frame);
 
 	}
+      m_stat_time_direct += esp_timer_get_time() - starttime;
       break;
 
     case 9:
@@ -813,6 +887,8 @@ void obd2ecu::LoadMap()
     closedir(dir);
     }
   #endif //#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+
+  CacheRebuild();
   }
 
 void obd2ecu::ClearMap()
@@ -825,6 +901,113 @@ void obd2ecu::ClearMap()
   m_supported_01_20 = 0;
   m_supported_21_40 = 0;
 
+  OvmsMutexLock lock(&m_cache_mutex);
+  for (int pid=0; pid<OBD2ECU_CACHE_PIDS; pid++)
+    {
+    m_cache[pid].valid = false;
+    m_cache[pid].metric = NULL;
+    }
+  }
+
+/*
+ * Response cache: Mode 1 replies for metric & unimplemented PIDs are precomputed
+ * and refreshed by the metric listener when the backing metric changes. PIDs
+ * depending on other state (capabilities, RPM jitter) and scripts are computed
+ * per request.
+ */
+
+void obd2ecu::CacheRebuild()
+  {
+  for (int pid=0; pid<OBD2ECU_CACHE_PIDS; pid++)
+    CacheSetup(pid);
+  }
+
+void obd2ecu::CacheSetup(uint8_t pid)
+  {
+  if (pid >= OBD2ECU_CACHE_PIDS) return;
+
+  OvmsMutexLock lock(&m_cache_mutex);
+  obd2cache* c = &m_cache[pid];
+  c->valid = false;
+  c->metric = NULL;
+  c->scale = 1.0;
+
+  switch (pid)
+    {
+    case 0x00:  /* capabilities */
+    case 0x01:  /* status since DTC cleared */
+    case 0x0c:  /* RPM: jitter & idle workaround */
+    case 0x20:  /* capabilities */
+    case 0x40:  /* capabilities */
+      return;
+    default:
+      break;
+    }
+
+  PidMap::iterator it = m_pidmap.find(pid);
+  if (it == m_pidmap.end()) return;
+  obd2pid* p = it->second;
+  if (p->GetType() == obd2pid::Script) return;
+
+  if (p->GetType() != obd2pid::Unimplemented)
+    c->metric = p->GetMetric();
+  if (pid == 0x10)
+    c->scale = 3.0;  /* MAF scaling, see IncomingFrame() */
+  c->valid = true;
+  CacheUpdate(pid);
+  }
+
+/* Refresh cache entry; call with m_cache_mutex locked */
+void obd2ecu::CacheUpdate(uint8_t pid)
+  {
+  obd2cache* c = &m_cache[pid];
+  CAN_frame_t frame;
+  float value = (c->metric) ? c->metric->AsFloat() * c->scale : 0.0;
+  FillFrame(&frame,RESPONSE_PID,pid,value,pid_format[pid]);
+  memcpy(c->data, frame.data.u8, 8);
+  }
+
+int obd2ecu::CacheSize()
+  {
+  OvmsMutexLock lock(&m_cache_mutex);
+  int cnt = 0;
+  for (int pid=0; pid<OBD2ECU_CACHE_PIDS; pid++)
+    if (m_cache[pid].valid) cnt++;
+  return cnt;
+  }
+
+void obd2ecu::MetricModified(OvmsMetric* metric)
+  {
+  OvmsMutexLock lock(&m_cache_mutex);
+  for (int pid=0; pid<OBD2ECU_CACHE_PIDS; pid++)
+    {
+    if (m_cache[pid].valid && m_cache[pid].metric == metric)
+      {
+      CacheUpdate(pid);
+      m_stat_updates++;
+      }
+    }
+  }
+
+void obd2ecu::ResetStats()
+  {
+  m_stat_requests = 0;
+  m_stat_cached = 0;
+  m_stat_updates = 0;
+  m_stat_lastcount = 0;
+  m_stat_rate = 0;
+  m_stat_rate_max = 0;
+  m_stat_time_cached = 0;
+  m_stat_time_direct = 0;
+  }
+
+void obd2ecu::Ticker10(std::string event, void* data)
+  {
+  uint32_t count = m_stat_requests;
+  m_stat_rate = (float)(count - m_stat_lastcount) / 10;
+  m_stat_lastcount = count;
+  if (m_stat_rate > m_stat_rate_max)
+    m_stat_rate_max = m_stat_rate;
   }
 /* procedure to add a PID to the vectors of supported PIDS, used with PID 0 & 0x20 */
 
@@ -863,6 +1046,7 @@ obd2ecuInit::obd2ecuInit()
   cmd_ecu->RegisterCommand("stop","Stop the OBDII ECU",obd2ecu_stop);
   cmd_ecu->RegisterCommand("list","Show OBDII ECU pid list",obd2ecu_list, "", 0, 1);
   cmd_ecu->RegisterCommand("reload","Reload OBDII ECU pid map",obd2ecu_reload);
+  cmd_ecu->RegisterCommand("status","Show OBDII ECU request statistics",obd2ecu_status, "[reset]", 0, 1);
 
   MyConfig.RegisterParam("obd2ecu", "OBD2ECU configuration", true, true);
   MyConfig.RegisterParam("obd2ecu.map", "OBD2ECU metric map", true, true);
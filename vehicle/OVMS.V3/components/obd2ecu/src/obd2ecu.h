@@ -37,6 +37,22 @@
 #include "pcp.h"
 #include "can.h"
 #include "ovms_metrics.h"
+#include "ovms_mutex.h"
+
+#define OBD2ECU_CACHE_PIDS  0x41      // Mode 1 PIDs 0x00-0x40 (size of pid_format table)
+
+/**
+ * obd2cache: precomputed Mode 1 response for a PID. Entries backed by a metric
+ * are refreshed by the metric listener when the metric changes, so requests
+ * only need to copy the data bytes into the reply frame.
+ */
+struct obd2cache
+  {
+  bool valid;                   // entry can be served from the cache
+  OvmsMetric* metric;           // backing metric (NULL = constant value)
+  float scale;                  // factor applied to the metric value
+  uint8_t data[8];              // response frame data
+  };
 
 class obd2pid
   {
@@ -93,14 +109,35 @@ class obd2ecu : public pcp, public InternalRamAllocated
     uint32_t m_supported_01_20;  // bitmap of PIDs configured 0x01 through 0x20
     uint32_t m_supported_21_40;  // bitmap of PIDs configured 0x21 through 0x40
 
+  protected:
+    OvmsMutex m_cache_mutex;
+    obd2cache m_cache[OBD2ECU_CACHE_PIDS];
+
+  public:
+    uint32_t m_stat_requests;    // Mode 1 requests received
+    uint32_t m_stat_cached;      // ...served from the response cache
+    uint32_t m_stat_updates;     // cache entries refreshed by metric changes
+    uint32_t m_stat_lastcount;   // m_stat_requests at last rate calculation
+    float m_stat_rate;           // requests per second (10 second average)
+    float m_stat_rate_max;       // max requests per second
+    uint64_t m_stat_time_cached; // sum of turnaround times [us] of cached replies
+    uint64_t m_stat_time_direct; // sum of turnaround times [us] of computed replies
+
   public:
     void IncomingFrame(CAN_frame_t* p_frame);
     void LoadMap();
     void ClearMap();
     void Addpid(uint8_t pid);
+    void CacheRebuild();
+    void CacheSetup(uint8_t pid);
+    int CacheSize();
+    void ResetStats();
+    void MetricModified(OvmsMetric* metric);
+    void Ticker10(std::string event, void* data);
 
   protected:
     void FillFrame(CAN_frame_t *frame,int reply,uint8_t pid,float data,uint8_t format);
+    void CacheUpdate(uint8_t pid);
   };
   
 class obd2ecuInit
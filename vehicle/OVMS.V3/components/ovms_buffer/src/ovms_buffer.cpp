@@ -43,6 +43,7 @@ OvmsBuffer::OvmsBuffer(size_t size, void* userdata)
   m_tail = 0;
   m_size = size;
   m_used = 0;
+  m_scanned = 0;
   m_userdata = userdata;
   }
 
@@ -71,6 +72,7 @@ void OvmsBuffer::EmptyAll()
   m_head = 0;
   m_tail = 0;
   m_used = 0;
+  m_scanned = 0;
   }
 
 bool OvmsBuffer::Push(uint8_t byte)
@@ -89,10 +91,15 @@ bool OvmsBuffer::Push(uint8_t *byte, size_t count)
   if ((m_size-m_used)<count) return false;
 
   m_used += count;
-  for (size_t k=0;k<count;k++)
+  while (count > 0)
     {
-    // ESP_LOGI(TAG, "Push() %02x at %d",byte[k],m_head);
-    m_buffer[m_head++] = byte[k];
+    // Copy up to the wrap point, then the remainder:
+    size_t n = m_size - m_head;
+    if (n > count) n = count;
+    memcpy(m_buffer+m_head, byte, n);
+    byte += n;
+    count -= n;
+    m_head += n;
     if (m_head >= m_size) m_head=0;
     }
 
@@ -104,6 +111,7 @@ uint8_t OvmsBuffer::Pop()
   if (m_used==0) return 0;
 
   m_used--;
+  if (m_scanned > 0) m_scanned--;
   uint8_t result = m_buffer[m_tail++];
   if (m_tail >= m_size) m_tail=0;
 
@@ -112,18 +120,20 @@ uint8_t OvmsBuffer::Pop()
 
 size_t OvmsBuffer::Pop(size_t count, uint8_t *dest)
   {
-  size_t done = 0;
-
-  while ((m_used>0)&&(done < count))
-    {
-    m_used--;
-    dest[done++] = m_buffer[m_tail++];
-    if (m_tail >= m_size) m_tail=0;
-    }
-
+  size_t done = Peek(count, dest);
+  Drop(done);
   return done;
   }
 
+void OvmsBuffer::Drop(size_t count)
+  {
+  if (count > m_used) count = m_used;
+  m_used -= count;
+  m_scanned = (m_scanned > count) ? m_scanned - count : 0;
+  m_tail += count;
+  if (m_tail >= m_size) m_tail -= m_size;
+  }
+
 uint8_t OvmsBuffer::Peek()
   {
   if (m_used==0) return 0;
@@ -133,16 +143,22 @@ uint8_t OvmsBuffer::Peek()
 
 size_t OvmsBuffer::Peek(size_t count, uint8_t *dest)
   {
-  size_t done = 0;
+  if (count > m_used) count = m_used;
 
-  size_t tail = m_tail;
-  while ((done<m_used)&&(done<count))
-    {
-    dest[done++] = m_buffer[tail++];
-    if (tail >= m_size) tail=0;
-    }
+  size_t n = m_size - m_tail;
+  if (n > count) n = count;
+  memcpy(dest, m_buffer+m_tail, n);
+  if (n < count)
+    memcpy(dest+n, m_buffer, count-n);
 
-  return done;
+  return count;
+  }
+
+size_t OvmsBuffer::PeekSpan(uint8_t** data)
+  {
+  *data = m_buffer+m_tail;
+  size_t n = m_size - m_tail;
+  return (n < m_used) ? n : m_used;
   }
 
 void OvmsBuffer::Diagnostics()
@@ -152,41 +168,81 @@ void OvmsBuffer::Diagnostics()
     m_used,m_size,m_head,m_tail,hl);
   }
 
+/**
+ * HasLine: get length of first line in buffer, -1 if no line end found
+ *  The scan resumes where the last scan stopped, so repeated calls while
+ *  a line is being received only check the new data.
+ */
 int OvmsBuffer::HasLine()
   {
-  size_t tail = m_tail;
-
-  if (m_used==0) return -1;
-
-  // ESP_LOGI(TAG, "HasLine() with tail at %d (%d used)",m_tail,m_used);
-  for (size_t done=0;done<m_used;done++)
+  size_t pos = m_scanned;
+  while (pos < m_used)
     {
-    // ESP_LOGI(TAG, "HasLine() at tail %d is %02x (%d done)",tail,m_buffer[tail],done);
-    if ((m_buffer[tail]=='\r')||(m_buffer[tail]=='\n'))
+    // Scan up to the wrap point, then the remainder:
+    size_t idx = m_tail + pos;
+    if (idx >= m_size) idx -= m_size;
+    size_t n = m_size - idx;
+    if (n > m_used - pos) n = m_used - pos;
+    const uint8_t* p = m_buffer + idx;
+    for (size_t i = 0; i < n; i++)
       {
-      // ESP_LOGI(TAG, "HasLine() found a CR/LF at tail %d (done=%d)",tail,done);
-      return done;
+      if (p[i] == '\r' || p[i] == '\n')
+        {
+        m_scanned = pos + i;
+        return m_scanned;
+        }
       }
-    tail++;
-    if (tail >= m_size) tail=0;
+    pos += n;
     }
-
-  // ESP_LOGI(TAG, "HasLine() didnt find a CR/LF");
+  m_scanned = m_used;
   return -1;
   }
 
-std::string OvmsBuffer::ReadLine()
+/**
+ * PeekLine: get view on first line in buffer (without line end)
+ *  The line is returned as one or two (if wrapping the ring) spans pointing
+ *  into the buffer. Use DropLine() to consume the line after processing.
+ *  Returns the line length or -1 if no line is available.
+ */
+int OvmsBuffer::PeekLine(OvmsBufferSpan span[2])
   {
   int hl = HasLine();
-  if (hl<0) return std::string("");
-
-  uint8_t result[hl+1];
-  Pop(hl, result);
+  if (hl < 0) return -1;
+
+  size_t n = m_size - m_tail;
+  if (n > (size_t)hl) n = hl;
+  span[0].data = m_buffer + m_tail;
+  span[0].len = n;
+  span[1].data = m_buffer;
+  span[1].len = hl - n;
+  return hl;
+  }
 
+void OvmsBuffer::DropLine(int len)
+  {
+  Drop(len);
   if (Peek() == '\r') Pop();
   if (Peek() == '\n') Pop();
+  }
 
-  return std::string((char*)result,hl);
+bool OvmsBuffer::ReadLine(std::string& line)
+  {
+  OvmsBufferSpan span[2];
+  int hl = PeekLine(span);
+  if (hl < 0) return false;
+
+  line.assign((char*)span[0].data, span[0].len);
+  if (span[1].len)
+    line.append((char*)span[1].data, span[1].len);
+  DropLine(hl);
+  return true;
+  }
+
+std::string OvmsBuffer::ReadLine()
+  {
+  std::string line;
+  ReadLine(line);
+  return line;
   }
 
 int OvmsBuffer::PollSocket(int sock, long timeoutms)
@@ -34,6 +34,12 @@
 #include <string>
 #include <stdint.h>
 
+typedef struct
+  {
+  uint8_t* data;
+  size_t len;
+  } OvmsBufferSpan;
+
 class OvmsBuffer
   {
   public:
@@ -53,11 +59,16 @@ class OvmsBuffer
     size_t Pop(size_t count, uint8_t *dest);
     uint8_t Peek();
     size_t Peek(size_t count, uint8_t *dest);
+    size_t PeekSpan(uint8_t **data);    // contiguous used bytes at tail, no copy
+    void Drop(size_t count);            // discard bytes from tail
     void Diagnostics();
 
   public:
     int HasLine();
     std::string ReadLine();
+    bool ReadLine(std::string& line);
+    int PeekLine(OvmsBufferSpan span[2]);   // line view, no copy
+    void DropLine(int len);                 // discard line viewed by PeekLine()
 
   public:
     int PollSocket(int sock, long timeoutms);
@@ -71,6 +82,7 @@ class OvmsBuffer
     int m_tail;
     size_t m_size;
     size_t m_used;
+    size_t m_scanned;                   // bytes from tail known to contain no line end
   };
 
 #endif //#ifndef __OVMS_BUFFER_H__
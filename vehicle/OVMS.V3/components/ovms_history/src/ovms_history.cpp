@@ -0,0 +1,953 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "history";
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "ovms_history.h"
+#include "ovms_config.h"
+#include "ovms_events.h"
+#include "ovms_malloc.h"
+#include "ovms_peripherals.h"
+
+#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+#include "ovms_script.h"
+#endif
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+#include "ovms_webserver.h"
+#endif
+
+#define HISTORY_PARAM             "history"
+#define HISTORY_DEFAULT_MAX       1000          // default max number of samples per query
+#define HISTORY_LIMIT_MAX         10000
+
+const uint32_t history_resolution[HISTORY_LEVELS] = { 1, 60, 900 };
+static const char* const history_level_name[HISTORY_LEVELS] = { "1s", "1m", "15m" };
+static const int history_default_blocks[HISTORY_LEVELS] = { 16, 16, 16 };
+
+OvmsHistory MyHistory __attribute__ ((init_priority (8600)));
+
+
+/**
+ * Sample encoding: unsigned LEB128 varints, signed values zigzag encoded
+ */
+
+static inline int put_varint(uint8_t* dst, uint64_t v)
+  {
+  int len = 0;
+  while (v >= 0x80)
+    {
+    dst[len++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+    }
+  dst[len++] = (uint8_t)v;
+  return len;
+  }
+
+static inline bool get_varint(const uint8_t*& src, const uint8_t* end, uint64_t& v)
+  {
+  v = 0;
+  for (int shift = 0; src < end && shift < 64; shift += 7)
+    {
+    uint8_t b = *src++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0)
+      return true;
+    }
+  return false;
+  }
+
+static inline uint64_t zigzag(int64_t v)
+  {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  }
+
+static inline int64_t unzigzag(uint64_t v)
+  {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  }
+
+
+/**
+ * HistoryRing: block ring buffer of one resolution level
+ */
+
+HistoryRing::HistoryRing()
+  {
+  m_series = NULL;
+  m_level = 0;
+  m_nvalues = 1;
+  m_blocks = NULL;
+  m_size = 0;
+  m_first = 0;
+  m_count = 0;
+  m_lasttime = 0;
+  memset(m_lastvalue, 0, sizeof(m_lastvalue));
+  }
+
+HistoryRing::~HistoryRing()
+  {
+  if (m_blocks)
+    free(m_blocks);
+  }
+
+bool HistoryRing::Init(HistorySeries* series, int level, int blocks)
+  {
+  if (m_blocks)
+    {
+    free(m_blocks);
+    m_blocks = NULL;
+    }
+  m_series = series;
+  m_level = level;
+  m_nvalues = (level == 0) ? 1 : HISTORY_MAX_VALUES;
+  m_size = 0;
+  if (blocks > 0)
+    {
+    m_blocks = (HistoryBlock*) ExternalRamMalloc(blocks * sizeof(HistoryBlock));
+    if (!m_blocks)
+      return false;
+    m_size = blocks;
+    }
+  Clear();
+  return true;
+  }
+
+void HistoryRing::Clear()
+  {
+  m_first = 0;
+  m_count = 0;
+  m_lasttime = 0;
+  }
+
+uint32_t HistoryRing::FirstTime()
+  {
+  return m_count ? m_blocks[m_first].t0 : 0;
+  }
+
+uint32_t HistoryRing::LastTime()
+  {
+  return m_count ? m_blocks[(m_first + m_count - 1) % m_size].t1 : 0;
+  }
+
+size_t HistoryRing::Samples()
+  {
+  size_t cnt = 0;
+  for (int i = 0; i < m_count; i++)
+    cnt += m_blocks[(m_first + i) % m_size].count;
+  return cnt;
+  }
+
+HistoryBlock* HistoryRing::NewBlock()
+  {
+  if (m_count == m_size)
+    {
+    // ring full: drop the oldest block
+    m_series->Spill(m_level, &m_blocks[m_first]);
+    m_first = (m_first + 1) % m_size;
+    m_count--;
+    }
+  HistoryBlock* block = &m_blocks[(m_first + m_count) % m_size];
+  m_count++;
+  block->t0 = block->t1 = 0;
+  block->count = block->used = 0;
+  return block;
+  }
+
+int HistoryRing::Encode(uint8_t* dst, uint32_t time, const int32_t* value)
+  {
+  int len = put_varint(dst, time - m_lasttime);
+  for (int i = 0; i < m_nvalues; i++)
+    len += put_varint(dst + len, zigzag((int64_t)value[i] - m_lastvalue[i]));
+  return len;
+  }
+
+void HistoryRing::Add(uint32_t time, const int32_t* value)
+  {
+  if (!m_size)
+    return;
+
+  if (m_count && time <= m_lasttime)
+    {
+    // duplicate or clock moved backwards: skip small steps, restart on big ones
+    if (m_lasttime - time <= 3600)
+      return;
+    ESP_LOGW(TAG, "%s/%s: clock moved back by %u seconds, history cleared",
+      m_series->m_name.c_str(), history_level_name[m_level], m_lasttime - time);
+    Clear();
+    }
+
+  uint8_t buf[5 + HISTORY_MAX_VALUES * 10];
+  int len = 0;
+  HistoryBlock* block = NULL;
+  if (m_count)
+    {
+    block = &m_blocks[(m_first + m_count - 1) % m_size];
+    len = Encode(buf, time, value);
+    if (block->used + len > HISTORY_BLOCK_DATA || block->count == UINT16_MAX)
+      block = NULL;
+    }
+  if (!block)
+    {
+    // start new block, first sample is encoded absolute:
+    block = NewBlock();
+    block->t0 = time;
+    m_lasttime = time;
+    memset(m_lastvalue, 0, sizeof(m_lastvalue));
+    len = Encode(buf, time, value);
+    }
+
+  memcpy(block->data + block->used, buf, len);
+  block->used += len;
+  block->count++;
+  block->t1 = time;
+  m_lasttime = time;
+  memcpy(m_lastvalue, value, m_nvalues * sizeof(int32_t));
+  }
+
+void HistoryRing::Decode(const HistoryBlock* block, int nvalues, HistorySampleList& out,
+  uint32_t from, uint32_t to, size_t max)
+  {
+  const uint8_t* p = block->data;
+  const uint8_t* end = block->data + block->used;
+  HistorySample s;
+  uint64_t v;
+  s.time = block->t0;
+  memset(s.value, 0, sizeof(s.value));
+  for (int n = 0; n < block->count; n++)
+    {
+    if (!get_varint(p, end, v))
+      return;
+    s.time += v;
+    for (int i = 0; i < nvalues; i++)
+      {
+      if (!get_varint(p, end, v))
+        return;
+      s.value[i] += unzigzag(v);
+      }
+    if (s.time > to)
+      return;
+    if (s.time >= from)
+      {
+      if (out.size() >= max)
+        return;
+      if (nvalues == 1)
+        s.value[1] = s.value[2] = s.value[0];
+      out.push_back(s);
+      }
+    }
+  }
+
+void HistoryRing::Query(HistorySampleList& out, uint32_t from, uint32_t to, size_t max)
+  {
+  for (int i = 0; i < m_count && out.size() < max; i++)
+    {
+    const HistoryBlock* block = &m_blocks[(m_first + i) % m_size];
+    if (block->t1 < from)
+      continue;
+    if (block->t0 > to)
+      break;
+    Decode(block, m_nvalues, out, from, to, max);
+    }
+  }
+
+
+/**
+ * HistorySeries: recorder for one metric
+ */
+
+HistorySeries::HistorySeries(const std::string& name, int decimals, const int* blocks)
+  {
+  m_name = name;
+  m_decimals = decimals;
+  m_scale = 1;
+  for (int i = 0; i < decimals; i++)
+    m_scale *= 10;
+  for (int level = 0; level < HISTORY_LEVELS; level++)
+    {
+    m_blocks[level] = blocks[level];
+    m_spilled[level] = 0;
+    m_rollup[level].count = 0;
+    if (!m_ring[level].Init(this, level, blocks[level]))
+      ESP_LOGE(TAG, "%s/%s: cannot allocate %d blocks", name.c_str(), history_level_name[level], blocks[level]);
+    }
+  }
+
+HistorySeries::~HistorySeries()
+  {
+  }
+
+void HistorySeries::Clear()
+  {
+  for (int level = 0; level < HISTORY_LEVELS; level++)
+    {
+    m_ring[level].Clear();
+    m_rollup[level].count = 0;
+    }
+  }
+
+void HistorySeries::Sample(uint32_t time)
+  {
+  OvmsMetric* metric = MyMetrics.Find(m_name.c_str());
+  if (!metric || metric->GetValueType() == MetricValueOther || !metric->IsDefined() || metric->IsStale())
+    return;
+
+  double scaled = round((double)metric->AsFloat() * m_scale);
+  if (scaled > INT32_MAX) scaled = INT32_MAX;
+  else if (scaled < -INT32_MAX) scaled = -INT32_MAX;
+  int32_t value[HISTORY_MAX_VALUES] = { (int32_t)scaled, 0, 0 };
+  m_ring[0].Add(time, value);
+
+  // rollups: the period is written when the first sample of the next period arrives
+  for (int level = 1; level < HISTORY_LEVELS; level++)
+    {
+    HistoryRollup& r = m_rollup[level];
+    uint32_t period = time / history_resolution[level];
+    if (r.count && period != r.period)
+      {
+      int32_t agg[HISTORY_MAX_VALUES] =
+        {
+        (int32_t)((r.sum + (r.sum >= 0 ? 1 : -1) * (int64_t)(r.count / 2)) / (int64_t)r.count),
+        r.min, r.max
+        };
+      m_ring[level].Add(r.period * history_resolution[level], agg);
+      r.count = 0;
+      }
+    if (r.count == 0)
+      {
+      r.period = period;
+      r.sum = 0;
+      r.min = r.max = value[0];
+      }
+    r.sum += value[0];
+    if (value[0] < r.min) r.min = value[0];
+    if (value[0] > r.max) r.max = value[0];
+    r.count++;
+    }
+  }
+
+int HistorySeries::FindLevel(uint32_t from, uint32_t to, size_t max)
+  {
+  // use the finest level covering the range within max samples,
+  //  else the one reaching back furthest:
+  int best = -1;
+  uint32_t besttime = UINT32_MAX;
+  for (int level = 0; level < HISTORY_LEVELS; level++)
+    {
+    if ((to - from) / history_resolution[level] > max)
+      continue;
+    uint32_t first = m_ring[level].FirstTime();
+    if (MyHistory.m_sd_enable && path_exists(SpillPath(level)))
+      first = 0;
+    else if (m_ring[level].BlocksUsed() == 0)
+      continue;
+    if (first <= from)
+      return level;
+    if (first < besttime)
+      {
+      best = level;
+      besttime = first;
+      }
+    }
+  return (best >= 0) ? best : HISTORY_LEVELS-1;
+  }
+
+void HistorySeries::Query(HistorySampleList& out, int level, uint32_t from, uint32_t to, size_t max)
+  {
+  HistoryRing& ring = m_ring[level];
+  if (MyHistory.m_sd_enable && (ring.BlocksUsed() == 0 || ring.FirstTime() > from))
+    {
+    // fetch the part not covered by RAM from the spill files:
+    uint32_t spillto = to;
+    if (ring.BlocksUsed() && ring.FirstTime() <= spillto)
+      spillto = ring.FirstTime() - 1;
+    QuerySpill(out, level, from, spillto, max);
+    }
+  ring.Query(out, from, to, max);
+  }
+
+std::string HistorySeries::SpillPath(int level, bool old /*=false*/)
+  {
+  std::string path = MyHistory.m_sd_path;
+  path.append("/");
+  path.append(m_name);
+  path.append(".");
+  path.append(history_level_name[level]);
+  path.append(old ? ".hst.1" : ".hst");
+  return path;
+  }
+
+static bool history_sd_available()
+  {
+#ifdef CONFIG_OVMS_COMP_SDCARD
+  if (!MyPeripherals || !MyPeripherals->m_sdcard || !MyPeripherals->m_sdcard->isavailable())
+    return false;
+#endif // #ifdef CONFIG_OVMS_COMP_SDCARD
+  return true;
+  }
+
+void HistorySeries::Spill(int level, const HistoryBlock* block)
+  {
+  if (!MyHistory.m_sd_enable || !history_sd_available())
+    return;
+
+  std::string path = SpillPath(level);
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0)
+    {
+    // rotate:
+    if (st.st_size + sizeof(HistoryBlock) > MyHistory.m_sd_maxsize)
+      {
+      std::string oldpath = SpillPath(level, true);
+      unlink(oldpath.c_str());
+      rename(path.c_str(), oldpath.c_str());
+      }
+    }
+  else
+    {
+    mkpath(MyHistory.m_sd_path);
+    }
+
+  FILE* fp = fopen(path.c_str(), "a");
+  if (!fp)
+    {
+    ESP_LOGW(TAG, "%s: cannot write spill file '%s'", m_name.c_str(), path.c_str());
+    return;
+    }
+  if (fwrite(block, sizeof(HistoryBlock), 1, fp) == 1)
+    m_spilled[level]++;
+  fclose(fp);
+  }
+
+void HistorySeries::QuerySpill(HistorySampleList& out, int level, uint32_t from, uint32_t to, size_t max)
+  {
+  if (from > to || !history_sd_available())
+    return;
+
+  HistoryBlock* block = (HistoryBlock*) ExternalRamMalloc(sizeof(HistoryBlock));
+  if (!block)
+    return;
+  int nvalues = (level == 0) ? 1 : HISTORY_MAX_VALUES;
+
+  for (int old = 1; old >= 0 && out.size() < max; old--)
+    {
+    FILE* fp = fopen(SpillPath(level, old).c_str(), "r");
+    if (!fp)
+      continue;
+    // check the block headers, only read the data of matching blocks:
+    while (out.size() < max && fread(block, offsetof(HistoryBlock, data), 1, fp) == 1)
+      {
+      if (block->t1 < from || block->t0 > to || block->used > HISTORY_BLOCK_DATA)
+        {
+        if (fseek(fp, HISTORY_BLOCK_DATA, SEEK_CUR) != 0)
+          break;
+        continue;
+        }
+      if (fread(block->data, HISTORY_BLOCK_DATA, 1, fp) != 1)
+        break;
+      HistoryRing::Decode(block, nvalues, out, from, to, max);
+      }
+    fclose(fp);
+    }
+
+  free(block);
+  }
+
+void HistorySeries::AppendValue(std::string& buf, int32_t value)
+  {
+  if (m_decimals == 0)
+    {
+    format_int(buf, value);
+    return;
+    }
+  uint32_t av = (value < 0) ? -(int64_t)value : value;
+  if (value < 0)
+    buf.append(1, '-');
+  format_int(buf, av / m_scale);
+  char frac[HISTORY_MAX_DECIMALS+2];
+  snprintf(frac, sizeof(frac), ".%0*u", m_decimals, (unsigned)(av % m_scale));
+  buf.append(frac);
+  }
+
+void HistorySeries::AppendJSON(std::string& buf, int level, uint32_t from, uint32_t to, size_t max)
+  {
+  HistorySampleList samples;
+  Query(samples, level, from, to, max);
+
+  OvmsMetric* metric = MyMetrics.Find(m_name.c_str());
+  buf.append("{\"metric\":\"");
+  json_append(buf, m_name);
+  buf.append("\",\"unit\":\"");
+  if (metric)
+    json_append(buf, std::string(OvmsMetricUnitLabel(metric->GetUnits())));
+  buf.append("\",\"resolution\":");
+  format_int(buf, history_resolution[level]);
+  buf.append(",\"from\":");
+  format_int(buf, from);
+  buf.append(",\"to\":");
+  format_int(buf, to);
+  buf.append((level == 0)
+    ? ",\"columns\":[\"time\",\"value\"]"
+    : ",\"columns\":[\"time\",\"avg\",\"min\",\"max\"]");
+  if (samples.size() >= max)
+    buf.append(",\"truncated\":true");
+  buf.append(",\"data\":[");
+
+  int nvalues = (level == 0) ? 1 : HISTORY_MAX_VALUES;
+  buf.reserve(buf.size() + samples.size() * (14 + nvalues * (m_decimals + 6)));
+  for (auto it = samples.begin(); it != samples.end(); it++)
+    {
+    if (it != samples.begin())
+      buf.append(1, ',');
+    buf.append(1, '[');
+    format_int(buf, it->time);
+    for (int i = 0; i < nvalues; i++)
+      {
+      buf.append(1, ',');
+      AppendValue(buf, it->value[i]);
+      }
+    buf.append(1, ']');
+    }
+  buf.append("]}");
+  }
+
+
+/**
+ * Commands
+ */
+
+static void history_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyHistory.Status(writer);
+  }
+
+static void history_show(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  uint32_t now = time(NULL);
+  int resolution = (argc > 1) ? atoi(argv[1]) : 0;
+  uint32_t from = OvmsHistory::ParseTime((argc > 2) ? argv[2] : "", now - 600);
+  uint32_t to = OvmsHistory::ParseTime((argc > 3) ? argv[3] : "", now);
+
+  OvmsMutexLock lock(&MyHistory.m_mutex);
+  auto it = MyHistory.m_series.find(argv[0]);
+  if (it == MyHistory.m_series.end())
+    {
+    writer->printf("Error: metric '%s' is not recorded\n", argv[0]);
+    return;
+    }
+  HistorySeries* series = it->second;
+
+  int level = series->FindLevel(from, to, HISTORY_DEFAULT_MAX);
+  for (int i = 0; resolution && i < HISTORY_LEVELS; i++)
+    {
+    if (history_resolution[i] >= (uint32_t)resolution || i == HISTORY_LEVELS-1)
+      {
+      level = i;
+      break;
+      }
+    }
+
+  HistorySampleList samples;
+  series->Query(samples, level, from, to, HISTORY_DEFAULT_MAX);
+  writer->printf("%s: %u samples at %s resolution\n",
+    series->m_name.c_str(), samples.size(), history_level_name[level]);
+  writer->puts((level == 0) ? "Time                   Value" : "Time                   Avg / Min / Max");
+
+  std::string line;
+  char tbuf[32];
+  for (auto& s : samples)
+    {
+    time_t t = s.time;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+    line = tbuf;
+    line.append("    ");
+    series->AppendValue(line, s.value[0]);
+    if (level > 0)
+      {
+      line.append(" / ");
+      series->AppendValue(line, s.value[1]);
+      line.append(" / ");
+      series->AppendValue(line, s.value[2]);
+      }
+    writer->puts(line.c_str());
+    }
+  }
+
+static void history_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  OvmsMutexLock lock(&MyHistory.m_mutex);
+  for (auto it = MyHistory.m_series.begin(); it != MyHistory.m_series.end(); it++)
+    {
+    if (argc == 0 || it->first == argv[0])
+      it->second->Clear();
+    }
+  writer->puts("History cleared (RAM)");
+  }
+
+
+/**
+ * Javascript API: OvmsHistory.List(), OvmsHistory.Get(metric, [from], [to], [resolution], [max])
+ */
+
+#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+
+static uint32_t duk_history_time(duk_context *ctx, duk_idx_t idx, uint32_t defvalue)
+  {
+  if (duk_is_string(ctx, idx))
+    return OvmsHistory::ParseTime(duk_get_string(ctx, idx), defvalue);
+  if (duk_is_number(ctx, idx))
+    {
+    double t = duk_get_number(ctx, idx);
+    return (t < 0) ? time(NULL) + (int32_t)t : (uint32_t)t;
+    }
+  return defvalue;
+  }
+
+static duk_ret_t DukOvmsHistoryList(duk_context *ctx)
+  {
+  OvmsMutexLock lock(&MyHistory.m_mutex);
+  duk_idx_t arr_idx = duk_push_array(ctx);
+  int i = 0;
+  for (auto it = MyHistory.m_series.begin(); it != MyHistory.m_series.end(); it++)
+    {
+    duk_push_string(ctx, it->first.c_str());
+    duk_put_prop_index(ctx, arr_idx, i++);
+    }
+  return 1;
+  }
+
+static duk_ret_t DukOvmsHistoryGet(duk_context *ctx)
+  {
+  uint32_t now = time(NULL);
+  const char* metric = duk_to_string(ctx, 0);
+  uint32_t from = duk_history_time(ctx, 1, now - 3600);
+  uint32_t to = duk_history_time(ctx, 2, now);
+  int resolution = duk_opt_int(ctx, 3, 0);
+  int max = duk_opt_int(ctx, 4, 0);
+
+  std::string json;
+  if (!MyHistory.GetJSON(json, metric, from, to, resolution, max))
+    return 0;
+  duk_push_lstring(ctx, json.data(), json.size());
+  duk_json_decode(ctx, -1);
+  return 1;
+  }
+
+#endif //#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+
+
+/**
+ * Web API: /api/history?metric=…&from=…&to=…&res=…&max=…
+ */
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+
+static void HandleHistory(PageEntry_t& p, PageContext_t& c)
+  {
+  uint32_t now = time(NULL);
+  std::string metric = c.getvar("metric");
+  std::string json;
+
+  if (metric.empty())
+    {
+    // list recorded metrics:
+    OvmsMutexLock lock(&MyHistory.m_mutex);
+    json = "{\"metrics\":[";
+    for (auto it = MyHistory.m_series.begin(); it != MyHistory.m_series.end(); it++)
+      {
+      if (it != MyHistory.m_series.begin())
+        json.append(1, ',');
+      json.append(1, '"');
+      json_append(json, it->first);
+      json.append(1, '"');
+      }
+    json.append("]}");
+    }
+  else
+    {
+    uint32_t from = OvmsHistory::ParseTime(c.getvar("from"), now - 3600);
+    uint32_t to = OvmsHistory::ParseTime(c.getvar("to"), now);
+    int resolution = atoi(c.getvar("res").c_str());
+    int max = atoi(c.getvar("max").c_str());
+    if (!MyHistory.GetJSON(json, metric, from, to, resolution, max))
+      {
+      c.head(404);
+      c.print("ERROR: metric is not recorded");
+      c.done();
+      return;
+      }
+    }
+
+  c.head(200,
+    "Content-Type: application/json; charset=utf-8\r\n"
+    "Cache-Control: no-cache");
+  c.print(json);
+  c.done();
+  }
+
+#endif //#ifdef CONFIG_OVMS_COMP_WEBSERVER
+
+
+/**
+ * OvmsHistory: recorder framework
+ */
+
+OvmsHistory::OvmsHistory()
+  {
+  ESP_LOGI(TAG, "Initialising HISTORY (8600)");
+
+  m_sd_enable = false;
+  m_sd_maxsize = 0;
+
+  MyConfig.RegisterParam(HISTORY_PARAM, "Metric history recorder", true, true);
+
+  OvmsCommand* cmd_history = MyCommandApp.RegisterCommand("history", "METRIC HISTORY framework", history_status, "", 0, 0);
+  cmd_history->RegisterCommand("status", "Show recorded metrics and memory usage", history_status);
+  cmd_history->RegisterCommand("show", "Show recorded samples", history_show,
+    "<metric> [<resolution>] [<from>] [<to>]\n"
+    "<resolution>: seconds (1, 60, 900), 0 = auto\n"
+    "<from>, <to>: UTC timestamp or relative time, e.g. -90, -15m, -2h, -1d", 1, 4);
+  cmd_history->RegisterCommand("clear", "Clear recorded samples", history_clear, "[<metric>]", 0, 1);
+
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG, "config.mounted", std::bind(&OvmsHistory::ConfigChanged, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "config.changed", std::bind(&OvmsHistory::ConfigChanged, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "ticker.1", std::bind(&OvmsHistory::Ticker, this, _1, _2));
+
+#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+  ESP_LOGI(TAG, "Expanding DUKTAPE javascript engine");
+  DuktapeObjectRegistration* dto = new DuktapeObjectRegistration("OvmsHistory");
+  dto->RegisterDuktapeFunction(DukOvmsHistoryList, 0, "List");
+  dto->RegisterDuktapeFunction(DukOvmsHistoryGet, 5, "Get");
+  MyDuktape.RegisterDuktapeObject(dto);
+#endif //#ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+  MyWebServer.RegisterPage("/api/history", "Metric history", HandleHistory, PageMenu_None, PageAuth_Cookie);
+#endif //#ifdef CONFIG_OVMS_COMP_WEBSERVER
+  }
+
+OvmsHistory::~OvmsHistory()
+  {
+  for (auto it = m_series.begin(); it != m_series.end(); it++)
+    delete it->second;
+  }
+
+void OvmsHistory::ConfigChanged(std::string event, void* data)
+  {
+  if (event == "config.changed")
+    {
+    OvmsConfigParam* param = (OvmsConfigParam*) data;
+    if (param && param->GetName() != HISTORY_PARAM)
+      return;
+    }
+
+  OvmsMutexLock lock(&m_mutex);
+
+  m_sd_enable = MyConfig.GetParamValueBool(HISTORY_PARAM, "sd.enable", false);
+  m_sd_path = MyConfig.GetParamValue(HISTORY_PARAM, "sd.path", "/sd/history");
+  m_sd_maxsize = MyConfig.GetParamValueInt(HISTORY_PARAM, "sd.maxsize", 512) * 1024;
+  int blocks[HISTORY_LEVELS];
+  for (int level = 0; level < HISTORY_LEVELS; level++)
+    {
+    std::string instance = std::string("blocks.") + history_level_name[level];
+    blocks[level] = MyConfig.GetParamValueInt(HISTORY_PARAM, instance, history_default_blocks[level]);
+    if (blocks[level] < 0) blocks[level] = 0;
+    if (blocks[level] > 1024) blocks[level] = 1024;
+    }
+
+  // parse metrics list: "<name>[:<decimals>]", separated by ',' or ' '
+  std::map<std::string, int> config;
+  std::string list = MyConfig.GetParamValue(HISTORY_PARAM, "metrics");
+  size_t pos = 0;
+  while (pos < list.size())
+    {
+    size_t end = list.find_first_of(", ", pos);
+    if (end == std::string::npos)
+      end = list.size();
+    std::string item = list.substr(pos, end - pos);
+    pos = end + 1;
+    if (item.empty())
+      continue;
+    int decimals = 2;
+    size_t colon = item.find(':');
+    if (colon != std::string::npos)
+      {
+      decimals = atoi(item.c_str() + colon + 1);
+      if (decimals < 0) decimals = 0;
+      if (decimals > HISTORY_MAX_DECIMALS) decimals = HISTORY_MAX_DECIMALS;
+      item.resize(colon);
+      }
+    else
+      {
+      OvmsMetric* metric = MyMetrics.Find(item.c_str());
+      if (metric && metric->GetValueType() != MetricValueFloat)
+        decimals = 0;
+      }
+    config[item] = decimals;
+    }
+
+  // remove deselected & reconfigured series:
+  for (auto it = m_series.begin(); it != m_series.end(); )
+    {
+    HistorySeries* series = it->second;
+    auto cf = config.find(it->first);
+    if (cf == config.end() || cf->second != series->m_decimals
+      || memcmp(blocks, series->m_blocks, sizeof(blocks)) != 0)
+      {
+      delete series;
+      it = m_series.erase(it);
+      }
+    else
+      it++;
+    }
+
+  // add new series:
+  for (auto cf = config.begin(); cf != config.end(); cf++)
+    {
+    if (m_series.find(cf->first) == m_series.end())
+      m_series[cf->first] = new HistorySeries(cf->first, cf->second, blocks);
+    }
+
+  ESP_LOGI(TAG, "Recording %d metric(s), %d bytes per metric, SD spill %s",
+    m_series.size(), (blocks[0] + blocks[1] + blocks[2]) * sizeof(HistoryBlock),
+    m_sd_enable ? m_sd_path.c_str() : "disabled");
+  }
+
+void OvmsHistory::Ticker(std::string event, void* data)
+  {
+  uint32_t now = time(NULL);
+  if (now < HISTORY_TIME_VALID)
+    return;
+  OvmsMutexLock lock(&m_mutex);
+  for (auto it = m_series.begin(); it != m_series.end(); it++)
+    it->second->Sample(now);
+  }
+
+void OvmsHistory::Status(OvmsWriter* writer)
+  {
+  OvmsMutexLock lock(&m_mutex);
+  uint32_t now = time(NULL);
+
+  if (m_series.empty())
+    {
+    writer->puts("No metrics recorded (config set history metrics <metric>[:<decimals>],...)");
+    return;
+    }
+
+  size_t total = 0;
+  for (auto it = m_series.begin(); it != m_series.end(); it++)
+    {
+    HistorySeries* series = it->second;
+    writer->printf("%s (%d decimals):\n", series->m_name.c_str(), series->m_decimals);
+    for (int level = 0; level < HISTORY_LEVELS; level++)
+      {
+      HistoryRing& ring = series->m_ring[level];
+      total += ring.BlocksTotal() * sizeof(HistoryBlock);
+      uint32_t span = ring.BlocksUsed() ? now - ring.FirstTime() : 0;
+      writer->printf("  %-3s: %6u samples, %3u/%-3u blocks, %3u:%02u:%02u h back",
+        history_level_name[level], ring.Samples(), ring.BlocksUsed(), ring.BlocksTotal(),
+        span / 3600, (span / 60) % 60, span % 60);
+      if (series->m_spilled[level])
+        writer->printf(", %u blocks spilled", series->m_spilled[level]);
+      writer->puts("");
+      }
+    }
+  writer->printf("%d metric(s), %u bytes SPIRAM, SD spill %s\n", m_series.size(), total,
+    m_sd_enable ? m_sd_path.c_str() : "disabled");
+  }
+
+bool OvmsHistory::GetJSON(std::string& buf, const std::string& metric, uint32_t from, uint32_t to,
+  int resolution /*=0*/, size_t max /*=0*/)
+  {
+  OvmsMutexLock lock(&m_mutex);
+  auto it = m_series.find(metric);
+  if (it == m_series.end())
+    return false;
+  HistorySeries* series = it->second;
+
+  if (max == 0)
+    max = HISTORY_DEFAULT_MAX;
+  else if (max > HISTORY_LIMIT_MAX)
+    max = HISTORY_LIMIT_MAX;
+  if (to < from)
+    to = from;
+
+  int level;
+  if (resolution <= 0)
+    {
+    level = series->FindLevel(from, to, max);
+    }
+  else
+    {
+    // use the next resolution available:
+    for (level = 0; level < HISTORY_LEVELS-1; level++)
+      {
+      if (history_resolution[level] >= (uint32_t)resolution)
+        break;
+      }
+    }
+
+  series->AppendJSON(buf, level, from, to, max);
+  return true;
+  }
+
+/**
+ * ParseTime: absolute UTC timestamp or relative to now ("-<n>[smhd]")
+ */
+uint32_t OvmsHistory::ParseTime(const std::string& arg, uint32_t defvalue)
+  {
+  if (arg.empty())
+    return defvalue;
+  char* end;
+  long val = strtol(arg.c_str(), &end, 10);
+  switch (*end)
+    {
+    case 'm': val *= 60; break;
+    case 'h': val *= 3600; break;
+    case 'd': val *= 86400; break;
+    default: break;
+    }
+  if (arg[0] == '-')
+    return time(NULL) + val;
+  return val;
+  }
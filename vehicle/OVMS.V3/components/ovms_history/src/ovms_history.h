@@ -0,0 +1,181 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __OVMS_HISTORY_H__
+#define __OVMS_HISTORY_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ovms_metrics.h"
+#include "ovms_command.h"
+#include "ovms_mutex.h"
+#include "ovms_utils.h"
+
+/**
+ * Metric history: opt-in time series recorder for numeric metrics
+ *
+ * Each recorded metric (config "history" "metrics") gets a series of three
+ * ring buffers with 1 second samples and 1 minute / 15 minute rollups
+ * (avg/min/max). Samples are stored as delta encoded integers (zigzag varints)
+ * in fixed size blocks in SPIRAM, the first sample of each block is absolute.
+ * Blocks dropped from the rings can be spilled to the SD card.
+ */
+
+#define HISTORY_LEVELS            3
+#define HISTORY_BLOCK_SIZE        256           // bytes incl. header
+#define HISTORY_BLOCK_DATA        (HISTORY_BLOCK_SIZE - 12)
+#define HISTORY_MAX_VALUES        3             // avg, min, max
+#define HISTORY_MAX_DECIMALS      6
+#define HISTORY_TIME_VALID        1577836800    // 2020-01-01: don't record before clock sync
+
+extern const uint32_t history_resolution[HISTORY_LEVELS];
+
+struct HistoryBlock
+  {
+  uint32_t  t0;                           // time of first sample
+  uint32_t  t1;                           // time of last sample
+  uint16_t  count;                        // number of samples
+  uint16_t  used;                         // bytes used in data
+  uint8_t   data[HISTORY_BLOCK_DATA];     // per sample: time delta, value deltas
+  };
+
+struct HistorySample
+  {
+  uint32_t  time;
+  int32_t   value[HISTORY_MAX_VALUES];    // scaled by 10^decimals
+  };
+
+typedef std::vector<HistorySample> HistorySampleList;
+
+class HistorySeries;
+
+class HistoryRing
+  {
+  public:
+    HistoryRing();
+    ~HistoryRing();
+
+  public:
+    bool Init(HistorySeries* series, int level, int blocks);
+    void Clear();
+    void Add(uint32_t time, const int32_t* value);
+    void Query(HistorySampleList& out, uint32_t from, uint32_t to, size_t max);
+    static void Decode(const HistoryBlock* block, int nvalues, HistorySampleList& out,
+      uint32_t from, uint32_t to, size_t max);
+
+  public:
+    uint32_t FirstTime();
+    uint32_t LastTime();
+    size_t Samples();
+    size_t BlocksUsed() { return m_count; }
+    size_t BlocksTotal() { return m_size; }
+
+  protected:
+    HistoryBlock* NewBlock();
+    int Encode(uint8_t* dst, uint32_t time, const int32_t* value);
+
+  protected:
+    HistorySeries*  m_series;
+    int             m_level;
+    int             m_nvalues;
+    HistoryBlock*   m_blocks;
+    int             m_size;
+    int             m_first;                // index of oldest block
+    int             m_count;
+    uint32_t        m_lasttime;             // encoder state of the newest block
+    int32_t         m_lastvalue[HISTORY_MAX_VALUES];
+  };
+
+struct HistoryRollup
+  {
+  uint32_t  period;
+  int64_t   sum;
+  int32_t   min;
+  int32_t   max;
+  uint32_t  count;
+  };
+
+class HistorySeries
+  {
+  public:
+    HistorySeries(const std::string& name, int decimals, const int* blocks);
+    ~HistorySeries();
+
+  public:
+    void Sample(uint32_t time);
+    void Clear();
+    int FindLevel(uint32_t from, uint32_t to, size_t max);
+    void Query(HistorySampleList& out, int level, uint32_t from, uint32_t to, size_t max);
+    void Spill(int level, const HistoryBlock* block);
+    void AppendValue(std::string& buf, int32_t value);
+    void AppendJSON(std::string& buf, int level, uint32_t from, uint32_t to, size_t max);
+
+  protected:
+    std::string SpillPath(int level, bool old=false);
+    void QuerySpill(HistorySampleList& out, int level, uint32_t from, uint32_t to, size_t max);
+
+  public:
+    std::string     m_name;
+    int             m_decimals;
+    int32_t         m_scale;                    // 10^decimals
+    int             m_blocks[HISTORY_LEVELS];
+    HistoryRing     m_ring[HISTORY_LEVELS];
+    HistoryRollup   m_rollup[HISTORY_LEVELS];   // [0] unused
+    uint32_t        m_spilled[HISTORY_LEVELS];  // number of blocks written to SD
+  };
+
+typedef NameMap<HistorySeries*> HistorySeriesMap;
+
+class OvmsHistory
+  {
+  public:
+    OvmsHistory();
+    ~OvmsHistory();
+
+  public:
+    void ConfigChanged(std::string event, void* data);
+    void Ticker(std::string event, void* data);
+    void Status(OvmsWriter* writer);
+    bool GetJSON(std::string& buf, const std::string& metric, uint32_t from, uint32_t to,
+      int resolution=0, size_t max=0);
+    static uint32_t ParseTime(const std::string& arg, uint32_t defvalue);
+
+  public:
+    OvmsMutex         m_mutex;
+    HistorySeriesMap  m_series;
+    bool              m_sd_enable;
+    std::string       m_sd_path;
+    size_t            m_sd_maxsize;
+  };
+
+extern OvmsHistory MyHistory;
+
+#endif //#ifndef __OVMS_HISTORY_H__
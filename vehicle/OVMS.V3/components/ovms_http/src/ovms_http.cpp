@@ -193,7 +193,7 @@ void OvmsSyncHttpClient::ConnectionLaunch()
   opts.user_data = this;
   if (m_tls)
     {
-    opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+    opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
     opts.ssl_server_name = m_server.c_str();
     }
 
@@ -210,6 +210,8 @@ void OvmsSyncHttpClient::ConnectionLaunch()
       }
     return;
     }
+  if (m_tls)
+    MyOvmsTLS.SetupConnection(m_mgconn, address, opts);
 
   if (m_buf) delete m_buf;
   m_buf = new OvmsBuffer(4096);
@@ -233,7 +235,9 @@ void OvmsSyncHttpClient::ConnectionOk(struct mg_connection *nc)
   req.append(m_server);
   req.append("\r\nUser-Agent: ");
   req.append(get_user_agent());
-  req.append("\r\n\r\n");
+  req.append("\r\n");
+  req.append(m_reqheaders);
+  req.append("\r\n");
   mg_send(nc, req.c_str(), req.length());
   }
 
@@ -408,6 +412,16 @@ bool OvmsSyncHttpClient::Request(std::string url, const char* method)
   return (m_error.empty());
   }
 
+/**
+ * SetRequestHeaders: set additional headers for the next requests
+ *  Pass the header lines including "\r\n" termination, e.g. "Range: bytes=1000-\r\n",
+ *  or an empty string to clear.
+ */
+void OvmsSyncHttpClient::SetRequestHeaders(std::string headers)
+  {
+  m_reqheaders = headers;
+  }
+
 std::string OvmsSyncHttpClient::GetBodyAsString()
   {
   return m_body;
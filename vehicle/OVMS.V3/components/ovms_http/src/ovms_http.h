@@ -57,6 +57,7 @@ class OvmsSyncHttpClient
 
   public:
     bool Request(std::string url, const char* method = "GET");
+    void SetRequestHeaders(std::string headers);
     std::string GetBodyAsString();
     OvmsBuffer* GetBodyAsBuffer();
     int GetResponseCode();
@@ -76,6 +77,7 @@ class OvmsSyncHttpClient
     std::string m_path;
     bool m_tls;
     const char* m_method;
+    std::string m_reqheaders;
     bool m_inheaders;
     size_t m_bodysize;
     int m_responsecode;
@@ -157,8 +157,14 @@ void GsmMuxChannel::ProcessFrame(uint8_t* frame, size_t length, size_t iframepos
     case ChanOpen:
       if (frame[1] == (GSM_UIH + GSM_PF))
         {
-        for (size_t k=iframepos;k<length;k++)
-          m_buffer.Push(frame[k]);
+        size_t size = length - iframepos;
+        size_t space = m_buffer.FreeSpace();
+        if (size > space)
+          {
+          ESP_LOGW(TAG, "Channel #%d buffer overflow, %d bytes lost", m_channel, size-space);
+          size = space;
+          }
+        m_buffer.Push(frame+iframepos, size);
         m_mux->m_modem->IncomingMuxData(this);
         }
       break;
@@ -185,6 +191,9 @@ GsmMux::GsmMux(modem* m, int channelcount, size_t maxframesize)
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_fcserrors = 0;
+  m_rxbytes = 0;
+  m_statstart = 0;
   }
 
 GsmMux::~GsmMux()
@@ -200,6 +209,9 @@ void GsmMux::Startup()
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_fcserrors = 0;
+  m_rxbytes = 0;
+  m_statstart = monotonictime;
   m_channels.insert(m_channels.end(),new GsmMuxChannel(this,0,8));
   for (int k=1; k<=m_channelcount; k++)
     {
@@ -232,6 +244,9 @@ void GsmMux::Shutdown()
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_fcserrors = 0;
+  m_rxbytes = 0;
+  m_statstart = 0;
   }
 
 void GsmMux::StartChannel(int channel)
@@ -274,54 +289,84 @@ uint32_t GsmMux::GoodFrameAge()
 
 void GsmMux::Process(OvmsBuffer* buf)
   {
-  while (buf->UsedSpace()>0)
+  uint8_t* data;
+  size_t size;
+
+  // Process the ring buffer content in place, in (up to two) contiguous blocks:
+  while ((size = buf->PeekSpan(&data)) > 0)
+    {
+    ProcessBlock(data, size);
+    buf->Drop(size);
+    }
+  }
+
+void GsmMux::ProcessBlock(uint8_t* data, size_t size)
+  {
+  uint8_t* end = data + size;
+
+  while (data < end)
     {
-    if (m_framepos == m_framesize)
+    if (m_framepos == 0)
       {
-      // Overflow frame
-      ESP_LOGW(TAG, "Frame overflow (%d bytes)",m_framesize);
-      MyCommandApp.HexDump(TAG, "Frame head", (const char*)m_frame, 8*16);
-      m_framepos = 0;
-      m_framelen = 0;
-      m_framemorelen = false;
-      m_framingerrors++;
+      // Skip to start of frame:
+      data = (uint8_t*) memchr(data, GSM0_SOF, end-data);
+      if (data == NULL) return;
+      m_frame[m_framepos++] = *data++;
       continue;
       }
-    uint8_t b = buf->Pop();
-    if ((m_framepos == 0)&&(b != GSM0_SOF))
-      {
-      continue; // Skip to start of frame
-      }
-    if ((m_framepos == 1)&&(b == GSM0_SOF)) continue; // We found end of previous frame, so just skip it
-    // ESP_LOGI(TAG, "Got %02x at %d (length sofar = %d)",b,m_framepos,m_framelen);
-    m_frame[m_framepos++] = b;
-    if (m_framepos == 4)
+
+    if ((m_framepos < 4) || (m_framemorelen))
       {
-      // First byte of length field
-      m_framemorelen = !(b & GSM_EA);
-      m_framelen = (b>>1);
-      if (!m_framemorelen)
+      // Frame header, byte by byte:
+      uint8_t b = *data++;
+      if ((m_framepos == 1)&&(b == GSM0_SOF)) continue; // We found end of previous frame, so just skip it
+      m_frame[m_framepos++] = b;
+      if (m_framepos == 4)
         {
-        m_framelen += (m_framepos+2);
-        m_frameipos = m_framepos;
+        // First byte of length field
+        m_framemorelen = !(b & GSM_EA);
+        m_framelen = (b>>1);
+        if (!m_framemorelen)
+          {
+          m_framelen += (m_framepos+2);
+          m_frameipos = m_framepos;
+          }
+        else
+          {
+          m_framelen += (m_framepos+3);
+          m_frameipos = m_framepos+1;
+          }
         }
-      else
+      else if (m_framepos == 5)
         {
-        m_framelen += (m_framepos+3);
-        m_frameipos = m_framepos+1;
+        // Second byte of length field
+        m_framelen += (b<<7);
+        m_framemorelen = false;
         }
-      // ESP_LOGI(TAG, "Frame length (first byte) = %d",m_framelen);
-      }
-    if ((m_framepos == 5)&&(m_framemorelen))
-      {
-      // Second byte of length field
-      m_framelen += (b<<7);
-      m_framemorelen = false;
-      // ESP_LOGI(TAG, "Frame length (second byte) = %d",m_framelen);
+      if ((m_framepos >= 4) && (!m_framemorelen) && (m_framelen > m_framesize))
+        {
+        // Overflow frame
+        ESP_LOGW(TAG, "Frame overflow (%d bytes, max %d)",m_framelen,m_framesize);
+        MyCommandApp.HexDump(TAG, "Frame head", (const char*)m_frame, m_framepos);
+        m_framepos = 0;
+        m_framelen = 0;
+        m_framemorelen = false;
+        m_framingerrors++;
+        }
+      continue;
       }
+
+    // Frame body, in bulk:
+    size_t n = m_framelen - m_framepos;
+    if (n > (size_t)(end-data)) n = end-data;
+    memcpy(m_frame+m_framepos, data, n);
+    m_framepos += n;
+    m_rxbytes += n;
+    data += n;
+
     if (m_framepos == m_framelen)
       {
-      if (b == GSM0_SOF)
+      if (m_frame[m_framelen-1] == GSM0_SOF)
         {
         // We have a complete frame...
         ProcessFrame();
@@ -358,6 +403,7 @@ void GsmMux::ProcessFrame()
     m_frameipos = 0;
     m_framelen = 0;
     m_framingerrors++;
+    m_fcserrors++;
     m_framemorelen = false;
     return;
     }
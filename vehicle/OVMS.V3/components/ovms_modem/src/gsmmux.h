@@ -76,6 +76,7 @@ class GsmMux : public InternalRamAllocated
     void StartChannel(int channel);
     void StopChannel(int channel);
     void Process(OvmsBuffer* buf);
+    void ProcessBlock(uint8_t* data, size_t size);
     void ProcessFrame();
     size_t tx(int channel, uint8_t* data, ssize_t size);
     size_t tx(int channel, const char* data, ssize_t size = -1);
@@ -103,6 +104,9 @@ class GsmMux : public InternalRamAllocated
     uint32_t m_lastgoodrxframe;
     uint32_t m_rxframecount;
     uint32_t m_txframecount;
+    uint32_t m_fcserrors;
+    uint32_t m_rxbytes;             // frame bytes copied in bulk
+    uint32_t m_statstart;           // monotonictime of statistics start
 
   public:
     modem* m_modem;
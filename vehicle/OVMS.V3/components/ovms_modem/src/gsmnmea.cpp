@@ -33,7 +33,7 @@
 static const char *TAG = "gsm-nmea";
 
 #include <string>
-#include <sstream>
+#include <string.h>
 
 #include "gsmnmea.h"
 #include "ovms_command.h"
@@ -42,27 +42,12 @@ static const char *TAG = "gsm-nmea";
 #include "ovms_metrics.h"
 #include "metrics_standard.h"
 #include "ovms_time.h"
+#include "ovms.h"
 
 #define JDEpoch 2440588 // Julian date of the Unix epoch
 #define DIM(a) (sizeof(a)/sizeof(*(a)))
 
 
-/**
- * gps2latlon: convert NMEA degree/minute form to degrees
- */
-static float gps2latlon(const char *gpscoord)
-{
-  double f;
-  long d;
-
-  f = atof(gpscoord);
-  d = (long) (f / 100); // extract degrees
-  f = d + (f - (d * 100)) / 60; // convert to decimal format
-
-  return (float) f;
-}
-
-
 /**
  * JdFromYMD:
  *  computes the Julian date from year, month, day
@@ -99,151 +84,351 @@ static unsigned long utc_to_timestamp(const char* date, const char* time)
   }
 
 
-void GsmNMEA::IncomingLine(const std::string line)
+/**
+ * nmea_hex: hex digit value or -1
+ */
+static inline int nmea_hex(char c)
   {
-  ESP_LOGV(TAG, "IncomingLine: %s", line.c_str());
-
-  std::istringstream sentence(line);
-  std::string token;
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+  }
 
-  if (!std::getline(sentence, token, ','))
-    return;
-  if (token.length() < 6 || token[0] != '$')
-    return;
 
-  if (token.substr(3) == "GNS")
+/**
+ * nmea_fixed: parse decimal field into fixed point number with <decimals> digits
+ *  (excess digits are truncated). An empty field yields 0.
+ */
+static bool nmea_fixed(const gsmnmea_field_t& f, int decimals, int64_t& out)
+  {
+  const char *p = f.p, *e = f.p + f.len;
+  bool neg = false, frac = false;
+  int digits = 0;
+  int64_t v = 0;
+
+  if (p < e && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+  for (; p < e; p++)
     {
-    // NMEA sentence type "GNS": GNSS Position Fix Data (GPS/GLONASS/… combined position data)
-    //  $..GNS,<Time>,<Latitude>,<NS>,<Longitude>,<EW>,<Mode>,<SatCnt>,<HDOP>,<Altitude>,<GeoidalSep>,<DiffAge>,<Chksum>
-    // Example:
-    //  $GNGNS,085320.0,5118.138139,N,00723.398844,E,AA,12,0.9,321.3,47.0,,*6E
-    // Notes:
-    //  <Mode>: first char = GPS, second = GLONASS;
-    //    N = No fix
-    //    A = Autonomous mode (non differential)
-    //    D = Differential mode
-    //    E = Estimation mode
-
-    float lat=0, lon=0, alt=0, hdop=0;
-    char ns=0, ew=0;
-    char mode[3] = {0,0,0};
-    int satcnt=0;
-
-    // Parse sentence:
-
-    if (std::getline(sentence, token, ','))
-      {;} // Time ignored here, see RMC handler
-    if (std::getline(sentence, token, ','))
-      lat = gps2latlon(token.c_str());
-    if (std::getline(sentence, token, ','))
-      ns = token[0];
-    if (std::getline(sentence, token, ','))
-      lon = gps2latlon(token.c_str());
-    if (std::getline(sentence, token, ','))
-      ew = token[0];
-    if (std::getline(sentence, token, ','))
+    if (*p == '.' && !frac)
+      {
+      frac = true;
+      continue;
+      }
+    if (*p < '0' || *p > '9')
+      return false;
+    if (frac)
       {
-      mode[0] = token[0];
-      mode[1] = token[1];
+      if (decimals == 0) continue;
+      decimals--;
       }
-    if (std::getline(sentence, token, ','))
-      satcnt = atoi(token.c_str());
-    if (std::getline(sentence, token, ','))
-      hdop = atof(token.c_str());
-    if (std::getline(sentence, token, ','))
-      alt = atof(token.c_str());
+    if (++digits > 15)
+      return false;
+    v = v * 10 + (*p - '0');
+    }
+  while (decimals-- > 0)
+    v *= 10;
+
+  out = neg ? -v : v;
+  return true;
+  }
+
+static bool nmea_int32(const gsmnmea_field_t& f, int decimals, int32_t& out)
+  {
+  int64_t v;
+  if (!nmea_fixed(f, decimals, v) || v > INT32_MAX || v < INT32_MIN)
+    return false;
+  out = v;
+  return true;
+  }
+
+
+/**
+ * nmea_coord: convert NMEA degree/minute form "[d]ddmm.mmmmmm" to 1e-7 degrees
+ *  hemisphere: 'S' or 'W' negates the result
+ */
+static bool nmea_coord(const gsmnmea_field_t& f, const gsmnmea_field_t& hemisphere, int32_t& out)
+  {
+  int64_t v, deg, min;
+  if (!nmea_fixed(f, 6, v) || v < 0 || v > 18000000000LL)
+    return false;
+  deg = v / 100000000;                  // ddd
+  min = v % 100000000;                  // mm.mmmmmm in 1e-6 minutes
+  out = deg * 10000000 + (min + 3) / 6; // 1e-6 min → 1e-7 deg
+  if (hemisphere.len && (hemisphere.p[0] == 'S' || hemisphere.p[0] == 'W'))
+    out = -out;
+  return true;
+  }
 
-    // Check:
 
-    if (!ns || !ew || !mode[0])
-      return; // malformed/empty sentence
+/**
+ * nmea_copy: copy field into fixed size string
+ */
+static void nmea_copy(const gsmnmea_field_t& f, char* dst, int size)
+  {
+  int n = (f.len < size-1) ? f.len : size-1;
+  memcpy(dst, f.p, n);
+  dst[n] = 0;
+  }
 
-    // Data set complete, store:
 
-    if (ns == 'S')
-      lat = -lat;
-    if (ew == 'W')
-      lon = -lon;
+/**
+ * Sentence field parsers
+ */
 
-    bool gpslock = (mode[0] != 'N' || mode[1] != 'N');
+static gsmnmea_result_t nmea_parse_gns(const gsmnmea_field_t* f, int cnt, gsmnmea_sentence_t& s)
+  {
+  // NMEA sentence type "GNS": GNSS Position Fix Data (GPS/GLONASS/… combined position data)
+  //  $..GNS,<Time>,<Latitude>,<NS>,<Longitude>,<EW>,<Mode>,<SatCnt>,<HDOP>,<Altitude>,<GeoidalSep>,<DiffAge>,<Chksum>
+  // Example:
+  //  $GNGNS,085320.0,5118.138139,N,00723.398844,E,AA,12,0.9,321.3,47.0,,*6E
+  // Notes:
+  //  <Mode>: first char = GPS, second = GLONASS;
+  //    N = No fix
+  //    A = Autonomous mode (non differential)
+  //    D = Differential mode
+  //    E = Estimation mode
+
+  if (cnt < 10)
+    return NMEA_MALFORMED;
+  if (!f[3].len || !f[5].len || !f[6].len)
+    return NMEA_IGNORED; // empty sentence
+  if (!nmea_coord(f[2], f[3], s.lat) ||
+      !nmea_coord(f[4], f[5], s.lon) ||
+      !nmea_int32(f[7], 0, s.satcnt) ||
+      !nmea_int32(f[8], 2, s.hdop) ||
+      !nmea_int32(f[9], 1, s.alt))
+    return NMEA_MALFORMED;
+  nmea_copy(f[6], s.mode, sizeof(s.mode));
+  return NMEA_OK;
+  }
 
-    *StdMetrics.ms_v_pos_gpsmode = (std::string) mode;
-    *StdMetrics.ms_v_pos_satcount = (int) satcnt;
-    *StdMetrics.ms_v_pos_gpshdop = (float) hdop;
+static gsmnmea_result_t nmea_parse_rmc(const gsmnmea_field_t* f, int cnt, gsmnmea_sentence_t& s)
+  {
+  // NMEA sentence type "RMC": Recommended Minimum Specific GNSS Data
+  //  $..RMC,<Time>,<Status>,<Latitude>,<NS>,<Longitude>,<EW>,<SpeedKnots>,<Direction>,<Date>,<MagVar>,<MagVarEW>,<Mode>,<Chksum>
+  // Example:
+  //  $GPRMC,085320.0,A,5118.138139,N,00723.398844,E,0.0,265.5,101217,,,A*62
+
+  if (cnt < 10)
+    return NMEA_MALFORMED;
+  if (!f[1].len || !f[9].len)
+    return NMEA_IGNORED; // empty sentence
+  if (f[1].len < 6 || f[9].len < 6)
+    return NMEA_MALFORMED;
+  for (int i = 0; i < 6; i++)
+    {
+    if (f[1].p[i] < '0' || f[1].p[i] > '9' || f[9].p[i] < '0' || f[9].p[i] > '9')
+      return NMEA_MALFORMED;
+    }
+  if (!nmea_int32(f[7], 3, s.speed) ||
+      !nmea_int32(f[8], 2, s.direction))
+    return NMEA_MALFORMED;
+  nmea_copy(f[1], s.time, sizeof(s.time));
+  nmea_copy(f[9], s.date, sizeof(s.date));
+  return NMEA_OK;
+  }
 
-    if (gpslock)
+typedef gsmnmea_result_t (*gsmnmea_parser_t)(const gsmnmea_field_t* f, int cnt, gsmnmea_sentence_t& s);
+
+static const struct
+  {
+  char              name[4];
+  gsmnmea_type_t    type;
+  gsmnmea_parser_t  parser;
+  } nmea_sentence_types[] =
+  {
+  { "GNS", NMEA_GNS, nmea_parse_gns },
+  { "RMC", NMEA_RMC, nmea_parse_rmc },
+  };
+
+
+/**
+ * Parse: validate & parse a sentence in a single pass without allocations
+ *  Fields are referenced in place, numbers are parsed into fixed point.
+ */
+gsmnmea_result_t GsmNMEA::Parse(const char* line, size_t len, gsmnmea_sentence_t& sentence)
+  {
+  gsmnmea_field_t field[NMEA_MAXFIELDS];
+  int cnt = 0;
+  uint8_t csum = 0;
+  const char *p = line, *e = line + len;
+
+  sentence.type = NMEA_NONE;
+
+  while (e > p && (e[-1] == '\r' || e[-1] == '\n' || e[-1] == ' '))
+    e--;
+  if (p == e || *p++ != '$')
+    return NMEA_MALFORMED;
+
+  // Split fields & calculate checksum:
+  field[0].p = p;
+  for (; p < e && *p != '*'; p++)
+    {
+    csum ^= (uint8_t) *p;
+    if (*p == ',')
       {
-      *StdMetrics.ms_v_pos_latitude = (float) lat;
-      *StdMetrics.ms_v_pos_longitude = (float) lon;
-      *StdMetrics.ms_v_pos_altitude = (float) alt;
+      field[cnt].len = p - field[cnt].p;
+      if (++cnt == NMEA_MAXFIELDS)
+        return NMEA_MALFORMED;
+      field[cnt].p = p + 1;
       }
-
-    // upodate gpslock last, so listeners will see updated lat/lon values:
-    if (gpslock != StdMetrics.ms_v_pos_gpslock->AsBool())
+    }
+  field[cnt].len = p - field[cnt].p;
+  cnt++;
+
+  // Validate checksum:
+  if (e - p != 3)
+    return NMEA_CHECKSUM;
+  int hi = nmea_hex(p[1]), lo = nmea_hex(p[2]);
+  if (hi < 0 || lo < 0 || csum != (uint8_t)((hi << 4) | lo))
+    return NMEA_CHECKSUM;
+
+  // Dispatch by sentence type (talker ID ignored):
+  if (field[0].len != 5)
+    return NMEA_IGNORED;
+  for (size_t i = 0; i < DIM(nmea_sentence_types); i++)
+    {
+    if (memcmp(field[0].p + 2, nmea_sentence_types[i].name, 3) == 0)
       {
-      *StdMetrics.ms_v_pos_gpslock = (bool) gpslock;
-      if (gpslock)
-        MyEvents.SignalEvent("system.modem.gotgps", NULL);
-      else
-        MyEvents.SignalEvent("system.modem.lostgps", NULL);
+      gsmnmea_result_t res = nmea_sentence_types[i].parser(field, cnt, sentence);
+      if (res == NMEA_OK)
+        sentence.type = nmea_sentence_types[i].type;
+      return res;
       }
+    }
+  return NMEA_IGNORED;
+  }
+
 
-    // END "GNS" handler
+void GsmNMEA::IncomingLine(const char* line, size_t len)
+  {
+  ESP_LOGV(TAG, "IncomingLine: %.*s", (int)len, line);
+
+  gsmnmea_sentence_t s;
+  m_stat_sentences++;
+  switch (Parse(line, len, s))
+    {
+    case NMEA_OK:
+      if (s.type == NMEA_GNS)
+        UpdateGNS(s);
+      else if (s.type == NMEA_RMC)
+        UpdateRMC(s);
+      break;
+    case NMEA_IGNORED:
+      m_stat_ignored++;
+      break;
+    case NMEA_MALFORMED:
+      m_stat_malformed++;
+      break;
+    case NMEA_CHECKSUM:
+      m_stat_csumerr++;
+      ESP_LOGD(TAG, "Checksum error: %.*s", (int)len, line);
+      break;
+    }
+  }
+
+
+/**
+ * UpdateGNS / UpdateRMC: store sentence data in metrics
+ *  Metrics are only set on changes, unchanged values are refreshed every
+ *  NMEA_REFRESH_INTERVAL seconds to keep them from becoming stale.
+ */
+void GsmNMEA::UpdateGNS(const gsmnmea_sentence_t& s)
+  {
+  bool refresh = (monotonictime - m_gns_refresh >= NMEA_REFRESH_INTERVAL);
+  if (refresh)
+    m_gns_refresh = monotonictime;
+
+  bool gpslock = (s.mode[0] != 'N' || (s.mode[1] && s.mode[1] != 'N'));
+
+  if (refresh || strcmp(s.mode, m_gns.mode) != 0)
+    {
+    *StdMetrics.ms_v_pos_gpsmode = (std::string) s.mode;
+    m_stat_updates++;
+    }
+  if (refresh || s.satcnt != m_gns.satcnt)
+    {
+    *StdMetrics.ms_v_pos_satcount = (int) s.satcnt;
+    m_stat_updates++;
+    }
+  if (refresh || s.hdop != m_gns.hdop)
+    {
+    *StdMetrics.ms_v_pos_gpshdop = (float) s.hdop / 100;
+    m_stat_updates++;
     }
 
-  else if (token.substr(3) == "RMC")
+  if (gpslock)
     {
-    // NMEA sentence type "RMC": Recommended Minimum Specific GNSS Data
-    //  $..RMC,<Time>,<Status>,<Latitude>,<NS>,<Longitude>,<EW>,<SpeedKnots>,<Direction>,<Date>,<MagVar>,<MagVarEW>,<Mode>,<Chksum>
-    // Example:
-    //  $GPRMC,085320.0,A,5118.138139,N,00723.398844,E,0.0,265.5,101217,,,A*62
-
-    char date[6] = {0}, time[6] = {0};
-    float direction=0, speed=0;
-
-    // Parse sentence:
-
-    if (std::getline(sentence, token, ','))
-      strncpy(time, token.c_str(), 6);
-    if (std::getline(sentence, token, ','))
-      {;} // Status
-    if (std::getline(sentence, token, ','))
-      {;} // Latitude
-    if (std::getline(sentence, token, ','))
-      {;} // NS
-    if (std::getline(sentence, token, ','))
-      {;} // Longitude
-    if (std::getline(sentence, token, ','))
-      {;} // EW
-    if (std::getline(sentence, token, ','))
-      speed = atof(token.c_str()) * 1.852;
-    if (std::getline(sentence, token, ','))
-      direction = atof(token.c_str());
-    if (std::getline(sentence, token, ','))
-      strncpy(date, token.c_str(), 6);
-
-    // Check:
-
-    if (!date[0] || !time[0])
-      return; // malformed/empty sentence
-
-    // Data complete, store:
-
-    if (m_gpstime_enabled)
+    if (refresh || s.lat != m_gns.lat)
+      {
+      *StdMetrics.ms_v_pos_latitude = (float) ((double) s.lat / 10000000);
+      m_stat_updates++;
+      }
+    if (refresh || s.lon != m_gns.lon)
       {
-      int tm = utc_to_timestamp(date, time);
-      if (tm < 1572735600) // 2019-11-03 00:00:00
-        tm += (1024*7*86400); // Nasty kludge to workaround SIM5360 week rollover
-      *StdMetrics.ms_m_timeutc = (int) tm;
-      MyTime.Set(TAG, 2, true, tm);
+      *StdMetrics.ms_v_pos_longitude = (float) ((double) s.lon / 10000000);
+      m_stat_updates++;
       }
+    if (refresh || s.alt != m_gns.alt)
+      {
+      *StdMetrics.ms_v_pos_altitude = (float) s.alt / 10;
+      m_stat_updates++;
+      }
+    m_gns = s;
+    }
+  else
+    {
+    // keep last position for change detection:
+    memcpy(m_gns.mode, s.mode, sizeof(m_gns.mode));
+    m_gns.satcnt = s.satcnt;
+    m_gns.hdop = s.hdop;
+    }
 
-    *StdMetrics.ms_v_pos_direction = (float) direction;
-    *StdMetrics.ms_v_pos_gpsspeed = (float) speed;
+  // update gpslock last, so listeners will see updated lat/lon values:
+  if (gpslock != StdMetrics.ms_v_pos_gpslock->AsBool())
+    {
+    *StdMetrics.ms_v_pos_gpslock = (bool) gpslock;
+    if (gpslock)
+      MyEvents.SignalEvent("system.modem.gotgps", NULL);
+    else
+      MyEvents.SignalEvent("system.modem.lostgps", NULL);
+    }
+  else if (refresh)
+    {
+    *StdMetrics.ms_v_pos_gpslock = (bool) gpslock;
+    }
+  }
+
+void GsmNMEA::UpdateRMC(const gsmnmea_sentence_t& s)
+  {
+  bool refresh = (monotonictime - m_rmc_refresh >= NMEA_REFRESH_INTERVAL);
+  if (refresh)
+    m_rmc_refresh = monotonictime;
+
+  if (m_gpstime_enabled && (refresh || strcmp(s.time, m_rmc.time) != 0 || strcmp(s.date, m_rmc.date) != 0))
+    {
+    int tm = utc_to_timestamp(s.date, s.time);
+    if (tm < 1572735600) // 2019-11-03 00:00:00
+      tm += (1024*7*86400); // Nasty kludge to workaround SIM5360 week rollover
+    *StdMetrics.ms_m_timeutc = (int) tm;
+    MyTime.Set(TAG, 2, true, tm);
+    m_stat_updates++;
+    }
 
-    // END "RMC" handler
+  if (refresh || s.direction != m_rmc.direction)
+    {
+    *StdMetrics.ms_v_pos_direction = (float) s.direction / 100;
+    m_stat_updates++;
+    }
+  if (refresh || s.speed != m_rmc.speed)
+    {
+    *StdMetrics.ms_v_pos_gpsspeed = (float) s.speed * 0.001852f;
+    m_stat_updates++;
     }
 
+  m_rmc = s;
   }
 
 
@@ -253,6 +438,11 @@ void GsmNMEA::Startup()
 
   m_gpstime_enabled = MyConfig.GetParamValueBool("modem", "enable.gpstime", false);
 
+  // Force initial metrics update:
+  memset(&m_gns, 0, sizeof(m_gns));
+  memset(&m_rmc, 0, sizeof(m_rmc));
+  m_gns_refresh = m_rmc_refresh = monotonictime - NMEA_REFRESH_INTERVAL;
+
   // Switch on GPS, subscribe to NMEA sentences…
   //   2 = $..RMC -- UTC time & date
   //  64 = $..GNS -- Position & fix data
@@ -292,6 +482,14 @@ GsmNMEA::GsmNMEA(GsmMux* mux, int channel_nmea, int channel_cmd)
   m_channel_cmd = channel_cmd;
   m_connected = false;
   m_gpstime_enabled = false;
+  memset(&m_gns, 0, sizeof(m_gns));
+  memset(&m_rmc, 0, sizeof(m_rmc));
+  m_gns_refresh = m_rmc_refresh = 0;
+  m_stat_sentences = 0;
+  m_stat_ignored = 0;
+  m_stat_malformed = 0;
+  m_stat_csumerr = 0;
+  m_stat_updates = 0;
   }
 
 GsmNMEA::~GsmNMEA()
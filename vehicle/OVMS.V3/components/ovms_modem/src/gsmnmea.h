@@ -38,6 +38,48 @@
 #include "driver/uart.h"
 #include "gsmmux.h"
 
+#define NMEA_MAXFIELDS          24      // max fields per sentence incl. type
+#define NMEA_REFRESH_INTERVAL   5       // seconds between refreshs of unchanged metrics
+
+typedef enum
+  {
+  NMEA_OK = 0,                          // sentence parsed
+  NMEA_IGNORED,                         // valid, but type not handled or no data
+  NMEA_MALFORMED,                       // framing or field syntax error
+  NMEA_CHECKSUM,                        // checksum missing or mismatch
+  } gsmnmea_result_t;
+
+typedef enum
+  {
+  NMEA_NONE = 0,
+  NMEA_GNS,                             // GNSS position fix data
+  NMEA_RMC,                             // recommended minimum data
+  } gsmnmea_type_t;
+
+typedef struct
+  {
+  const char*   p;
+  int           len;
+  } gsmnmea_field_t;
+
+// Parsed sentence data, all numbers are fixed point:
+typedef struct
+  {
+  gsmnmea_type_t type;
+  // GNS:
+  int32_t       lat;                    // latitude [1e-7 deg]
+  int32_t       lon;                    // longitude [1e-7 deg]
+  int32_t       alt;                    // altitude [1/10 m]
+  int32_t       hdop;                   // horizontal dilution of precision [1/100]
+  int32_t       satcnt;                 // satellites used
+  char          mode[3];                // mode indicators GPS, GLONASS
+  // RMC:
+  char          time[7];                // "hhmmss" UTC
+  char          date[7];                // "ddmmyy" UTC
+  int32_t       speed;                  // speed over ground [1/1000 kn]
+  int32_t       direction;              // course over ground [1/100 deg]
+  } gsmnmea_sentence_t;
+
 class GsmNMEA : public InternalRamAllocated
   {
   public:
@@ -45,16 +87,35 @@ class GsmNMEA : public InternalRamAllocated
     ~GsmNMEA();
 
   public:
-    void IncomingLine(const std::string line);
+    static gsmnmea_result_t Parse(const char* line, size_t len, gsmnmea_sentence_t& sentence);
+    void IncomingLine(const char* line, size_t len);
+    void IncomingLine(const std::string& line) { IncomingLine(line.data(), line.length()); }
     void Startup();
     void Shutdown(bool hard=false);
 
+  protected:
+    void UpdateGNS(const gsmnmea_sentence_t& s);
+    void UpdateRMC(const gsmnmea_sentence_t& s);
+
   public:
     GsmMux*       m_mux;
     int           m_channel_nmea;
     int           m_channel_cmd;
     bool          m_connected;
     bool          m_gpstime_enabled;
+
+  protected:
+    gsmnmea_sentence_t  m_gns;          // last GNS data stored in metrics
+    gsmnmea_sentence_t  m_rmc;          // last RMC data stored in metrics
+    uint32_t      m_gns_refresh;        // monotonictime of last GNS metrics refresh
+    uint32_t      m_rmc_refresh;        // monotonictime of last RMC metrics refresh
+
+  public:
+    uint32_t      m_stat_sentences;     // sentences received
+    uint32_t      m_stat_ignored;       // … of unhandled type
+    uint32_t      m_stat_malformed;     // … with syntax errors
+    uint32_t      m_stat_csumerr;       // … with checksum errors
+    uint32_t      m_stat_updates;       // metric updates done
   };
 
 #endif //#ifndef __GSM_NMEA__
@@ -34,6 +34,7 @@ static const char *TAG = "modem";
 #include <string.h>
 #include <algorithm>
 #include <functional>
+#include <vector>
 #include "ovms_modem.h"
 #include "ovms_peripherals.h"
 #include "metrics_standard.h"
@@ -41,6 +42,8 @@ static const char *TAG = "modem";
 #include "ovms_events.h"
 #include "ovms_notify.h"
 #include "ovms_boot.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Global convenience variables
@@ -437,8 +440,12 @@ void modem::SupportSummary(OvmsWriter* writer, bool debug /*=FALSE*/)
       {
       writer->printf("    Open Channels: %d\n", m_mux->m_openchannels);
       writer->printf("    Framing Errors: %d\n", m_mux->m_framingerrors);
-      writer->printf("    RX frames: %d\n", m_mux->m_rxframecount);
-      writer->printf("    TX frames: %d\n", m_mux->m_txframecount);
+      writer->printf("    FCS Errors: %d\n", m_mux->m_fcserrors);
+      uint32_t elapsed = (m_mux->m_statstart > 0) ? monotonictime - m_mux->m_statstart : 0;
+      if (elapsed == 0) elapsed = 1;
+      writer->printf("    RX frames: %d (%.1f/s)\n", m_mux->m_rxframecount, (float)m_mux->m_rxframecount / elapsed);
+      writer->printf("    RX bytes copied: %u (%.1f/s)\n", m_mux->m_rxbytes, (float)m_mux->m_rxbytes / elapsed);
+      writer->printf("    TX frames: %d (%.1f/s)\n", m_mux->m_txframecount, (float)m_mux->m_txframecount / elapsed);
       writer->printf("    Last RX frame: %d sec(s) ago\n", m_mux->GoodFrameAge());
       }
     }
@@ -484,6 +491,9 @@ void modem::SupportSummary(OvmsWriter* writer, bool debug /*=FALSE*/)
         MyConfig.GetParamValueBool("modem", "enable.gps", false) ? "enabled" : "disabled");
       writer->printf("     Time: %s\n",
         MyConfig.GetParamValueBool("modem", "enable.gpstime", false) ? "enabled" : "disabled");
+      writer->printf("     NMEA sentences: %u (%u ignored, %u malformed, %u checksum errors)\n",
+        m_nmea->m_stat_sentences, m_nmea->m_stat_ignored, m_nmea->m_stat_malformed, m_nmea->m_stat_csumerr);
+      writer->printf("     NMEA metric updates: %u\n", m_nmea->m_stat_updates);
       }
     }
   }
@@ -955,9 +965,10 @@ bool modem::StandardIncomingHandler(int channel, OvmsBuffer* buf)
     else
       {
       // Normal line mode
-      while (buf->HasLine() >= 0)
+      std::string line;
+      while (buf->ReadLine(line))
         {
-        StandardLineHandler(channel, buf, buf->ReadLine());
+        StandardLineHandler(channel, buf, line);
         result = true;
         }
       return result;
@@ -1402,9 +1413,22 @@ void modem::IncomingMuxData(GsmMuxChannel* channel)
     }
   else if (channel->m_channel == m_mux_channel_NMEA)
     {
-    while (channel->m_buffer.HasLine() >= 0)
+    OvmsBufferSpan span[2];
+    int len;
+    while ((len = channel->m_buffer.PeekLine(span)) >= 0)
       {
-      if (m_nmea != NULL) m_nmea->IncomingLine(channel->m_buffer.ReadLine());
+      if (m_nmea != NULL)
+        {
+        if (span[1].len == 0)
+          m_nmea->IncomingLine((const char*)span[0].data, len);
+        else
+          {
+          std::string line((const char*)span[0].data, span[0].len);
+          line.append((const char*)span[1].data, span[1].len);
+          m_nmea->IncomingLine(line);
+          }
+        }
+      channel->m_buffer.DropLine(len);
       }
     }
   else if (channel->m_channel == m_mux_channel_DATA)
@@ -1621,6 +1645,105 @@ void cellular_drivers(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
     }
   }
 
+// Load a recorded NMEA stream (one sentence per line) for cellular_nmea_*:
+static bool cellular_nmea_load(OvmsWriter* writer, const char* path, std::vector<std::string>& lines)
+  {
+  FILE* f = fopen(path, "r");
+  if (!f)
+    {
+    writer->printf("Error: cannot open %s\n", path);
+    return false;
+    }
+  char buf[128];
+  while (fgets(buf, sizeof(buf), f))
+    {
+    if (buf[0] == '$')
+      lines.push_back(buf);
+    }
+  fclose(f);
+  if (lines.empty())
+    {
+    writer->printf("Error: no NMEA sentences found in %s\n", path);
+    return false;
+    }
+  return true;
+  }
+
+void cellular_nmea_bench(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  std::vector<std::string> lines;
+  if (!cellular_nmea_load(writer, argv[0], lines))
+    return;
+  int loops = (argc > 1) ? atoi(argv[1]) : 10;
+  if (loops < 1) loops = 1;
+
+  gsmnmea_sentence_t s;
+  uint32_t res[NMEA_CHECKSUM+1] = { 0 };
+  int64_t t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    for (auto& line : lines)
+      res[GsmNMEA::Parse(line.data(), line.length(), s)]++;
+    }
+  int64_t t = esp_timer_get_time() - t0;
+  uint32_t cnt = lines.size() * loops;
+
+  writer->printf("Parsed %u sentences in %lld us = %.2f us/sentence\n",
+    cnt, t, (double) t / cnt);
+  writer->printf("  %u ok, %u ignored, %u malformed, %u checksum errors\n",
+    res[NMEA_OK], res[NMEA_IGNORED], res[NMEA_MALFORMED], res[NMEA_CHECKSUM]);
+  }
+
+void cellular_nmea_fuzz(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  std::vector<std::string> lines;
+  if (!cellular_nmea_load(writer, argv[0], lines))
+    return;
+  int rounds = (argc > 1) ? atoi(argv[1]) : 100;
+  if (rounds < 1) rounds = 1;
+
+  // Mutate sentences randomly (replace, insert & delete characters, truncate),
+  // for half of the mutations fix up the checksum to exercise the field parsers:
+  static const char alphabet[] = "$*,.-+0123456789ABCDEFNSWEGMRC\r\n\0\xff";
+  gsmnmea_sentence_t s;
+  uint32_t res[NMEA_CHECKSUM+1] = { 0 };
+  std::string m;
+  for (int r = 0; r < rounds; r++)
+    {
+    for (auto& line : lines)
+      {
+      m = line;
+      int edits = 1 + esp_random() % 4;
+      for (int k = 0; k < edits && !m.empty(); k++)
+        {
+        size_t pos = esp_random() % m.length();
+        char c = alphabet[esp_random() % (sizeof(alphabet)-1)];
+        switch (esp_random() % 4)
+          {
+          case 0: m[pos] = c; break;
+          case 1: m.insert(pos, 1, c); break;
+          case 2: m.erase(pos, 1); break;
+          case 3: m.resize(pos); break;
+          }
+        }
+      size_t star = m.rfind('*');
+      if ((esp_random() & 1) && m.length() > 1 && star != std::string::npos)
+        {
+        uint8_t csum = 0;
+        for (size_t k = 1; k < star; k++) csum ^= (uint8_t) m[k];
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02X", csum);
+        m.replace(star+1, std::string::npos, hex);
+        }
+      res[GsmNMEA::Parse(m.data(), m.length(), s)]++;
+      }
+    }
+
+  writer->printf("Fuzzed %u sentences:\n", (uint32_t) (lines.size() * rounds));
+  writer->printf("  %u ok, %u ignored, %u malformed, %u checksum errors\n",
+    res[NMEA_OK], res[NMEA_IGNORED], res[NMEA_MALFORMED], res[NMEA_CHECKSUM]);
+  }
+
 ////////////////////////////////////////////////////////////////////////////////
 // Development assistance functions
 
@@ -1658,6 +1781,9 @@ ModemInit::ModemInit()
   cmd_cellular->RegisterCommand("drivers","Show supported CELLULAR MODEM drivers",cellular_drivers, "", 0, 0);
   OvmsCommand* cmd_status = cmd_cellular->RegisterCommand("status","Show CELLULAR MODEM status",cellular_status, "[debug]", 0, 0, false);
   cmd_status->RegisterCommand("debug","Show extended CELLULAR MODEM status",cellular_status, "", 0, 0, false);
+  OvmsCommand* cmd_nmea = cmd_cellular->RegisterCommand("nmea","CELLULAR MODEM NMEA parser tests");
+  cmd_nmea->RegisterCommand("bench","Benchmark NMEA parser on recorded stream",cellular_nmea_bench, "<file> [<loops>]", 1, 2);
+  cmd_nmea->RegisterCommand("fuzz","Fuzz NMEA parser with mutations of recorded stream",cellular_nmea_fuzz, "<file> [<rounds>]", 1, 2);
 
   OvmsCommand* cmd_setstate = cmd_cellular->RegisterCommand("setstate","CELLULAR MODEM state change framework");
   for (int x = modem::CheckPowerOff; x<=modem::PowerOffOn; x++)
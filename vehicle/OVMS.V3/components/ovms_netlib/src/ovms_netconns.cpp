@@ -33,6 +33,7 @@ static const char *TAG = "ovms-net";
 
 #include "ovms.h"
 #include "ovms_netconns.h"
+#include "ovms_tls.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // OvmsMongooseWrapper
@@ -136,6 +137,8 @@ bool OvmsNetTcpClient::Connect(std::string dest, struct mg_connect_opts opts)
     return false;
     }
   m_mgconn->user_data = this;
+  if (opts.ssl_ca_cert)
+    MyOvmsTLS.SetupConnection(m_mgconn, dest, opts);
   m_netstate = NetConnConnecting;
   return true;
   }
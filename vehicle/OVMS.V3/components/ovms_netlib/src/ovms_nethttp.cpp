@@ -109,7 +109,7 @@ bool OvmsNetHttpAsyncClient::Request(std::string url, const char* method)
   memset(&opts, 0, sizeof(opts));
   if (m_tls)
     {
-    opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+    opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
     opts.ssl_server_name = m_server.c_str();
     }
 
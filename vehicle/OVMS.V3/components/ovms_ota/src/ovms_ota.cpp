@@ -53,6 +53,11 @@ static const char *TAG = "ota";
 #include "ovms_netmanager.h"
 #include "ovms_version.h"
 #include "crypt_md5.h"
+#include "ovms_malloc.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <atomic>
+#include <stdarg.h>
 
 OvmsOTA MyOTA __attribute__ ((init_priority (4400)));
 
@@ -61,6 +66,350 @@ OvmsOTA MyOTA __attribute__ ((init_priority (4400)));
 //
 // Used to write OTA firmware to flash
 
+////////////////////////////////////////////////////////////////////////////////
+// OvmsOTAPatch: streaming delta firmware update
+//
+// Patch file format (all integers little endian):
+//    Header (48 bytes):
+//      "OVDP"        magic
+//      uint32        format version (1)
+//      uint32        source image size
+//      uint32        target image size
+//      uint8[16]     source image MD5
+//      uint8[16]     target image MD5
+//    Commands:
+//      'C' uint32 offset, uint32 length    copy from source image
+//      'I' uint32 length, data[length]     insert data
+//      'E'                                 end of patch
+//
+// The source image is the running partition. The patch is applied while being
+// received, the target image is written directly into the update partition.
+
+#define OTA_PATCH_MAGIC       "OVDP"
+#define OTA_PATCH_VERSION     1
+#define OTA_PATCH_HDRSIZE     48
+
+class OvmsOTAPatch
+  {
+  public:
+    OvmsOTAPatch(const esp_partition_t* source, const esp_partition_t* target);
+    ~OvmsOTAPatch();
+
+  public:
+    static bool IsPatch(const uint8_t* data, size_t len);
+    bool IsStarted() { return m_otabegun; }
+    bool Feed(const uint8_t* data, size_t len);
+    bool Finish();
+
+  protected:
+    bool ProcessHeader();
+    bool ProcessCommand();
+    bool Output(const uint8_t* data, size_t len);
+    bool Copy(uint32_t offset, uint32_t len);
+    bool PartitionMD5(const esp_partition_t* part, uint32_t size, uint8_t* digest);
+    bool Fail(const char* fmt, ...);
+
+  protected:
+    enum
+      {
+      Header,                           // collecting header
+      Command,                          // collecting command code
+      Args,                             // collecting command arguments
+      Data,                             // passing insert data
+      End,                              // end command received
+      Failed
+      } m_state;
+    const esp_partition_t* m_source;
+    const esp_partition_t* m_target;
+    esp_ota_handle_t m_otah;
+    bool m_otabegun;
+    uint8_t m_acc[OTA_PATCH_HDRSIZE];   // header / command accumulator
+    size_t m_acclen;
+    size_t m_accneed;
+    uint8_t m_cmd;
+    uint32_t m_remain;                  // insert data remaining
+    uint32_t m_srcsize;
+    uint32_t m_tgtsize;
+    uint8_t m_srcmd5[OVMS_MD5_SIZE];
+    uint8_t m_tgtmd5[OVMS_MD5_SIZE];
+    OVMS_MD5_CTX m_md5;
+
+  public:
+    uint32_t m_written;
+    uint32_t m_copied;
+    std::string m_error;
+  };
+
+static uint32_t ota_patch_u32(const uint8_t* p)
+  {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+OvmsOTAPatch::OvmsOTAPatch(const esp_partition_t* source, const esp_partition_t* target)
+  {
+  m_state = Header;
+  m_source = source;
+  m_target = target;
+  m_otah = 0;
+  m_otabegun = false;
+  m_acclen = 0;
+  m_accneed = OTA_PATCH_HDRSIZE;
+  m_cmd = 0;
+  m_remain = 0;
+  m_srcsize = 0;
+  m_tgtsize = 0;
+  m_written = 0;
+  m_copied = 0;
+  }
+
+OvmsOTAPatch::~OvmsOTAPatch()
+  {
+  if (m_otabegun)
+    esp_ota_end(m_otah);
+  }
+
+/**
+ * IsPatch: check if a data stream starts with the patch file magic
+ */
+bool OvmsOTAPatch::IsPatch(const uint8_t* data, size_t len)
+  {
+  return (len >= 4 && memcmp(data, OTA_PATCH_MAGIC, 4) == 0);
+  }
+
+bool OvmsOTAPatch::Fail(const char* fmt, ...)
+  {
+  char buf[100];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  m_error = buf;
+  m_state = Failed;
+  ESP_LOGE(TAG, "Patch: %s", buf);
+  return false;
+  }
+
+/**
+ * Feed: process the next chunk of the patch file
+ *  Chunks may be of any size, commands may span chunks.
+ */
+bool OvmsOTAPatch::Feed(const uint8_t* data, size_t len)
+  {
+  while (len > 0)
+    {
+    switch (m_state)
+      {
+      case Header:
+      case Command:
+      case Args:
+        {
+        size_t n = std::min(len, m_accneed - m_acclen);
+        memcpy(m_acc + m_acclen, data, n);
+        m_acclen += n;
+        data += n;
+        len -= n;
+        if (m_acclen == m_accneed)
+          {
+          if (!((m_state == Header) ? ProcessHeader() : ProcessCommand()))
+            return false;
+          }
+        break;
+        }
+      case Data:
+        {
+        size_t n = std::min(len, (size_t)m_remain);
+        if (!Output(data, n))
+          return false;
+        m_remain -= n;
+        data += n;
+        len -= n;
+        if (m_remain == 0)
+          {
+          m_state = Command;
+          m_acclen = 0;
+          m_accneed = 1;
+          }
+        break;
+        }
+      case End:
+        return Fail("Data after end of patch");
+      case Failed:
+        return false;
+      }
+    }
+  return true;
+  }
+
+bool OvmsOTAPatch::ProcessHeader()
+  {
+  if (!IsPatch(m_acc, m_acclen))
+    return Fail("Invalid patch file");
+  if (ota_patch_u32(m_acc+4) != OTA_PATCH_VERSION)
+    return Fail("Unsupported patch version %u", ota_patch_u32(m_acc+4));
+  m_srcsize = ota_patch_u32(m_acc+8);
+  m_tgtsize = ota_patch_u32(m_acc+12);
+  memcpy(m_srcmd5, m_acc+16, OVMS_MD5_SIZE);
+  memcpy(m_tgtmd5, m_acc+32, OVMS_MD5_SIZE);
+
+  if (m_srcsize == 0 || m_srcsize > m_source->size)
+    return Fail("Patch source size %u exceeds running partition", m_srcsize);
+  if (m_tgtsize < 32 || m_tgtsize > m_target->size)
+    return Fail("Patch target size %u exceeds target partition", m_tgtsize);
+
+  // Verify the patch applies to the running firmware:
+  uint8_t digest[OVMS_MD5_SIZE];
+  if (!PartitionMD5(m_source, m_srcsize, digest))
+    return false;
+  if (memcmp(digest, m_srcmd5, OVMS_MD5_SIZE) != 0)
+    return Fail("Patch does not match running firmware");
+
+  esp_err_t err = esp_ota_begin(m_target, m_tgtsize, &m_otah);
+  if (err != ESP_OK)
+    return Fail("ESP32 error #%d when starting OTA operation", err);
+  m_otabegun = true;
+  OVMS_MD5_Init(&m_md5);
+
+  ESP_LOGD(TAG, "Patch: source %u bytes, target %u bytes", m_srcsize, m_tgtsize);
+  m_state = Command;
+  m_acclen = 0;
+  m_accneed = 1;
+  return true;
+  }
+
+bool OvmsOTAPatch::ProcessCommand()
+  {
+  if (m_state == Command)
+    {
+    m_cmd = m_acc[0];
+    switch (m_cmd)
+      {
+      case 'C':
+        m_state = Args;
+        m_accneed = 9;
+        return true;
+      case 'I':
+        m_state = Args;
+        m_accneed = 5;
+        return true;
+      case 'E':
+        m_state = End;
+        return true;
+      default:
+        return Fail("Invalid patch command 0x%02x at output offset %u", m_cmd, m_written);
+      }
+    }
+
+  // Arguments complete:
+  m_acclen = 0;
+  m_accneed = 1;
+  if (m_cmd == 'C')
+    {
+    m_state = Command;
+    return Copy(ota_patch_u32(m_acc+1), ota_patch_u32(m_acc+5));
+    }
+  else
+    {
+    m_remain = ota_patch_u32(m_acc+1);
+    m_state = (m_remain > 0) ? Data : Command;
+    return true;
+    }
+  }
+
+bool OvmsOTAPatch::Output(const uint8_t* data, size_t len)
+  {
+  if (m_written + len > m_tgtsize)
+    return Fail("Patch output exceeds target size");
+  esp_err_t err = esp_ota_write(m_otah, data, len);
+  if (err != ESP_OK)
+    return Fail("ESP32 error #%d when writing to flash", err);
+  OVMS_MD5_Update(&m_md5, data, len);
+  m_written += len;
+  return true;
+  }
+
+bool OvmsOTAPatch::Copy(uint32_t offset, uint32_t len)
+  {
+  if (offset > m_srcsize || len > m_srcsize - offset)
+    return Fail("Patch copy range %u+%u exceeds source", offset, len);
+  uint8_t buf[512];
+  while (len > 0)
+    {
+    size_t n = std::min((size_t)len, sizeof(buf));
+    esp_err_t err = esp_partition_read(m_source, offset, buf, n);
+    if (err != ESP_OK)
+      return Fail("ESP32 error #%d reading running partition", err);
+    if (!Output(buf, n))
+      return false;
+    offset += n;
+    len -= n;
+    m_copied += n;
+    }
+  return true;
+  }
+
+bool OvmsOTAPatch::PartitionMD5(const esp_partition_t* part, uint32_t size, uint8_t* digest)
+  {
+  OVMS_MD5_CTX md5;
+  uint8_t buf[512];
+  OVMS_MD5_Init(&md5);
+  for (uint32_t offset = 0; offset < size; )
+    {
+    size_t n = std::min((size_t)(size - offset), sizeof(buf));
+    esp_err_t err = esp_partition_read(part, offset, buf, n);
+    if (err != ESP_OK)
+      return Fail("ESP32 error #%d reading partition %s", err, part->label);
+    OVMS_MD5_Update(&md5, buf, n);
+    offset += n;
+    }
+  OVMS_MD5_Final(digest, &md5);
+  return true;
+  }
+
+/**
+ * Finish: finalise the OTA operation and verify the target image
+ */
+bool OvmsOTAPatch::Finish()
+  {
+  if (m_state == Failed)
+    return false;
+  if (m_state != End)
+    return Fail("Patch incomplete");
+  if (m_written != m_tgtsize)
+    return Fail("Patch output size %u does not match target size %u", m_written, m_tgtsize);
+
+  uint8_t digest[OVMS_MD5_SIZE];
+  OVMS_MD5_Final(digest, &m_md5);
+  if (memcmp(digest, m_tgtmd5, OVMS_MD5_SIZE) != 0)
+    return Fail("Patch result does not match target checksum");
+
+  m_otabegun = false;
+  esp_err_t err = esp_ota_end(m_otah);
+  if (err != ESP_OK)
+    return Fail("ESP32 error #%d finalising OTA operation", err);
+
+  // Verify flash content:
+  if (!PartitionMD5(m_target, m_tgtsize, digest))
+    return false;
+  if (memcmp(digest, m_tgtmd5, OVMS_MD5_SIZE) != 0)
+    return Fail("Flash verification failed");
+
+  return true;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+// OvmsOTAWriter
+
+#define OTA_PIPE_BUFSIZE      16384     // Download buffer size
+#define OTA_PIPE_BUFCNT       2         // Download buffers (double buffering)
+#define OTA_PIPE_TIMEOUT      30000     // Max wait time for a free buffer [ms] (excluding flash erase)
+#define OTA_RESUME_MAXTRIES   5         // Max resume attempts after a connection loss
+
+typedef struct
+  {
+  uint8_t* data;                        // NULL = end of download
+  size_t len;
+  } ota_pipe_buf_t;
+
 class OvmsOTAWriter : public OvmsSyncHttpClient
   {
   public:
@@ -68,17 +417,50 @@ class OvmsOTAWriter : public OvmsSyncHttpClient
                   OvmsWriter* writer);
     ~OvmsOTAWriter();
 
+  public:
+    bool Download(std::string url);
+
   public:
     virtual void ConnectionBodyStart(struct mg_connection *nc);
     virtual void ConnectionBodyData(struct mg_connection *nc, uint8_t* data, size_t len);
     virtual void ConnectionBodyFinish(struct mg_connection *nc);
 
+  protected:
+    void Abort(struct mg_connection *nc, const char* msg);
+    void Progress(bool final=false);
+    bool PipeStart();
+    bool PipePush(const uint8_t* data, size_t len);
+    esp_err_t PipeFinish();
+    static void WriterTaskEntry(void* pvParameters);
+    void WriterTask();
+
   public:
     const esp_partition_t* m_target;
     OvmsWriter* m_writer;
     esp_ota_handle_t m_otah;
     size_t m_sofar;
-    size_t m_filesize;
+    size_t m_filesize;                  // bytes received (total over all requests)
+    size_t m_total;                     // firmware size
+    size_t m_skip;                      // bytes to skip (resumed request answered from start)
+    bool m_fatal;                       // error, no resume possible
+    int64_t m_starttime;
+
+  protected:
+    uint8_t* m_pipemem;                 // buffer memory
+    QueueHandle_t m_freeq;              // free buffers
+    QueueHandle_t m_fullq;              // buffers to be written
+    ota_pipe_buf_t m_fill;              // buffer currently filled by the network task
+    TaskHandle_t m_task;                // flash writer task
+    SemaphoreHandle_t m_taskdone;
+    std::atomic<esp_err_t> m_writeerr;  // flash writer result
+    volatile size_t m_written;          // bytes written to flash
+    volatile bool m_erasing;            // flash writer is preparing (erasing) the partition
+    bool m_otabegun;
+    std::atomic<OvmsOTAPatch*> m_patch; // delta update in progress (set by the writer task)
+
+  public:
+    bool IsPatch() { return m_patch != NULL; }
+    std::string GetPatchError() { OvmsOTAPatch* p = m_patch; return p ? p->m_error : ""; }
   };
 
 OvmsOTAWriter::OvmsOTAWriter(const esp_partition_t* target,
@@ -87,18 +469,332 @@ OvmsOTAWriter::OvmsOTAWriter(const esp_partition_t* target,
   {
   m_target = target;
   m_writer = writer;
+  m_otah = 0;
   m_sofar = 0;
   m_filesize = 0;
+  m_total = 0;
+  m_skip = 0;
+  m_fatal = false;
+  m_starttime = 0;
+  m_pipemem = NULL;
+  m_freeq = NULL;
+  m_fullq = NULL;
+  m_fill.data = NULL;
+  m_fill.len = 0;
+  m_task = NULL;
+  m_taskdone = NULL;
+  m_writeerr = ESP_OK;
+  m_written = 0;
+  m_erasing = false;
+  m_otabegun = false;
+  m_patch = NULL;
   }
 
 OvmsOTAWriter::~OvmsOTAWriter()
   {
+  if (m_task) PipeFinish();
+  if (m_freeq) vQueueDelete(m_freeq);
+  if (m_fullq) vQueueDelete(m_fullq);
+  if (m_taskdone) vSemaphoreDelete(m_taskdone);
+  if (m_pipemem) free(m_pipemem);
+  if (m_patch) delete m_patch.load();
+  }
+
+/**
+ * Download: download & flash firmware
+ *  The network task (mongoose) fills the download buffers, a separate writer task
+ *  flashes them, so slow flash erases & writes don't stall the network receive path.
+ *  If the connection drops, the download is resumed using a HTTP Range request.
+ */
+bool OvmsOTAWriter::Download(std::string url)
+  {
+  if (!PipeStart())
+    {
+    m_error = "Out of memory";
+    return false;
+    }
+
+  int tries = 0;
+  m_starttime = esp_timer_get_time();
+  while (true)
+    {
+    m_error.clear();
+    if (m_filesize > 0)
+      SetRequestHeaders("Range: bytes=" + std::to_string(m_filesize) + "-\r\n");
+    Request(url);
+
+    if (m_total > 0 && m_filesize == m_total && !m_fatal)
+      break; // complete
+    if (m_fatal || m_total == 0 || ++tries > OTA_RESUME_MAXTRIES)
+      break;
+
+    if (m_writer)
+      m_writer->printf("Connection lost at %d bytes (%s), resuming (try %d)...\n",
+                       m_filesize, m_error.c_str(), tries);
+    else
+      ESP_LOGW(TAG, "Connection lost at %d bytes (%s), resuming (try %d)...",
+               m_filesize, m_error.c_str(), tries);
+    vTaskDelay(pdMS_TO_TICKS(1000 * tries));
+    }
+
+  SetRequestHeaders("");
+  bool complete = (m_total > 0 && m_filesize == m_total && !m_fatal);
+  if (complete)
+    {
+    if (m_writer)
+      m_writer->puts("Finishing flash write...");
+    else
+      ESP_LOGD(TAG, "Finishing flash write...");
+    }
+  esp_err_t err = PipeFinish();
+  OvmsOTAPatch* patch = m_patch;
+
+  if (!complete)
+    {
+    if (m_error.empty())
+      m_error = "Download incomplete";
+    return false;
+    }
+  if (err != ESP_OK && patch)
+    {
+    m_error = "Patch failed: " + patch->m_error;
+    if (m_writer)
+      m_writer->printf("Error: %s\n", m_error.c_str());
+    return false;
+    }
+  else if (err != ESP_OK)
+    {
+    if (m_writer)
+      m_writer->printf("Error: ESP32 error #%d writing firmware to flash - state is inconsistent\n",err);
+    else
+      ESP_LOGE(TAG, "ESP32 error #%d writing firmware to flash - state is inconsistent",err);
+    m_error = "ESP32 error writing firmware to flash - state is inconsistent";
+    return false;
+    }
+
+  m_error.clear();
+  Progress(true);
+  if (patch)
+    {
+    if (m_writer)
+      m_writer->printf("Delta update applied: %u bytes written, %u bytes copied from running firmware\n",
+                       patch->m_written, patch->m_copied);
+    else
+      ESP_LOGI(TAG, "Delta update applied: %u bytes written, %u bytes copied from running firmware",
+               patch->m_written, patch->m_copied);
+    }
+  return true;
+  }
+
+/**
+ * Abort: report error, close connection, no resume
+ */
+void OvmsOTAWriter::Abort(struct mg_connection *nc, const char* msg)
+  {
+  if (m_writer)
+    m_writer->printf("Error: %s\n",msg);
+  else
+    ESP_LOGE(TAG, "Error: %s",msg);
+  nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+  m_error = std::string(msg);
+  m_fatal = true;
+  if (m_waitcompletion != NULL) xSemaphoreGive(m_waitcompletion);
+  }
+
+/**
+ * Progress: output download progress & update metrics
+ */
+void OvmsOTAWriter::Progress(bool final /*=false*/)
+  {
+  int64_t elapsed = esp_timer_get_time() - m_starttime;
+  float rate = (elapsed > 0) ? m_filesize * 1000000.0f / 1024 / elapsed : 0;
+  int progress = m_total ? (int)((uint64_t)m_filesize * 100 / m_total) : 0;
+  MyOTA.m_metric_progress->SetValue(progress);
+  MyOTA.m_metric_rate->SetValue(rate);
+  if (final)
+    return;
+  if (m_writer)
+    m_writer->printf("Downloading... (%d bytes so far, %d%%, %.1f kB/s)\n",m_filesize,progress,rate);
+  else
+    ESP_LOGD(TAG, "Downloading... (%d bytes so far, %d%%, %.1f kB/s)",m_filesize,progress,rate);
+  }
+
+/**
+ * PipeStart: allocate buffers, start flash writer task
+ */
+bool OvmsOTAWriter::PipeStart()
+  {
+  m_pipemem = (uint8_t*) ExternalRamMalloc(OTA_PIPE_BUFSIZE * OTA_PIPE_BUFCNT);
+  if (!m_pipemem)
+    return false;
+  m_freeq = xQueueCreate(OTA_PIPE_BUFCNT, sizeof(ota_pipe_buf_t));
+  m_fullq = xQueueCreate(OTA_PIPE_BUFCNT+1, sizeof(ota_pipe_buf_t));
+  m_taskdone = xSemaphoreCreateBinary();
+  for (int i = 0; i < OTA_PIPE_BUFCNT; i++)
+    {
+    ota_pipe_buf_t buf = { m_pipemem + i * OTA_PIPE_BUFSIZE, 0 };
+    xQueueSend(m_freeq, &buf, 0);
+    }
+  m_writeerr = ESP_OK;
+  m_written = 0;
+  xTaskCreatePinnedToCore(WriterTaskEntry, "OVMS OTA Writer",
+    4096, (void*)this, 5, &m_task, CORE(1));
+  return true;
+  }
+
+/**
+ * PipePush: network side: copy data into buffers, pass full buffers to the writer
+ *  The partition erase done by esp_ota_begin() can take 20-30 seconds for a full
+ *  image, that time is not counted against OTA_PIPE_TIMEOUT.
+ */
+bool OvmsOTAWriter::PipePush(const uint8_t* data, size_t len)
+  {
+  while (len > 0)
+    {
+    if (m_writeerr != ESP_OK)
+      return false;
+    if (m_fill.data == NULL)
+      {
+      int waited = 0;
+      while (xQueueReceive(m_freeq, &m_fill, pdMS_TO_TICKS(1000)) != pdTRUE)
+        {
+        if (m_writeerr != ESP_OK)
+          return false;
+        if (!m_erasing && (waited += 1000) >= OTA_PIPE_TIMEOUT)
+          return false;
+        }
+      m_fill.len = 0;
+      }
+    size_t n = std::min(len, OTA_PIPE_BUFSIZE - m_fill.len);
+    memcpy(m_fill.data + m_fill.len, data, n);
+    m_fill.len += n;
+    data += n;
+    len -= n;
+    if (m_fill.len == OTA_PIPE_BUFSIZE)
+      {
+      xQueueSend(m_fullq, &m_fill, portMAX_DELAY);
+      m_fill.data = NULL;
+      }
+    }
+  return true;
+  }
+
+/**
+ * PipeFinish: flush last buffer, stop writer task, finalise OTA operation
+ */
+esp_err_t OvmsOTAWriter::PipeFinish()
+  {
+  if (!m_task)
+    return m_writeerr;
+  if (m_fill.data && m_fill.len > 0)
+    {
+    xQueueSend(m_fullq, &m_fill, portMAX_DELAY);
+    m_fill.data = NULL;
+    }
+  ota_pipe_buf_t end = { NULL, 0 };
+  xQueueSend(m_fullq, &end, portMAX_DELAY);
+  xSemaphoreTake(m_taskdone, portMAX_DELAY);
+  m_task = NULL;
+  OvmsOTAPatch* patch = m_patch;
+  if (patch)
+    {
+    if (m_writeerr == ESP_OK && !patch->Finish())
+      m_writeerr = ESP_FAIL;
+    }
+  else if (m_otabegun)
+    {
+    esp_err_t err = esp_ota_end(m_otah);
+    if (m_writeerr == ESP_OK && err != ESP_OK)
+      m_writeerr = err;
+    m_otabegun = false;
+    }
+  return m_writeerr;
+  }
+
+void OvmsOTAWriter::WriterTaskEntry(void* pvParameters)
+  {
+  OvmsOTAWriter* me = (OvmsOTAWriter*)pvParameters;
+  me->WriterTask();
+  }
+
+/**
+ * WriterTask: flash buffers received from the network task
+ */
+void OvmsOTAWriter::WriterTask()
+  {
+  ota_pipe_buf_t buf;
+  OvmsOTAPatch* patch = m_patch;
+  while (xQueueReceive(m_fullq, &buf, portMAX_DELAY) == pdTRUE)
+    {
+    if (buf.data == NULL)
+      break;
+    if (m_writeerr == ESP_OK && !m_otabegun && !patch && OvmsOTAPatch::IsPatch(buf.data, buf.len))
+      {
+      // Delta update: apply patch to running image
+      patch = new OvmsOTAPatch(esp_ota_get_running_partition(), m_target);
+      m_patch = patch;
+      }
+    if (patch)
+      {
+      // The patch header check verifies the running image & erases the target:
+      m_erasing = !patch->IsStarted();
+      if (m_writeerr == ESP_OK && !patch->Feed(buf.data, buf.len))
+        m_writeerr = ESP_FAIL;
+      m_erasing = false;
+      }
+    else if (m_writeerr == ESP_OK && !m_otabegun)
+      {
+      // Erase the partition range needed while the network task continues receiving:
+      m_erasing = true;
+      m_writeerr = esp_ota_begin(m_target, m_total, &m_otah);
+      m_otabegun = (m_writeerr == ESP_OK);
+      m_erasing = false;
+      }
+    if (!patch && m_writeerr == ESP_OK)
+      m_writeerr = esp_ota_write(m_otah, buf.data, buf.len);
+    m_written += buf.len;
+    xQueueSend(m_freeq, &buf, portMAX_DELAY);
+    }
+  xSemaphoreGive(m_taskdone);
+  vTaskDelete(NULL);
   }
 
 void OvmsOTAWriter::ConnectionBodyStart(struct mg_connection *nc)
   {
   size_t expected = m_bodysize;
 
+  if (m_total > 0)
+    {
+    // Resumed download:
+    if (m_responsecode == 206 && m_filesize + expected == m_total)
+      {
+      m_skip = 0;
+      }
+    else if (m_responsecode == 200 && expected == m_total)
+      {
+      // Server doesn't support ranges, skip the part already received:
+      m_skip = m_filesize;
+      }
+    else
+      {
+      Abort(nc, "Resumed download does not match firmware size");
+      return;
+      }
+    if (m_writer)
+      m_writer->printf("Resuming download at %d bytes\n",m_filesize);
+    else
+      ESP_LOGD(TAG, "Resuming download at %d bytes",m_filesize);
+    return;
+    }
+
+  if (m_responsecode != 200)
+    {
+    char msg[40];
+    snprintf(msg, sizeof(msg), "HTTP status %d", m_responsecode);
+    Abort(nc, msg);
+    return;
+    }
+
   if (expected < 32)
     {
     if (m_writer)
@@ -107,9 +803,15 @@ void OvmsOTAWriter::ConnectionBodyStart(struct mg_connection *nc)
       ESP_LOGE(TAG,"Error: Invalid expected file size %d",expected);
     nc->flags |= MG_F_CLOSE_IMMEDIATELY;
     m_error = std::string("Invalid expected file size for firmware");
+    m_fatal = true;
     if (m_waitcompletion != NULL) xSemaphoreGive(m_waitcompletion);
     return;
     }
+  else if (expected > m_target->size)
+    {
+    Abort(nc, "Download firmware is bigger than available partition space");
+    return;
+    }
   else
     {
     if (m_writer)
@@ -123,89 +825,79 @@ void OvmsOTAWriter::ConnectionBodyStart(struct mg_connection *nc)
   else
     ESP_LOGD(TAG, "Preparing flash partition...");
 
-  esp_err_t err = esp_ota_begin(m_target, expected, &m_otah);
-  if (err != ESP_OK)
-    {
-    if (m_writer)
-      m_writer->printf("Error: ESP32 error #%d when starting OTA operation\n",err);
-    else
-      ESP_LOGE(TAG,"Error: ESP32 error #%d when starting OTA operation",err);
-    nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-    m_error = std::string("ESP32 error when starting OTA operation");
-    if (m_waitcompletion != NULL) xSemaphoreGive(m_waitcompletion);
-    return;
-    }
+  m_total = expected;
+  m_skip = 0;
   }
 
 void OvmsOTAWriter::ConnectionBodyData(struct mg_connection *nc, uint8_t* data, size_t len)
   {
+  if (m_fatal)
+    return;
+
+  if (m_skip > 0)
+    {
+    size_t n = std::min(len, m_skip);
+    m_skip -= n;
+    data += n;
+    len -= n;
+    if (len == 0) return;
+    }
+
   m_filesize += len;
   m_sofar += len;
   if (m_sofar > 100000)
     {
-    if (m_writer)
-      m_writer->printf("Downloading... (%d bytes so far)\n",m_filesize);
-    else
-      ESP_LOGD(TAG, "Downloading... (%d bytes so far)",m_filesize);
+    Progress();
     m_sofar = 0;
     }
 
-  if (m_filesize > m_target->size)
+  if (m_filesize > m_total)
     {
-    if (m_writer)
-      m_writer->printf("Error: Download firmware is bigger than available partition space - state is inconsistent\n");
-    else
-      ESP_LOGE(TAG, "Download firmware is bigger than available partition space - state is inconsistent");
-    esp_ota_end(m_otah);
-    nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-    m_error = std::string("Download firmware is bigger than available partition space - state is inconsistent");
-    if (m_waitcompletion != NULL) xSemaphoreGive(m_waitcompletion);
+    Abort(nc, "Download firmware is bigger than expected - state is inconsistent");
     return;
     }
 
-  esp_err_t err = esp_ota_write(m_otah, data, len);
-  if (err != ESP_OK)
+  if (!PipePush(data, len))
     {
-    if (m_writer)
-      m_writer->printf("Error: ESP32 error #%d when writing to flash - state is inconsistent\n",err);
+    // m_writeerr is set by the writer after the patch error, so m_error is valid now:
+    OvmsOTAPatch* patch = m_patch;
+    if (m_writeerr != ESP_OK && patch && !patch->m_error.empty())
+      {
+      std::string msg = "Patch failed: " + patch->m_error;
+      Abort(nc, msg.c_str());
+      }
+    else if (m_writeerr != ESP_OK)
+      {
+      if (m_writer)
+        m_writer->printf("Error: ESP32 error #%d when writing to flash - state is inconsistent\n",m_writeerr.load());
+      else
+        ESP_LOGE(TAG, "ESP32 error #%d when writing to flash - state is inconsistent",m_writeerr.load());
+      Abort(nc, "ESP32 error when writing to flash - state is inconsistent");
+      }
     else
-      ESP_LOGE(TAG, "ESP32 error #%d when writing to flash - state is inconsistent",err);
-    esp_ota_end(m_otah);
-    nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-    m_error = std::string("ESP32 error #%d when writing to flash - state is inconsistent");
-    if (m_waitcompletion != NULL) xSemaphoreGive(m_waitcompletion);
+      {
+      Abort(nc, "Timeout waiting for flash writer");
+      }
     return;
     }
   }
 
 void OvmsOTAWriter::ConnectionBodyFinish(struct mg_connection *nc)
   {
-  if (m_writer)
-    m_writer->printf("Download complete (at %d bytes)\n",m_filesize);
-  else
-    ESP_LOGD(TAG, "Download complete (at %d bytes)",m_filesize);
-
-  if (m_filesize != m_bodysize)
-    {
-    if (m_writer)
-      m_writer->printf("Error: Download file size (%d) does not match expected (%d)\n",m_filesize,m_bodysize);
-    else
-      ESP_LOGE(TAG, "Download file size (%d) does not match expected (%d)",m_filesize,m_bodysize);
-    m_error = std::string("Download file size does not match expected");
-    esp_ota_end(m_otah);
+  if (m_fatal)
     return;
-    }
-
-  esp_err_t err = esp_ota_end(m_otah);
-  if (err != ESP_OK)
+  if (m_filesize < m_total)
     {
     if (m_writer)
-      m_writer->printf("Error: ESP32 error #%d finalising OTA operation - state is inconsistent\n",err);
+      m_writer->printf("Download interrupted (at %d of %d bytes)\n",m_filesize,m_total);
     else
-      ESP_LOGE(TAG, "ESP32 error #%d finalising OTA operation - state is inconsistent",err);
-    m_error = std::string("ESP32 error finalising OTA operation - state is inconsistent");
+      ESP_LOGW(TAG, "Download interrupted (at %d of %d bytes)",m_filesize,m_total);
     return;
     }
+  if (m_writer)
+    m_writer->printf("Download complete (at %d bytes)\n",m_filesize);
+  else
+    ESP_LOGD(TAG, "Download complete (at %d bytes)",m_filesize);
   }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -236,6 +928,57 @@ int buildverscmp(std::string v1, std::string v2)
   return cmp;
   }
 
+/**
+ * ota_download: download & flash firmware image, optionally try delta update first
+ *  If config ota/delta is enabled, a patch file "ovms3-<version>.pat" for the running
+ *  firmware version is looked up next to the image URL. If that is not available
+ *  or fails to apply, the full image is downloaded.
+ */
+static bool ota_download(const esp_partition_t* target, OvmsWriter* writer, std::string &url,
+                         size_t &size, std::string &error)
+  {
+  if (MyConfig.GetParamValueBool("ota", "delta", false))
+    {
+    std::string version = GetOVMSVersion();
+    std::string::size_type p;
+    if ((p = version.find_first_of('/')) != std::string::npos)
+      version.resize(p);
+    std::string patchurl = url;
+    if ((p = patchurl.find_last_of('/')) != std::string::npos)
+      patchurl.resize(p+1);
+    else
+      patchurl.clear();
+    patchurl.append("ovms3-");
+    patchurl.append(version);
+    patchurl.append(".pat");
+
+    if (writer)
+      writer->printf("Trying delta update from %s\n", patchurl.c_str());
+    else
+      ESP_LOGI(TAG, "Trying delta update from %s", patchurl.c_str());
+    OvmsOTAWriter http(target, writer);
+    if (http.Download(patchurl) && http.IsPatch())
+      {
+      url = patchurl;
+      size = http.m_filesize;
+      return true;
+      }
+    if (writer)
+      writer->printf("Delta update not possible (%s), downloading full image\n", http.GetError().c_str());
+    else
+      ESP_LOGW(TAG, "Delta update not possible (%s), downloading full image", http.GetError().c_str());
+    }
+
+  OvmsOTAWriter http(target, writer);
+  if (!http.Download(url) || http.HasError())
+    {
+    error = http.GetError();
+    return false;
+    }
+  size = http.m_filesize;
+  return true;
+  }
+
 ////////////////////////////////////////////////////////////////////////////////
 // Commands
 
@@ -330,39 +1073,61 @@ void ota_flash_vfs(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc
     return;
     }
 
-  writer->puts("Preparing flash partition...");
-  esp_ota_handle_t otah;
-  esp_err_t err = esp_ota_begin(target, ds.st_size, &otah);
-  if (err != ESP_OK)
+  uint8_t buf[512];
+  esp_err_t err;
+  size_t n = fread(buf, sizeof(char), sizeof(buf), f);
+  if (OvmsOTAPatch::IsPatch(buf, n))
     {
-    writer->printf("Error: ESP32 error #%d when starting OTA operation\n",err);
+    writer->puts("Applying delta update to running image...");
+    OvmsOTAPatch patch(running, target);
+    do
+      {
+      if (!patch.Feed(buf, n))
+        break;
+      } while ((n = fread(buf, sizeof(char), sizeof(buf), f)) > 0);
     fclose(f);
-    return;
+    if (!patch.Finish())
+      {
+      writer->printf("Error: Patch failed: %s\n", patch.m_error.c_str());
+      return;
+      }
+    writer->printf("Delta update applied: %u bytes written, %u bytes copied from running firmware\n",
+                   patch.m_written, patch.m_copied);
     }
-
-  writer->puts("Flashing image partition...");
-  char buf[512];
-  while(size_t n = fread(buf, sizeof(char), sizeof(buf), f))
+  else
     {
-    err = esp_ota_write(otah, buf, n);
+    writer->puts("Preparing flash partition...");
+    esp_ota_handle_t otah;
+    err = esp_ota_begin(target, ds.st_size, &otah);
     if (err != ESP_OK)
       {
-      writer->printf("Error: ESP32 error #%d when writing to flash - state is inconsistent\n",err);
-      esp_ota_end(otah);
+      writer->printf("Error: ESP32 error #%d when starting OTA operation\n",err);
       fclose(f);
       return;
       }
-    }
-  fclose(f);
 
-  err = esp_ota_end(otah);
-  if (err != ESP_OK)
-    {
-    writer->printf("Error: ESP32 error #%d finalising OTA operation - state is inconsistent\n",err);
-    return;
-    }
+    writer->puts("Flashing image partition...");
+    while (n > 0)
+      {
+      err = esp_ota_write(otah, buf, n);
+      if (err != ESP_OK)
+        {
+        writer->printf("Error: ESP32 error #%d when writing to flash - state is inconsistent\n",err);
+        esp_ota_end(otah);
+        fclose(f);
+        return;
+        }
+      n = fread(buf, sizeof(char), sizeof(buf), f);
+      }
+    fclose(f);
 
-  fclose(f);
+    err = esp_ota_end(otah);
+    if (err != ESP_OK)
+      {
+      writer->printf("Error: ESP32 error #%d finalising OTA operation - state is inconsistent\n",err);
+      return;
+      }
+    }
 
   writer->puts("Setting boot partition...");
   err = esp_ota_set_boot_partition(target);
@@ -437,14 +1202,23 @@ void ota_flash_http(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
   writer->printf("Download firmware from %s to %s\n",url.c_str(),target->label);
 
   // Download and flash...
-  OvmsOTAWriter http(target, writer);
-  if (!http.Request(url))
+  size_t size = 0;
+  std::string error;
+  bool ok;
+  if (argc == 0)
     {
-    writer->printf("Error: Request failed: %s\n",http.GetError().c_str());
+    ok = ota_download(target, writer, url, size, error);
     }
-
-  if (http.HasError())
+  else
+    {
+    OvmsOTAWriter http(target, writer);
+    ok = (http.Download(url) && !http.HasError());
+    error = http.GetError();
+    size = http.m_filesize;
+    }
+  if (!ok)
     {
+    writer->printf("Error: Request failed: %s\n",error.c_str());
     return;
     }
 
@@ -458,7 +1232,7 @@ void ota_flash_http(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
     }
 
   writer->printf("OTA flash was successful\n  Flashed %d bytes from %s\n  Next boot will be from '%s'\n",
-                 http.GetBodySize(),url.c_str(),target->label);
+                 size,url.c_str(),target->label);
   MyConfig.SetParamValue("ota", "http.mru", url);
   }
 
@@ -637,6 +1411,8 @@ OvmsOTA::OvmsOTA()
 
   m_autotask = NULL;
   m_lastcheckday = -1;
+  m_metric_progress = MyMetrics.InitInt("m.ota.progress", SM_STALE_MAX, 0, Percentage);
+  m_metric_rate = MyMetrics.InitFloat("m.ota.rate", SM_STALE_MAX, 0);
 
   MyConfig.RegisterParam("ota", "OTA setup and status", true, true);
 
@@ -873,16 +1649,11 @@ bool OvmsOTA::AutoFlash(bool force)
   MyNotify.NotifyStringf("info", "ota.update", "New OTA firmware %s is now being downloaded", info.version_server.c_str());
 
   // Download and flash...
-  OvmsOTAWriter http(target, NULL);
-  if (!http.Request(url))
-    {
-    ESP_LOGE(TAG, "AutoFlash: HTTP Request failed: %s", http.GetError().c_str());
-    m_lastcheckday = -1; // Allow to try again within the same day
-    return false;
-    }
-
-  if (http.HasError())
+  size_t size = 0;
+  std::string error;
+  if (!ota_download(target, NULL, url, size, error))
     {
+    ESP_LOGE(TAG, "AutoFlash: HTTP Request failed: %s", error.c_str());
     m_lastcheckday = -1; // Allow to try again within the same day
     return false;
     }
@@ -896,7 +1667,7 @@ bool OvmsOTA::AutoFlash(bool force)
     return false;
     }
 
-  ESP_LOGI(TAG, "AutoFlash: Success flash of %d bytes from %s", http.GetBodySize(), url.c_str());
+  ESP_LOGI(TAG, "AutoFlash: Success flash of %d bytes from %s", size, url.c_str());
   MyNotify.NotifyStringf("info", "ota.update", "OTA firmware %s has been updated (OVMS will restart)", info.version_server.c_str());
   MyConfig.SetParamValue("ota", "http.mru", url);
 
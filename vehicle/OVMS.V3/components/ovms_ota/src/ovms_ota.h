@@ -35,6 +35,7 @@
 #include "freertos/task.h"
 #include "ovms_events.h"
 #include "ovms_mutex.h"
+#include "ovms_metrics.h"
 
 struct ota_info
   {
@@ -65,6 +66,8 @@ class OvmsOTA
     TaskHandle_t m_autotask;
     int m_lastcheckday;
     std::string m_lastnotifyversion;
+    OvmsMetricInt* m_metric_progress;     // m.ota.progress: download progress [%]
+    OvmsMetricFloat* m_metric_rate;       // m.ota.rate: download speed [kB/s]
 
 #ifdef CONFIG_OVMS_COMP_SDCARD
   protected:
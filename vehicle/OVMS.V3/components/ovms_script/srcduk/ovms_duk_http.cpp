@@ -232,7 +232,7 @@ bool DuktapeHTTPRequest::StartRequest(duk_context *ctx /*=NULL*/)
   if (startsWith(m_url, "https://"))
     {
     #if MG_ENABLE_SSL
-      opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+      opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
     #else
       m_error = "SSL support disabled";
       ESP_LOGD(TAG, "DuktapeHTTPRequest: connect to '%s' failed: %s", m_url.c_str(), m_error.c_str());
@@ -251,6 +251,8 @@ bool DuktapeHTTPRequest::StartRequest(duk_context *ctx /*=NULL*/)
     CallMethod(ctx, "fail");
     return false;
     }
+  if (opts.ssl_ca_cert)
+    MyOvmsTLS.SetupConnection(m_mgconn, m_url, opts);
 
   // connection created:
   if (m_timeout > 0)
@@ -153,6 +153,134 @@ static struct
   { "vehicle",   "timezone" }              // 23 PARAM_TIMEZONE
   };
 
+/**
+ * Compact historical data encoding (see protocol_v2 "K" message):
+ *  Records are encoded as "<type>,<timediff>,<recno>,<lifetime>,<data>".
+ *  All fields following the type are coded against the previous record of
+ *  the same type within the batch:
+ *    "~" / "~<n>"  = 1 / n fields unchanged
+ *    "^<delta>"    = numeric delta in units of the previous field's last decimal
+ *    "\<text>"     = literal text starting with one of the escape chars
+ *  Any other field content is literal.
+ */
+typedef std::map<extram::string, std::vector<extram::string>> mp_compact_ref_t;
+
+static bool mp_compact_parsefixed(const extram::string& field, int64_t& value, int& decimals)
+  {
+  const char* p = field.c_str();
+  bool neg = (*p == '-');
+  if (neg) p++;
+  if (*p < '0' || *p > '9')
+    return false;
+  value = 0;
+  decimals = -1;
+  for (; *p; p++)
+    {
+    if (*p == '.' && decimals < 0)
+      decimals = 0;
+    else if (*p >= '0' && *p <= '9' && value < 100000000000000LL)
+      {
+      value = value * 10 + (*p - '0');
+      if (decimals >= 0) decimals++;
+      }
+    else
+      return false;
+    }
+  if (decimals == 0)
+    return false;
+  if (decimals < 0)
+    decimals = 0;
+  if (neg)
+    value = -value;
+  return true;
+  }
+
+static void mp_compact_formatfixed(char* buf, int64_t value, int decimals)
+  {
+  char digits[24];
+  int64_t absval = (value < 0) ? -value : value;
+  int len = snprintf(digits, sizeof(digits), "%0*lld", decimals+1, (long long)absval);
+  if (value < 0) *buf++ = '-';
+  memcpy(buf, digits, len - decimals);
+  buf += len - decimals;
+  if (decimals)
+    {
+    *buf++ = '.';
+    memcpy(buf, digits + len - decimals, decimals);
+    buf += decimals;
+    }
+  *buf = 0;
+  }
+
+static void mp_compact_field(extram::string& out, const extram::string& field, const extram::string* ref)
+  {
+  if (ref)
+    {
+    // try numeric delta, use if shorter and exactly reproducible:
+    int64_t val, refval;
+    int dec, refdec;
+    if (mp_compact_parsefixed(field, val, dec) && mp_compact_parsefixed(*ref, refval, refdec) && dec == refdec)
+      {
+      char buf[28];
+      mp_compact_formatfixed(buf, val, dec);
+      if (field == buf)
+        {
+        int len = snprintf(buf, sizeof(buf), "^%lld", (long long)(val - refval));
+        if (len < (int)field.size())
+          {
+          out.append(buf, len);
+          return;
+          }
+        }
+      }
+    }
+  if (!field.empty() && (field[0] == '~' || field[0] == '^' || field[0] == '\\'))
+    out += '\\';
+  out.append(field);
+  }
+
+static void mp_compact_record(extram::string& out, mp_compact_ref_t& refs, int timediff, const extram::string& msg)
+  {
+  std::vector<extram::string> fields;
+  size_t start = msg.find(',');
+  extram::string type = msg.substr(0, start);
+  char buf[12];
+  snprintf(buf, sizeof(buf), "%d", timediff);
+  fields.push_back(extram::string(buf));
+  while (start != extram::string::npos)
+    {
+    size_t end = msg.find(',', start+1);
+    fields.push_back(msg.substr(start+1, (end == extram::string::npos) ? end : end-start-1));
+    start = end;
+    }
+
+  std::vector<extram::string>& ref = refs[type];
+  out.append(type);
+  int run = 0;
+  for (size_t i=0; i<fields.size(); i++)
+    {
+    if (i < ref.size() && fields[i] == ref[i])
+      {
+      run++;
+      continue;
+      }
+    if (run)
+      {
+      out += ",~";
+      if (run > 1) { snprintf(buf, sizeof(buf), "%d", run); out.append(buf); }
+      run = 0;
+      }
+    out += ',';
+    mp_compact_field(out, fields[i], (i < ref.size()) ? &ref[i] : NULL);
+    }
+  if (run)
+    {
+    out += ",~";
+    if (run > 1) { snprintf(buf, sizeof(buf), "%d", run); out.append(buf); }
+    }
+  ref.swap(fields);
+  }
+
 OvmsServerV2 *MyOvmsServerV2 = NULL;
 size_t MyOvmsServerV2Modifier = 0;
 size_t MyOvmsServerV2Reader = 0;
@@ -266,17 +394,9 @@ void OvmsServerV2::ProcessServerMsg()
     ESP_LOGI(TAG, "Shared secret key is %s (%d bytes)",key.c_str(),key.length());
     hmac_md5((uint8_t*)key.c_str(), key.length(), (uint8_t*)m_password.c_str(), m_password.length(), sdigest);
     RC4_setup(&m_crypto_rx1, &m_crypto_rx2, sdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t v = 0;
-      RC4_crypt(&m_crypto_rx1, &m_crypto_rx2, &v, 1);
-      }
+    RC4_skip(&m_crypto_rx1, &m_crypto_rx2, 1024);
     RC4_setup(&m_crypto_tx1, &m_crypto_tx2, sdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t v = 0;
-      RC4_crypt(&m_crypto_tx1, &m_crypto_tx2, &v, 1);
-      }
+    RC4_skip(&m_crypto_tx1, &m_crypto_tx2, 1024);
 
     if (m_paranoid)
       {
@@ -296,11 +416,16 @@ void OvmsServerV2::ProcessServerMsg()
       std::string msg("MP-0 ET");
       msg.append(m_ptoken);
       Transmit(msg);
-      m_ptoken_ready = true;
 
       // Generate, and store, the digest for future use
       std::string modpass = MyConfig.GetParamValue("password","module");
       hmac_md5((uint8_t*) token, OVMS_PROTOCOL_V2_TOKENSIZE, (uint8_t*)modpass.c_str(), modpass.length(), m_pdigest);
+
+      // Every paranoid message starts from the same primed cipher state,
+      // so prime it once here and clone it per message:
+      RC4_setup(&m_pcrypto1, &m_pcrypto2, m_pdigest, OVMS_MD5_SIZE);
+      RC4_skip(&m_pcrypto1, &m_pcrypto2, 1024);
+      m_ptoken_ready = true;
       }
 
     m_pending_notify_info = true;
@@ -309,6 +434,7 @@ void OvmsServerV2::ProcessServerMsg()
     m_pending_notify_data = true;
     m_pending_notify_data_last = 0;
     m_pending_notify_data_retransmit = 0;
+    m_pending_notify_data_batches.clear();
     m_connretry = 0;
 
     StandardMetrics.ms_s_v2_connected->SetValue(true);
@@ -323,13 +449,11 @@ void OvmsServerV2::ProcessServerMsg()
     return;
     }
 
-  uint8_t* b = new uint8_t[line.length()+1];
+  // Decode & decrypt in place:
+  uint8_t* b = (uint8_t*) &line[0];
   int len = base64decode(line.c_str(),b);
-
   RC4_crypt(&m_crypto_rx1, &m_crypto_rx2, b, len);
-  b[len]=0;
-  line = std::string((char*)b);
-  delete [] b;
+  line.resize(strnlen(line.c_str(), len));
   ESP_LOGI(TAG, "Incoming Msg: %s",line.c_str());
 
   if (line.compare(0, 5, "MP-0 ") != 0)
@@ -341,29 +465,17 @@ void OvmsServerV2::ProcessServerMsg()
 
   if ((line.at(5) == 'E')&&(line.at(6) == 'M'))
     {
-    char code[2]; code[0] = line.at(7); code[1] = 0;
-    uint8_t *d = new uint8_t[line.length()-6];
-    len = base64decode(line.c_str()+7,d+1);
-
-    RC4_CTX1* pm_crypto1 = new RC4_CTX1;
-    RC4_CTX2* pm_crypto2 = new RC4_CTX2;
-    RC4_setup(pm_crypto1, pm_crypto2, m_pdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t zero = 0;
-      RC4_crypt(pm_crypto1, pm_crypto2, &zero, 1);
-      }
-    RC4_crypt(pm_crypto1, pm_crypto2, d, len);
-
-    line.erase(5);
-    line = std::string("MP-0 ");
-    line.append(code);
-    line.append((char*)d);
-    len = line.length();
-
-    delete pm_crypto1;
-    delete pm_crypto2;
-    delete d;
+    // The message is of the form MP-0 EMX<b64>, where X is the code
+    // and <b64> the paranoid encrypted data; decode it in place:
+    uint8_t *d = (uint8_t*) &line[8];
+    len = base64decode((char*)d, d);
+    RC4_CTX1 pm_crypto1 = m_pcrypto1;
+    RC4_CTX2 pm_crypto2 = m_pcrypto2;
+    RC4_crypt(&pm_crypto1, &pm_crypto2, d, len);
+
+    line[5] = line[7];
+    line.erase(6, 2);
+    line.resize(6 + strnlen(line.c_str()+6, len));
     ESP_LOGI(TAG, "Decoded Paranoid Msg: %s",line.c_str());
     }
 
@@ -728,53 +840,49 @@ void OvmsServerV2::Transmit(const std::string& message)
     return;
 
   int len = message.length();
-  char* s = new char[(len*2)+4];
-  memcpy(s,message.c_str(),len);
   ESP_LOGI(TAG, "Send %s",message.c_str());
 
-  if ((m_ptoken_ready)&&
-      (s[5] != 'E')&&
-      (s[5] != 'A')&&
-      (s[5] != 'a')&&
-      (s[5] != 'g')&&
-      (s[5] != 'P'))
+  // The message is of the form MP-0 X...
+  // Where X is the code and ... is the (optional) data
+  bool paranoid = ((m_ptoken_ready)&&
+                   (message[5] != 'E')&&
+                   (message[5] != 'A')&&
+                   (message[5] != 'a')&&
+                   (message[5] != 'g')&&
+                   (message[5] != 'P'));
+
+  // Encryption and encoding is done in place in a single buffer: the
+  // plain text line is placed at the end of the base64 output area, so
+  // the encoder never overtakes its input. Paranoid data is nested the
+  // same way at the end of the paranoid line.
+  int plen = (paranoid) ? 8 + howmany(len-6,3)*4 : len;
+  int blen = howmany(plen,3)*4;
+  char* buf = new char[blen+3];
+  uint8_t* s = (uint8_t*)buf + blen - plen;
+
+  if (paranoid)
     {
-    // We must convert the message to a paranoid one...
-    // The message is of the form MP-0 X...
-    // Where X is the code and ... is the (optional) data
-    char code[2]; code[0] = s[5]; code[1] = 0;
-    uint8_t* d = new uint8_t[len-6];
-    memcpy(d,s+6,len-6);
-
-    // Paranoid encrypt the message part of the transaction
-    RC4_CTX1* pm_crypto1 = new RC4_CTX1;
-    RC4_CTX2* pm_crypto2 = new RC4_CTX2;
-    RC4_setup(pm_crypto1, pm_crypto2, m_pdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t zero = 0;
-      RC4_crypt(pm_crypto1, pm_crypto2, &zero, 1);
-      }
-    RC4_crypt(pm_crypto1, pm_crypto2, d, len-6);
-
-    strcpy(s,"MP-0 EM");
-    strcat(s,code);
-    base64encode(d, len-6, (uint8_t*)s+8);
-    // The messdage is now in paranoid mode...
-    delete d;
-    delete pm_crypto1;
-    delete pm_crypto2;
+    // Convert to MP-0 EMX... with paranoid encrypted data:
+    uint8_t* d = s + plen - (len-6);
+    memcpy(d, message.data()+6, len-6);
+    RC4_CTX1 pm_crypto1 = m_pcrypto1;
+    RC4_CTX2 pm_crypto2 = m_pcrypto2;
+    RC4_crypt(&pm_crypto1, &pm_crypto2, d, len-6);
+    base64encode(d, len-6, s+8);
+    memcpy(s, "MP-0 EM", 7);
+    s[7] = message[5];
+    }
+  else
+    {
+    memcpy(s, message.data(), len);
     }
 
-  RC4_crypt(&m_crypto_tx1, &m_crypto_tx2, (uint8_t*)s, len);
-
-  char* buf = new char[(len*2)+4];
-  base64encode((uint8_t*)s, len, (uint8_t*)buf);
-  strcat(buf,"\r\n");
-  mg_send(m_mgconn, buf, strlen(buf));
+  RC4_crypt(&m_crypto_tx1, &m_crypto_tx2, s, plen);
+  char* end = base64encode(s, plen, (uint8_t*)buf);
+  memcpy(end, "\r\n", 3);
+  mg_send(m_mgconn, buf, blen+2);
 
   delete [] buf;
-  delete [] s;
   }
 
 void OvmsServerV2::SetStatus(const char* status, bool fault, State newstate)
@@ -862,7 +970,7 @@ void OvmsServerV2::Connect()
   opts.error_string = &err;
   if (m_tls)
     {
-    opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+    opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
     opts.ssl_server_name = m_server.c_str();
     }
   if ((m_mgconn = mg_connect_opt(mgr, address.c_str(), OvmsServerV2MongooseCallback, opts)) == NULL)
@@ -872,6 +980,8 @@ void OvmsServerV2::Connect()
     m_connretry = 60; // Try again in 60 seconds...
     return;
     }
+  if (m_tls)
+    MyOvmsTLS.SetupConnection(m_mgconn, address, opts);
   return;
   }
 
@@ -1553,6 +1663,12 @@ void OvmsServerV2::TransmitNotifyAlert()
 
 void OvmsServerV2::TransmitNotifyData()
   {
+  if (m_notify_data_compact)
+    {
+    TransmitNotifyDataCompact();
+    return;
+    }
+
   // Find the type object
   OvmsNotifyType* data = MyNotify.GetType("data");
   if (data == NULL) return;
@@ -1606,11 +1722,104 @@ void OvmsServerV2::TransmitNotifyData()
     }
   }
 
+/**
+ * TransmitNotifyDataCompact: send data records in compact batches ("K" message)
+ *  The batch ackcode is the ID of the first record, the ack covers all records.
+ */
+void OvmsServerV2::TransmitNotifyDataCompact()
+  {
+  // Find the type object
+  OvmsNotifyType* data = MyNotify.GetType("data");
+  if (data == NULL) return;
+
+  uint32_t starttime = esp_log_timestamp();
+  int cnt = 0;
+  size_t size = 0;
+
+  while(1)
+    {
+    mp_compact_ref_t refs;
+    extram::string records;
+    std::vector<uint32_t> ids;
+    uint32_t last = m_pending_notify_data_last;
+    uint32_t now = esp_log_timestamp();
+
+    while (ids.size() < OVMS_V2_COMPACT_MAXRECORDS && records.size() < OVMS_V2_COMPACT_MAXSIZE)
+      {
+      OvmsNotifyEntry* e = data->FirstUnreadEntry(MyOvmsServerV2Reader, last);
+      if (e == NULL)
+        break;
+
+      extram::string msg = e->GetValue();
+      ESP_LOGD(TAG, "TransmitNotifyDataCompact: msg=%s", msg.c_str());
+
+      // terminate payload at first LF:
+      size_t eol = msg.find('\n');
+      if (eol != std::string::npos)
+        msg.resize(eol);
+
+      if (!records.empty())
+        records += OVMS_V2_COMPACT_RS;
+      mp_compact_record(records, refs, -((int)(now - e->m_created) / 1000), msg);
+      ids.push_back(e->m_id);
+      last = e->m_id;
+      }
+
+    if (ids.empty())
+      {
+      m_pending_notify_data = false;
+      // if we have sent something, check for retransmissions in 10 seconds:
+      if (m_pending_notify_data_last)
+        m_pending_notify_data_retransmit = 10;
+      return;
+      }
+
+    extram::ostringstream buffer;
+    buffer
+      << "MP-0 K"
+      << ids.front()
+      << ","
+      << ids.size()
+      << ","
+      << records;
+    Transmit(buffer.str().c_str());
+    m_pending_notify_data_last = last;
+
+    if (m_pending_notify_data_batches.size() >= OVMS_V2_COMPACT_MAXPENDING)
+      m_pending_notify_data_batches.erase(m_pending_notify_data_batches.begin());
+    m_pending_notify_data_batches[ids.front()].swap(ids);
+
+    // be nice to other tasks, the network & the server:
+    // limits per second: 300 ms / 5 transmissions / 4000 bytes payload
+    cnt++;
+    size += buffer.str().size();
+    now = esp_log_timestamp();
+    if (now - starttime >= 300 || cnt == 5 || size >= 4000)
+      {
+      ESP_LOGD(TAG, "TransmitNotifyDataCompact: used %d ms for %d batches, %u bytes", now - starttime, cnt, size);
+      return;
+      }
+    }
+  }
+
 void OvmsServerV2::HandleNotifyDataAck(uint32_t ack)
   {
   OvmsNotifyType* data = MyNotify.GetType("data");
   if (data == NULL) return;
 
+  auto batch = m_pending_notify_data_batches.find(ack);
+  if (batch != m_pending_notify_data_batches.end())
+    {
+    for (auto id = batch->second.begin(); id != batch->second.end(); ++id)
+      {
+      OvmsNotifyEntry* e = data->FindEntry(*id);
+      if (e)
+        data->MarkRead(MyOvmsServerV2Reader, e);
+      }
+    m_pending_notify_data_batches.erase(batch);
+    return;
+    }
+
   OvmsNotifyEntry* e = data->FindEntry(ack);
   if (e)
     {
@@ -1773,6 +1982,7 @@ void OvmsServerV2::EventListener(std::string event, void* data)
 void OvmsServerV2::ConfigChanged(OvmsConfigParam* param)
   {
   m_streaming = MyConfig.GetParamValueInt("vehicle", "stream", 0);
+  m_notify_data_compact = MyConfig.GetParamValueBool("server.v2", "notify.data.compact", false);
   m_updatetime_connected = MyConfig.GetParamValueInt("server.v2", "updatetime.connected", 60);
   m_updatetime_idle = MyConfig.GetParamValueInt("server.v2", "updatetime.idle", 600);
   }
@@ -1913,6 +2123,7 @@ OvmsServerV2::OvmsServerV2(const char* name)
   m_now_capabilities = false;
   m_now_group = false;
   m_streaming = 0;
+  m_notify_data_compact = false;
   m_updatetime_idle = 600;
   m_updatetime_connected = 60;
   m_lasttx = 0;
@@ -2080,6 +2291,8 @@ OvmsServerV2Init::OvmsServerV2Init()
   //   'port': The port to connect to (default: 6867)
   //   'updatetime.connected': Time between updates when one or more apps connected (default: 60)
   //   'updatetime.idle': Time between updates when no apps connected (default: 600)
+  //   'notify.data.compact': Send data notifications as compact "K" batches (default: no)
+  //                          Note: needs server support for the "K" message
   // Also note:
   //  Parameter "vehicle", instance "id", is the vehicle ID
   //  Server Password has been movied to password/server.v2
@@ -44,9 +44,18 @@
 #include "ovms_metrics.h"
 #include "ovms_notify.h"
 #include "ovms_mutex.h"
+#include <map>
+#include <vector>
 
 #define OVMS_PROTOCOL_V2_TOKENSIZE 22
 
+#define OVMS_V2_COMPACT_RS '\x1e'            // compact batch record separator
+#define OVMS_V2_COMPACT_MAXRECORDS 32         // max records per compact batch
+#define OVMS_V2_COMPACT_MAXSIZE 1500          // max payload size per compact batch
+#define OVMS_V2_COMPACT_MAXPENDING 16         // max unacknowledged compact batches
+
+typedef std::map<uint32_t, std::vector<uint32_t>> OvmsServerV2BatchMap_t;
+
 class OvmsServerV2 : public OvmsServer
   {
   public:
@@ -80,6 +89,7 @@ class OvmsServerV2 : public OvmsServer
     void TransmitNotifyError();
     void TransmitNotifyAlert();
     void TransmitNotifyData();
+    void TransmitNotifyDataCompact();
     void HandleNotifyDataAck(uint32_t ack);
 
   public:
@@ -134,6 +144,8 @@ class OvmsServerV2 : public OvmsServer
 
     bool m_paranoid;
     uint8_t m_pdigest[OVMS_MD5_SIZE];
+    RC4_CTX1 m_pcrypto1;                  // primed paranoid cipher state,
+    RC4_CTX2 m_pcrypto2;                  // cloned per message
     std::string m_ptoken;
     bool m_ptoken_ready;
 
@@ -146,6 +158,7 @@ class OvmsServerV2 : public OvmsServer
     bool m_now_group;
 
     int m_streaming;
+    bool m_notify_data_compact;
     int m_updatetime_idle;
     int m_updatetime_connected;
 
@@ -160,6 +173,7 @@ class OvmsServerV2 : public OvmsServer
     bool m_pending_notify_data;
     uint32_t m_pending_notify_data_last;
     int m_pending_notify_data_retransmit;
+    OvmsServerV2BatchMap_t m_pending_notify_data_batches;
   };
 
 class OvmsServerV2Init
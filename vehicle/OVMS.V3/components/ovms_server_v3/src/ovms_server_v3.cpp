@@ -267,10 +267,7 @@ void OvmsServerV3::TransmitAllMetrics()
   while (metric != NULL)
     {
     metric->ClearModified(MyOvmsServerV3Modifier);
-    if (!metric->AsString().empty())
-      {
-      TransmitMetric(metric);
-      }
+    TransmitMetric(metric, true);
     metric = metric->m_next;
     }
   }
@@ -292,9 +289,17 @@ void OvmsServerV3::TransmitModifiedMetrics()
     }
   }
 
-void OvmsServerV3::TransmitMetric(OvmsMetric* metric)
+void OvmsServerV3::TransmitMetric(OvmsMetric* metric, bool skipempty /*=false*/)
   {
-  std::string topic(m_topic_prefix);
+  // Note: the caller holds m_mgconn_mutex, which also protects our buffers
+  std::string& val = m_tx_value;
+  val.clear();
+  metric->AppendString(val);
+  if (skipempty && val.empty())
+    return;
+
+  std::string& topic = m_tx_topic;
+  topic.assign(m_topic_prefix);
   topic.append("metric/");
   topic.append(metric->m_name);
 
@@ -305,8 +310,6 @@ void OvmsServerV3::TransmitMetric(OvmsMetric* metric)
         topic[i] = '/';
     }
 
-  std::string val = metric->AsString();
-
   mg_mqtt_publish(m_mgconn, topic.c_str(), m_msgid++,
     MG_MQTT_QOS(0) | MG_MQTT_RETAIN, val.c_str(), val.length());
   ESP_LOGI(TAG,"Tx metric %s=%s",topic.c_str(),val.c_str());
@@ -678,7 +681,7 @@ void OvmsServerV3::Connect()
   opts.error_string = &err;
   if (m_tls)
     {
-    opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+    opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
     opts.ssl_server_name = m_server.c_str();
     }
   if ((m_mgconn = mg_connect_opt(mgr, address.c_str(), OvmsServerV3MongooseCallback, opts)) == NULL)
@@ -687,6 +690,8 @@ void OvmsServerV3::Connect()
     m_connretry = 20; // Try again in 20 seconds...
     return;
     }
+  if (m_tls)
+    MyOvmsTLS.SetupConnection(m_mgconn, address, opts);
   return;
   }
 
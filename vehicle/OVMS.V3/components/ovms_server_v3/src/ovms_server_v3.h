@@ -92,6 +92,8 @@ class OvmsServerV3 : public OvmsServer
     std::string m_conn_topic[MQTT_CONN_NTOPICS];
     struct mg_connection *m_mgconn;
     OvmsMutex m_mgconn_mutex;
+    std::string m_tx_topic;         // TransmitMetric() buffers, protected by m_mgconn_mutex
+    std::string m_tx_value;
     int m_connretry;
     bool m_sendall;
     int m_msgid;
@@ -139,7 +141,7 @@ class OvmsServerV3 : public OvmsServer
     void CountClients();
 
   private:
-    void TransmitMetric(OvmsMetric* metric);
+    void TransmitMetric(OvmsMetric* metric, bool skipempty=false);
   };
 
 class OvmsServerV3Init
@@ -11,3 +11,7 @@ COMPONENT_SRCDIRS := src
 COMPONENT_ADD_INCLUDEDIRS := src
 COMPONENT_ADD_LDFLAGS = -Wl,--whole-archive -l$(COMPONENT_NAME) -Wl,--no-whole-archive
 COMPONENT_EMBED_TXTFILES := trustedca/usertrust.crt trustedca/dst.crt trustedca/digicert_global.crt trustedca/starfield_class2.crt
+
+ifdef CONFIG_OVMS_SC_GPL_WOLF
+CXXFLAGS += -DWOLFSSL_USER_SETTINGS
+endif
@@ -47,6 +47,29 @@ static const char *TAG = "tls";
 #include "mbedtls/x509_crt.h"
 #include "mbedtls/debug.h"
 
+#if defined(CONFIG_OVMS_SC_GPL_MONGOOSE) && defined(CONFIG_OVMS_SC_GPL_WOLF)
+#include "mongoose.h"
+#if MG_ENABLE_SSL
+#define OVMS_TLS_SHARED_STORE 1
+#include <wolfssl/ssl.h>
+#include <wolfssl/wolfcrypt/sha.h>
+#include <arpa/inet.h>
+
+// Mongoose OpenSSL interface connection context (mongoose.c, MG_SSL_IF_OPENSSL),
+// pointed to by mg_connection.ssl_if_data. We only access the leading handles.
+struct ovms_mg_ssl_if_ctx
+  {
+  WOLFSSL* ssl;
+  WOLFSSL_CTX* ssl_ctx;
+  };
+
+// CA marker for outbound connections verified against the shared CA store.
+// Mongoose treats "*" as "no CA", so it skips loading the PEM list per
+// connection; SetupConnection() then attaches the shared store.
+static const char c_shared_ca[] = "*";
+#endif //MG_ENABLE_SSL
+#endif
+
 OvmsTLS MyOvmsTLS __attribute__ ((init_priority (3000)));
 
 void tls_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
@@ -61,6 +84,18 @@ void tls_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, c
     {
     writer->printf("SSL/TLS has %d trusted CAs, not currently cached\n", MyOvmsTLS.Count());
     }
+
+#ifdef OVMS_TLS_SHARED_STORE
+  int storecount = MyOvmsTLS.GetStoreCount();
+  if (storecount >= 0)
+    writer->printf("Shared CA store has %d parsed CAs\n", storecount);
+  else
+    writer->puts("Shared CA store not currently built");
+  uint32_t connects, resumes;
+  MyOvmsTLS.GetSessionStats(&connects, &resumes);
+  writer->printf("Outbound TLS connections: %u, session resumptions offered: %u\n",
+    connects, resumes);
+#endif //OVMS_TLS_SHARED_STORE
   }
 
 void tls_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
@@ -107,6 +142,17 @@ OvmsTLS::OvmsTLS()
   ESP_LOGI(TAG, "Initialising TLS (3000)");
 
   m_trustedcache = NULL;
+  m_certstore = NULL;
+  m_storecount = 0;
+  m_connects = 0;
+  m_resumes = 0;
+
+  // Config:
+  //   tls ca.shared          -- yes (default) = verify outbound connections against
+  //                             the shared pre-parsed CA store
+  //   tls session.cache      -- yes (default) = resume TLS sessions to known hosts
+  //   tls session.timeout    -- session lifetime in seconds (default 3600)
+  MyConfig.RegisterParam("tls", "SSL/TLS configuration", true, true);
 
   OvmsCommand* cmd_tls = MyCommandApp.RegisterCommand("tls","SSL/TLS Framework",NULL,"",0,0);
   OvmsCommand* cmd_trust = cmd_tls->RegisterCommand("trust","SSL/TLS Trusted CA Framework", tls_status, "", 0, 0, false);
@@ -139,6 +185,7 @@ void OvmsTLS::Clear()
     }
   m_trustlist.clear();
   ClearTrustedRaw();
+  ClearCertStore();
   }
 
 void OvmsTLS::Reload()
@@ -239,6 +286,180 @@ void OvmsTLS::BuildTrustedRaw()
   ESP_LOGI(TAG, "Built trusted CA cache (%d entries, %d bytes)",count,size);
   }
 
+/**
+ * GetCertStore: get the shared CA store, parse the trusted CA list into it
+ *  on first use. Connections hold their own reference to the store, so it
+ *  stays valid for them when the list gets reloaded.
+ */
+void* OvmsTLS::GetCertStore()
+  {
+#ifdef OVMS_TLS_SHARED_STORE
+  OvmsMutexLock lock(&m_storemutex);
+  if (m_certstore != NULL) return m_certstore;
+
+  WOLFSSL_CERT_MANAGER* cm = wolfSSL_CertManagerNew();
+  if (cm == NULL)
+    {
+    ESP_LOGE(TAG, "Shared CA store: out of memory");
+    return NULL;
+    }
+
+  int count = 0;
+  for (auto it = m_trustlist.begin(); it != m_trustlist.end(); it++)
+    {
+    char *pem = it->second->GetPEM();
+    if (wolfSSL_CertManagerLoadCABuffer(cm, (const unsigned char*)pem, strlen(pem),
+          WOLFSSL_FILETYPE_PEM) == WOLFSSL_SUCCESS)
+      count++;
+    else
+      ESP_LOGW(TAG, "Shared CA store: can't parse '%s'", it->first.c_str());
+    }
+
+  m_certstore = cm;
+  m_storecount = count;
+  ESP_LOGI(TAG, "Built shared CA store (%d of %d CAs)", count, m_trustlist.size());
+  return m_certstore;
+#else
+  return NULL;
+#endif //OVMS_TLS_SHARED_STORE
+  }
+
+void OvmsTLS::ClearCertStore()
+  {
+#ifdef OVMS_TLS_SHARED_STORE
+  OvmsMutexLock lock(&m_storemutex);
+  if (m_certstore != NULL)
+    {
+    ESP_LOGI(TAG, "Clearing shared CA store");
+    wolfSSL_CertManagerFree((WOLFSSL_CERT_MANAGER*)m_certstore);
+    m_certstore = NULL;
+    m_storecount = 0;
+    }
+#endif //OVMS_TLS_SHARED_STORE
+  }
+
+/**
+ * AttachCertStore: replace the CA store of a connection SSL context by the
+ *  shared store (the context keeps a reference)
+ */
+bool OvmsTLS::AttachCertStore(void* ssl_ctx)
+  {
+#ifdef OVMS_TLS_SHARED_STORE
+  OvmsMutexLock lock(&m_storemutex);
+  if (m_certstore == NULL)
+    return false;
+  WOLFSSL_X509_STORE* store = wolfSSL_X509_STORE_new();
+  if (store == NULL)
+    return false;
+  wolfSSL_CertManagerFree(store->cm);
+  store->cm = (WOLFSSL_CERT_MANAGER*) m_certstore;
+  wolfSSL_CertManager_up_ref(store->cm);
+  wolfSSL_CTX_set_cert_store((WOLFSSL_CTX*) ssl_ctx, store);
+  return true;
+#else
+  return false;
+#endif //OVMS_TLS_SHARED_STORE
+  }
+
+int OvmsTLS::GetStoreCount()
+  {
+  OvmsMutexLock lock(&m_storemutex);
+  return (m_certstore != NULL) ? m_storecount : -1;
+  }
+
+void OvmsTLS::GetSessionStats(uint32_t* connects, uint32_t* resumes)
+  {
+  *connects = m_connects;
+  *resumes = m_resumes;
+  }
+
+/**
+ * GetConnectCA: get the ssl_ca_cert option for an outbound mongoose connection.
+ *  The connection must be passed to SetupConnection() after mg_connect*().
+ */
+const char* OvmsTLS::GetConnectCA()
+  {
+#ifdef OVMS_TLS_SHARED_STORE
+  if (MyConfig.GetParamValueBool("tls", "ca.shared", true) && GetCertStore() != NULL)
+    return c_shared_ca;
+#endif //OVMS_TLS_SHARED_STORE
+  return GetTrustedList();
+  }
+
+/**
+ * SetupConnection: attach the shared CA store and a cached TLS session to a
+ *  new outbound connection. The handshake is done by the mongoose task once
+ *  the TCP connection has been established, so this needs to be called
+ *  directly after mg_connect*().
+ *
+ *  address: "[scheme://]host[:port][/path]", used as the session cache key
+ *  opts: the options passed to mg_connect*()
+ *
+ *  If the shared CA store cannot be attached, the connection is closed.
+ */
+bool OvmsTLS::SetupConnection(struct mg_connection* nc, const std::string& address,
+  const struct mg_connect_opts& opts)
+  {
+#ifdef OVMS_TLS_SHARED_STORE
+  if (nc == NULL)
+    return false;
+  ovms_mg_ssl_if_ctx* ifctx = (ovms_mg_ssl_if_ctx*) nc->ssl_if_data;
+  if (ifctx == NULL || ifctx->ssl == NULL || ifctx->ssl_ctx == NULL)
+    {
+    // The mongoose verification has been disabled by c_shared_ca, don't fail open:
+    if (opts.ssl_ca_cert == c_shared_ca)
+      {
+      ESP_LOGE(TAG, "SetupConnection %s: no TLS context, closing", address.c_str());
+      nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+      }
+    return false;
+    }
+
+  // Session key & host name from address:
+  std::string key = address;
+  size_t pos = key.find("://");
+  if (pos != std::string::npos) key.erase(0, pos+3);
+  pos = key.find('/');
+  if (pos != std::string::npos) key.erase(pos);
+  std::string host = (opts.ssl_server_name) ? opts.ssl_server_name : key.substr(0, key.rfind(':'));
+
+  if (opts.ssl_ca_cert == c_shared_ca)
+    {
+    if (!AttachCertStore(ifctx->ssl_ctx))
+      {
+      ESP_LOGE(TAG, "SetupConnection %s: shared CA store unavailable", key.c_str());
+      nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+      return false;
+      }
+    wolfSSL_set_verify(ifctx->ssl, WOLFSSL_VERIFY_PEER | WOLFSSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    struct in_addr ip;
+    if (!host.empty() && inet_aton(host.c_str(), &ip) == 0)
+      wolfSSL_check_domain_name(ifctx->ssl, host.c_str());
+    }
+
+  m_connects++;
+  if (MyConfig.GetParamValueBool("tls", "session.cache", true))
+    {
+    // wolfSSL keeps client sessions by server ID, we use a hash of host:port:
+    byte serverid[WC_SHA_DIGEST_SIZE];
+    wc_ShaHash((const byte*)key.data(), key.size(), serverid);
+    wolfSSL_set_timeout(ifctx->ssl, MyConfig.GetParamValueInt("tls", "session.timeout", 3600));
+#ifdef HAVE_SESSION_TICKET
+    wolfSSL_UseSessionTicket(ifctx->ssl);
+#endif
+    wolfSSL_SetServerID(ifctx->ssl, serverid, sizeof(serverid), 0);
+    if (wolfSSL_session_reused(ifctx->ssl))
+      {
+      m_resumes++;
+      ESP_LOGD(TAG, "SetupConnection %s: resuming cached session", key.c_str());
+      }
+    }
+  return true;
+#else
+  return false;
+#endif //OVMS_TLS_SHARED_STORE
+  }
+
 OvmsTrustedCert::OvmsTrustedCert(char* pem, bool needfree)
   {
   ESP_LOGD(TAG,"Registered %d byte trusted CA (%d)",strlen(pem),needfree);
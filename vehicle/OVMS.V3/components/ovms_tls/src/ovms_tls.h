@@ -33,6 +33,10 @@
 
 #include <string>
 #include <map>
+#include "ovms_mutex.h"
+
+struct mg_connection;
+struct mg_connect_opts;
 
 class OvmsTrustedCert
   {
@@ -63,9 +67,19 @@ class OvmsTLS
     void Clear();
     void Reload();
 
+  public:
+    const char* GetConnectCA();
+    bool SetupConnection(struct mg_connection* nc, const std::string& address,
+      const struct mg_connect_opts& opts);
+    int GetStoreCount();
+    void GetSessionStats(uint32_t* connects, uint32_t* resumes);
+
   protected:
     void BuildTrustedRaw();
     void ClearTrustedRaw();
+    void* GetCertStore();
+    void ClearCertStore();
+    bool AttachCertStore(void* ssl_ctx);
     void UpdatedConfig(std::string event, void* data);
 
   public:
@@ -73,6 +87,11 @@ class OvmsTLS
 
   protected:
     char* m_trustedcache;
+    void* m_certstore;                // shared pre-parsed CA store (WOLFSSL_CERT_MANAGER)
+    int m_storecount;                 // CAs loaded into m_certstore
+    OvmsMutex m_storemutex;
+    uint32_t m_connects;              // outbound TLS connections set up
+    uint32_t m_resumes;               // ... of which resumed a cached session
   };
 
 extern OvmsTLS MyOvmsTLS;
@@ -0,0 +1,748 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "triplog";
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "ovms.h"
+#include "ovms_triplog.h"
+#include "ovms_config.h"
+#include "ovms_events.h"
+#include "ovms_utils.h"
+#include "ovms_peripherals.h"
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+#include "ovms_webserver.h"
+#endif
+
+#define TRIPLOG_PARAM             "triplog"
+#define TRIPLOG_TASK_STACK        5120
+#define TRIPLOG_TASK_PRIORITY     5
+#define TRIPLOG_DEFAULT_METRICS   "v.p.speed:1,v.b.soc:1,v.b.power:2,v.b.current:1,v.b.voltage:1," \
+                                  "v.b.temp:1,v.p.odometer:1,v.p.altitude:0,v.p.latitude:6,v.p.longitude:6"
+
+OvmsTripLog MyTripLog __attribute__ ((init_priority (8610)));
+
+
+/**
+ * triplog_time: parse range time: absolute UTC timestamp or "+<n>[smh]" = offset from log start
+ */
+static uint32_t triplog_time(const std::string& arg, uint32_t start, uint32_t defvalue)
+  {
+  if (arg.empty())
+    return defvalue;
+  char* end;
+  long val = strtol(arg.c_str(), &end, 10);
+  switch (*end)
+    {
+    case 'm': val *= 60; break;
+    case 'h': val *= 3600; break;
+    default: break;
+    }
+  return (arg[0] == '+') ? start + val : val;
+  }
+
+static bool triplog_sd_available(const std::string& path)
+  {
+#ifdef CONFIG_OVMS_COMP_SDCARD
+  if (startsWith(path, "/sd") && (!MyPeripherals || !MyPeripherals->m_sdcard || !MyPeripherals->m_sdcard->isavailable()))
+    return false;
+#endif // #ifdef CONFIG_OVMS_COMP_SDCARD
+  return true;
+  }
+
+
+/**
+ * Commands
+ */
+
+static void triplog_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyTripLog.Status(writer);
+  }
+
+static void triplog_start(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyTripLog.Start((argc > 0) ? argv[0] : "manual", writer);
+  }
+
+static void triplog_stop(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (!MyTripLog.IsRunning())
+    {
+    writer->puts("Trip log not running");
+    return;
+    }
+  MyTripLog.Stop();
+  writer->puts("Trip log stopped");
+  }
+
+static void triplog_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  std::string path = (argc > 0) ? argv[0] : MyTripLog.m_path;
+  DIR* dir = opendir(path.c_str());
+  if (!dir)
+    {
+    writer->printf("Error: cannot open directory '%s'\n", path.c_str());
+    return;
+    }
+  struct dirent* dp;
+  struct stat st;
+  int cnt = 0;
+  while ((dp = readdir(dir)) != NULL)
+    {
+    if (!endsWith(dp->d_name, ".otl"))
+      continue;
+    std::string file = path + "/" + dp->d_name;
+    if (stat(file.c_str(), &st) != 0)
+      continue;
+    writer->printf("%8ld  %s\n", (long)st.st_size, dp->d_name);
+    cnt++;
+    }
+  closedir(dir);
+  writer->printf("%d trip log(s) in %s\n", cnt, path.c_str());
+  }
+
+static void triplog_info(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  TripLogReader reader;
+  std::string path = MyTripLog.FilePath(argv[0]);
+  if (!reader.Open(path))
+    {
+    writer->printf("Error: %s: %s\n", path.c_str(), reader.m_error.c_str());
+    return;
+    }
+
+  char tbuf[32];
+  time_t start = reader.m_header.start;
+  struct tm tm;
+  localtime_r(&start, &tm);
+  strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+  writer->printf("File    : %s\nType    : %s\nStart   : %s (%u)\nInterval: %u ms, max %u rows per block\n",
+    path.c_str(), reader.m_header.type, tbuf, reader.m_header.start,
+    reader.m_header.interval, reader.m_header.rows);
+  writer->puts("Columns :");
+  for (auto& col : reader.m_columns)
+    writer->printf("  %-28s %-8s %u decimals\n", col.name, col.unit, col.decimals);
+
+  uint32_t blocks = 0, rows = 0, raw = 0, stored = 0;
+  while (reader.NextBlock())
+    {
+    if (verbosity > COMMAND_RESULT_SMS)
+      writer->printf("  block %4u: time %u+%us, %u rows, %u -> %u bytes\n", blocks,
+        reader.m_block.time - reader.m_header.start, reader.m_block.rows * reader.m_header.interval / 1000,
+        reader.m_block.rows, reader.m_block.rawsize, reader.m_block.zsize);
+    blocks++;
+    rows += reader.m_block.rows;
+    raw += reader.m_block.rawsize;
+    stored += reader.m_block.zsize;
+    }
+  writer->printf("Data    : %u blocks, %u rows, %u -> %u bytes (%.0f%%)\n",
+    blocks, rows, raw, stored, raw ? 100.0 * stored / raw : 0.0);
+  }
+
+static void triplog_stat(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  TripLogReader reader;
+  std::string path = MyTripLog.FilePath(argv[0]);
+  if (!reader.Open(path))
+    {
+    writer->printf("Error: %s: %s\n", path.c_str(), reader.m_error.c_str());
+    return;
+    }
+
+  uint32_t from = triplog_time((argc > 1) ? argv[1] : "", reader.m_header.start, 0);
+  uint32_t to = triplog_time((argc > 2) ? argv[2] : "", reader.m_header.start, UINT32_MAX);
+  TripLogStats stats;
+  if (!reader.Aggregate(from, to, stats))
+    writer->printf("Warning: %s, result incomplete\n", reader.m_error.empty() ? "read error" : reader.m_error.c_str());
+
+  writer->printf("%-28s %-8s %8s %10s %10s %10s %10s %10s\n",
+    "Metric", "Unit", "Count", "Min", "Max", "Avg", "First", "Last");
+  std::string line;
+  for (int col = 0; col < reader.m_header.columns; col++)
+    {
+    TripLogColumn& c = reader.m_columns[col];
+    TripLogStat& s = stats[col];
+    if (s.count == 0)
+      {
+      writer->printf("%-28s %-8s %8u\n", c.name, c.unit, 0);
+      continue;
+      }
+    std::string vmin, vmax, vavg, vfirst, vlast;
+    triplog_append_value(vmin, s.min, c.decimals);
+    triplog_append_value(vmax, s.max, c.decimals);
+    triplog_append_value(vavg, llround((double)s.sum / s.count), c.decimals);
+    triplog_append_value(vfirst, s.first, c.decimals);
+    triplog_append_value(vlast, s.last, c.decimals);
+    writer->printf("%-28s %-8s %8u %10s %10s %10s %10s %10s\n", c.name, c.unit, s.count,
+      vmin.c_str(), vmax.c_str(), vavg.c_str(), vfirst.c_str(), vlast.c_str());
+    }
+  writer->printf("Blocks: %u from index, %u decoded\n", reader.m_blocks_indexed, reader.m_blocks_decoded);
+  }
+
+static void triplog_export(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  TripLogReader reader;
+  std::string path = MyTripLog.FilePath(argv[0]);
+  if (!reader.Open(path))
+    {
+    writer->printf("Error: %s: %s\n", path.c_str(), reader.m_error.c_str());
+    return;
+    }
+
+  std::string csvpath = (argc > 1) ? std::string(argv[1]) : path;
+  if (argc < 2)
+    {
+    if (endsWith(csvpath, ".otl"))
+      csvpath.resize(csvpath.size() - 4);
+    csvpath.append(".csv");
+    }
+  if (MyConfig.ProtectedPath(csvpath))
+    {
+    writer->printf("Error: protected path '%s'\n", csvpath.c_str());
+    return;
+    }
+  FILE* fp = fopen(csvpath.c_str(), "w");
+  if (!fp)
+    {
+    writer->printf("Error: cannot create '%s'\n", csvpath.c_str());
+    return;
+    }
+
+  std::string line = "time";
+  for (auto& col : reader.m_columns)
+    {
+    line.append(1, ',');
+    line.append(col.name);
+    }
+  line.append(1, '\n');
+  fwrite(line.data(), line.size(), 1, fp);
+
+  uint32_t rowcnt = 0;
+  char tbuf[24];
+  while (reader.NextBlock() && reader.ReadBlockData())
+    {
+    int rows = reader.m_block.rows;
+    for (int row = 0; row < rows; row++)
+      {
+      double t = reader.RowTime(row);
+      snprintf(tbuf, sizeof(tbuf), "%.3f", t);
+      line = tbuf;
+      for (int col = 0; col < reader.m_header.columns; col++)
+        {
+        line.append(1, ',');
+        if (reader.m_defined[col * rows + row])
+          triplog_append_value(line, reader.m_value[col * rows + row], reader.m_columns[col].decimals);
+        }
+      line.append(1, '\n');
+      fwrite(line.data(), line.size(), 1, fp);
+      rowcnt++;
+      }
+    }
+  fclose(fp);
+  writer->printf("Exported %u rows to %s\n", rowcnt, csvpath.c_str());
+  }
+
+
+/**
+ * Web API: /api/triplog[?file=…[&from=…][&to=…]]
+ */
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+
+static void HandleTripLog(PageEntry_t& p, PageContext_t& c)
+  {
+  std::string file = c.getvar("file");
+  std::string json;
+
+  if (file.empty())
+    {
+    // list log files:
+    json = "{\"path\":\"";
+    json_append(json, MyTripLog.m_path);
+    json.append("\",\"running\":");
+    MyTripLog.m_mutex.Lock();
+    if (MyTripLog.m_writer)
+      {
+      json.append("{\"file\":\"");
+      json_append(json, MyTripLog.m_writer->m_path);
+      json.append("\",\"type\":\"");
+      json_append(json, MyTripLog.m_type);
+      json.append("\"}");
+      }
+    else
+      {
+      json.append("null");
+      }
+    MyTripLog.m_mutex.Unlock();
+    json.append(",\"files\":[");
+    DIR* dir = opendir(MyTripLog.m_path.c_str());
+    if (dir)
+      {
+      struct dirent* dp;
+      struct stat st;
+      bool first = true;
+      while ((dp = readdir(dir)) != NULL)
+        {
+        if (!endsWith(dp->d_name, ".otl"))
+          continue;
+        std::string path = MyTripLog.m_path + "/" + dp->d_name;
+        if (stat(path.c_str(), &st) != 0)
+          continue;
+        if (!first)
+          json.append(1, ',');
+        first = false;
+        json.append("{\"name\":\"");
+        json_append(json, std::string(dp->d_name));
+        json.append("\",\"size\":");
+        format_int(json, st.st_size);
+        json.append("}");
+        }
+      closedir(dir);
+      }
+    json.append("]}");
+    }
+  else if (!MyTripLog.GetStatsJSON(json, MyTripLog.FilePath(file), c.getvar("from"), c.getvar("to")))
+    {
+    c.head(404);
+    c.print("ERROR: ");
+    c.print(json);
+    c.done();
+    return;
+    }
+
+  c.head(200,
+    "Content-Type: application/json; charset=utf-8\r\n"
+    "Cache-Control: no-cache");
+  c.print(json);
+  c.done();
+  }
+
+#endif //#ifdef CONFIG_OVMS_COMP_WEBSERVER
+
+
+/**
+ * OvmsTripLog: logger service
+ */
+
+OvmsTripLog::OvmsTripLog()
+  {
+  ESP_LOGI(TAG, "Initialising TRIPLOG (8610)");
+
+  m_task = NULL;
+  m_stop = false;
+  m_writer = NULL;
+  m_enable = false;
+  m_drive = true;
+  m_charge = true;
+  m_interval = 1000;
+  m_rows = 300;
+
+  MyConfig.RegisterParam(TRIPLOG_PARAM, "Trip data logger", true, true);
+
+  OvmsCommand* cmd_triplog = MyCommandApp.RegisterCommand("triplog", "TRIP LOG framework", triplog_status, "", 0, 0);
+  cmd_triplog->RegisterCommand("status", "Show trip logger status", triplog_status);
+  cmd_triplog->RegisterCommand("start", "Start logging to a new file", triplog_start, "[<type>]", 0, 1);
+  cmd_triplog->RegisterCommand("stop", "Stop logging", triplog_stop);
+  cmd_triplog->RegisterCommand("list", "List trip log files", triplog_list, "[<path>]", 0, 1);
+  cmd_triplog->RegisterCommand("info", "Show trip log file structure", triplog_info, "<file>", 1, 1);
+  cmd_triplog->RegisterCommand("stat", "Show trip log statistics", triplog_stat,
+    "<file> [<from>] [<to>]\n"
+    "<from>, <to>: UTC timestamp or offset from log start, e.g. +90, +15m, +1h", 1, 3);
+  cmd_triplog->RegisterCommand("export", "Export trip log to CSV", triplog_export, "<file> [<csvfile>]", 1, 2);
+
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG, "config.mounted", std::bind(&OvmsTripLog::ConfigChanged, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "config.changed", std::bind(&OvmsTripLog::ConfigChanged, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "vehicle.on", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "vehicle.off", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "vehicle.charge.start", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "vehicle.charge.stop", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "sd.unmounting", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "system.shutdown", std::bind(&OvmsTripLog::EventListener, this, _1, _2));
+
+#ifdef CONFIG_OVMS_COMP_WEBSERVER
+  MyWebServer.RegisterPage("/api/triplog", "Trip logs", HandleTripLog, PageMenu_None, PageAuth_Cookie);
+#endif //#ifdef CONFIG_OVMS_COMP_WEBSERVER
+  }
+
+OvmsTripLog::~OvmsTripLog()
+  {
+  Stop();
+  }
+
+void OvmsTripLog::ConfigChanged(std::string event, void* data)
+  {
+  if (event == "config.changed")
+    {
+    OvmsConfigParam* param = (OvmsConfigParam*) data;
+    if (param && param->GetName() != TRIPLOG_PARAM)
+      return;
+    }
+
+  // Note: changes of the log format apply to the next log started
+  OvmsMutexLock lock(&m_mutex);
+  m_enable = MyConfig.GetParamValueBool(TRIPLOG_PARAM, "enable", false);
+  m_drive = MyConfig.GetParamValueBool(TRIPLOG_PARAM, "drive", true);
+  m_charge = MyConfig.GetParamValueBool(TRIPLOG_PARAM, "charge", true);
+  m_path = MyConfig.GetParamValue(TRIPLOG_PARAM, "path", "/sd/triplog");
+  m_metrics = MyConfig.GetParamValue(TRIPLOG_PARAM, "metrics", TRIPLOG_DEFAULT_METRICS);
+  int interval = MyConfig.GetParamValueInt(TRIPLOG_PARAM, "interval", 1000);
+  m_interval = (interval < 100) ? 100 : (interval > 3600000) ? 3600000 : interval;
+  int rows = MyConfig.GetParamValueInt(TRIPLOG_PARAM, "block.rows", 300);
+  m_rows = (rows < 10) ? 10 : (rows > TRIPLOG_MAX_ROWS) ? TRIPLOG_MAX_ROWS : rows;
+  }
+
+void OvmsTripLog::EventListener(std::string event, void* data)
+  {
+  if (event == "vehicle.on")
+    {
+    if (m_enable && m_drive)
+      Start("drive");
+    }
+  else if (event == "vehicle.off")
+    {
+    if (IsRunning() && m_type == "drive")
+      Stop();
+    }
+  else if (event == "vehicle.charge.start")
+    {
+    if (m_enable && m_charge)
+      Start("charge");
+    }
+  else if (event == "vehicle.charge.stop")
+    {
+    if (IsRunning() && m_type == "charge")
+      Stop();
+    }
+  else if (event == "sd.unmounting")
+    {
+    if (IsRunning() && startsWith(m_path, "/sd"))
+      Stop();
+    }
+  else if (event == "system.shutdown")
+    {
+    Stop();
+    }
+  }
+
+std::string OvmsTripLog::FilePath(const std::string& name)
+  {
+  if (name.find('/') != std::string::npos)
+    return name;
+  return m_path + "/" + name;
+  }
+
+bool OvmsTripLog::Start(const std::string& type, OvmsWriter* writer /*=NULL*/)
+  {
+  if (IsRunning())
+    Stop();
+
+  OvmsMutexLock lock(&m_mutex);
+
+  if (!triplog_sd_available(m_path))
+    {
+    ESP_LOGW(TAG, "Start: SD card not available");
+    if (writer) writer->puts("Error: SD card not available");
+    return false;
+    }
+
+  // build columns from metrics list: "<name>[:<decimals>]", separated by ',' or ' '
+  TripLogColumns columns;
+  size_t pos = 0;
+  while (pos < m_metrics.size() && columns.size() < TRIPLOG_MAX_COLUMNS)
+    {
+    size_t end = m_metrics.find_first_of(", ", pos);
+    if (end == std::string::npos)
+      end = m_metrics.size();
+    std::string name = m_metrics.substr(pos, end - pos);
+    pos = end + 1;
+    if (name.empty())
+      continue;
+    int decimals = -1;
+    size_t colon = name.find(':');
+    if (colon != std::string::npos)
+      {
+      decimals = atoi(name.c_str() + colon + 1);
+      if (decimals < 0) decimals = 0;
+      if (decimals > TRIPLOG_MAX_DECIMALS) decimals = TRIPLOG_MAX_DECIMALS;
+      name.resize(colon);
+      }
+    TripLogColumn col;
+    memset(&col, 0, sizeof(col));
+    if (name.size() >= sizeof(col.name))
+      {
+      ESP_LOGW(TAG, "Start: metric name '%s' too long, skipped", name.c_str());
+      continue;
+      }
+    strcpy(col.name, name.c_str());
+    OvmsMetric* metric = MyMetrics.Find(col.name);
+    if (metric)
+      {
+      if (metric->GetValueType() == MetricValueOther)
+        {
+        ESP_LOGW(TAG, "Start: metric '%s' is not numeric, skipped", col.name);
+        continue;
+        }
+      strncpy(col.unit, OvmsMetricUnitLabel(metric->GetUnits()), sizeof(col.unit)-1);
+      if (decimals < 0)
+        decimals = (metric->GetValueType() == MetricValueFloat) ? 2 : 0;
+      }
+    col.decimals = (decimals < 0) ? 2 : decimals;
+    columns.push_back(col);
+    }
+  if (columns.empty())
+    {
+    ESP_LOGW(TAG, "Start: no metrics configured");
+    if (writer) writer->puts("Error: no metrics configured");
+    return false;
+    }
+
+  // create file:
+  mkpath(m_path);
+  char name[32];
+  time_t now = time(NULL);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm);
+  std::string path = m_path + "/" + name + "-" + type + ".otl";
+  m_writer = new TripLogWriter();
+  if (!m_writer->Open(path, type.c_str(), m_interval, m_rows, columns))
+    {
+    delete m_writer;
+    m_writer = NULL;
+    if (writer) writer->printf("Error: cannot create log file '%s'\n", path.c_str());
+    return false;
+    }
+
+  m_type = type;
+  m_columns = columns;
+  m_stop = false;
+  if (xTaskCreatePinnedToCore(LoggerTask, "OVMS TripLog", TRIPLOG_TASK_STACK, (void*)this,
+      TRIPLOG_TASK_PRIORITY, &m_task, CORE(1)) != pdPASS)
+    {
+    ESP_LOGE(TAG, "Start: cannot create task");
+    m_task = NULL;
+    delete m_writer;
+    m_writer = NULL;
+    if (writer) writer->puts("Error: cannot create logger task");
+    return false;
+    }
+
+  ESP_LOGI(TAG, "Started %s log '%s': %d columns, %u ms interval", type.c_str(), path.c_str(),
+    columns.size(), m_interval);
+  if (writer) writer->printf("Logging %d metrics every %u ms to %s\n", columns.size(), m_interval, path.c_str());
+  return true;
+  }
+
+void OvmsTripLog::Stop()
+  {
+  TaskHandle_t task = m_task;
+  if (!task)
+    return;
+  m_stop = true;
+  xTaskNotifyGive(task);
+  // wait for the final block to be written:
+  for (int i = 0; m_task && i < 500; i++)
+    vTaskDelay(pdMS_TO_TICKS(20));
+  if (m_task)
+    ESP_LOGE(TAG, "Stop: logger task did not terminate");
+  }
+
+void OvmsTripLog::LoggerTask(void* object)
+  {
+  OvmsTripLog* me = (OvmsTripLog*) object;
+  me->Logger();
+  vTaskDelete(NULL);
+  }
+
+void OvmsTripLog::Logger()
+  {
+  int ncols = m_columns.size();
+  std::vector<double> scale(ncols);
+  for (int col = 0; col < ncols; col++)
+    scale[col] = pow(10, m_columns[col].decimals);
+
+  int32_t value[TRIPLOG_MAX_COLUMNS];
+  bool defined[TRIPLOG_MAX_COLUMNS];
+  TickType_t period = pdMS_TO_TICKS(m_interval);
+  if (period == 0) period = 1;
+  TickType_t next = xTaskGetTickCount();
+
+  while (!m_stop)
+    {
+    for (int col = 0; col < ncols; col++)
+      {
+      OvmsMetric* metric = MyMetrics.Find(m_columns[col].name);
+      defined[col] = (metric && metric->IsDefined() && !metric->IsStale());
+      if (defined[col])
+        {
+        double v = round(metric->AsFloat() * scale[col]);
+        value[col] = (v > INT32_MAX) ? INT32_MAX : (v < -INT32_MAX) ? -INT32_MAX : (int32_t)v;
+        }
+      else
+        {
+        value[col] = 0;
+        }
+      }
+
+    m_mutex.Lock();
+    m_writer->AddRow(value, defined);
+    bool failed = !m_writer->IsOpen();
+    m_mutex.Unlock();
+    if (failed)
+      break;
+
+    // fixed rate: wait for the next period; on overrun, record the
+    // periods missed as undefined rows to keep the row times in sync
+    next += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(next - now) > 0)
+      {
+      ulTaskNotifyTake(pdTRUE, next - now);
+      }
+    else
+      {
+      TickType_t skipped = (now - next) / period;
+      if (skipped > 0)
+        {
+        next += skipped * period;
+        m_mutex.Lock();
+        m_writer->SkipRows(skipped > TRIPLOG_MAX_ROWS ? TRIPLOG_MAX_ROWS : skipped);
+        failed = !m_writer->IsOpen();
+        m_mutex.Unlock();
+        if (failed)
+          break;
+        }
+      }
+    }
+
+  m_mutex.Lock();
+  m_writer->Close();
+  ESP_LOGI(TAG, "Stopped %s log '%s': %u rows, %u blocks, %u bytes (%u raw)", m_type.c_str(),
+    m_writer->m_path.c_str(), m_writer->m_rows_total, m_writer->m_blocks,
+    m_writer->m_bytes_written, m_writer->m_bytes_raw);
+  delete m_writer;
+  m_writer = NULL;
+  m_task = NULL;
+  m_mutex.Unlock();
+  }
+
+void OvmsTripLog::Status(OvmsWriter* writer)
+  {
+  OvmsMutexLock lock(&m_mutex);
+  writer->printf("Auto start : %s (drive: %s, charge: %s)\n", m_enable ? "enabled" : "disabled",
+    m_drive ? "yes" : "no", m_charge ? "yes" : "no");
+  writer->printf("Log format : %u ms interval, %d rows per block, path %s\n", m_interval, m_rows, m_path.c_str());
+  writer->printf("Metrics    : %s\n", m_metrics.c_str());
+  if (!m_writer)
+    {
+    writer->puts("Logging    : stopped");
+    return;
+    }
+  writer->printf("Logging    : %s to %s\n", m_type.c_str(), m_writer->m_path.c_str());
+  writer->printf("Written    : %u rows, %u blocks, %u bytes (data compressed %u -> %u bytes)\n",
+    m_writer->m_rows_total, m_writer->m_blocks, m_writer->m_bytes_written,
+    m_writer->m_bytes_raw, m_writer->m_bytes_written);
+  }
+
+bool OvmsTripLog::GetStatsJSON(std::string& buf, const std::string& path, const std::string& from, const std::string& to)
+  {
+  TripLogReader reader;
+  if (!reader.Open(path))
+    {
+    buf = reader.m_error;
+    return false;
+    }
+  uint32_t tfrom = triplog_time(from, reader.m_header.start, 0);
+  uint32_t tto = triplog_time(to, reader.m_header.start, UINT32_MAX);
+  TripLogStats stats;
+  bool complete = reader.Aggregate(tfrom, tto, stats);
+
+  buf.append("{\"file\":\"");
+  json_append(buf, path);
+  buf.append("\",\"type\":\"");
+  json_append(buf, std::string(reader.m_header.type, strnlen(reader.m_header.type, sizeof(reader.m_header.type))));
+  buf.append("\",\"start\":");
+  format_int(buf, reader.m_header.start);
+  buf.append(",\"interval\":");
+  format_int(buf, reader.m_header.interval);
+  buf.append(",\"from\":");
+  format_int(buf, tfrom);
+  buf.append(",\"to\":");
+  if (tto == UINT32_MAX)
+    buf.append("null");
+  else
+    format_int(buf, tto);
+  buf.append(",\"complete\":");
+  buf.append(complete ? "true" : "false");
+  buf.append(",\"blocks\":{\"indexed\":");
+  format_int(buf, reader.m_blocks_indexed);
+  buf.append(",\"decoded\":");
+  format_int(buf, reader.m_blocks_decoded);
+  buf.append("},\"columns\":[");
+  for (int col = 0; col < reader.m_header.columns; col++)
+    {
+    TripLogColumn& c = reader.m_columns[col];
+    TripLogStat& s = stats[col];
+    if (col) buf.append(1, ',');
+    buf.append("{\"metric\":\"");
+    json_append(buf, std::string(c.name));
+    buf.append("\",\"unit\":\"");
+    json_append(buf, std::string(c.unit));
+    buf.append("\",\"count\":");
+    format_int(buf, s.count);
+    if (s.count)
+      {
+      buf.append(",\"min\":");
+      triplog_append_value(buf, s.min, c.decimals);
+      buf.append(",\"max\":");
+      triplog_append_value(buf, s.max, c.decimals);
+      buf.append(",\"avg\":");
+      triplog_append_value(buf, llround((double)s.sum / s.count), c.decimals);
+      buf.append(",\"first\":");
+      triplog_append_value(buf, s.first, c.decimals);
+      buf.append(",\"last\":");
+      triplog_append_value(buf, s.last, c.decimals);
+      }
+    buf.append("}");
+    }
+  buf.append("]}");
+  return true;
+  }
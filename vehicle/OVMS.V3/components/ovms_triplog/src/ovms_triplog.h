@@ -0,0 +1,250 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __OVMS_TRIPLOG_H__
+#define __OVMS_TRIPLOG_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ovms_metrics.h"
+#include "ovms_command.h"
+#include "ovms_mutex.h"
+
+/**
+ * Trip logger: samples a set of metrics at a fixed rate into columnar,
+ * block compressed files (extension .otl) on the SD card.
+ *
+ * File layout (little endian):
+ *   TripLogFileHeader
+ *   TripLogColumn [columns]
+ *   blocks:
+ *     TripLogBlockHeader
+ *     TripLogColumnIndex [columns]    -- per column statistics of the block
+ *     payload [zsize]                 -- zlib stream (or raw, see flags)
+ *
+ * Payload per column: presence bitmap (1 bit per row), then the defined values
+ * as zigzag varint deltas of the scaled integers (value * 10^decimals).
+ * Row times are block time + row * interval; periods missed by the logger are
+ * stored as undefined rows.
+ * The column indexes allow aggregating full blocks without decompression.
+ */
+
+#define TRIPLOG_MAGIC_FILE        "OVTL"
+#define TRIPLOG_MAGIC_BLOCK       "BLK1"
+#define TRIPLOG_VERSION           1
+#define TRIPLOG_MAX_COLUMNS       32
+#define TRIPLOG_MAX_ROWS          3600
+#define TRIPLOG_MAX_DECIMALS      6
+#define TRIPLOG_BLOCK_COMPRESSED  0x0001        // block flag: payload is zlib compressed
+
+#define TRIPLOG_ZLIB_LEVEL        6
+#define TRIPLOG_ZLIB_WBITS        12            // 4 KB window
+#define TRIPLOG_ZLIB_MEMLEVEL     5
+
+struct TripLogFileHeader          // 32 bytes
+  {
+  char      magic[4];             // "OVTL"
+  uint8_t   version;
+  uint8_t   columns;
+  uint16_t  rows;                 // max rows per block
+  uint32_t  interval;             // sampling interval [ms]
+  uint32_t  start;                // UTC time of log start
+  char      type[16];             // "drive", "charge", "manual"
+  };
+
+struct TripLogColumn              // 48 bytes
+  {
+  char      name[32];             // metric name
+  char      unit[12];             // metric unit label
+  uint8_t   decimals;             // value scaling: 10^decimals
+  uint8_t   reserved[3];
+  };
+
+struct TripLogBlockHeader         // 24 bytes
+  {
+  char      magic[4];             // "BLK1"
+  uint32_t  time;                 // UTC time of first row [s]
+  uint16_t  time_ms;              // … [ms]
+  uint16_t  rows;
+  uint32_t  rawsize;              // uncompressed payload size
+  uint32_t  zsize;                // stored payload size
+  uint16_t  flags;
+  uint16_t  reserved;
+  };
+
+struct TripLogColumnIndex         // 32 bytes
+  {
+  int64_t   sum;
+  int32_t   min;
+  int32_t   max;
+  int32_t   first;
+  int32_t   last;
+  uint16_t  count;                // number of rows with defined value
+  uint16_t  reserved;
+  uint32_t  reserved2;
+  };
+
+struct TripLogStat
+  {
+  uint32_t  count = 0;
+  int64_t   sum = 0;
+  int32_t   min = 0;
+  int32_t   max = 0;
+  int32_t   first = 0;
+  int32_t   last = 0;
+
+  void Add(int32_t value);
+  void Merge(const TripLogColumnIndex& index);
+  };
+
+typedef std::vector<TripLogColumn> TripLogColumns;
+typedef std::vector<TripLogStat> TripLogStats;
+
+struct z_stream_s;
+
+class TripLogWriter
+  {
+  public:
+    TripLogWriter();
+    ~TripLogWriter();
+
+  public:
+    bool Open(const std::string& path, const char* type, uint32_t interval, int rows,
+      const TripLogColumns& columns);
+    void AddRow(const int32_t* value, const bool* defined);
+    void SkipRows(int count);
+    bool Flush();
+    void Close();
+    bool IsOpen() { return m_fp != NULL; }
+
+  public:
+    std::string     m_path;
+    uint32_t        m_rows_total;
+    uint32_t        m_blocks;
+    uint32_t        m_bytes_raw;
+    uint32_t        m_bytes_written;
+
+  protected:
+    FILE*           m_fp;
+    z_stream_s*     m_zs;
+    int             m_columns;
+    int             m_rows;
+    int             m_rowcnt;
+    uint32_t        m_interval;
+    uint32_t        m_blocktime;
+    uint16_t        m_blocktime_ms;
+    int32_t*        m_value;            // column major: [col * m_rows + row]
+    uint8_t*        m_defined;          // presence bitmaps, column major
+    TripLogColumnIndex* m_index;
+    uint8_t*        m_raw;
+    size_t          m_rawsize;
+    uint8_t*        m_zbuf;
+    size_t          m_zsize;
+  };
+
+class TripLogReader
+  {
+  public:
+    TripLogReader();
+    ~TripLogReader();
+
+  public:
+    bool Open(const std::string& path);
+    void Close();
+    bool NextBlock();
+    bool ReadBlockData();
+    bool Aggregate(uint32_t from, uint32_t to, TripLogStats& stats);
+    double RowTime(int row);
+    uint32_t BlockEndTime();
+
+  public:
+    TripLogFileHeader       m_header;
+    TripLogColumns          m_columns;
+    TripLogBlockHeader      m_block;
+    std::vector<TripLogColumnIndex> m_index;
+    std::vector<int32_t>    m_value;          // decoded block data, column major
+    std::vector<uint8_t>    m_defined;        // … presence flags
+    uint32_t                m_blocks_indexed;
+    uint32_t                m_blocks_decoded;
+    std::string             m_error;
+
+  protected:
+    FILE*           m_fp;
+    z_stream_s*     m_zs;
+    bool            m_datapending;
+  };
+
+extern void triplog_append_value(std::string& buf, int64_t value, int decimals);
+
+class OvmsTripLog
+  {
+  public:
+    OvmsTripLog();
+    ~OvmsTripLog();
+
+  public:
+    void ConfigChanged(std::string event, void* data);
+    void EventListener(std::string event, void* data);
+    bool Start(const std::string& type, OvmsWriter* writer=NULL);
+    void Stop();
+    bool IsRunning() { return m_task != NULL; }
+    void Status(OvmsWriter* writer);
+    bool GetStatsJSON(std::string& buf, const std::string& path, const std::string& from, const std::string& to);
+    std::string FilePath(const std::string& name);
+
+  protected:
+    static void LoggerTask(void* object);
+    void Logger();
+
+  public:
+    OvmsMutex           m_mutex;
+    TaskHandle_t        m_task;
+    volatile bool       m_stop;
+    TripLogWriter*      m_writer;
+    std::string         m_type;
+    TripLogColumns      m_columns;      // columns of the running log
+
+    // configuration:
+    bool                m_enable;
+    bool                m_drive;
+    bool                m_charge;
+    std::string         m_path;
+    uint32_t            m_interval;
+    int                 m_rows;
+    std::string         m_metrics;      // "<name>[:<decimals>],…"
+  };
+
+extern OvmsTripLog MyTripLog;
+
+#endif //#ifndef __OVMS_TRIPLOG_H__
@@ -0,0 +1,653 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "triplog";
+
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include "ovms_triplog.h"
+#include "ovms_malloc.h"
+#include "ovms_utils.h"
+
+#include "zlib.h"
+
+
+/**
+ * zlib memory allocation: keep the compression state out of internal RAM
+ */
+static voidpf zalloc_extram(voidpf opaque, uInt items, uInt size)
+  {
+  return ExternalRamMalloc(items * size);
+  }
+
+static void zfree_extram(voidpf opaque, voidpf address)
+  {
+  free(address);
+  }
+
+
+/**
+ * Value encoding: zigzag LEB128 varints
+ */
+static inline int put_varint(uint8_t* dst, uint64_t v)
+  {
+  int len = 0;
+  while (v >= 0x80)
+    {
+    dst[len++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+    }
+  dst[len++] = (uint8_t)v;
+  return len;
+  }
+
+static inline bool get_varint(const uint8_t*& src, const uint8_t* end, uint64_t& v)
+  {
+  v = 0;
+  for (int shift = 0; src < end && shift < 64; shift += 7)
+    {
+    uint8_t b = *src++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0)
+      return true;
+    }
+  return false;
+  }
+
+static inline uint64_t zigzag(int64_t v)
+  {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  }
+
+static inline int64_t unzigzag(uint64_t v)
+  {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  }
+
+
+/**
+ * triplog_append_value: append scaled integer as decimal number
+ */
+void triplog_append_value(std::string& buf, int64_t value, int decimals)
+  {
+  char tmp[32];
+  uint64_t av = (value < 0) ? -value : value;
+  if (decimals <= 0)
+    {
+    snprintf(tmp, sizeof(tmp), "%s%llu", (value < 0) ? "-" : "", (unsigned long long)av);
+    }
+  else
+    {
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; i++)
+      scale *= 10;
+    snprintf(tmp, sizeof(tmp), "%s%llu.%0*llu", (value < 0) ? "-" : "",
+      (unsigned long long)(av / scale), decimals, (unsigned long long)(av % scale));
+    }
+  buf.append(tmp);
+  }
+
+
+/**
+ * TripLogStat: aggregation of a column
+ */
+void TripLogStat::Add(int32_t value)
+  {
+  if (count == 0)
+    {
+    min = max = first = value;
+    }
+  else
+    {
+    if (value < min) min = value;
+    if (value > max) max = value;
+    }
+  last = value;
+  sum += value;
+  count++;
+  }
+
+void TripLogStat::Merge(const TripLogColumnIndex& index)
+  {
+  if (index.count == 0)
+    return;
+  if (count == 0)
+    {
+    min = index.min;
+    max = index.max;
+    first = index.first;
+    }
+  else
+    {
+    if (index.min < min) min = index.min;
+    if (index.max > max) max = index.max;
+    }
+  last = index.last;
+  sum += index.sum;
+  count += index.count;
+  }
+
+
+/**
+ * TripLogWriter: collects rows in memory, writes one compressed block per
+ *  m_rows rows, so the SD card sees few larger writes.
+ */
+TripLogWriter::TripLogWriter()
+  {
+  m_rows_total = 0;
+  m_blocks = 0;
+  m_bytes_raw = 0;
+  m_bytes_written = 0;
+  m_fp = NULL;
+  m_zs = NULL;
+  m_columns = 0;
+  m_rows = 0;
+  m_rowcnt = 0;
+  m_interval = 0;
+  m_blocktime = 0;
+  m_blocktime_ms = 0;
+  m_value = NULL;
+  m_defined = NULL;
+  m_index = NULL;
+  m_raw = NULL;
+  m_rawsize = 0;
+  m_zbuf = NULL;
+  m_zsize = 0;
+  }
+
+TripLogWriter::~TripLogWriter()
+  {
+  Close();
+  }
+
+bool TripLogWriter::Open(const std::string& path, const char* type, uint32_t interval, int rows,
+  const TripLogColumns& columns)
+  {
+  Close();
+  if (columns.empty() || columns.size() > TRIPLOG_MAX_COLUMNS || rows < 1 || rows > TRIPLOG_MAX_ROWS)
+    return false;
+
+  m_path = path;
+  m_columns = columns.size();
+  m_rows = rows;
+  m_rowcnt = 0;
+  m_interval = interval;
+  m_rows_total = m_blocks = m_bytes_raw = m_bytes_written = 0;
+
+  // buffers (SPIRAM):
+  int bmsize = (m_rows + 7) / 8;
+  m_rawsize = m_columns * (bmsize + m_rows * 5);
+  m_value = (int32_t*) ExternalRamMalloc(m_columns * m_rows * sizeof(int32_t));
+  m_defined = (uint8_t*) ExternalRamCalloc(m_columns, bmsize);
+  m_index = (TripLogColumnIndex*) ExternalRamCalloc(m_columns, sizeof(TripLogColumnIndex));
+  m_raw = (uint8_t*) ExternalRamMalloc(m_rawsize);
+  m_zs = (z_stream*) ExternalRamCalloc(1, sizeof(z_stream));
+  if (!m_value || !m_defined || !m_index || !m_raw || !m_zs)
+    {
+    ESP_LOGE(TAG, "Open: out of memory");
+    Close();
+    return false;
+    }
+
+  m_zs->zalloc = zalloc_extram;
+  m_zs->zfree = zfree_extram;
+  m_zs->opaque = NULL;
+  if (deflateInit2(m_zs, TRIPLOG_ZLIB_LEVEL, Z_DEFLATED, TRIPLOG_ZLIB_WBITS, TRIPLOG_ZLIB_MEMLEVEL,
+      Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+    ESP_LOGE(TAG, "Open: zlib init failed");
+    free(m_zs);
+    m_zs = NULL;
+    Close();
+    return false;
+    }
+  m_zsize = deflateBound(m_zs, m_rawsize);
+  m_zbuf = (uint8_t*) ExternalRamMalloc(m_zsize);
+  if (!m_zbuf)
+    {
+    ESP_LOGE(TAG, "Open: out of memory");
+    Close();
+    return false;
+    }
+
+  m_fp = fopen(path.c_str(), "w");
+  if (!m_fp)
+    {
+    ESP_LOGE(TAG, "Open: cannot create '%s'", path.c_str());
+    Close();
+    return false;
+    }
+
+  TripLogFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, TRIPLOG_MAGIC_FILE, 4);
+  hdr.version = TRIPLOG_VERSION;
+  hdr.columns = m_columns;
+  hdr.rows = m_rows;
+  hdr.interval = m_interval;
+  hdr.start = time(NULL);
+  strncpy(hdr.type, type, sizeof(hdr.type)-1);
+  if (fwrite(&hdr, sizeof(hdr), 1, m_fp) != 1
+    || fwrite(columns.data(), sizeof(TripLogColumn), m_columns, m_fp) != (size_t)m_columns)
+    {
+    ESP_LOGE(TAG, "Open: write error on '%s'", path.c_str());
+    Close();
+    return false;
+    }
+  fflush(m_fp);
+  m_bytes_written = sizeof(hdr) + m_columns * sizeof(TripLogColumn);
+  return true;
+  }
+
+void TripLogWriter::AddRow(const int32_t* value, const bool* defined)
+  {
+  if (!m_fp)
+    return;
+
+  if (m_rowcnt == 0)
+    {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    m_blocktime = tv.tv_sec;
+    m_blocktime_ms = tv.tv_usec / 1000;
+    }
+
+  int bmsize = (m_rows + 7) / 8;
+  for (int col = 0; col < m_columns; col++)
+    {
+    m_value[col * m_rows + m_rowcnt] = value[col];
+    if (defined[col])
+      m_defined[col * bmsize + m_rowcnt / 8] |= (1 << (m_rowcnt % 8));
+    }
+
+  m_rows_total++;
+  if (++m_rowcnt == m_rows)
+    Flush();
+  }
+
+bool TripLogWriter::Flush()
+  {
+  if (!m_fp || m_rowcnt == 0)
+    return true;
+
+  // encode columns & build block index:
+  int bmsize = (m_rows + 7) / 8;
+  int bmused = (m_rowcnt + 7) / 8;
+  uint8_t* p = m_raw;
+  for (int col = 0; col < m_columns; col++)
+    {
+    const int32_t* value = &m_value[col * m_rows];
+    uint8_t* defined = &m_defined[col * bmsize];
+    TripLogColumnIndex& index = m_index[col];
+    memset(&index, 0, sizeof(index));
+    memcpy(p, defined, bmused);
+    p += bmused;
+    int32_t last = 0;
+    for (int row = 0; row < m_rowcnt; row++)
+      {
+      if ((defined[row / 8] & (1 << (row % 8))) == 0)
+        continue;
+      int32_t v = value[row];
+      p += put_varint(p, zigzag((int64_t)v - last));
+      last = v;
+      if (index.count == 0)
+        {
+        index.min = index.max = index.first = v;
+        }
+      else
+        {
+        if (v < index.min) index.min = v;
+        if (v > index.max) index.max = v;
+        }
+      index.last = v;
+      index.sum += v;
+      index.count++;
+      }
+    memset(defined, 0, bmsize);
+    }
+
+  TripLogBlockHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, TRIPLOG_MAGIC_BLOCK, 4);
+  hdr.time = m_blocktime;
+  hdr.time_ms = m_blocktime_ms;
+  hdr.rows = m_rowcnt;
+  hdr.rawsize = p - m_raw;
+
+  // compress, store raw if that doesn't help:
+  const uint8_t* payload = m_raw;
+  hdr.zsize = hdr.rawsize;
+  deflateReset(m_zs);
+  m_zs->next_in = m_raw;
+  m_zs->avail_in = hdr.rawsize;
+  m_zs->next_out = m_zbuf;
+  m_zs->avail_out = m_zsize;
+  if (deflate(m_zs, Z_FINISH) == Z_STREAM_END && m_zs->total_out < hdr.rawsize)
+    {
+    payload = m_zbuf;
+    hdr.zsize = m_zs->total_out;
+    hdr.flags |= TRIPLOG_BLOCK_COMPRESSED;
+    }
+
+  m_rowcnt = 0;
+  bool ok = (fwrite(&hdr, sizeof(hdr), 1, m_fp) == 1
+    && fwrite(m_index, sizeof(TripLogColumnIndex), m_columns, m_fp) == (size_t)m_columns
+    && fwrite(payload, hdr.zsize, 1, m_fp) == 1
+    && fflush(m_fp) == 0);
+  if (!ok)
+    {
+    ESP_LOGE(TAG, "Flush: write error on '%s', log stopped", m_path.c_str());
+    fclose(m_fp);
+    m_fp = NULL;
+    return false;
+    }
+  fsync(fileno(m_fp));
+
+  m_blocks++;
+  m_bytes_raw += hdr.rawsize;
+  m_bytes_written += sizeof(hdr) + m_columns * sizeof(TripLogColumnIndex) + hdr.zsize;
+  ESP_LOGD(TAG, "Flush: block %u, %u rows, %u -> %u bytes", m_blocks, hdr.rows, hdr.rawsize, hdr.zsize);
+  return true;
+  }
+
+/**
+ * SkipRows: account for periods not sampled (logger overrun) as undefined rows,
+ *  so the row times of the current block stay on the interval grid.
+ *  Not needed at a block start, as a new block takes the actual time.
+ */
+void TripLogWriter::SkipRows(int count)
+  {
+  if (!m_fp || m_rowcnt == 0 || count <= 0)
+    return;
+  if (count > m_rows - m_rowcnt)
+    count = m_rows - m_rowcnt;
+  m_rowcnt += count;
+  m_rows_total += count;
+  if (m_rowcnt == m_rows)
+    Flush();
+  }
+
+void TripLogWriter::Close()
+  {
+  if (m_fp)
+    {
+    Flush();
+    if (m_fp)
+      fclose(m_fp);
+    m_fp = NULL;
+    }
+  if (m_zs)
+    {
+    deflateEnd(m_zs);
+    free(m_zs);
+    m_zs = NULL;
+    }
+  if (m_value) { free(m_value); m_value = NULL; }
+  if (m_defined) { free(m_defined); m_defined = NULL; }
+  if (m_index) { free(m_index); m_index = NULL; }
+  if (m_raw) { free(m_raw); m_raw = NULL; }
+  if (m_zbuf) { free(m_zbuf); m_zbuf = NULL; }
+  }
+
+
+/**
+ * TripLogReader: sequential block access, decodes block data on demand
+ */
+TripLogReader::TripLogReader()
+  {
+  memset(&m_header, 0, sizeof(m_header));
+  memset(&m_block, 0, sizeof(m_block));
+  m_blocks_indexed = 0;
+  m_blocks_decoded = 0;
+  m_fp = NULL;
+  m_zs = NULL;
+  m_datapending = false;
+  }
+
+TripLogReader::~TripLogReader()
+  {
+  Close();
+  }
+
+bool TripLogReader::Open(const std::string& path)
+  {
+  Close();
+  m_fp = fopen(path.c_str(), "r");
+  if (!m_fp)
+    {
+    m_error = "cannot open file";
+    return false;
+    }
+  if (fread(&m_header, sizeof(m_header), 1, m_fp) != 1
+    || memcmp(m_header.magic, TRIPLOG_MAGIC_FILE, 4) != 0
+    || m_header.version != TRIPLOG_VERSION
+    || m_header.columns == 0 || m_header.columns > TRIPLOG_MAX_COLUMNS
+    || m_header.rows == 0 || m_header.rows > TRIPLOG_MAX_ROWS)
+    {
+    m_error = "not a trip log file";
+    Close();
+    return false;
+    }
+  m_columns.resize(m_header.columns);
+  if (fread(m_columns.data(), sizeof(TripLogColumn), m_header.columns, m_fp) != m_header.columns)
+    {
+    m_error = "file truncated";
+    Close();
+    return false;
+    }
+  for (auto& col : m_columns)
+    {
+    col.name[sizeof(col.name)-1] = 0;
+    col.unit[sizeof(col.unit)-1] = 0;
+    }
+  m_index.resize(m_header.columns);
+  m_blocks_indexed = m_blocks_decoded = 0;
+  m_datapending = false;
+  return true;
+  }
+
+void TripLogReader::Close()
+  {
+  if (m_fp)
+    {
+    fclose(m_fp);
+    m_fp = NULL;
+    }
+  if (m_zs)
+    {
+    inflateEnd(m_zs);
+    free(m_zs);
+    m_zs = NULL;
+    }
+  }
+
+/**
+ * NextBlock: read the next block header & index, skips the data of the current block
+ */
+bool TripLogReader::NextBlock()
+  {
+  if (!m_fp)
+    return false;
+  if (m_datapending && fseek(m_fp, m_block.zsize, SEEK_CUR) != 0)
+    return false;
+  m_datapending = false;
+  if (fread(&m_block, sizeof(m_block), 1, m_fp) != 1
+    || memcmp(m_block.magic, TRIPLOG_MAGIC_BLOCK, 4) != 0
+    || m_block.rows == 0 || m_block.rows > m_header.rows
+    || fread(m_index.data(), sizeof(TripLogColumnIndex), m_header.columns, m_fp) != m_header.columns)
+    return false;
+
+  // check the sizes before using them for buffer allocations:
+  uint32_t maxraw = m_header.columns * ((m_block.rows + 7) / 8 + m_block.rows * 5);
+  uint32_t maxz = (m_block.flags & TRIPLOG_BLOCK_COMPRESSED)
+    ? deflateBound(Z_NULL, m_block.rawsize) : m_block.rawsize;
+  if (m_block.rawsize > maxraw || m_block.zsize > maxz)
+    {
+    m_error = "data corrupted";
+    return false;
+    }
+
+  m_datapending = true;
+  return true;
+  }
+
+/**
+ * ReadBlockData: load & decode the current block data into m_value / m_defined
+ */
+bool TripLogReader::ReadBlockData()
+  {
+  if (!m_datapending)
+    return false;
+  m_datapending = false;
+
+  std::vector<uint8_t> zbuf(m_block.zsize);
+  if (fread(zbuf.data(), m_block.zsize, 1, m_fp) != 1)
+    return false;
+
+  std::vector<uint8_t> rawbuf;
+  const uint8_t* raw = zbuf.data();
+  if (m_block.flags & TRIPLOG_BLOCK_COMPRESSED)
+    {
+    if (!m_zs)
+      {
+      m_zs = (z_stream*) ExternalRamCalloc(1, sizeof(z_stream));
+      if (!m_zs)
+        return false;
+      m_zs->zalloc = zalloc_extram;
+      m_zs->zfree = zfree_extram;
+      if (inflateInit(m_zs) != Z_OK)
+        {
+        free(m_zs);
+        m_zs = NULL;
+        return false;
+        }
+      }
+    else
+      {
+      inflateReset(m_zs);
+      }
+    rawbuf.resize(m_block.rawsize);
+    m_zs->next_in = zbuf.data();
+    m_zs->avail_in = m_block.zsize;
+    m_zs->next_out = rawbuf.data();
+    m_zs->avail_out = m_block.rawsize;
+    if (inflate(m_zs, Z_FINISH) != Z_STREAM_END)
+      {
+      m_error = "data corrupted";
+      return false;
+      }
+    raw = rawbuf.data();
+    }
+
+  // decode columns:
+  int rows = m_block.rows;
+  int bmused = (rows + 7) / 8;
+  const uint8_t* p = raw;
+  const uint8_t* end = raw + m_block.rawsize;
+  uint64_t v;
+  m_value.assign(m_header.columns * rows, 0);
+  m_defined.assign(m_header.columns * rows, 0);
+  for (int col = 0; col < m_header.columns; col++)
+    {
+    if (p + bmused > end)
+      return false;
+    const uint8_t* bitmap = p;
+    p += bmused;
+    int32_t last = 0;
+    for (int row = 0; row < rows; row++)
+      {
+      if ((bitmap[row / 8] & (1 << (row % 8))) == 0)
+        continue;
+      if (!get_varint(p, end, v))
+        return false;
+      last += unzigzag(v);
+      m_value[col * rows + row] = last;
+      m_defined[col * rows + row] = 1;
+      }
+    }
+
+  m_blocks_decoded++;
+  return true;
+  }
+
+double TripLogReader::RowTime(int row)
+  {
+  return m_block.time + (m_block.time_ms + (double)row * m_header.interval) / 1000;
+  }
+
+uint32_t TripLogReader::BlockEndTime()
+  {
+  return (uint32_t) RowTime(m_block.rows - 1);
+  }
+
+/**
+ * Aggregate: compute column statistics for the time range [from, to] (UTC seconds)
+ *  Blocks completely inside the range are aggregated from their index, only
+ *  blocks crossing the range borders need to be decoded.
+ */
+bool TripLogReader::Aggregate(uint32_t from, uint32_t to, TripLogStats& stats)
+  {
+  stats.assign(m_header.columns, TripLogStat());
+  while (NextBlock())
+    {
+    uint32_t end = BlockEndTime();
+    if (end < from)
+      continue;
+    if (m_block.time > to)
+      break;
+    if (m_block.time >= from && end <= to)
+      {
+      for (int col = 0; col < m_header.columns; col++)
+        stats[col].Merge(m_index[col]);
+      m_blocks_indexed++;
+      continue;
+      }
+    if (!ReadBlockData())
+      return false;
+    int rows = m_block.rows;
+    for (int row = 0; row < rows; row++)
+      {
+      uint32_t t = (uint32_t) RowTime(row);
+      if (t < from || t > to)
+        continue;
+      for (int col = 0; col < m_header.columns; col++)
+        {
+        if (m_defined[col * rows + row])
+          stats[col].Add(m_value[col * rows + row]);
+        }
+      }
+    }
+  return true;
+  }
@@ -36,6 +36,7 @@ static const char *TAG = "webcommand";
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include "esp_timer.h"
 #include "buffered_shell.h"
 #include "log_buffers.h"
 #include "ovms_webserver.h"
@@ -50,7 +51,7 @@ struct hcs_writebuf
 
 
 HttpCommandStream::HttpCommandStream(mg_connection* nc, extram::string command,
-    bool javascript /*=false*/, int verbosity /*=COMMAND_RESULT_NORMAL*/)
+    bool javascript /*=false*/, int verbosity /*=COMMAND_RESULT_NORMAL*/, z_stream_s* deflate /*=NULL*/)
   : OvmsShell(verbosity), MgHandler(nc)
   // Note: due to a gcc bug, the base classes MUST be done in this order,
   //  or compilation will fail with "error: generic thunk code fails for method […] printf".
@@ -65,14 +66,13 @@ HttpCommandStream::HttpCommandStream(mg_connection* nc, extram::string command,
   m_javascript = javascript;
   m_done = false;
   m_sent = m_ack = 0;
+  m_deflate = deflate; // gzip stream, owned by the handler from now on
   Initialize(false);
   SetSecure(true); // Note: assuming user is admin
 
-  // create write queue & command task:
+  // create write queue, the command is executed by the pool (see Submit()):
   m_writequeue = xQueueCreate(30, sizeof(hcs_writebuf));
-  char name[configMAX_TASK_NAME_LEN];
-  snprintf(name, sizeof(name), "%s", command.c_str());
-  xTaskCreatePinnedToCore(CommandTask, name, CONFIG_OVMS_SYS_COMMAND_STACK_SIZE, (void*)this, 4, &m_cmdtask, CORE(1));
+  m_refs = 2;
 }
 
 HttpCommandStream::~HttpCommandStream()
@@ -83,6 +83,7 @@ HttpCommandStream::~HttpCommandStream()
       free(wbuf.data);
     vQueueDelete(m_writequeue);
   }
+  OvmsWebServer::DeflateEnd(m_deflate);
 }
 
 
@@ -95,40 +96,49 @@ void HttpCommandStream::Initialize(bool print)
 }
 
 
-void HttpCommandStream::CommandTask(void* object)
+/**
+ * Execute: run the command (called by a command pool worker)
+ */
+void HttpCommandStream::Execute()
 {
-  HttpCommandStream* me = (HttpCommandStream*) object;
-
   ESP_LOGI(TAG, "HttpCommandStream[%p]: %d bytes free, executing: %s%s",
-    me->m_nc, heap_caps_get_free_size(MALLOC_CAP_8BIT),
-    me->m_command.substr(0,200).c_str(), (me->m_command.length()>200) ? " [...]" : "");
+    m_nc, heap_caps_get_free_size(MALLOC_CAP_8BIT),
+    m_command.substr(0,200).c_str(), (m_command.length()>200) ? " [...]" : "");
 
   // execute command:
-  if (me->m_javascript) {
+  if (m_javascript) {
     #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
-      MyDuktape.DuktapeEvalNoResult(me->m_command.c_str(), me);
+      MyDuktape.DuktapeEvalNoResult(m_command.c_str(), this);
     #else
-      me->puts("ERROR: Javascript support disabled");
+      puts("ERROR: Javascript support disabled");
     #endif
   } else {
-    me->ProcessChars(me->m_command.data(), me->m_command.size());
-    me->ProcessChar('\n');
+    ProcessChars(m_command.data(), m_command.size());
+    ProcessChar('\n');
   }
 
-  me->m_done = true;
+  m_done = true;
 
 #if MG_ENABLE_BROADCAST && WEBSRV_USE_MG_BROADCAST
-  if (m_writequeue && uxQueueMessagesWaiting(me->m_writequeue) > 0) {
-    ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] RequestPollLast, qlen=%d done=%d sent=%d ack=%d", me->m_nc, uxQueueMessagesWaiting(me->m_writequeue), me->m_done, me->m_sent, me->m_ack);
-    me->RequestPoll();
-    ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] RequestPollDone, qlen=%d done=%d sent=%d ack=%d", me->m_nc, uxQueueMessagesWaiting(me->m_writequeue), me->m_done, me->m_sent, me->m_ack);
+  if (m_writequeue && uxQueueMessagesWaiting(m_writequeue) > 0) {
+    ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] RequestPollLast, qlen=%d done=%d sent=%d ack=%d", m_nc, uxQueueMessagesWaiting(m_writequeue), m_done, m_sent, m_ack);
+    RequestPoll();
+    ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] RequestPollDone, qlen=%d done=%d sent=%d ack=%d", m_nc, uxQueueMessagesWaiting(m_writequeue), m_done, m_sent, m_ack);
   }
 #endif // MG_ENABLE_BROADCAST && WEBSRV_USE_MG_BROADCAST
 
-  while (me->m_nc)
-    vTaskDelay(10/portTICK_PERIOD_MS);
-  delete me;
-  vTaskDelete(NULL);
+  // the connection may still need to fetch the remaining output:
+  Release();
+}
+
+
+/**
+ * Release: drop a reference, the last one (worker or connection) deletes the stream
+ */
+void HttpCommandStream::Release()
+{
+  if (--m_refs == 0)
+    delete this;
 }
 
 
@@ -136,17 +146,26 @@ void HttpCommandStream::ProcessQueue()
 {
   size_t txlen = 0;
   hcs_writebuf wbuf;
+  extram::string zbuf;
 
   if (m_writequeue) {
     while (txlen < XFER_CHUNK_SIZE && xQueueReceive(m_writequeue, &wbuf, 0) == pdTRUE) {
       if (m_nc) {
-        mg_send_http_chunk(m_nc, wbuf.data, wbuf.len);
+        if (m_deflate)
+          OvmsWebServer::Deflate(m_deflate, zbuf, wbuf.data, wbuf.len, DeflateNoFlush);
+        else
+          mg_send_http_chunk(m_nc, wbuf.data, wbuf.len);
         txlen += wbuf.len;
       }
       free(wbuf.data);
     }
 
     if (txlen) {
+      if (m_deflate) {
+        // flush to deliver the output immediately:
+        OvmsWebServer::Deflate(m_deflate, zbuf, NULL, 0, DeflateSyncFlush);
+        mg_send_http_chunk(m_nc, zbuf.data(), zbuf.size());
+      }
       m_sent += txlen;
       ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] ProcessQueue txlen=%d, qlen=%d done=%d sent=%d ack=%d",
         m_nc, txlen, uxQueueMessagesWaiting(m_writequeue), m_done, m_sent, m_ack);
@@ -158,9 +177,15 @@ void HttpCommandStream::ProcessQueue()
       m_nc, m_sent, heap_caps_get_free_size(MALLOC_CAP_8BIT));
     if (m_nc) {
       m_nc->flags |= MG_F_SEND_AND_CLOSE; // necessary to prevent mg_broadcast lockups
+      if (m_deflate) {
+        zbuf.clear();
+        OvmsWebServer::Deflate(m_deflate, zbuf, NULL, 0, DeflateFinish);
+        mg_send_http_chunk(m_nc, zbuf.data(), zbuf.size());
+      }
       mg_send_http_chunk(m_nc, "", 0);
       m_nc->user_data = NULL;
       m_nc = NULL;
+      Release();
     }
   }
 }
@@ -190,13 +215,13 @@ int HttpCommandStream::HandleEvent(int ev, void* p)
       ESP_EARLY_LOGV(TAG, "HttpCommandStream[%p] EV_CLOSE qlen=%d done=%d sent=%d ack=%d",
         m_nc, m_writequeue ? uxQueueMessagesWaiting(m_writequeue) : -1, m_done, m_sent, m_ack);
       // connection has been closed, possibly externally:
-      // we need to let the command task finish normally to prevent problems
+      // we need to let the command worker finish normally to prevent problems
       // due to lost/locked ressources, so we just detach:
       m_nc->user_data = NULL;
       m_nc = NULL;
-      ProcessQueue();   // empty queue (no tx) to prevent task lockup on write
-      ev = 0;           // prevent deletion by main event handler
-      break;
+      ProcessQueue();   // empty queue (no tx) to prevent worker lockup on write
+      Release();        // the worker may still hold a reference
+      return 0;         // prevent deletion by main event handler
 
     default:
       break;
@@ -267,3 +292,151 @@ void HttpCommandStream::Log(LogBuffers* message)
   // writing could block, logging is done via the websocket stream
   message->release();
 }
+
+
+/**
+ * HttpCommandPool: bounded command queue & on demand worker tasks
+ *
+ * Workers keep their stack between commands, so polling clients don't cause
+ * a task creation per request. Workers exit after WEBSRV_CMD_IDLETIME seconds
+ * without a job to free their stacks.
+ */
+
+HttpCommandPool::HttpCommandPool()
+{
+  m_queue = xQueueCreate(WEBSRV_CMD_QUEUESIZE, sizeof(HttpCommandStream*));
+}
+
+HttpCommandPool::~HttpCommandPool()
+{
+  // never destroyed
+}
+
+
+/**
+ * CanAccept: check if a command can be queued (counts a rejection if not)
+ *  Note: to be called from the mongoose task only, before sending the response header
+ */
+bool HttpCommandPool::CanAccept()
+{
+  if (uxQueueSpacesAvailable(m_queue) > 0)
+    return true;
+  OvmsMutexLock lock(&m_mutex);
+  m_rejected++;
+  return false;
+}
+
+
+/**
+ * Submit: queue the command for execution, start a worker if necessary
+ *  On failure, the command is finished with an error message.
+ */
+bool HttpCommandPool::Submit(HttpCommandStream* job)
+{
+  OvmsMutexLock lock(&m_mutex);
+
+  job->m_queuetime = esp_timer_get_time();
+  if (xQueueSend(m_queue, &job, 0) != pdTRUE) {
+    m_rejected++;
+    ESP_LOGW(TAG, "HttpCommandPool: queue full, command rejected");
+    job->puts("ERROR: command queue full, please retry");
+    job->m_done = true;
+    job->Release();
+    return false;
+  }
+  m_submitted++;
+
+  uint32_t depth = uxQueueMessagesWaiting(m_queue);
+  if (depth > m_maxdepth)
+    m_maxdepth = depth;
+
+  // start another worker if the idle ones can't take all waiting jobs:
+  if (depth > (uint32_t)(m_workers - m_busy) && m_workers < WEBSRV_CMD_WORKERS) {
+    TaskHandle_t task;
+    if (xTaskCreatePinnedToCore(WorkerTask, "OVMS WebCmd", CONFIG_OVMS_SYS_COMMAND_STACK_SIZE,
+        (void*)this, 4, &task, CORE(1)) == pdPASS) {
+      m_workers++;
+      if (m_workers > m_maxworkers)
+        m_maxworkers = m_workers;
+    } else if (m_workers == 0) {
+      ESP_LOGE(TAG, "HttpCommandPool: cannot start worker, %d bytes free",
+        heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    }
+  }
+
+  return true;
+}
+
+
+void HttpCommandPool::WorkerTask(void* object)
+{
+  HttpCommandPool* me = (HttpCommandPool*) object;
+  me->Worker();
+  vTaskDelete(NULL);
+}
+
+void HttpCommandPool::Worker()
+{
+  HttpCommandStream* job;
+  while (true) {
+    if (xQueueReceive(m_queue, &job, pdMS_TO_TICKS(WEBSRV_CMD_IDLETIME*1000)) != pdTRUE) {
+      // idle timeout: exit unless a job has been queued meanwhile
+      OvmsMutexLock lock(&m_mutex);
+      if (uxQueueMessagesWaiting(m_queue) == 0) {
+        m_workers--;
+        return;
+      }
+      continue;
+    }
+
+    int64_t start = esp_timer_get_time();
+    uint32_t wait = start - job->m_queuetime;
+    m_mutex.Lock();
+    m_busy++;
+    m_waitsum += wait;
+    if (wait > m_waitmax)
+      m_waitmax = wait;
+    m_mutex.Unlock();
+
+    job->Execute();   // Note: job may be deleted now
+
+    uint32_t run = esp_timer_get_time() - start;
+    m_mutex.Lock();
+    m_busy--;
+    m_completed++;
+    m_runsum += run;
+    if (run > m_runmax)
+      m_runmax = run;
+    m_mutex.Unlock();
+  }
+}
+
+
+void HttpCommandPool::Status(OvmsWriter* writer)
+{
+  OvmsMutexLock lock(&m_mutex);
+  writer->printf(
+    "Command workers: %d running (%d busy), max %d (limit %d)\n"
+    "Command queue  : %d waiting, max %d (size %d)\n"
+    "Commands       : %u submitted, %u completed, %u rejected\n",
+    m_workers, m_busy, m_maxworkers, WEBSRV_CMD_WORKERS,
+    uxQueueMessagesWaiting(m_queue), m_maxdepth, WEBSRV_CMD_QUEUESIZE,
+    m_submitted, m_completed, m_rejected);
+  if (m_completed) {
+    writer->printf(
+      "Queue latency  : avg %.1f ms, max %.1f ms\n"
+      "Execution time : avg %.1f ms, max %.1f ms\n",
+      (float)m_waitsum / m_completed / 1000, (float)m_waitmax / 1000,
+      (float)m_runsum / m_completed / 1000, (float)m_runmax / 1000);
+  }
+}
+
+void HttpCommandPool::ResetStatus()
+{
+  OvmsMutexLock lock(&m_mutex);
+  m_submitted = m_rejected = m_completed = 0;
+  m_maxdepth = 0;
+  m_maxworkers = m_workers;
+  m_waitsum = m_runsum = 0;
+  m_waitmax = m_runmax = 0;
+}
@@ -0,0 +1,309 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2018       Michael Balzer
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "webserver";
+
+#include <string.h>
+#include <strings.h>
+#include "ovms_webserver.h"
+#include "esp_heap_caps.h"
+#include "ovms_malloc.h"
+
+#ifdef CONFIG_OVMS_SC_ZIP
+#include "zlib.h"
+
+/**
+ * find_nocase: find string in buffer, case insensitive
+ */
+static const char* find_nocase(const char* buf, size_t len, const char* needle)
+{
+  size_t nlen = strlen(needle);
+  for (size_t i = 0; i + nlen <= len; i++) {
+    if (strncasecmp(buf + i, needle, nlen) == 0)
+      return buf + i;
+  }
+  return NULL;
+}
+
+
+/**
+ * zlib memory allocation: the deflate state is too large for internal RAM
+ */
+static voidpf zalloc_extram(voidpf opaque, uInt items, uInt size)
+{
+  return ExternalRamMalloc(items * size);
+}
+
+static void zfree_extram(voidpf opaque, voidpf address)
+{
+  free(address);
+}
+
+
+/**
+ * AcceptsGzip: check if the client accepts gzip Content-Encoding
+ */
+bool OvmsWebServer::AcceptsGzip(http_message* hm)
+{
+  mg_str* hdr = mg_get_http_header(hm, "Accept-Encoding");
+  if (!hdr)
+    return false;
+  return (find_nocase(hdr->p, hdr->len, "gzip") != NULL
+    && find_nocase(hdr->p, hdr->len, "gzip;q=0") == NULL);
+}
+
+
+/**
+ * DeflateInit: create a deflate stream with bounded window & memory usage
+ *  gzip: true = gzip format (HTTP), false = raw deflate (WebSocket permessage-deflate)
+ */
+z_stream_s* OvmsWebServer::DeflateInit(bool gzip)
+{
+  z_stream* zs = (z_stream*) ExternalRamCalloc(1, sizeof(z_stream));
+  if (!zs)
+    return NULL;
+  zs->zalloc = zalloc_extram;
+  zs->zfree = zfree_extram;
+  zs->opaque = NULL;
+  int wbits = gzip ? (16 + WEBSRV_DEFLATE_WBITS) : -WEBSRV_DEFLATE_WBITS;
+  if (deflateInit2(zs, WEBSRV_DEFLATE_LEVEL, Z_DEFLATED, wbits, WEBSRV_DEFLATE_MEMLEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    ESP_LOGE(TAG, "DeflateInit: zlib init failed, %d bytes free", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    free(zs);
+    return NULL;
+  }
+  return zs;
+}
+
+
+/**
+ * Deflate: compress data, append output to out
+ */
+bool OvmsWebServer::Deflate(z_stream_s* zs, extram::string& out, const char* data, size_t len, DeflateFlush flush)
+{
+  int zflush = (flush == DeflateFinish) ? Z_FINISH : (flush == DeflateSyncFlush) ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+  int res;
+  size_t pos;
+  zs->next_in = (Bytef*) data;
+  zs->avail_in = len;
+  do {
+    pos = out.size();
+    out.resize(pos + XFER_CHUNK_SIZE/2);
+    zs->next_out = (Bytef*) &out[pos];
+    zs->avail_out = XFER_CHUNK_SIZE/2;
+    res = deflate(zs, zflush);
+    out.resize(pos + XFER_CHUNK_SIZE/2 - zs->avail_out);
+  } while (zs->avail_out == 0 && res == Z_OK);
+  return (res != Z_STREAM_ERROR);
+}
+
+
+/**
+ * DeflateEnd: free deflate stream
+ */
+void OvmsWebServer::DeflateEnd(z_stream_s*& zs)
+{
+  if (zs) {
+    deflateEnd(zs);
+    free(zs);
+    zs = NULL;
+  }
+}
+
+
+/**
+ * InflateMessage: decompress a permessage-deflate WebSocket message
+ *  (client_no_context_takeover, i.e. each message is a separate stream)
+ */
+bool OvmsWebServer::InflateMessage(extram::string& out, const char* data, size_t len, size_t maxlen)
+{
+  static const char tail[4] = { 0x00, 0x00, (char)0xff, (char)0xff };
+  z_stream zs = {};
+  zs.zalloc = zalloc_extram;
+  zs.zfree = zfree_extram;
+  if (inflateInit2(&zs, -15) != Z_OK)
+    return false;
+
+  int res = Z_OK;
+  for (int part = 0; part < 2 && res == Z_OK; part++) {
+    zs.next_in = (Bytef*) (part == 0 ? data : tail);
+    zs.avail_in = (part == 0 ? len : sizeof(tail));
+    while (zs.avail_in > 0 && res == Z_OK) {
+      size_t pos = out.size();
+      if (pos >= maxlen) {
+        res = Z_BUF_ERROR;
+        break;
+      }
+      out.resize(maxlen);
+      zs.next_out = (Bytef*) &out[pos];
+      zs.avail_out = maxlen - pos;
+      res = inflate(&zs, Z_SYNC_FLUSH);
+      out.resize(maxlen - zs.avail_out);
+      if (res == Z_BUF_ERROR && zs.avail_out > 0)
+        res = Z_OK;   // no progress possible, input consumed
+    }
+  }
+
+  inflateEnd(&zs);
+  return (res == Z_OK || res == Z_STREAM_END);
+}
+
+
+/**
+ * CompressResponse: gzip a complete chunked response generated by a page handler
+ *  (sent from txstart in the connection's send buffer), if that reduces the size.
+ *  The response needs to be complete, i.e. not be continued by an async handler.
+ */
+void OvmsWebServer::CompressResponse(mg_connection* nc, size_t txstart)
+{
+  mbuf& io = nc->send_mbuf;
+  if (io.len < txstart + WEBSRV_DEFLATE_MINSIZE)
+    return;
+  const char* rsp = io.buf + txstart;
+  const char* end = io.buf + io.len;
+
+  // check header:
+  const char* hend = find_nocase(rsp, end - rsp, "\r\n\r\n");
+  if (!hend
+    || !find_nocase(rsp, hend - rsp, "\r\nTransfer-Encoding: chunked")
+    || find_nocase(rsp, hend - rsp, "\r\nContent-Encoding:"))
+    return;
+
+  // collect body:
+  extram::string body;
+  const char* p = hend + 4;
+  while (p < end) {
+    char* e;
+    unsigned long n = strtoul(p, &e, 16);
+    if (e == p || e + 2 > end || e[0] != '\r' || e[1] != '\n')
+      return;
+    p = e + 2;
+    if (n == 0)
+      break;
+    if (p + n + 2 > end)
+      return;
+    body.append(p, n);
+    p += n + 2;
+  }
+  if (p + 2 != end || p[0] != '\r' || p[1] != '\n' || body.size() < WEBSRV_DEFLATE_MINSIZE)
+    return;   // incomplete or trailing data
+
+  // compress:
+  extram::string gz;
+  z_stream_s* zs = DeflateInit(true);
+  if (!zs)
+    return;
+  bool ok = Deflate(zs, gz, body.data(), body.size(), DeflateFinish);
+  DeflateEnd(zs);
+  if (!ok || gz.size() >= body.size())
+    return;
+  ESP_LOGD(TAG, "CompressResponse: %u -> %u bytes", body.size(), gz.size());
+
+  // replace response:
+  extram::string head(rsp, hend - rsp);
+  head.append("\r\nContent-Encoding: gzip\r\nVary: Accept-Encoding\r\n\r\n");
+  io.len = txstart;
+  mg_send(nc, head.data(), head.size());
+  mg_send_http_chunk(nc, gz.data(), gz.size());
+  mg_send_http_chunk(nc, "", 0);
+}
+
+
+/**
+ * AcceptsWebSocketDeflate: check the client's WebSocket extension offers for
+ *  a permessage-deflate variant we support (no server side restrictions)
+ */
+bool OvmsWebServer::AcceptsWebSocketDeflate(http_message* hm)
+{
+  mg_str* hdr = mg_get_http_header(hm, "Sec-WebSocket-Extensions");
+  if (!hdr)
+    return false;
+  return (find_nocase(hdr->p, hdr->len, "permessage-deflate") != NULL
+    && find_nocase(hdr->p, hdr->len, "server_max_window_bits") == NULL
+    && find_nocase(hdr->p, hdr->len, "server_no_context_takeover") == NULL);
+}
+
+
+/**
+ * AcceptWebSocketDeflate: add the permessage-deflate agreement to the
+ *  handshake response queued by mongoose (clears WEBSRV_F_WSDEFLATE on failure)
+ */
+void OvmsWebServer::AcceptWebSocketDeflate(mg_connection* nc)
+{
+  static const char ext[] = "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover\r\n";
+  mbuf& io = nc->send_mbuf;
+  const char* rsp = find_nocase(io.buf, io.len, "HTTP/1.1 101 ");
+  const char* hend = rsp ? find_nocase(rsp, io.buf + io.len - rsp, "\r\n\r\n") : NULL;
+  if (!hend || mbuf_insert(&io, hend + 2 - io.buf, ext, sizeof(ext)-1) != sizeof(ext)-1) {
+    ESP_LOGW(TAG, "AcceptWebSocketDeflate: handshake response not found, compression disabled");
+    nc->flags &= ~WEBSRV_F_WSDEFLATE;
+  }
+}
+
+#else // CONFIG_OVMS_SC_ZIP
+
+bool OvmsWebServer::AcceptsGzip(http_message* hm)
+{
+  return false;
+}
+
+z_stream_s* OvmsWebServer::DeflateInit(bool gzip)
+{
+  return NULL;
+}
+
+bool OvmsWebServer::Deflate(z_stream_s* zs, extram::string& out, const char* data, size_t len, DeflateFlush flush)
+{
+  return false;
+}
+
+void OvmsWebServer::DeflateEnd(z_stream_s*& zs)
+{
+  zs = NULL;
+}
+
+bool OvmsWebServer::InflateMessage(extram::string& out, const char* data, size_t len, size_t maxlen)
+{
+  return false;
+}
+
+void OvmsWebServer::CompressResponse(mg_connection* nc, size_t txstart)
+{
+}
+
+bool OvmsWebServer::AcceptsWebSocketDeflate(http_message* hm)
+{
+  return false;
+}
+
+void OvmsWebServer::AcceptWebSocketDeflate(mg_connection* nc)
+{
+  nc->flags &= ~WEBSRV_F_WSDEFLATE;
+}
+
+#endif // CONFIG_OVMS_SC_ZIP
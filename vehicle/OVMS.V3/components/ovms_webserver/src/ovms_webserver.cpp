@@ -52,12 +52,26 @@ static const char *TAG = "webserver";
 
 OvmsWebServer MyWebServer __attribute__ ((init_priority (8200)));
 
+static void webserver_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+{
+  writer->printf("Web server %s, %d websocket client(s)\n",
+    MyWebServer.m_running ? "running" : "stopped", MyWebServer.m_client_cnt);
+  MyWebServer.m_cmdpool.Status(writer);
+}
+
+static void webserver_status_reset(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+{
+  MyWebServer.m_cmdpool.ResetStatus();
+  writer->puts("Web server statistics reset");
+}
+
 OvmsWebServer::OvmsWebServer()
 {
   ESP_LOGI(TAG, "Initialising WEBSERVER (8200)");
 
   m_running = false;
   m_configured = false;
+  m_compress = false;
   m_restart_countdown = 0;
   memset(m_sessions, 0, sizeof(m_sessions));
 
@@ -71,6 +85,10 @@ OvmsWebServer::OvmsWebServer()
   m_client_backlog = xQueueCreate(50, sizeof(WebSocketTxTodo));
   m_update_ticker = xTimerCreate("Web client update ticker", 250 / portTICK_PERIOD_MS, pdTRUE, NULL, UpdateTicker);
 
+  OvmsCommand* cmd_webserver = MyCommandApp.RegisterCommand("webserver", "Web server framework");
+  OvmsCommand* cmd_status = cmd_webserver->RegisterCommand("status", "Show web server status", webserver_status);
+  cmd_status->RegisterCommand("reset", "Reset web server statistics", webserver_status_reset);
+
   MyConfig.RegisterParam("http.server", "Webserver configuration", true, true);
   MyConfig.RegisterParam("http.plugin", "Webserver plugins", true, true);
 
@@ -109,6 +127,7 @@ OvmsWebServer::OvmsWebServer()
   RegisterPage("/status", "Status", HandleStatus, PageMenu_Main, PageAuth_Cookie);
   RegisterPage("/shell", "Shell", HandleShell, PageMenu_Tools, PageAuth_Cookie);
   RegisterPage("/edit", "Editor", HandleEditor, PageMenu_Tools, PageAuth_Cookie);
+  RegisterPage("/tasks", "Task monitor", HandleTaskMonitor, PageMenu_Tools, PageAuth_Cookie);
   RegisterPage("/cfg/init", "Setup wizard", HandleCfgInit, PageMenu_None, PageAuth_Cookie);
   RegisterPage("/cfg/password", "Password", HandleCfgPassword, PageMenu_Config, PageAuth_Cookie);
   RegisterPage("/cfg/vehicle", "Vehicle", HandleCfgVehicle, PageMenu_Config, PageAuth_Cookie);
@@ -208,10 +227,17 @@ void OvmsWebServer::ConfigChanged(std::string event, void* data)
     CfgInitStartup();
   }
 
+#ifdef CONFIG_OVMS_SC_ZIP
+  if (!param || param->GetName() == "http.server") {
+    m_compress = MyConfig.GetParamValueBool("http.server", "compress", true);
+  }
+#endif // CONFIG_OVMS_SC_ZIP
+
 #if MG_ENABLE_FILESYSTEM
   if (!param || param->GetName() == "http.server") {
     // Instances:
     //    Name                Default                 Function
+    //    compress            yes                     gzip/deflate dynamic content & WebSocket messages
     //    enable.files        yes                     Enable file serving from docroot
     //    enable.dirlist      yes                     Enable directory listings
     //    docroot             /sd                     File server document root
@@ -530,8 +556,19 @@ void OvmsWebServer::EventHandler(mg_connection *nc, int ev, void *p)
   // framework handling:
   switch (ev)
   {
+    case MG_EV_WEBSOCKET_HANDSHAKE_REQUEST: // websocket upgrade request
+      {
+        if (MyWebServer.m_compress && AcceptsWebSocketDeflate((http_message*) p))
+          nc->flags |= WEBSRV_F_WSDEFLATE;
+      }
+      break;
+
     case MG_EV_WEBSOCKET_HANDSHAKE_DONE:    // new websocket connection
       {
+        // Note: the handshake response is still in the send buffer, and needs to be
+        //  amended before the handler queues the first (compressed) frames:
+        if (nc->flags & WEBSRV_F_WSDEFLATE)
+          AcceptWebSocketDeflate(nc);
         MyWebServer.CreateWebSocketHandler(nc);
       }
       break;
@@ -548,7 +585,11 @@ void OvmsWebServer::EventHandler(mg_connection *nc, int ev, void *p)
         PageEntry* page = MyWebServer.FindPage(c.uri.c_str());
         if (page) {
           // serve by page handler:
+          size_t txstart = nc->send_mbuf.len;
           page->Serve(c);
+          // gzip response if complete (no async handler attached):
+          if (MyWebServer.m_compress && nc->user_data == NULL && AcceptsGzip(c.hm))
+            CompressResponse(nc, txstart);
         }
 #if MG_ENABLE_FILESYSTEM
         else if (MyWebServer.m_file_enable) {
@@ -38,6 +38,7 @@
 #include <memory>
 #include <utility>
 #include <map>
+#include <atomic>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
@@ -63,6 +64,21 @@
 
 #define WEBSRV_USE_MG_BROADCAST   0  // Note: mg_broadcast() not working reliably yet, do not enable for production!
 
+// Response compression (config "http.server" "compress", needs CONFIG_OVMS_SC_ZIP):
+//  the deflate window & memory level are reduced to keep the per stream state at ~20 KB
+#define WEBSRV_DEFLATE_WBITS      11            // 2 KB window
+#define WEBSRV_DEFLATE_MEMLEVEL   4
+#define WEBSRV_DEFLATE_LEVEL      6
+#define WEBSRV_DEFLATE_MINSIZE    256           // don't gzip smaller HTTP responses
+#define WEBSRV_INFLATE_MAXSIZE    4096          // max size of inflated incoming WebSocket message
+#define WEBSRV_F_WSDEFLATE        MG_F_USER_1   // connection flag: permessage-deflate negotiated
+
+// Command worker pool (/api/execute):
+//  workers are started on demand and exit after being idle for WEBSRV_CMD_IDLETIME
+#define WEBSRV_CMD_WORKERS        3             // max number of command worker tasks
+#define WEBSRV_CMD_QUEUESIZE      8             // max number of commands waiting for a worker
+#define WEBSRV_CMD_IDLETIME       60            // seconds
+
 // Asset URLs with versioning:
 #define URL_ASSETS_SCRIPT_JS      "/assets/script.js?v="       STR(MTIME_ASSETS_SCRIPT_JS)
 #define URL_ASSETS_CHARTS_JS      "/assets/charts.js?v="       STR(MTIME_ASSETS_CHARTS_JS)
@@ -71,6 +87,15 @@
 #define URL_ASSETS_FAVICON_PNG    "/apple-touch-icon.png?v="   STR(MTIME_ASSETS_FAVICON_PNG)
 #define URL_ASSETS_ZONES_JSON     "/assets/zones.json?v="      STR(MTIME_ASSETS_ZONES_JSON)
 
+struct z_stream_s;
+
+enum DeflateFlush
+{
+  DeflateNoFlush = 0,         // buffer input
+  DeflateSyncFlush,           // output all pending data, end on byte boundary (00 00 ff ff)
+  DeflateFinish,              // finish stream
+};
+
 struct user_session {
   uint64_t id;
   time_t last_used;
@@ -378,6 +403,36 @@ struct WebSocketTxJob
   void clear(size_t client);
 };
 
+/**
+ * WebSocket binary metrics format (client message "format binary"):
+ *  Metric IDs are announced by a preceding text frame {"metricids":{"name":id,...}}.
+ *  Binary frame: uint8 WSBIN_FRAME_METRICS, then per metric:
+ *    uint16 id, uint8 WebSocketBinType, value (little endian)
+ */
+#define WSBIN_FRAME_METRICS       0x01
+
+enum WebSocketBinType
+{
+  WSBIN_Undefined = 0,        // value: -
+  WSBIN_Bool,                 // value: uint8
+  WSBIN_Int,                  // value: int32
+  WSBIN_Float,                // value: float32
+  WSBIN_JSON,                 // value: uint16 length + JSON text
+};
+
+/**
+ * WebSocketMetric: per client metric state cache
+ *  (subscription match result & binary format ID)
+ */
+struct WebSocketMetric
+{
+  const char*             name;           // validates the cache entry
+  bool                    subscribed;
+  uint16_t                id;             // 0 = not yet announced
+};
+
+typedef std::map<const OvmsMetric*, WebSocketMetric> WebSocketMetricMap;
+
 struct WebSocketTxTodo
 {
   int                     client;
@@ -399,6 +454,7 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
     void InitTx();
     void ContinueTx();
     void ProcessTxJob();
+    void SendFrame(int op, const char* data, size_t len);
     int HandleEvent(int ev, void* p);
     void HandleIncomingMsg(std::string msg);
 
@@ -406,6 +462,12 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
     void Subscribe(std::string topic);
     void Unsubscribe(std::string topic);
     bool IsSubscribedTo(std::string topic);
+    WebSocketMetric& GetMetricState(OvmsMetric* m);
+    void ResetMetricStates();
+
+  protected:
+    int AddMetricsJSON(std::string& msg, OvmsMetric*& m, int& count);
+    int AddMetricsBinary(std::string& msg, std::string& ids, OvmsMetric*& m, int& count);
 
   // OvmsWriter:
   public:
@@ -424,6 +486,11 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
     int                       m_sent = 0;
     int                       m_ack = 0;
     std::set<std::string>     m_subscriptions;
+    bool                      m_metrics_filter = false;   // client has "metrics/..." subscriptions
+    bool                      m_metrics_binary = false;   // binary metrics frame format
+    WebSocketMetricMap        m_metrics;                  // metric state cache
+    uint16_t                  m_metrics_lastid = 0;
+    z_stream_s*               m_deflate = NULL;           // permessage-deflate TX stream
 };
 
 struct WebSocketSlot
@@ -443,22 +510,26 @@ typedef std::vector<WebSocketSlot> WebSocketSlots;
 class HttpCommandStream : public OvmsShell, public MgHandler
 {
   public:
-    HttpCommandStream(mg_connection* nc, extram::string command, bool javascript=false, int verbosity=COMMAND_RESULT_VERBOSE);
+    HttpCommandStream(mg_connection* nc, extram::string command, bool javascript=false, int verbosity=COMMAND_RESULT_VERBOSE,
+      z_stream_s* deflate=NULL);
     ~HttpCommandStream();
 
   public:
     void ProcessQueue();
     int HandleEvent(int ev, void* p);
-    static void CommandTask(void* object);
+    void Execute();
+    void Release();
 
   public:
     extram::string            m_command;
     bool                      m_javascript = false;
-    TaskHandle_t              m_cmdtask = NULL;
+    std::atomic_int           m_refs;                 // connection + worker
+    int64_t                   m_queuetime = 0;        // esp_timer time of submission
     QueueHandle_t             m_writequeue = NULL;
     bool                      m_done = false;
     size_t                    m_sent = 0;
     int                       m_ack = 0;
+    z_stream_s*               m_deflate = NULL;       // gzip Content-Encoding stream
 
   public:
     void Initialize(bool print);
@@ -470,6 +541,49 @@ class HttpCommandStream : public OvmsShell, public MgHandler
 };
 
 
+/**
+ * HttpCommandPool: worker tasks executing HttpCommandStreams
+ *
+ * Submit() never blocks: if all workers are busy and the queue is full, the
+ * command is rejected, and the caller shall respond with "503 Service Unavailable".
+ */
+
+class HttpCommandPool
+{
+  public:
+    HttpCommandPool();
+    ~HttpCommandPool();
+
+  public:
+    bool CanAccept();
+    bool Submit(HttpCommandStream* job);
+    void Status(OvmsWriter* writer);
+    void ResetStatus();
+
+  protected:
+    static void WorkerTask(void* object);
+    void Worker();
+
+  protected:
+    QueueHandle_t             m_queue;
+    OvmsMutex                 m_mutex;
+    int                       m_workers = 0;          // running worker tasks
+    int                       m_busy = 0;             // workers executing a command
+
+  protected:
+    // statistics:
+    uint32_t                  m_submitted = 0;
+    uint32_t                  m_rejected = 0;
+    uint32_t                  m_completed = 0;
+    uint32_t                  m_maxdepth = 0;         // max queue length
+    uint32_t                  m_maxworkers = 0;
+    uint64_t                  m_waitsum = 0;          // queue latency [us]
+    uint32_t                  m_waitmax = 0;
+    uint64_t                  m_runsum = 0;           // execution time [us]
+    uint32_t                  m_runmax = 0;
+};
+
+
 
 /**
  * OvmsWebServer: main web framework (static instance: MyWebServer)
@@ -516,6 +630,16 @@ class OvmsWebServer : public ExternalRamAllocated
     void CheckSessions(void);
     static bool CheckLogin(std::string username, std::string password);
 
+  public:
+    static bool AcceptsGzip(http_message* hm);
+    static z_stream_s* DeflateInit(bool gzip);
+    static bool Deflate(z_stream_s* zs, extram::string& out, const char* data, size_t len, DeflateFlush flush);
+    static void DeflateEnd(z_stream_s*& zs);
+    static bool InflateMessage(extram::string& out, const char* data, size_t len, size_t maxlen);
+    static void CompressResponse(mg_connection* nc, size_t txstart);
+    static bool AcceptsWebSocketDeflate(http_message* hm);
+    static void AcceptWebSocketDeflate(mg_connection* nc);
+
   public:
     WebSocketHandler* CreateWebSocketHandler(mg_connection* nc);
     void DestroyWebSocketHandler(WebSocketHandler* handler);
@@ -540,6 +664,7 @@ class OvmsWebServer : public ExternalRamAllocated
     static void HandleShell(PageEntry_t& p, PageContext_t& c);
     static void HandleDashboard(PageEntry_t& p, PageContext_t& c);
     static void HandleBmsCellMonitor(PageEntry_t& p, PageContext_t& c);
+    static void HandleTaskMonitor(PageEntry_t& p, PageContext_t& c);
     static void HandleCfgBrakelight(PageEntry_t& p, PageContext_t& c);
     static void HandleEditor(PageEntry_t& p, PageContext_t& c);
     static void HandleCfgPassword(PageEntry_t& p, PageContext_t& c);
@@ -579,6 +704,7 @@ class OvmsWebServer : public ExternalRamAllocated
   public:
     bool                      m_running;
     bool                      m_configured;
+    bool                      m_compress;
 
 #if MG_ENABLE_FILESYSTEM
     bool                      m_file_enable;
@@ -597,6 +723,8 @@ class OvmsWebServer : public ExternalRamAllocated
     QueueHandle_t             m_client_backlog;
     TimerHandle_t             m_update_ticker;
 
+    HttpCommandPool           m_cmdpool;
+
     int                       m_init_timeout;
     int                       m_restart_countdown;
 };
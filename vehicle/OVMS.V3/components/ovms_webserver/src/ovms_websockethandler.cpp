@@ -42,6 +42,7 @@ static const char *TAG = "websocket";
 #include "metrics_standard.h"
 #include "buffered_shell.h"
 #include "vehicle.h"
+#include "ovms_mempool.h"
 
 
 /**
@@ -73,6 +74,10 @@ WebSocketHandler::WebSocketHandler(mg_connection* nc, size_t slot, size_t modifi
   m_job.type = WSTX_None;
   m_sent = m_ack = 0;
   
+  // permessage-deflate: if the stream cannot be created, we just send uncompressed frames
+  if (nc->flags & WEBSRV_F_WSDEFLATE)
+    m_deflate = OvmsWebServer::DeflateInit(false);
+  
   // Register as logging console:
   SetMonitoring(true);
   MyCommandApp.RegisterConsole(this);
@@ -86,6 +91,7 @@ WebSocketHandler::~WebSocketHandler()
       ClearTxJob(m_job);
     vQueueDelete(m_jobqueue);
   }
+  OvmsWebServer::DeflateEnd(m_deflate);
 }
 
 
@@ -107,7 +113,7 @@ void WebSocketHandler::ProcessTxJob()
         msg = "{\"event\":\"";
         msg += m_job.event;
         msg += "\"}";
-        mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg.data(), msg.size());
+        SendFrame(WEBSOCKET_OP_TEXT, msg.data(), msg.size());
         m_sent = 1;
       }
       break;
@@ -126,33 +132,30 @@ void WebSocketHandler::ProcessTxJob()
       OvmsMetric* m;
       for (i=0, m=MyMetrics.m_first; i < m_sent && m != NULL; m=m->m_next, i++);
       
-      // build msg:
+      // build & send msg:
       std::string msg;
-      msg.reserve(2*XFER_CHUNK_SIZE+128);
-      msg = "{\"metrics\":{";
-      for (i=0; m && msg.size() < XFER_CHUNK_SIZE; m=m->m_next) {
-        if (m->IsModifiedAndClear(m_modifier) || m_job.type == WSTX_MetricsAll) {
-          if (i) msg += ',';
-          msg += '\"';
-          msg += m->m_name;
-          msg += "\":";
-          msg += m->AsJSON();
-          i++;
+      int checked = 0;
+      if (m_metrics_binary) {
+        std::string ids;
+        i = AddMetricsBinary(msg, ids, m, checked);
+        if (!ids.empty())
+          SendFrame(WEBSOCKET_OP_TEXT, ids.data(), ids.size());
+        if (i)
+          SendFrame(WEBSOCKET_OP_BINARY, msg.data(), msg.size());
+      } else {
+        i = AddMetricsJSON(msg, m, checked);
+        if (i) {
+          ESP_EARLY_LOGV(TAG, "WebSocket msg: %s", msg.c_str());
+          SendFrame(WEBSOCKET_OP_TEXT, msg.data(), msg.size());
         }
       }
-      
-      // send msg:
-      if (i) {
-        msg += "}}";
-        ESP_EARLY_LOGV(TAG, "WebSocket msg: %s", msg.c_str());
-        mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg.data(), msg.size());
-        m_sent += i;
-      }
+      if (i)
+        m_sent += checked;
       
       // done?
       if (!m && m_ack == m_sent) {
         if (m_sent)
-          ESP_EARLY_LOGV(TAG, "WebSocketHandler[%p]: ProcessTxJob type=%d done, sent=%d metrics", m_nc, m_job.type, m_sent);
+          ESP_EARLY_LOGV(TAG, "WebSocketHandler[%p]: ProcessTxJob type=%d done, checked=%d metrics", m_nc, m_job.type, m_sent);
         ClearTxJob(m_job);
       }
       
@@ -194,7 +197,7 @@ void WebSocketHandler::ProcessTxJob()
         }
         
         // send frame:
-        mg_send_websocket_frame(m_nc, op, msg.data(), msg.size());
+        SendFrame(op, msg.data(), msg.size());
         ESP_EARLY_LOGV(TAG, "WebSocketHandler[%p]: ProcessTxJob type=%d: sent %d bytes, op=%04x", m_nc, m_job.type, m_sent, op);
       }
       break;
@@ -219,7 +222,7 @@ void WebSocketHandler::ProcessTxJob()
         msg = "{\"log\":\"";
         msg += json_encode(stripesc(*it));
         msg += "\"}";
-        mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg.data(), msg.size());
+        SendFrame(WEBSOCKET_OP_TEXT, msg.data(), msg.size());
         m_sent++;
       }
       else if (m_ack == m_sent) {
@@ -248,13 +251,173 @@ void WebSocketHandler::ProcessTxJob()
 }
 
 
+/**
+ * SendFrame: send WebSocket frame, compressed if permessage-deflate has been negotiated
+ *  (the deflate stream keeps its context across messages, messages are
+ *  flushed to byte boundaries and may be fragmented by WEBSOCKET_DONT_FIN)
+ */
+void WebSocketHandler::SendFrame(int op, const char* data, size_t len)
+{
+  if (!m_deflate) {
+    mg_send_websocket_frame(m_nc, op, data, len);
+    return;
+  }
+  
+  bool fin = !(op & WEBSOCKET_DONT_FIN);
+  int opcode = op & 0x0f;
+  
+  extram::string payload;
+  if (!OvmsWebServer::Deflate(m_deflate, payload, data, len, DeflateSyncFlush)) {
+    ESP_LOGE(TAG, "WebSocketHandler[%p]: deflate failed, closing connection", m_nc);
+    m_nc->flags |= MG_F_SEND_AND_CLOSE;
+    return;
+  }
+  // remove the flush marker from the message end (re-added by the receiver):
+  size_t plen = payload.size();
+  if (fin && plen >= 4 && memcmp(payload.data() + plen - 4, "\x00\x00\xff\xff", 4) == 0)
+    plen -= 4;
+  
+  // frame header (RSV1 marks a compressed message, set on the first frame only):
+  uint8_t hdr[10];
+  size_t hlen;
+  hdr[0] = (fin ? 0x80 : 0x00) | (opcode != WEBSOCKET_OP_CONTINUE ? 0x40 : 0x00) | opcode;
+  if (plen < 126) {
+    hdr[1] = plen;
+    hlen = 2;
+  } else if (plen < 65536) {
+    hdr[1] = 126;
+    hdr[2] = plen >> 8;
+    hdr[3] = plen & 0xff;
+    hlen = 4;
+  } else {
+    hdr[1] = 127;
+    memset(&hdr[2], 0, 4);
+    hdr[6] = (plen >> 24) & 0xff;
+    hdr[7] = (plen >> 16) & 0xff;
+    hdr[8] = (plen >> 8) & 0xff;
+    hdr[9] = plen & 0xff;
+    hlen = 10;
+  }
+  mg_send(m_nc, hdr, hlen);
+  mg_send(m_nc, payload.data(), plen);
+}
+
+
+/**
+ * AddMetricsJSON: add next chunk of modified/subscribed metrics in JSON format
+ *  Returns the number of metrics added, m advanced to the next metric to check.
+ */
+int WebSocketHandler::AddMetricsJSON(std::string& msg, OvmsMetric*& m, int& checked)
+{
+  int i;
+  msg.reserve(2*XFER_CHUNK_SIZE+128);
+  msg = "{\"metrics\":{";
+  for (i=0; m && msg.size() < XFER_CHUNK_SIZE; m=m->m_next, checked++) {
+    if (!m->IsModifiedAndClear(m_modifier) && m_job.type != WSTX_MetricsAll)
+      continue;
+    if (m_metrics_filter && !GetMetricState(m).subscribed)
+      continue;
+    if (i) msg += ',';
+    msg += '\"';
+    msg += m->m_name;
+    msg += "\":";
+    m->AppendJSON(msg);
+    i++;
+  }
+  if (i) msg += "}}";
+  return i;
+}
+
+/**
+ * AddMetricsBinary: add next chunk of modified/subscribed metrics in binary format
+ *  New metric IDs are collected in ids as a JSON "metricids" object, which needs
+ *  to be sent before the binary frame.
+ *  Returns the number of metrics added, m advanced to the next metric to check.
+ */
+int WebSocketHandler::AddMetricsBinary(std::string& msg, std::string& ids, OvmsMetric*& m, int& checked)
+{
+  int i;
+  char rec[8];
+  msg.reserve(XFER_CHUNK_SIZE+64);
+  msg = (char) WSBIN_FRAME_METRICS;
+  for (i=0; m && msg.size() < XFER_CHUNK_SIZE; m=m->m_next, checked++) {
+    if (!m->IsModifiedAndClear(m_modifier) && m_job.type != WSTX_MetricsAll)
+      continue;
+    WebSocketMetric& ms = GetMetricState(m);
+    if (m_metrics_filter && !ms.subscribed)
+      continue;
+    
+    if (ms.id == 0) {
+      // announce new ID:
+      ms.id = ++m_metrics_lastid;
+      ids += ids.empty() ? "{\"metricids\":{\"" : ",\"";
+      ids += m->m_name;
+      snprintf(rec, sizeof(rec), "\":%u", ms.id);
+      ids += rec;
+    }
+    
+    // record: id (uint16), type (uint8), value
+    rec[0] = ms.id & 0xff;
+    rec[1] = ms.id >> 8;
+    if (!m->IsDefined()) {
+      rec[2] = WSBIN_Undefined;
+      msg.append(rec, 3);
+    }
+    else {
+      switch (m->GetValueType()) {
+        case MetricValueBool:
+          rec[2] = WSBIN_Bool;
+          rec[3] = ((OvmsMetricBool*)m)->AsBool() ? 1 : 0;
+          msg.append(rec, 4);
+          break;
+        case MetricValueInt:
+        {
+          int32_t val = ((OvmsMetricInt*)m)->AsInt();
+          rec[2] = WSBIN_Int;
+          memcpy(rec+3, &val, 4);
+          msg.append(rec, 7);
+          break;
+        }
+        case MetricValueFloat:
+        {
+          float val = m->AsFloat();
+          rec[2] = WSBIN_Float;
+          memcpy(rec+3, &val, 4);
+          msg.append(rec, 7);
+          break;
+        }
+        default:
+        {
+          // append JSON, then fill in the length:
+          size_t pos = msg.size();
+          rec[2] = WSBIN_JSON;
+          msg.append(rec, 5);
+          m->AppendJSON(msg);
+          size_t len = msg.size() - pos - 5;
+          if (len > 0xffff) {
+            len = 0xffff;
+            msg.resize(pos + 5 + len);
+          }
+          msg[pos+3] = len & 0xff;
+          msg[pos+4] = len >> 8;
+          break;
+        }
+      }
+    }
+    i++;
+  }
+  if (!ids.empty()) ids += "}}";
+  return i;
+}
+
+
 void WebSocketTxJob::clear(size_t client)
 {
   auto& slot = MyWebServer.m_client_slots[client];
   switch (type) {
     case WSTX_Event:
       if (event)
-        free(event);
+        MyExtRamPool.Free(event);
       break;
     case WSTX_Notify:
       if (notification) {
@@ -342,7 +505,17 @@ int WebSocketHandler::HandleEvent(int ev, void* p)
       // websocket message received
       websocket_message* wm = (websocket_message*) p;
       std::string msg;
-      msg.assign((char*) wm->data, wm->size);
+      if ((m_nc->flags & WEBSRV_F_WSDEFLATE) && (wm->flags & 0x40)) {
+        // RSV1: compressed message
+        extram::string data;
+        if (!OvmsWebServer::InflateMessage(data, (char*) wm->data, wm->size, WEBSRV_INFLATE_MAXSIZE)) {
+          ESP_LOGW(TAG, "WebSocketHandler[%p]: inflate failed, message dropped (%d bytes)", m_nc, wm->size);
+          break;
+        }
+        msg.assign(data.data(), data.size());
+      } else {
+        msg.assign((char*) wm->data, wm->size);
+      }
       HandleIncomingMsg(msg);
       break;
     }
@@ -401,6 +574,16 @@ void WebSocketHandler::HandleIncomingMsg(std::string msg)
       if (!arg.empty()) Unsubscribe(arg);
     }
   }
+  else if (cmd == "format") {
+    input >> arg;
+    if (arg == "binary" || arg == "json") {
+      m_metrics_binary = (arg == "binary");
+      ResetMetricStates();
+      AddTxJob({ WSTX_MetricsAll, NULL });
+    } else {
+      ESP_LOGW(TAG, "WebSocketHandler[%p]: unknown format '%s'", m_nc, arg.c_str());
+    }
+  }
   else {
     ESP_LOGW(TAG, "WebSocketHandler[%p]: unhandled message: '%s'", m_nc, msg.c_str());
   }
@@ -547,10 +730,10 @@ void OvmsWebServer::EventListener(std::string event, void* data)
     for (int i=0; i<m_client_cnt; i++) {
       auto& slot = m_client_slots[i];
       if (slot.handler) {
-        WebSocketTxJob job = { WSTX_Event, strdup(event.c_str()) };
+        WebSocketTxJob job = { WSTX_Event, MyExtRamPool.Strdup(event.c_str()) };
         if (!AddToBacklog(i, job)) {
           ESP_LOGW(TAG, "EventListener: event '%s' dropped for client %d", event.c_str(), i);
-          free(job.event);
+          MyExtRamPool.Free(job.event);
         }
       }
     }
@@ -560,9 +743,9 @@ void OvmsWebServer::EventListener(std::string event, void* data)
   // client list locked; add tx jobs:
   for (auto slot: m_client_slots) {
     if (slot.handler) {
-      WebSocketTxJob job = { WSTX_Event, strdup(event.c_str()) };
+      WebSocketTxJob job = { WSTX_Event, MyExtRamPool.Strdup(event.c_str()) };
       if (!slot.handler->AddTxJob(job, false))
-        free(job.event);
+        MyExtRamPool.Free(job.event);
       // Note: init_tx false to prevent mg_broadcast() deadlock on network events
       //  and keep processing time low
     }
@@ -633,6 +816,11 @@ void WebSocketHandler::Subscribe(std::string topic)
   }
   m_subscriptions.insert(topic);
   ESP_LOGD(TAG, "WebSocketHandler[%p]: subscription '%s' added", m_nc, topic.c_str());
+  if (startsWith(topic, "metrics/")) {
+    // send current values of newly subscribed metrics:
+    ResetMetricStates();
+    AddTxJob({ WSTX_MetricsAll, NULL });
+  }
 }
 
 void WebSocketHandler::Unsubscribe(std::string topic)
@@ -645,6 +833,8 @@ void WebSocketHandler::Unsubscribe(std::string topic)
       it++;
     }
   }
+  if (startsWith(topic, "metrics/"))
+    ResetMetricStates();
 }
 
 bool WebSocketHandler::IsSubscribedTo(std::string topic)
@@ -657,6 +847,39 @@ bool WebSocketHandler::IsSubscribedTo(std::string topic)
   return false;
 }
 
+/**
+ * Metric subscriptions:
+ *  Clients subscribing to "metrics/..." topics only receive the matching metrics,
+ *  clients without metric subscriptions receive all metrics. The topic is
+ *  the metric name in MQTT notation, e.g. "metrics/v/b/#" for all "v.b.*"
+ *  metrics. Match results and binary IDs are cached per metric.
+ */
+
+WebSocketMetric& WebSocketHandler::GetMetricState(OvmsMetric* m)
+{
+  auto it = m_metrics.find(m);
+  if (it != m_metrics.end() && it->second.name == m->m_name)
+    return it->second;
+  WebSocketMetric& ms = m_metrics[m];
+  ms.name = m->m_name;
+  ms.id = 0;
+  ms.subscribed = !m_metrics_filter || IsSubscribedTo(std::string("metrics/") + mqtt_topic(m->m_name));
+  return ms;
+}
+
+void WebSocketHandler::ResetMetricStates()
+{
+  m_metrics.clear();
+  m_metrics_lastid = 0;
+  m_metrics_filter = false;
+  for (auto it = m_subscriptions.begin(); it != m_subscriptions.end(); it++) {
+    if (startsWith(*it, "metrics/")) {
+      m_metrics_filter = true;
+      break;
+    }
+  }
+}
+
 bool OvmsWebServer::NotificationFilter(int client, OvmsNotifyType* type, const char* subtype)
 {
   if (xSemaphoreTake(MyWebServer.m_client_mutex, 0) != pdTRUE) {
@@ -277,26 +277,49 @@ void OvmsWebServer::HandleCommand(PageEntry_t& p, PageContext_t& c)
     return;
   }
 
+  // backpressure: all command workers busy & queue full → let the client retry
+  if (!command.empty() && !MyWebServer.m_cmdpool.CanAccept()) {
+    c.head(503,
+      "Content-Type: text/plain; charset=utf-8\r\n"
+      "Cache-Control: no-cache\r\n"
+      "Retry-After: 1");
+    c.print("ERROR: command queue full, please retry");
+    c.done();
+    return;
+  }
+
   // Note: application/octet-stream default instead of text/plain is a workaround for an *old*
   //  Chrome/Webkit bug: chunked text/plain is always buffered for the first 1024 bytes.
+  std::string headers;
   if (output == "text") {
-    c.head(200,
+    headers =
       "Content-Type: text/plain; charset=utf-8\r\n"
-      "Cache-Control: no-cache");
+      "Cache-Control: no-cache";
   } else if (output == "json") {
-    c.head(200,
+    headers =
       "Content-Type: application/json; charset=utf-8\r\n"
-      "Cache-Control: no-cache");
+      "Cache-Control: no-cache";
   } else {
-    c.head(200,
+    headers =
       "Content-Type: application/octet-stream; charset=utf-8\r\n"
-      "Cache-Control: no-cache");
+      "Cache-Control: no-cache";
   }
 
+  // stream gzip encoded output if possible:
+  z_stream_s* deflate = NULL;
+  if (!command.empty() && MyWebServer.m_compress && AcceptsGzip(c.hm))
+    deflate = DeflateInit(true);
+  if (deflate) {
+    headers +=
+      "\r\nContent-Encoding: gzip"
+      "\r\nVary: Accept-Encoding";
+  }
+  c.head(200, headers.c_str());
+
   if (command.empty())
     c.done();
   else
-    new HttpCommandStream(c.nc, command, javascript);
+    MyWebServer.m_cmdpool.Submit(new HttpCommandStream(c.nc, command, javascript, COMMAND_RESULT_VERBOSE, deflate));
 }
 
 
@@ -1701,7 +1724,7 @@ void OvmsWebServer::HandleCfgWebServer(PageEntry_t& p, PageContext_t& c)
 {
   std::string error, warn;
   std::string docroot, auth_domain, auth_file;
-  bool enable_files, enable_dirlist, auth_global;
+  bool enable_files, enable_dirlist, auth_global, compress;
   extram::string tls_cert, tls_key;
 
   if (c.method == "POST") {
@@ -1712,6 +1735,7 @@ void OvmsWebServer::HandleCfgWebServer(PageEntry_t& p, PageContext_t& c)
     enable_files = (c.getvar("enable_files") == "yes");
     enable_dirlist = (c.getvar("enable_dirlist") == "yes");
     auth_global = (c.getvar("auth_global") == "yes");
+    compress = (c.getvar("compress") == "yes");
     c.getvar("tls_cert", tls_cert);
     c.getvar("tls_key", tls_key);
 
@@ -1764,6 +1788,9 @@ void OvmsWebServer::HandleCfgWebServer(PageEntry_t& p, PageContext_t& c)
       MyConfig.SetParamValueBool("http.server", "enable.files", enable_files);
       MyConfig.SetParamValueBool("http.server", "enable.dirlist", enable_dirlist);
       MyConfig.SetParamValueBool("http.server", "auth.global", auth_global);
+#ifdef CONFIG_OVMS_SC_ZIP
+      MyConfig.SetParamValueBool("http.server", "compress", compress);
+#endif
 
       c.head(200);
       c.alert("success", "<p class=\"lead\">Webserver configuration saved.</p>"
@@ -1791,6 +1818,7 @@ void OvmsWebServer::HandleCfgWebServer(PageEntry_t& p, PageContext_t& c)
     enable_files = MyConfig.GetParamValueBool("http.server", "enable.files", true);
     enable_dirlist = MyConfig.GetParamValueBool("http.server", "enable.dirlist", true);
     auth_global = MyConfig.GetParamValueBool("http.server", "auth.global", true);
+    compress = MyConfig.GetParamValueBool("http.server", "compress", true);
     load_file("/store/tls/webserver.crt", tls_cert);
     load_file("/store/tls/webserver.key", tls_key);
 
@@ -1817,6 +1845,12 @@ void OvmsWebServer::HandleCfgWebServer(PageEntry_t& p, PageContext_t& c)
     "<p>Note: sub directories do <u>not</u> inherit the parent auth file.</p>");
   c.input_text("Auth domain/realm", "auth_domain", auth_domain.c_str(), "Default: ovms");
 
+#ifdef CONFIG_OVMS_SC_ZIP
+  c.input_checkbox("Enable compression", "compress", compress,
+    "<p>Compress dynamic pages, command outputs and websocket messages for clients supporting this."
+    " Speeds up remote access on slow connections.</p>");
+#endif // CONFIG_OVMS_SC_ZIP
+
   c.printf(
     "<div class=\"form-group\">\n"
       "<label class=\"control-label col-sm-3\" for=\"input-content\">TLS certificate:</label>\n"
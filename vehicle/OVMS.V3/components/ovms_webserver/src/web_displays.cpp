@@ -1174,6 +1174,131 @@ void OvmsWebServer::HandleBmsCellMonitor(PageEntry_t& p, PageContext_t& c)
   c.done();
 }
 
+/**
+ * HandleTaskMonitor: display task CPU, stack & heap history
+ *  (see "module tasks history", needs config module tasks.sample > 0)
+ */
+void OvmsWebServer::HandleTaskMonitor(PageEntry_t& p, PageContext_t& c)
+{
+  if (c.method == "POST") {
+    // process form submission:
+    int interval = atoi(c.getvar("interval").c_str());
+    if (interval > 0)
+      MyConfig.SetParamValueInt("module", "tasks.sample", interval);
+    else
+      MyConfig.DeleteInstance("module", "tasks.sample");
+    c.head(200);
+    c.alert("success", "<p>Saved.</p>");
+    c.print("<script>after(1, function(){ $('.modal').modal('hide'); loaduri('#main', 'get', '/tasks'); });</script>");
+    c.done();
+    return;
+  }
+
+  int interval = MyConfig.GetParamValueInt("module", "tasks.sample", 0);
+
+  c.head(200);
+  PAGE_HOOK("body.pre");
+
+  c.print(
+    "<div class=\"panel panel-primary panel-single\" id=\"taskmon\">\n"
+      "<div class=\"panel-heading\">Task Monitor</div>\n"
+      "<div class=\"panel-body\">\n"
+        "<div class=\"btn-group btn-group-sm\" data-toggle=\"buttons\" id=\"taskmon-type\">\n"
+          "<label class=\"btn btn-default active\"><input type=\"radio\" name=\"type\" value=\"cpu\" checked>CPU %</label>\n"
+          "<label class=\"btn btn-default\"><input type=\"radio\" name=\"type\" value=\"stack\">Stack free</label>\n"
+          "<label class=\"btn btn-default\"><input type=\"radio\" name=\"type\" value=\"heap\">Heap</label>\n"
+        "</div>\n"
+        "<div id=\"taskchart\" style=\"width: 100%; max-width: 100%; height: 60vh; min-height: 300px; margin: 0 auto\"></div>\n"
+        "<pre id=\"taskinfo\" style=\"display:none\"></pre>\n"
+      "</div>\n"
+      "<div class=\"panel-footer\">\n");
+
+  c.form_start(p.uri);
+  c.input("number", "Sample interval", "interval", interval > 0 ? std::to_string(interval).c_str() : "", "0 = off",
+    "<p>Sampling interval in seconds, history holds the last 60 samples.</p>",
+    "min=\"0\" step=\"1\"", "sec");
+  c.input_button("default", "Save");
+  c.form_end();
+
+  c.printf(
+      "</div>\n"
+    "</div>\n"
+    "\n"
+    "<script>\n"
+    "var taskchart, tasktype = 'cpu', tasktimer;\n"
+    "\n"
+    "function load_task_data() {\n"
+      "var text = '';\n"
+      "loadcmd('module tasks history ' + tasktype, function(msg) {\n"
+        "if (msg.error) return null;\n"
+        "text += msg.text;\n"
+        "if (!msg.request || msg.request.readyState != 4) return null;\n"
+        "var lines = text.trim().split('\\n');\n"
+        "if (lines.length < 2 || lines[0].indexOf('#time') != 0) {\n"
+          "$('#taskinfo').text(text).show();\n"
+          "return null;\n"
+        "}\n"
+        "$('#taskinfo').hide();\n"
+        "var times = lines[0].split(',').slice(1).map(Number);\n"
+        "var series = [];\n"
+        "for (var i = 1; i < lines.length; i++) {\n"
+          "var cols = lines[i].split(',');\n"
+          "series.push({ name: cols[0], data: cols.slice(1).map(function(v, j) {\n"
+            "return [times[j], (v === '') ? null : Number(v)]; }) });\n"
+        "}\n"
+        "update_task_chart(series);\n"
+        "return null;\n"
+      "});\n"
+    "}\n"
+    "\n"
+    "function update_task_chart(series) {\n"
+      "while (taskchart.series.length) taskchart.series[0].remove(false);\n"
+      "series.forEach(function(s) { taskchart.addSeries(s, false); });\n"
+      "taskchart.yAxis[0].setTitle({ text: (tasktype == 'cpu') ? 'CPU %%' : 'Bytes' }, false);\n"
+      "taskchart.redraw();\n"
+    "}\n"
+    "\n"
+    "function init_task_chart() {\n"
+      "taskchart = Highcharts.chart('taskchart', {\n"
+        "chart: { type: 'line', zoomType: 'x', animation: false },\n"
+        "title: { text: null },\n"
+        "credits: { enabled: false },\n"
+        "legend: { enabled: true, align: 'center', verticalAlign: 'bottom', margin: 2, padding: 2 },\n"
+        "xAxis: { title: { text: 'Uptime [s]' } },\n"
+        "yAxis: { title: { text: 'CPU %%' }, min: 0 },\n"
+        "tooltip: { shared: false, valueDecimals: 1 },\n"
+        "plotOptions: { series: { marker: { enabled: false }, connectNulls: false } },\n"
+        "series: [],\n"
+      "});\n"
+      "load_task_data();\n"
+      "tasktimer = window.setInterval(function() {\n"
+        "if (!$('#taskchart').length) { window.clearInterval(tasktimer); return; }\n"
+        "load_task_data();\n"
+      "}, %d);\n"
+    "}\n"
+    "\n"
+    "$('#taskmon-type input').on('change', function() {\n"
+      "tasktype = $(this).val();\n"
+      "load_task_data();\n"
+    "});\n"
+    "\n"
+    "if (window.Highcharts) {\n"
+      "init_task_chart();\n"
+    "} else {\n"
+      "$.ajax({\n"
+        "url: \"" URL_ASSETS_CHARTS_JS "\",\n"
+        "dataType: \"script\",\n"
+        "cache: true,\n"
+        "success: function(){ init_task_chart(); }\n"
+      "});\n"
+    "}\n"
+    "</script>\n",
+    (interval > 0 ? interval : 10) * 1000);
+
+  PAGE_HOOK("body.post");
+  c.done();
+}
+
 /**
  * HandleCfgBrakelight: configure vehicle brake light control
  * 
@@ -367,7 +367,7 @@ bool Pushover::SendMessageOpt( const std::string user_key, const std::string tok
   memset(&opts, 0, sizeof(opts));
   opts.error_string = &err;
 
-  opts.ssl_ca_cert = MyOvmsTLS.GetTrustedList();
+  opts.ssl_ca_cert = MyOvmsTLS.GetConnectCA();
 
   if ((m_mgconn = mg_connect_opt(mgr, _server.c_str(), PushoverMongooseCallback, opts)) == NULL)
     {
@@ -375,6 +375,7 @@ bool Pushover::SendMessageOpt( const std::string user_key, const std::string tok
     ESP_LOGE(TAG, "mg_connect_opt(%s) failed: %s", _server.c_str(), err);
     return false;
     }
+  MyOvmsTLS.SetupConnection(m_mgconn, _server, opts);
 
   ESP_LOGV(TAG,"Msg: %s",http->str().c_str());
   mg_send(m_mgconn, http->str().c_str(), http->str().length());
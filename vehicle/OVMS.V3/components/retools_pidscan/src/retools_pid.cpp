@@ -32,8 +32,13 @@
 #include "ovms_log.h"
 static const char *TAG = "re-pid";
 
+#include <algorithm>
+#include <unistd.h>
+#include "esp_timer.h"
 #include "retools_pid.h"
 #include "vehicle.h"
+#include "ovms_malloc.h"
+#include "ovms_peripherals.h"
 
 namespace {
 
@@ -87,23 +92,35 @@ canbus* GetCan(int bus)
 }
 
 OvmsReToolsPidScanner* s_scanner = nullptr;
+OvmsReToolsPidMultiScanner* s_multiScanner = nullptr;
+
+bool scanRunning(OvmsWriter* writer)
+{
+    if (s_scanner != nullptr && s_scanner->Complete())
+    {
+        delete s_scanner;
+        s_scanner = nullptr;
+    }
+    if (s_multiScanner != nullptr && s_multiScanner->Complete())
+    {
+        delete s_multiScanner;
+        s_multiScanner = nullptr;
+    }
+    if (s_scanner != nullptr || s_multiScanner != nullptr)
+    {
+        writer->puts(
+            "Error: Scan already in progress, stop it or wait for it to complete"
+        );
+        return true;
+    }
+    return false;
+}
 
 void scanStart(int, OvmsWriter* writer, OvmsCommand*, int argc, const char* const* argv)
 {
-    if (s_scanner != nullptr)
+    if (scanRunning(writer))
     {
-        if (s_scanner->Complete())
-        {
-            delete s_scanner;
-            s_scanner = nullptr;
-        }
-        else
-        {
-            writer->puts(
-                "Error: Scan already in progress, stop it or wait for it to complete"
-            );
-            return;
-        }
+        return;
     }
     unsigned long bus = 0, ecu = 0, rxid_low = 0, rxid_high = 0, start = 0, end = 0;
     int timeout = 3;
@@ -234,8 +251,245 @@ void scanStart(int, OvmsWriter* writer, OvmsCommand*, int argc, const char* cons
     }
 }
 
+bool ReadEcuList(const char* value, std::vector<unsigned long>& output)
+{
+    std::string list(value);
+    size_t pos = 0;
+    while (pos <= list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        unsigned long from, to;
+        if (!ReadHexRange(list.substr(pos, end - pos).c_str(), from, to) ||
+            from <= 0 || to >= 0xfff || to < from || output.size() + (to - from) >= 256)
+        {
+            return false;
+        }
+        for (unsigned long ecu = from; ecu <= to; ecu++)
+        {
+            output.push_back(ecu);
+        }
+        pos = end + 1;
+    }
+    return !output.empty();
+}
+
+void scanMulti(int, OvmsWriter* writer, OvmsCommand*, int argc, const char* const* argv)
+{
+    if (scanRunning(writer))
+    {
+        return;
+    }
+    unsigned long bus = 0, start = 0, end = 0, rxoffset = 8;
+    std::vector<unsigned long> ecuids;
+    int timeout = 3, concurrency = 4, interval = 0;
+    unsigned long polltype = VEHICLE_POLL_TYPE_OBDIIEXTENDED;
+    unsigned long step = 1;
+    std::string file;
+    bool valid = true, have_file = false;
+    int argpos = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            switch (argv[i][1])
+            {
+                case 'c':
+                    concurrency = atoi(argv[i]+2);
+                    if (concurrency < 1 || concurrency > ISOTP_MAX_CHANNELS)
+                    {
+                        writer->printf("Error: Invalid concurrency %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                case 'f':
+                    file = argv[i]+2;
+                    have_file = true;
+                    break;
+                case 'i':
+                    interval = atoi(argv[i]+2);
+                    if (interval < 0 || interval > 1000)
+                    {
+                        writer->printf("Error: Invalid request interval %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                case 'o':
+                    if (!ReadHexString(argv[i]+2, rxoffset) || rxoffset > 0x7ff)
+                    {
+                        writer->printf("Error: Invalid RX ID offset %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                case 's':
+                    if (!ReadHexString(argv[i]+2, step) || step < 1 || step > 0xffff)
+                    {
+                        writer->printf("Error: Invalid step size %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                case 't':
+                    if (!ReadHexString(argv[i]+2, polltype) || polltype < 1 || polltype > 0xff)
+                    {
+                        writer->printf("Error: Invalid poll type %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                case 'x':
+                    timeout = atoi(argv[i]+2);
+                    if (timeout < 1 || timeout > 10)
+                    {
+                        writer->printf("Error: Invalid timeout %s\n", argv[i]+2);
+                        valid = false;
+                    }
+                    break;
+                default:
+                    writer->printf("Error: Invalid argument %s\n", argv[i]);
+                    valid = false;
+                    break;
+            }
+        }
+        else
+        {
+            switch (++argpos)
+            {
+                case 1:
+                    if (!ReadHexString(argv[i], bus) || bus < 1 || bus > 4)
+                    {
+                        writer->printf("Error: Invalid bus to scan %s\n", argv[i]);
+                        valid = false;
+                    }
+                    break;
+                case 2:
+                    if (!ReadEcuList(argv[i], ecuids))
+                    {
+                        writer->printf("Error: Invalid ECU Id list to scan %s\n", argv[i]);
+                        valid = false;
+                    }
+                    break;
+                case 3:
+                    if (!ReadHexString(argv[i], start) || start > 0xffff)
+                    {
+                        writer->printf("Error: Invalid Start PID to scan %s\n", argv[i]);
+                        valid = false;
+                    }
+                    break;
+                case 4:
+                    if (!ReadHexString(argv[i], end) || end > 0xffff)
+                    {
+                        writer->printf("Error: Invalid End PID to scan %s\n", argv[i]);
+                        valid = false;
+                    }
+                    break;
+                default:
+                    writer->printf("Error: Invalid argument %s\n", argv[i]);
+                    valid = false;
+                    break;
+            }
+        }
+    }
+    if (start > end)
+    {
+        writer->printf(
+            "Error: Invalid Start PID %04x is after End PID %04x\n", start, end
+        );
+        valid = false;
+    }
+    else if (step > 1)
+    {
+        end = start + ((end - start) / step) * step;
+    }
+    if (POLL_TYPE_HAS_8BIT_PID(polltype) && end > 0xff)
+    {
+        writer->printf("Error: Poll type %x PID range is 00..ff\n", polltype);
+        valid = false;
+    }
+    if (!valid)
+    {
+        return;
+    }
+    canbus* can = GetCan(bus);
+    if (can == nullptr)
+    {
+        writer->puts("CAN not started in active mode, please start and try again");
+        return;
+    }
+    if (!have_file)
+    {
+#ifdef CONFIG_OVMS_COMP_SDCARD
+        if (MyPeripherals->m_sdcard->isavailable())
+        {
+            char name[48];
+            time_t now = time(NULL);
+            struct tm tmu;
+            localtime_r(&now, &tmu);
+            strftime(name, sizeof(name), "/sd/pidscan-%Y%m%d-%H%M%S.txt", &tmu);
+            file = name;
+        }
+#endif // #ifdef CONFIG_OVMS_COMP_SDCARD
+        if (file.empty())
+        {
+            writer->puts("Warning: SD card not available, results will not be saved");
+        }
+    }
+
+    std::vector<OvmsReToolsPidMultiScanner::Ecu> ecus;
+    for (auto ecu : ecuids)
+    {
+        ecus.push_back(OvmsReToolsPidMultiScanner::MakeEcu(ecu, (ecu + rxoffset) & 0xfff, start));
+    }
+    s_multiScanner = new OvmsReToolsPidMultiScanner(can, bus, ecus, polltype, start, end, step, timeout,
+                                                    concurrency, interval, file);
+    if (!s_multiScanner->Begin(false))
+    {
+        writer->puts("Error: cannot start scan, see log for details");
+        delete s_multiScanner;
+        s_multiScanner = nullptr;
+        return;
+    }
+    writer->printf("Scan started: bus %d, %d ECUs, rxid offset %x, polltype %x, PID %x-%x (step %x), "
+                   "max timeout %d seconds, %d parallel, interval %d ms\n",
+                   bus, ecus.size(), rxoffset, polltype, start, end, step, timeout, concurrency, interval);
+    if (!file.empty())
+    {
+        writer->printf("Results file: %s\n", file.c_str());
+    }
+}
+
+void scanResume(int, OvmsWriter* writer, OvmsCommand*, int argc, const char* const* argv)
+{
+    if (scanRunning(writer))
+    {
+        return;
+    }
+    int concurrency = (argc > 1) ? atoi(argv[1]) : 4;
+    int interval = (argc > 2) ? atoi(argv[2]) : 0;
+    if (concurrency < 1 || concurrency > ISOTP_MAX_CHANNELS || interval < 0 || interval > 1000)
+    {
+        writer->printf("Error: concurrency must be 1..%d, interval 0..1000\n", ISOTP_MAX_CHANNELS);
+        return;
+    }
+    s_multiScanner = OvmsReToolsPidMultiScanner::Resume(argv[0], concurrency, interval, writer);
+    if (s_multiScanner)
+    {
+        writer->printf("Scan resumed: PID %x-%x\n", s_multiScanner->Start(), s_multiScanner->End());
+        s_multiScanner->Output(writer, false);
+    }
+}
+
 void scanStatus(int, OvmsWriter* writer, OvmsCommand*, int, const char* const*)
 {
+    if (s_multiScanner != nullptr)
+    {
+        writer->printf("Multi ECU scan %s (%04x-%04x)\n",
+            s_multiScanner->Complete() ? "complete" : "running",
+            s_multiScanner->Start(), s_multiScanner->End());
+        s_multiScanner->Output(writer, true);
+        return;
+    }
     if (s_scanner == nullptr)
     {
         writer->puts("No scan running");
@@ -262,6 +516,15 @@ void scanStatus(int, OvmsWriter* writer, OvmsCommand*, int, const char* const*)
 
 void scanStop(int, OvmsWriter* writer, OvmsCommand*, int, const char* const*)
 {
+    if (s_multiScanner != nullptr)
+    {
+        writer->puts("Scan results:");
+        s_multiScanner->Output(writer, true);
+        delete s_multiScanner;
+        s_multiScanner = nullptr;
+        writer->puts("Scan stopped");
+        return;
+    }
     if (s_scanner == nullptr)
     {
         writer->puts("Error: No scan currently in progress");
@@ -597,6 +860,657 @@ void OvmsReToolsPidScanner::IncomingPollFrame(const CAN_frame_t* frame)
     }
 }
 
+#define PIDSCAN_MIN_TIMEOUT     50000       // min adaptive response timeout [us]
+#define PIDSCAN_RETRY_DELAY     100000      // delay after busy/TX failure [us]
+#define PIDSCAN_PROGRESS_TIME   10000000    // progress checkpoint interval [us]
+#define PIDSCAN_SILENT_SKIP     16          // timeouts until a silent ECU is skipped
+#define PIDSCAN_MAX_TXERRORS    100         // consecutive TX failures until abort
+
+OvmsReToolsPidMultiScanner::Ecu OvmsReToolsPidMultiScanner::MakeEcu(uint16_t txid, uint16_t rxid, int start)
+{
+    Ecu ecu;
+    memset(&ecu, 0, sizeof(ecu));
+    ecu.txid = txid;
+    ecu.rxid = rxid;
+    ecu.nextPid = start;
+    ecu.pid = -1;
+    ecu.channel = -1;
+    return ecu;
+}
+
+OvmsReToolsPidMultiScanner::OvmsReToolsPidMultiScanner(
+        canbus* bus, int busnum, const std::vector<Ecu>& ecus,
+        uint8_t polltype, int start, int end, int step, uint8_t timeout,
+        int concurrency, int interval, const std::string& file) :
+    m_bus(bus),
+    m_busnum(busnum),
+    m_ecus(ecus),
+    m_pollType(polltype),
+    m_startPid(start),
+    m_endPid(end),
+    m_pidStep(step),
+    m_timeout(timeout),
+    m_concurrency(concurrency),
+    m_interval(interval * 1000),
+    m_lastRequest(0),
+    m_txErrors(0),
+    m_nextEcu(0),
+    m_rxbuf(nullptr),
+    m_file(file),
+    m_fp(nullptr),
+    m_lastProgress(0),
+    m_startTime(0),
+    m_lastResponseTime(0),
+    m_task(nullptr),
+    m_rxqueue(nullptr),
+    m_stop(false),
+    m_complete(false),
+    m_found(),
+    m_mutex()
+{
+    if (m_concurrency < 1)
+        m_concurrency = 1;
+    if (m_concurrency > ISOTP_MAX_CHANNELS)
+        m_concurrency = ISOTP_MAX_CHANNELS;
+    m_rxbuf = static_cast<uint8_t*>(ExternalRamMalloc(m_concurrency * ISOTP_MAX_LENGTH));
+    for (int i = 0; i < m_concurrency; i++)
+    {
+        m_channelEcu[i] = -1;
+        m_channel[i].SetRxBuffer(m_rxbuf + i * ISOTP_MAX_LENGTH, m_rxbuf ? ISOTP_MAX_LENGTH : 0);
+        m_channel[i].SetFlowControl(0, 25);
+        m_channel[i].SetCallback(std::bind(
+            &OvmsReToolsPidMultiScanner::ChannelCallback, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3
+        ));
+        m_isotp.Attach(&m_channel[i]);
+    }
+}
+
+OvmsReToolsPidMultiScanner::~OvmsReToolsPidMultiScanner()
+{
+    if (m_task)
+    {
+        m_stop = true;
+        for (int i = 0; m_task && i < 100; i++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+    if (m_rxqueue)
+    {
+        MyCan.DeregisterListener(m_rxqueue);
+        vQueueDelete(m_rxqueue);
+        MyEvents.SignalEvent("retools.pidscan.stop", NULL);
+    }
+    if (m_fp)
+    {
+        fclose(m_fp);
+    }
+    for (int i = 0; i < m_concurrency; i++)
+    {
+        m_isotp.Detach(&m_channel[i]);
+    }
+    free(m_rxbuf);
+}
+
+/**
+ * Begin: open the results file & start scanning
+ *  append: continue an existing results file (resume)
+ */
+bool OvmsReToolsPidMultiScanner::Begin(bool append)
+{
+    if (!m_rxbuf)
+    {
+        ESP_LOGE(TAG, "Out of memory");
+        return false;
+    }
+    if (!m_file.empty())
+    {
+        m_fp = fopen(m_file.c_str(), append ? "a" : "w");
+        if (!m_fp)
+        {
+            ESP_LOGE(TAG, "Cannot open results file '%s'", m_file.c_str());
+            return false;
+        }
+        if (!append)
+        {
+            WriteHeader();
+        }
+    }
+    time(&m_startTime);
+    m_lastProgress = esp_timer_get_time();
+    m_rxqueue = xQueueCreate(40, sizeof(CAN_frame_t));
+    MyCan.RegisterListener(m_rxqueue);
+    MyEvents.SignalEvent("retools.pidscan.start", NULL);
+    xTaskCreatePinnedToCore(
+        &OvmsReToolsPidMultiScanner::Task, "OVMS RE PIDM", 4096, this, 5, &m_task, CORE(1)
+    );
+    return true;
+}
+
+void OvmsReToolsPidMultiScanner::Task(void *self)
+{
+    reinterpret_cast<OvmsReToolsPidMultiScanner*>(self)->Task();
+}
+
+void OvmsReToolsPidMultiScanner::Task()
+{
+    CAN_frame_t frame;
+    TickType_t wait = 0;
+    while (!m_stop)
+    {
+        if (xQueueReceive(m_rxqueue, &frame, wait) == pdTRUE && frame.origin == m_bus)
+        {
+            OvmsMutexLock lock(&m_mutex);
+            m_isotp.IncomingFrame(&frame);
+        }
+
+        OvmsMutexLock lock(&m_mutex);
+        int64_t now = esp_timer_get_time();
+        m_isotp.Process();
+        CheckTimeouts(now);
+        SendRequests(now);
+
+        // Determine the next due time, check for completion:
+        int64_t due = m_isotp.NextDue();
+        bool done = true;
+        bool channelFree = false;
+        for (int i = 0; i < m_concurrency; i++)
+        {
+            if (m_channelEcu[i] < 0)
+                channelFree = true;
+        }
+        for (auto& ecu : m_ecus)
+        {
+            if (ecu.channel >= 0)
+            {
+                done = false;
+                if (ecu.deadline < due)
+                    due = ecu.deadline;
+            }
+            else if (!ecu.skipped && ecu.nextPid <= m_endPid)
+            {
+                done = false;
+                if (!channelFree)
+                    continue;
+                int64_t next = std::max(ecu.notBefore, m_lastRequest + m_interval);
+                if (next < due)
+                    due = next;
+            }
+        }
+        if (done)
+        {
+            WriteProgress();
+            ESP_LOGI(TAG, "Scan of %d ECUs complete", m_ecus.size());
+            m_complete = true;
+            MyEvents.SignalEvent("retools.pidscan.done", NULL);
+            break;
+        }
+        if (m_txErrors > PIDSCAN_MAX_TXERRORS)
+        {
+            ESP_LOGE(TAG, "Error sending frames, terminating scan");
+            WriteProgress();
+            m_complete = true;
+            MyEvents.SignalEvent("retools.pidscan.done", NULL);
+            break;
+        }
+        if (now - m_lastProgress > PIDSCAN_PROGRESS_TIME)
+        {
+            WriteProgress();
+            m_lastProgress = now;
+        }
+
+        // Wait for frames until due, max 100 ms (stop check):
+        if (due <= now)
+            wait = 0;
+        else if (due - now > 100000)
+            wait = pdMS_TO_TICKS(100);
+        else
+            wait = std::max<TickType_t>(1, (due - now) / (1000 * portTICK_PERIOD_MS));
+    }
+    m_task = nullptr;
+    vTaskDelete(NULL);
+}
+
+/**
+ * Timeout: current response timeout for an ECU [us]
+ *  Adapted to the observed latency like TCP's RTO (RFC 6298), the
+ *  configured timeout applies until the first response.
+ */
+int64_t OvmsReToolsPidMultiScanner::Timeout(const Ecu& ecu) const
+{
+    int64_t maxTimeout = m_timeout * 1000000LL;
+    if (ecu.srtt == 0)
+        return maxTimeout;
+    int64_t timeout = ecu.srtt + 4 * ecu.rttvar;
+    if (timeout < PIDSCAN_MIN_TIMEOUT)
+        timeout = PIDSCAN_MIN_TIMEOUT;
+    return std::min(timeout << ecu.retries, maxTimeout);
+}
+
+void OvmsReToolsPidMultiScanner::UpdateLatency(Ecu& ecu, int64_t now)
+{
+    if (ecu.pending)
+        return;
+    int32_t sample = now - ecu.sent;
+    if (ecu.srtt == 0)
+    {
+        ecu.srtt = sample;
+        ecu.rttvar = sample / 2;
+    }
+    else
+    {
+        ecu.rttvar += (abs(ecu.srtt - sample) - ecu.rttvar) / 4;
+        ecu.srtt += (sample - ecu.srtt) / 8;
+    }
+}
+
+void OvmsReToolsPidMultiScanner::ReleaseChannel(Ecu& ecu)
+{
+    if (ecu.channel >= 0)
+    {
+        int ch = ecu.channel;
+        m_channelEcu[ch] = -1;
+        m_channel[ch].Abort();
+    }
+    ecu.channel = -1;
+    ecu.pid = -1;
+}
+
+void OvmsReToolsPidMultiScanner::NextPid(Ecu& ecu, int64_t now)
+{
+    ReleaseChannel(ecu);
+    ecu.retries = 0;
+    ecu.nextPid += m_pidStep;
+    ecu.notBefore = 0;
+}
+
+void OvmsReToolsPidMultiScanner::SendRequests(int64_t now)
+{
+    int busy = 0;
+    for (int i = 0; i < m_concurrency; i++)
+    {
+        if (m_channelEcu[i] >= 0)
+            busy++;
+    }
+
+    size_t count = m_ecus.size();
+    size_t first = m_nextEcu;
+    for (size_t n = 0; n < count && busy < m_concurrency; n++)
+    {
+        if (m_interval && now - m_lastRequest < m_interval)
+            return;
+        size_t index = (first + n) % count;
+        Ecu& ecu = m_ecus[index];
+        if (ecu.skipped || ecu.channel >= 0 || ecu.nextPid > m_endPid || ecu.notBefore > now)
+            continue;
+
+        int ch = 0;
+        while (m_channelEcu[ch] >= 0)
+            ch++;
+
+        uint8_t request[3];
+        uint8_t length;
+        request[0] = m_pollType;
+        if (POLL_TYPE_HAS_16BIT_PID(m_pollType))
+        {
+            request[1] = ecu.nextPid >> 8;
+            request[2] = ecu.nextPid & 0xff;
+            length = 3;
+        }
+        else
+        {
+            request[1] = ecu.nextPid & 0xff;
+            length = 2;
+        }
+
+        m_channel[ch].Configure(m_bus, ecu.txid, ecu.rxid);
+        m_channelEcu[ch] = index;
+        ecu.channel = ch;
+        ecu.pid = ecu.nextPid;
+        ecu.sent = now;
+        ecu.deadline = now + Timeout(ecu);
+        ecu.pending = false;
+        m_lastRequest = now;
+        m_nextEcu = (index + 1) % count;
+
+        // Note: single frame requests are transmitted by Send() directly, a TX failure is
+        //  returned here, not delivered to ChannelCallback()
+        ESP_LOGV(TAG, "Sending request to %x:%x", ecu.txid, ecu.pid);
+        int result = m_channel[ch].Send(request, length);
+        if (result != ISOTP_OK)
+        {
+            ESP_LOGD(TAG, "Error sending request to %x:%x, result %d", ecu.txid, ecu.pid, result);
+            ReleaseChannel(ecu);
+            ecu.notBefore = now + PIDSCAN_RETRY_DELAY;
+            m_txErrors++;
+        }
+        else
+        {
+            ecu.requests++;
+        }
+        if (ecu.channel >= 0)
+            busy++;
+    }
+}
+
+void OvmsReToolsPidMultiScanner::CheckTimeouts(int64_t now)
+{
+    for (auto& ecu : m_ecus)
+    {
+        if (ecu.channel < 0 || ecu.deadline > now)
+            continue;
+        if (m_channel[ecu.channel].IsReceiving())
+            continue; // multi frame response in progress, timeout handled by ISO-TP
+        ESP_LOGD(TAG, "Response timeout for %x:%x after %d ms", ecu.txid, ecu.pid,
+            (int)((now - ecu.sent) / 1000));
+        ReleaseChannel(ecu);
+        if (ecu.retries < 1)
+        {
+            // retry once with doubled timeout:
+            ecu.retries++;
+            continue;
+        }
+        ecu.timeouts++;
+        if (++ecu.silent >= PIDSCAN_SILENT_SKIP && ecu.responses == 0)
+        {
+            ESP_LOGW(TAG, "No response from %x, skipping ECU", ecu.txid);
+            ecu.skipped = true;
+        }
+        NextPid(ecu, now);
+    }
+}
+
+void OvmsReToolsPidMultiScanner::ChannelCallback(canisotp_channel* channel, canisotp_event_t event, int result)
+{
+    int ch = channel - m_channel;
+    if (ch < 0 || ch >= m_concurrency || m_channelEcu[ch] < 0)
+        return;
+    Ecu& ecu = m_ecus[m_channelEcu[ch]];
+    int64_t now = esp_timer_get_time();
+
+    if (event == ISOTP_EVENT_TXDONE)
+    {
+        if (result == ISOTP_OK)
+        {
+            m_txErrors = 0;
+        }
+        else
+        {
+            ESP_LOGD(TAG, "Error sending request to %x:%x, result %d", ecu.txid, ecu.pid, result);
+            ReleaseChannel(ecu);
+            ecu.notBefore = now + PIDSCAN_RETRY_DELAY;
+            m_txErrors++;
+        }
+    }
+    else if (result == ISOTP_OK)
+    {
+        HandleResponse(ch, channel->GetRxData(), channel->GetRxLength());
+    }
+    else
+    {
+        ESP_LOGD(TAG, "Error receiving response from %x:%x, result %d", ecu.txid, ecu.pid, result);
+        ReleaseChannel(ecu);
+        if (ecu.retries < 1)
+            ecu.retries++;
+        else
+            NextPid(ecu, now);
+    }
+}
+
+void OvmsReToolsPidMultiScanner::HandleResponse(int ch, const uint8_t* data, uint16_t length)
+{
+    int index = m_channelEcu[ch];
+    Ecu& ecu = m_ecus[index];
+    int64_t now = esp_timer_get_time();
+
+    if (length >= 3 && data[0] == UDS_RESP_TYPE_NRC && data[1] == m_pollType)
+    {
+        if (data[2] == UDS_RESP_NRC_RCRRP)
+        {
+            // ResponsePending: extend the timeout, keep waiting
+            ESP_LOGD(TAG, "ResponsePending from %x[%x]:%x", ecu.txid, ecu.rxid, ecu.pid);
+            ecu.pending = true;
+            ecu.deadline = now + m_timeout * 1000000LL;
+            return;
+        }
+        UpdateLatency(ecu, now);
+        ecu.responses++;
+        ecu.silent = 0;
+        if (data[2] == UDS_RESP_NRC_BRR)
+        {
+            // BusyRepeatRequest: retry the PID after a delay
+            ESP_LOGD(TAG, "BusyRepeatRequest from %x[%x]:%x", ecu.txid, ecu.rxid, ecu.pid);
+            ReleaseChannel(ecu);
+            ecu.notBefore = now + PIDSCAN_RETRY_DELAY;
+            return;
+        }
+        ESP_LOGV(TAG, "Negative response from %x[%x]:%x code %02x", ecu.txid, ecu.rxid, ecu.pid, data[2]);
+        NextPid(ecu, now);
+    }
+    else if (length >= 2 && data[0] == m_pollType + 0x40)
+    {
+        int offset;
+        uint16_t responsePid;
+        if (POLL_TYPE_HAS_16BIT_PID(m_pollType))
+        {
+            if (length < 3)
+                return;
+            responsePid = data[1] << 8 | data[2];
+            offset = 3;
+        }
+        else
+        {
+            responsePid = data[1];
+            offset = 2;
+        }
+        if (responsePid != ecu.pid)
+        {
+            // late response to a previous request
+            return;
+        }
+        UpdateLatency(ecu, now);
+        ecu.responses++;
+        ecu.silent = 0;
+        ecu.found++;
+        ESP_LOGD(TAG, "Success response from %x[%x]:%x length %d",
+            ecu.txid, ecu.rxid, ecu.pid, length - offset);
+        time(&m_lastResponseTime);
+        m_found[index << 16 | ecu.pid] = std::vector<uint8_t>(data + offset, data + length);
+        WriteResult(index, ecu.pid, data + offset, length - offset);
+        NextPid(ecu, now);
+    }
+}
+
+/**
+ * Results file: text lines, all numbers hexadecimal
+ *   S <bus> <polltype> <start> <end> <step> <timeout>   scan parameters
+ *   E <txid> <rxid>                                     ECU (one line per ECU)
+ *   R <txid> <pid> <data>                               response data
+ *   P <txid> <nextpid> [skip]                           progress checkpoint
+ */
+void OvmsReToolsPidMultiScanner::WriteHeader()
+{
+    fprintf(m_fp, "# OVMS PID scan\nS %x %x %x %x %x %x\n",
+        m_busnum, m_pollType, m_startPid, m_endPid, m_pidStep, m_timeout);
+    for (auto& ecu : m_ecus)
+    {
+        fprintf(m_fp, "E %x %x\n", ecu.txid, ecu.rxid);
+    }
+    fflush(m_fp);
+}
+
+void OvmsReToolsPidMultiScanner::WriteResult(int index, int pid, const uint8_t* data, uint16_t length)
+{
+    if (!m_fp)
+        return;
+    fprintf(m_fp, "R %x %x ", m_ecus[index].txid, pid);
+    for (int i = 0; i < length; i++)
+    {
+        fprintf(m_fp, "%02x", data[i]);
+    }
+    fputc('\n', m_fp);
+    fflush(m_fp);
+}
+
+void OvmsReToolsPidMultiScanner::WriteProgress()
+{
+    if (!m_fp)
+        return;
+    for (auto& ecu : m_ecus)
+    {
+        fprintf(m_fp, "P %x %x%s\n", ecu.txid, ecu.nextPid, ecu.skipped ? " skip" : "");
+    }
+    fflush(m_fp);
+    fsync(fileno(m_fp));
+}
+
+/**
+ * Resume: continue an interrupted scan from its results file
+ */
+OvmsReToolsPidMultiScanner* OvmsReToolsPidMultiScanner::Resume(
+        const std::string& file, int concurrency, int interval, OvmsWriter* writer)
+{
+    FILE* fp = fopen(file.c_str(), "r");
+    if (!fp)
+    {
+        writer->printf("Error: cannot open %s\n", file.c_str());
+        return nullptr;
+    }
+
+    const int linesize = 2 * ISOTP_MAX_LENGTH + 32;
+    char* line = static_cast<char*>(ExternalRamMalloc(linesize));
+    if (!line)
+    {
+        fclose(fp);
+        writer->puts("Error: out of memory");
+        return nullptr;
+    }
+
+    unsigned int bus = 0, polltype = 0, start = 0, end = 0, step = 0, timeout = 0;
+    bool header = false;
+    std::vector<Ecu> ecus;
+    std::map<uint32_t, std::vector<uint8_t>> found;
+    while (fgets(line, linesize, fp))
+    {
+        unsigned int txid, rxid, pid;
+        int pos;
+        if (line[0] == 'S')
+        {
+            header = (sscanf(line, "S %x %x %x %x %x %x", &bus, &polltype, &start, &end, &step, &timeout) == 6);
+        }
+        else if (line[0] == 'E' && sscanf(line, "E %x %x", &txid, &rxid) == 2)
+        {
+            ecus.push_back(MakeEcu(txid, rxid, start));
+        }
+        else if (line[0] == 'R' && sscanf(line, "R %x %x %n", &txid, &pid, &pos) == 2)
+        {
+            for (size_t i = 0; i < ecus.size(); i++)
+            {
+                if (ecus[i].txid != txid)
+                    continue;
+                std::vector<uint8_t> data;
+                unsigned int byte;
+                for (const char* p = line + pos; sscanf(p, "%2x", &byte) == 1; p += 2)
+                {
+                    data.push_back(byte);
+                }
+                found[i << 16 | pid] = std::move(data);
+                break;
+            }
+        }
+        else if (line[0] == 'P' && sscanf(line, "P %x %x", &txid, &pid) == 2)
+        {
+            for (auto& ecu : ecus)
+            {
+                if (ecu.txid != txid)
+                    continue;
+                ecu.nextPid = pid;
+                ecu.skipped = (strstr(line, "skip") != NULL);
+                break;
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+
+    if (!header || ecus.empty() || step < 1 || timeout < 1)
+    {
+        writer->printf("Error: %s is no valid scan results file\n", file.c_str());
+        return nullptr;
+    }
+    canbus* can = GetCan(bus);
+    if (can == nullptr)
+    {
+        writer->puts("CAN not started in active mode, please start and try again");
+        return nullptr;
+    }
+
+    for (auto& result : found)
+    {
+        ecus[result.first >> 16].found++;
+    }
+    auto scanner = new OvmsReToolsPidMultiScanner(can, bus, ecus, polltype, start, end, step, timeout,
+                                                  concurrency, interval, file);
+    scanner->m_found = std::move(found);
+    if (!scanner->Begin(true))
+    {
+        writer->puts("Error: cannot start scan");
+        delete scanner;
+        return nullptr;
+    }
+    return scanner;
+}
+
+void OvmsReToolsPidMultiScanner::Output(OvmsWriter* writer, bool results) const
+{
+    OvmsMutexLock lock(&m_mutex);
+    struct tm tmu;
+    char tb[64];
+
+    localtime_r(&m_startTime, &tmu);
+    strftime(tb, sizeof(tb), "%Y-%m-%d %H:%M:%S %Z", &tmu);
+    writer->printf("Scan started : %s\n", tb);
+    if (m_lastResponseTime)
+    {
+        localtime_r(&m_lastResponseTime, &tmu);
+        strftime(tb, sizeof(tb), "%Y-%m-%d %H:%M:%S %Z", &tmu);
+        writer->printf("Last response: %s\n", tb);
+    }
+    if (!m_file.empty())
+    {
+        writer->printf("Results file : %s\n", m_file.c_str());
+    }
+
+    int range = (m_endPid - m_startPid) / m_pidStep + 1;
+    for (auto& ecu : m_ecus)
+    {
+        int done = (std::min(ecu.nextPid, m_endPid + m_pidStep) - m_startPid) / m_pidStep;
+        writer->printf("%03x[%03x]: %3d%%  %5u req  %5u resp  %4u timeouts  rtt %5.1f ms  timeout %5.1f ms  %4u found%s\n",
+            ecu.txid, ecu.rxid, done * 100 / range, ecu.requests, ecu.responses, ecu.timeouts,
+            (double)ecu.srtt / 1000, (double)Timeout(ecu) / 1000, ecu.found,
+            ecu.skipped ? "  (skipped: no response)" : "");
+    }
+
+    if (!results)
+        return;
+    if (m_found.empty())
+    {
+        writer->puts("No valid responses received.");
+        return;
+    }
+    for (auto& found : m_found)
+    {
+        const Ecu& ecu = m_ecus[found.first >> 16];
+        writer->printf("%03x[%03x]:%04x", ecu.txid, ecu.rxid, found.first & 0xffff);
+        for (auto& byte : found.second)
+        {
+            writer->printf(" %02x", byte);
+        }
+        writer->printf("\n");
+    }
+}
+
 class OvmsReToolsPidScannerInit
   {
   public:
@@ -622,6 +1536,22 @@ OvmsReToolsPidScannerInit::OvmsReToolsPidScannerInit()
         "Default <timeout> is 3 seconds.",
         4, 8
     );
+    cmd_scan->RegisterCommand(
+        "multi", "Pipelined scan of PIDs on multiple ECUs", &scanMulti,
+        "<bus> <ecu>[-<ecu>][,…] <start_pid> <end_pid> [-s<pid_step>] [-t<poll_type>] [-x<timeout>]\n"
+        "  [-o<rxid_offset>] [-c<concurrency>] [-i<interval>] [-f<file>]\n"
+        "Give all values except bus, timeout, concurrency and interval hexadecimal.\n"
+        "Up to 256 ECUs, one request per ECU outstanding, <concurrency> ECUs in parallel (1-8, default 4).\n"
+        "Default <rxid_offset> is 8 (response ID = <ecu>+8).\n"
+        "Default <timeout> is 3 seconds, adapted to the response times of each ECU.\n"
+        "<interval> is the min time between requests in ms, default 0.\n"
+        "Default <file> is /sd/pidscan-<date>-<time>.txt, give -f without name to disable.",
+        4, 12
+    );
+    cmd_scan->RegisterCommand(
+        "resume", "Resume an interrupted multi ECU scan", &scanResume,
+        "<file> [<concurrency>] [<interval>]", 1, 3
+    );
     cmd_scan->RegisterCommand("status", "The status of the PID scan", &scanStatus);
     cmd_scan->RegisterCommand("stop", "Stop the current scan", &scanStop);
 }
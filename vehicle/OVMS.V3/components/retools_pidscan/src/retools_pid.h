@@ -33,6 +33,7 @@
 #define __RE_TOOLS_PID_H__
 
 #include "can.h"
+#include "canisotp.h"
 
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -40,7 +41,10 @@
 #include <functional>
 #include <vector>
 #include <tuple>
+#include <map>
+#include <string>
 #include <time.h>
+#include <stdio.h>
 
 class OvmsReToolsPidScanner
 {
@@ -109,4 +113,116 @@ class OvmsReToolsPidScanner
     mutable OvmsMutex m_foundMutex;
 };
 
+/// Pipelined scan of multiple ECUs: one request outstanding per ECU, up to
+/// ISOTP_MAX_CHANNELS ECUs in parallel, response timeouts adapted to the
+/// observed latency per ECU. Results and progress are appended to a text
+/// file, so an interrupted scan can be resumed.
+class OvmsReToolsPidMultiScanner
+{
+  public:
+    struct Ecu
+    {
+        /// Request & response CAN IDs
+        uint16_t txid;
+        uint16_t rxid;
+        /// Next PID to request, > end PID = done
+        int nextPid;
+        /// PID currently requested, -1 = none
+        int pid;
+        /// Channel used for the current request, -1 = none
+        int channel;
+        /// Retries of the current PID
+        uint8_t retries;
+        /// Request send time, response deadline & earliest next request [us]
+        int64_t sent;
+        int64_t deadline;
+        int64_t notBefore;
+        /// Smoothed response time & variance [us], 0 = no sample yet
+        int32_t srtt;
+        int32_t rttvar;
+        /// Statistics
+        uint32_t requests;
+        uint32_t responses;
+        uint32_t timeouts;
+        uint32_t found;
+        /// Consecutive timeouts, ECU is skipped if it never responded
+        uint16_t silent;
+        bool skipped;
+        /// ResponsePending received for the current request
+        bool pending;
+    };
+
+  public:
+    OvmsReToolsPidMultiScanner(canbus* bus, int busnum, const std::vector<Ecu>& ecus,
+                               uint8_t polltype, int start, int end, int step, uint8_t timeout,
+                               int concurrency, int interval, const std::string& file);
+    ~OvmsReToolsPidMultiScanner();
+
+    bool Begin(bool append);
+    static OvmsReToolsPidMultiScanner* Resume(const std::string& file, int concurrency,
+                                              int interval, OvmsWriter* writer);
+    static Ecu MakeEcu(uint16_t txid, uint16_t rxid, int start);
+
+    bool Complete() const { return m_complete; }
+    int Start() const { return m_startPid; }
+    int End() const { return m_endPid; }
+    const std::string& File() const { return m_file; }
+
+    void Output(OvmsWriter* writer, bool results) const;
+
+  private:
+    static void Task(void *self);
+    void Task();
+
+    void ChannelCallback(canisotp_channel* channel, canisotp_event_t event, int result);
+    void HandleResponse(int ch, const uint8_t* data, uint16_t length);
+    void SendRequests(int64_t now);
+    void CheckTimeouts(int64_t now);
+    void NextPid(Ecu& ecu, int64_t now);
+    void UpdateLatency(Ecu& ecu, int64_t now);
+    int64_t Timeout(const Ecu& ecu) const;
+    void ReleaseChannel(Ecu& ecu);
+    void WriteHeader();
+    void WriteProgress();
+    void WriteResult(int ecuindex, int pid, const uint8_t* data, uint16_t length);
+
+    canbus* m_bus;
+    int m_busnum;
+    /// The ECUs to scan
+    std::vector<Ecu> m_ecus;
+    uint8_t m_pollType;
+    int m_startPid;
+    int m_endPid;
+    int m_pidStep;
+    /// Max response timeout in seconds
+    uint8_t m_timeout;
+    /// Max requests outstanding
+    int m_concurrency;
+    /// Min request interval [us]
+    int m_interval;
+    int64_t m_lastRequest;
+    /// Consecutive CAN transmission failures
+    int m_txErrors;
+    /// Round robin ECU index for the next request
+    size_t m_nextEcu;
+    /// ISO-TP engine & channels, channel → ECU index map
+    canisotp m_isotp;
+    canisotp_channel m_channel[ISOTP_MAX_CHANNELS];
+    int m_channelEcu[ISOTP_MAX_CHANNELS];
+    uint8_t* m_rxbuf;
+    /// Results file
+    std::string m_file;
+    FILE* m_fp;
+    int64_t m_lastProgress;
+    time_t m_startTime;
+    time_t m_lastResponseTime;
+    TaskHandle_t m_task;
+    QueueHandle_t m_rxqueue;
+    volatile bool m_stop;
+    volatile bool m_complete;
+    /// The found PIDs: (ECU index << 16 | PID) → response data
+    std::map<uint32_t, std::vector<uint8_t>> m_found;
+    mutable OvmsMutex m_mutex;
+};
+
 #endif  // __RE_TOOLS_PID_H__
@@ -257,6 +257,7 @@ OvmsVehicle::OvmsVehicle()
   m_poll_plist = NULL;
   m_poll_plcur = NULL;
   m_poll_ticker = 0;
+  m_poll_ticker_wrap = 3600;
   m_poll_single_rxbuf = NULL;
   m_poll_single_rxerr = 0;
   m_poll_moduleid_sent = 0;
@@ -271,6 +272,32 @@ OvmsVehicle::OvmsVehicle()
   m_poll_sequence_max = 1;
   m_poll_sequence_cnt = 0;
   m_poll_fc_septime = 25;       // response default timing: 25 milliseconds
+  m_poll_concurrency = 1;
+  m_poll_session_cnt = 0;
+  memset(m_poll_session, 0, sizeof(m_poll_session));
+  m_poll_due_cnt = 0;
+  m_poll_due_valid = false;
+  m_poll_tick_ms = 1000;
+  m_poll_timeout_ms = 1000;
+  m_poll_pending_ms = 5000;
+  m_poll_timer = NULL;
+  m_poll_tick_pending = false;
+  m_poll_assemble = false;
+  m_poll_adaptive = false;
+  m_poll_adaptive_loadmax = 50;
+  m_poll_sequence_base = m_poll_sequence_max;
+  m_poll_throttled = false;
+  m_poll_sent_us = 0;
+  memset(m_poll_can_frames, 0, sizeof(m_poll_can_frames));
+  m_poll_can_rxoverflow = 0;
+  m_poll_overruns = 0;
+  m_poll_latency = 0;
+  m_poll_metric_rate = NULL;
+  m_poll_metric_latency = NULL;
+  m_poll_metric_canload = NULL;
+  m_poll_metric_throttle = NULL;
+  m_poll_metric_pidrate = NULL;
+  m_poll_metric_pidlatency = NULL;
 
   m_bms_voltages = NULL;
   m_bms_vmins = NULL;
@@ -411,11 +438,19 @@ OvmsVehicle::~OvmsVehicle()
     m_registeredlistener = false;
     }
 
+  if (m_poll_timer)
+    {
+    xTimerStop(m_poll_timer, 0);
+    xTimerDelete(m_poll_timer, 0);
+    m_poll_timer = NULL;
+    }
+
   vQueueDelete(m_rxqueue);
   vTaskDelete(m_rxtask);
 
   MyEvents.DeregisterEvent(TAG);
   MyMetrics.DeregisterListener(TAG);
+  PollerDeleteMetrics();
   }
 
 const char* OvmsVehicle::VehicleShortName()
@@ -436,9 +471,23 @@ void OvmsVehicle::RxTask()
     {
     if (xQueueReceive(m_rxqueue, &frame, (portTickType)portMAX_DELAY)==pdTRUE)
       {
+      if (frame.origin == NULL)
+        {
+        // Poll tick from PollerTimerTick():
+        m_poll_tick_pending = false;
+        if (m_ready)
+          PollerSend(true);
+        continue;
+        }
       if (!m_ready)
         continue;
-      if (m_poll_wait && frame.origin == m_poll_bus && m_poll_plist)
+      if (m_poll_concurrency > 1)
+        {
+        // Concurrent poller: PollerReceiveSession() looks up the session
+        if (m_poll_session_cnt && m_poll_plist)
+          PollerReceiveSession(&frame);
+        }
+      else if (m_poll_wait && frame.origin == m_poll_bus && m_poll_plist)
         {
         // This is a quick filter check to see if the frame is possibly intended for our poller.
         // The filter will be checked again in PollerReceive() after locking the mutex.
@@ -533,7 +582,10 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
   m_ticker++;
 
   PollerStateTicker();
-  PollerSend(true);
+  if (m_poll_adaptive)
+    PollerAdaptiveTicker();
+  if (!m_poll_timer)
+    PollerSend(true);
 
   Ticker1(m_ticker);
   if ((m_ticker % 10) == 0) Ticker10(m_ticker);
@@ -34,7 +34,9 @@
 #include <map>
 #include <vector>
 #include <string>
+#include "freertos/timers.h"
 #include "can.h"
+#include "canisotp.h"
 #include "ovms_events.h"
 #include "ovms_config.h"
 #include "ovms_metrics.h"
@@ -47,18 +49,6 @@ using namespace std;
 struct DashboardConfig;
 
 
-// ISO TP:
-//  (see https://en.wikipedia.org/wiki/ISO_15765-2)
-
-#define ISOTP_FT_SINGLE                 0
-#define ISOTP_FT_FIRST                  1
-#define ISOTP_FT_CONSECUTIVE            2
-#define ISOTP_FT_FLOWCTRL               3
-
-// Protocol variant:
-#define ISOTP_STD                       0     // standard addressing (11 bit IDs)
-#define ISOTP_EXTADR                    1     // extended addressing (19 bit IDs)
-
 // OBD2/UDS Polling types supported:
 //  (see https://en.wikipedia.org/wiki/OBD-II_PIDs
 //   and https://en.wikipedia.org/wiki/Unified_Diagnostic_Services)
@@ -130,11 +120,15 @@ struct DashboardConfig;
 
 // OBD/UDS Negative Response Code
 #define UDS_RESP_TYPE_NRC               0x7F  // see ISO 14229 Annex A.1
+#define UDS_RESP_NRC_BRR                0x21  // … busyRepeatRequest
 #define UDS_RESP_NRC_RCRRP              0x78  // … requestCorrectlyReceived-ResponsePending
 
 // Number of polling states supported
 #define VEHICLE_POLL_NSTATES            4
 
+// Maximum number of concurrent poll sessions (see PollSetConcurrency())
+#define VEHICLE_POLL_MAXSESSIONS        8
+
 // Macro for poll_pid_t termination
 #define POLL_LIST_END                   { 0, 0, 0x00, 0x00, { 0, 0, 0 }, 0, 0 }
 
@@ -212,6 +206,11 @@ class OvmsVehicle : public InternalRamAllocated
     void VehicleConfigChanged(std::string event, void* data);
     void PollerSend(bool fromTicker);
     void PollerReceive(CAN_frame_t* frame, uint32_t msgid);
+    void PollerDispatch();
+    void PollerReceiveSession(CAN_frame_t* frame);
+
+  public:
+    void PollerTimerTick();
 
   protected:
     virtual void IncomingFrameCan1(CAN_frame_t* p_frame);
@@ -223,6 +222,7 @@ class OvmsVehicle : public InternalRamAllocated
     virtual void PollerStateTicker();
     virtual void IncomingPollReply(canbus* bus, uint16_t type, uint16_t pid, uint8_t* data, uint8_t length, uint16_t mlremain);
     virtual void IncomingPollError(canbus* bus, uint16_t type, uint16_t pid, uint16_t code);
+    virtual void IncomingPollResponse(canbus* bus, uint16_t type, uint16_t pid, const uint8_t* data, uint16_t length);
 
   protected:
     int m_minsoc;            // The minimum SOC level before alert
@@ -411,7 +411,7 @@ class OvmsVehicle : public InternalRamAllocated
           uint8_t data[6];                      // payload data
           } args;
         };
-      uint16_t polltime[VEHICLE_POLL_NSTATES];  // poll intervals in seconds for used poll states
+      uint16_t polltime[VEHICLE_POLL_NSTATES];  // poll intervals in seconds (ticks, see PollSetTicker()) for used poll states
       uint8_t  pollbus;                         // 0 = default CAN bus from PollSetPidList(), 1…4 = specific
       uint8_t  protocol;                        // ISOTP_STD / ISOTP_EXTADR
       } poll_pid_t;
@@ -433,16 +433,114 @@ class OvmsVehicle : public InternalRamAllocated
     uint16_t          m_poll_ml_remain;       // Bytes remaining for ML poll
     uint16_t          m_poll_ml_offset;       // Offset of ML poll
     uint16_t          m_poll_ml_frame;        // Frame number for ML poll
-    uint8_t           m_poll_wait;            // Wait counter for a reply from a sent poll or bytes remaining.
-                                              // Gets set = 2 when a poll is sent OR when bytes are remaining after receiving.
+    uint16_t          m_poll_wait;            // Wait counter for a reply from a sent poll or bytes remaining.
+                                              // Gets set = PollerWaitTicks(m_poll_timeout_ms) when a poll is sent OR when bytes
+                                              //   are remaining after receiving, extended to m_poll_pending_ms on ResponsePending.
                                               // Gets set = 0 when a poll is received.
-                                              // Gets decremented with every second/tick in PollerSend().
+                                              // Gets decremented with every tick in PollerSend().
                                               // PollerSend() aborts when > 0.
-                                              // Why set = 2: When a poll gets send just before the next ticker occurs
-                                              //              PollerSend() decrements to 1 and doesn't send the next poll.
-                                              //              Only when the reply doesn't get in until the next ticker occurs
+                                              // Why one tick more: When a poll gets send just before the next ticker occurs
+                                              //              PollerSend() decrements right away and doesn't send the next poll.
+                                              //              Only when the reply doesn't get in until the last tick occurs
                                               //              PollserSend() decrements to 0 and abandons the outstanding reply (=timeout)
 
+  public:
+    typedef struct
+      {
+      bool              active;               // session in use
+      canbus*           bus;                  // bus polled on
+      const poll_pid_t* entry;                // poll list entry requested
+      uint8_t           protocol;             // ISOTP_STD / ISOTP_EXTADR
+      uint32_t          moduleid_sent;        // request ID (0x7df = broadcast)
+      uint32_t          moduleid_low;         // expected response ID range
+      uint32_t          moduleid_high;        // …
+      uint32_t          txmsgid;              // request frame MsgID
+      uint16_t          type;                 // expected type
+      uint16_t          pid;                  // expected PID
+      uint16_t          ml_remain;            // bytes remaining for ML response
+      uint16_t          ml_offset;            // offset of ML response frame
+      uint16_t          ml_frame;             // frame number of ML response
+      uint16_t          wait;                 // timeout counter (ticks), see m_poll_wait
+      uint32_t          sent_us;              // request transmission time (esp_timer µs)
+      } poll_session_t;
+
+  private:
+    uint8_t           m_poll_concurrency;     // Max concurrent sessions, 1 = sequential poller (default)
+    poll_session_t    m_poll_session[VEHICLE_POLL_MAXSESSIONS]; // Concurrent mode: sessions per (bus, txid)
+    uint8_t           m_poll_session_cnt;     // … active sessions
+    std::vector<const poll_pid_t*> m_poll_due; // … poll entries due in the current cycle, sent = NULL
+    size_t            m_poll_due_cnt;         // … entries in m_poll_due not yet sent
+    bool              m_poll_due_valid;       // … m_poll_due has been filled for m_poll_ticker
+
+  private:
+    uint16_t          m_poll_tick_ms;         // Poll tick period in ms, default 1000 = ticker.1 event
+    uint16_t          m_poll_timeout_ms;      // Response timeout in ms, default 1000
+    uint16_t          m_poll_pending_ms;      // … timeout after a ResponsePending NRC (UDS P2*), default 5000
+    TimerHandle_t     m_poll_timer;           // … timer for sub second ticks
+    volatile bool     m_poll_tick_pending;    // … tick queued to the vehicle task
+    std::vector<uint16_t> m_poll_phase;       // … tick offsets per poll list entry (sub second ticks)
+    uint32_t          m_poll_ticker_wrap;     // … m_poll_ticker period: LCM of 3600 & poll intervals, 0 = none
+
+  private:
+    bool              m_poll_assemble;        // Deliver complete responses via IncomingPollResponse()
+    std::map<uint64_t, std::vector<uint8_t>> m_poll_rxbuf; // … response buffers per (rxid, type, pid)
+
+  public:
+    typedef struct
+      {
+      float             latency;              // average response latency [ms]
+      uint32_t          responses;            // responses received
+      uint32_t          overruns;             // timeouts, aborted transfers & busy NRCs
+      uint8_t           septime;              // flow control separation time in use
+      uint8_t           goodcnt;              // multi frame responses since last septime change
+      } poll_ecu_stat_t;
+    typedef struct
+      {
+      float             latency;              // average response latency [ms]
+      uint32_t          responses;            // responses received
+      uint32_t          responses_last;       // … at last rate update
+      float             rate;                 // achieved response rate [1/s]
+      } poll_pid_stat_t;
+
+  private:
+    bool              m_poll_adaptive;        // Adaptive throttling & flow control enabled
+    uint8_t           m_poll_adaptive_loadmax; // … max bus load [%]
+    uint8_t           m_poll_sequence_base;   // … throttling configured by PollSetThrottling()
+    bool              m_poll_throttled;       // … requests were held back by the throttling limit
+    uint32_t          m_poll_sent_us;         // … current request transmission time (esp_timer µs)
+    uint32_t          m_poll_can_frames[4];   // … bus frame counters at last update
+    uint32_t          m_poll_can_rxoverflow;  // … bus RX buffer overflows at last update
+    uint32_t          m_poll_overruns;        // … overruns since last update
+    float             m_poll_latency;         // … average response latency [ms]
+    std::map<uint32_t, poll_ecu_stat_t> m_poll_ecu_stats; // … per ECU (txid)
+    std::map<uint64_t, poll_pid_stat_t> m_poll_pid_stats; // … per request (txid, type, pid)
+    OvmsMetricFloat*  m_poll_metric_rate;     // … v.poll.rate: responses per second
+    OvmsMetricFloat*  m_poll_metric_latency;  // … v.poll.latency: average latency [ms]
+    OvmsMetricFloat*  m_poll_metric_canload;  // … v.poll.canload: max load of the polled buses [%]
+    OvmsMetricInt*    m_poll_metric_throttle; // … v.poll.throttle: current sequence limit
+    OvmsMetricVector<float>* m_poll_metric_pidrate;    // … v.poll.pid.rate: per poll list entry [1/s]
+    OvmsMetricVector<float>* m_poll_metric_pidlatency; // … v.poll.pid.latency: per poll list entry [ms]
+
+  private:
+    void PollerEntryAddress(const poll_pid_t* entry, canbus*& bus,
+      uint32_t& moduleid_sent, uint32_t& moduleid_low, uint32_t& moduleid_high);
+    void PollerPrepareFrame(const poll_pid_t* entry, CAN_frame_t* txframe);
+    void PollerResetSessions();
+    void PollerDeleteMetrics();
+    poll_session_t* PollerFindSession(const CAN_frame_t* frame, uint32_t& msgid);
+    void PollerLoadSession(const poll_session_t* session);
+    void PollerSaveSession(poll_session_t* session);
+    void PollerUpdatePhases();
+    void PollerNextTick();
+    bool PollerIsDue(const poll_pid_t* entry);
+    uint16_t PollerWaitTicks(uint32_t timeout_ms);
+    void PollerAssembleResponse(canbus* bus, uint32_t msgid, const uint8_t* data, uint16_t length);
+    void PollerAdaptiveTicker();
+    void PollerRecordResponse();
+    void PollerRecordOverrun();
+    void PollerRecordTransfer();
+    uint8_t PollerGetSeptime(uint32_t txid);
+
   private:
     uint8_t           m_poll_sequence_max;    // Polls allowed to be sent in sequence per time tick (second), default 1, 0 = no limit
     uint8_t           m_poll_sequence_cnt;    // Polls already sent in the current time tick (second)
@@ -458,7 +556,12 @@ class OvmsVehicle : public InternalRamAllocated
     void PollSetPidList(canbus* bus, const poll_pid_t* plist);
     void PollSetState(uint8_t state);
     void PollSetThrottling(uint8_t sequence_max);
+    void PollSetConcurrency(uint8_t sessions);
+    void PollSetTicker(uint16_t tick_time_ms);
+    void PollSetResponseAssembly(bool assemble);
+    void PollSetAdaptiveThrottling(bool adaptive, uint8_t loadmax=50);
     void PollSetResponseSeparationTime(uint8_t septime);
+    void PollSetResponseTimeouts(uint16_t timeout_ms, uint16_t pending_ms=5000);
     int PollSingleRequest(canbus* bus, uint32_t txid, uint32_t rxid,
                       std::string request, std::string& response,
                       int timeout_ms=100, uint8_t protocol=ISOTP_STD);
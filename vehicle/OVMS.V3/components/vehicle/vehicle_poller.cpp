@@ -33,6 +33,7 @@ static const char *TAG = "vehicle";
 
 #include <stdio.h>
 #include <algorithm>
+#include "esp_timer.h"
 #include <ovms_command.h>
 #include <ovms_script.h>
 #include <ovms_metrics.h>
@@ -90,6 +91,36 @@ void OvmsVehicle::IncomingPollReply(canbus* bus, uint16_t type, uint16_t pid, ui
   }
 
 
+/**
+ * IncomingPollResponse: complete poll response handler (stub, override with vehicle implementation)
+ *  This is called by PollerReceive() instead of IncomingPollReply() if response assembly
+ *  has been enabled by PollSetResponseAssembly(). The handler is called once per response
+ *  with the complete payload, so it can be decoded in one pass at fixed offsets.
+ *  
+ *  The data buffer is owned by the poller and reused for the next response to the same
+ *  request; it's only valid during the call.
+ *  
+ *  @param bus
+ *    CAN bus the current poll is done on
+ *  @param type
+ *    OBD2 mode / UDS polling type, e.g. VEHICLE_POLL_TYPE_READDTC
+ *  @param pid
+ *    PID addressed (depending on the request type, may be none / 8 bit / 16 bit)
+ *  @param data
+ *    Response payload (without type & PID)
+ *  @param length
+ *    Payload size
+ *  
+ *  @member m_poll_moduleid_sent
+ *    The CAN ID addressed by the current request (txmoduleid)
+ *  @member m_poll_plcur
+ *    Pointer to the currently processed poll entry
+ */
+void OvmsVehicle::IncomingPollResponse(canbus* bus, uint16_t type, uint16_t pid, const uint8_t* data, uint16_t length)
+  {
+  }
+
+
 /**
  * IncomingPollError: poll response error handler (stub, override with vehicle implementation)
  *  This is called by PollerReceive() on reception of an OBD/UDS Negative Response Code (NRC),
@@ -162,6 +193,8 @@ void OvmsVehicle::PollSetPidList(canbus* bus, const poll_pid_t* plist)
   m_poll_wait = 0;
   m_poll_plcur = NULL;
   m_poll_txmsgid = 0;
+  PollerResetSessions();
+  PollerUpdatePhases();
   }
 
 
@@ -186,25 +219,603 @@ void OvmsVehicle::PollSetState(uint8_t state)
     m_poll_wait = 0;
     m_poll_plcur = NULL;
     m_poll_txmsgid = 0;
+    PollerResetSessions();
+    PollerUpdatePhases();
     }
   }
 
 
 /**
  * PollSetThrottling: configure polling speed / niceness
- *  If multiple requests are due at the same poll tick (second), this controls how many of
+ *  If multiple requests are due at the same poll tick (second, see PollSetTicker()), this controls how many of
  *  them will be sent in series without a delay, i.e. as soon as the response/timeout for
  *  the previous request occurred.
  *  
  *  @param sequence_max
- *    Polls allowed to be sent in sequence per time tick (second), default 1, 0 = no limit.
+ *    Polls allowed to be sent in sequence per time tick, default 1, 0 = no limit.
  *  
  *  The configuration is kept unchanged over calls to PollSetPidList() or PollSetState().
+ *  With adaptive throttling enabled, this sets the initial limit, see PollSetAdaptiveThrottling().
  */
 void OvmsVehicle::PollSetThrottling(uint8_t sequence_max)
   {
   OvmsRecMutexLock lock(&m_poll_mutex);
   m_poll_sequence_max = sequence_max;
+  m_poll_sequence_base = sequence_max;
+  }
+
+
+/**
+ * PollSetConcurrency: configure concurrent polling of multiple ECUs
+ *  By default, the poller processes one request at a time, i.e. waits for the response
+ *  (or timeout) before sending the next request, regardless of the ECU addressed.
+ *  
+ *  With concurrency > 1, the poller keeps an independent ISO-TP session per bus and
+ *  module ID, so requests to different ECUs (and/or buses) overlap. Requests to the same
+ *  ECU (or overlapping response ID ranges, e.g. broadcasts) are still sent in sequence,
+ *  in poll list order. Response timeouts are tracked per session, and the throttling
+ *  limit (see PollSetThrottling()) applies to the sum of requests sent on all sessions.
+ *  
+ *  The current poll state (m_poll_type, m_poll_pid, m_poll_moduleid_sent, m_poll_ml_…)
+ *  is set to the session of the response while IncomingPollReply() / IncomingPollError()
+ *  are called, so response handlers normally don't need to be changed.
+ *  
+ *  @param sessions
+ *    Maximum number of concurrent sessions: 1 = sequential poller (default),
+ *    up to VEHICLE_POLL_MAXSESSIONS.
+ *  
+ *  The configuration is kept unchanged over calls to PollSetPidList() or PollSetState().
+ */
+void OvmsVehicle::PollSetConcurrency(uint8_t sessions)
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  if (sessions < 1) sessions = 1;
+  if (sessions > VEHICLE_POLL_MAXSESSIONS) sessions = VEHICLE_POLL_MAXSESSIONS;
+  if (sessions == m_poll_concurrency) return;
+  m_poll_concurrency = sessions;
+  m_poll_wait = 0;
+  PollerResetSessions();
+  }
+
+
+static void OvmsVehiclePollTimer(TimerHandle_t timer)
+  {
+  OvmsVehicle* vehicle = (OvmsVehicle*) pvTimerGetTimerID(timer);
+  vehicle->PollerTimerTick();
+  }
+
+
+/**
+ * PollSetTicker: configure the poll tick period
+ *  By default, the poller is driven by the "ticker.1" event, so poll intervals
+ *  (poll_pid_t.polltime) are counted in seconds and no PID can be polled faster
+ *  than once per second.
+ *  
+ *  With a period below 1000 ms, the poller runs on its own timer, and the poll
+ *  intervals are counted in ticks of that period. Example: with a tick time of
+ *  100 ms, polltime 2 = 5 Hz, polltime 10 = 1 Hz, polltime 600 = once per minute.
+ *  
+ *  In this mode, entries sharing the same interval are spread evenly across their
+ *  period by assigning a tick offset to each of them (in poll list order), so
+ *  requests don't burst at the start of a period. The tick is processed by the
+ *  vehicle task, so the timer and event tasks are not blocked by the bus.
+ *  
+ *  Note: the response timeouts are kept in milliseconds (see PollSetResponseTimeouts()),
+ *  the throttling limit (see PollSetThrottling()) applies per tick. PollerStateTicker()
+ *  is still called once per second.
+ *  
+ *  @param tick_time_ms
+ *    Tick period in milliseconds: 10 … 1000, 1000 = per second (default).
+ *  
+ *  The poll list is restarted. The configuration is kept unchanged over calls to
+ *  PollSetPidList() or PollSetState().
+ */
+void OvmsVehicle::PollSetTicker(uint16_t tick_time_ms)
+  {
+  OvmsRecMutexLock slock(&m_poll_single_mutex);
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  if (tick_time_ms < 10) tick_time_ms = 10;
+  if (tick_time_ms > 1000) tick_time_ms = 1000;
+  if (tick_time_ms == m_poll_tick_ms) return;
+  m_poll_tick_ms = tick_time_ms;
+
+  if (m_poll_tick_ms < 1000)
+    {
+    if (!m_poll_timer)
+      {
+      m_poll_timer = xTimerCreate("Vehicle poll ticker", pdMS_TO_TICKS(m_poll_tick_ms),
+                                  pdTRUE, this, OvmsVehiclePollTimer);
+      xTimerStart(m_poll_timer, 0);
+      }
+    else
+      {
+      xTimerChangePeriod(m_poll_timer, pdMS_TO_TICKS(m_poll_tick_ms), 0);
+      }
+    }
+  else if (m_poll_timer)
+    {
+    xTimerStop(m_poll_timer, 0);
+    xTimerDelete(m_poll_timer, 0);
+    m_poll_timer = NULL;
+    }
+
+  m_poll_ticker = 0;
+  m_poll_sequence_cnt = 0;
+  m_poll_wait = 0;
+  m_poll_plcur = NULL;
+  m_poll_txmsgid = 0;
+  PollerResetSessions();
+  PollerUpdatePhases();
+  }
+
+
+/**
+ * PollerTimerTick: internal: timer callback, forward the tick to the vehicle task
+ *  (the tick is queued as a frame without origin, see RxTask())
+ */
+void OvmsVehicle::PollerTimerTick()
+  {
+  if (m_poll_tick_pending)
+    return; // vehicle task is busy, skip tick
+  CAN_frame_t frame;
+  memset(&frame, 0, sizeof(frame));
+  m_poll_tick_pending = true;
+  if (xQueueSend(m_rxqueue, &frame, 0) != pdTRUE)
+    m_poll_tick_pending = false;
+  }
+
+
+/**
+ * PollerUpdatePhases: internal: distribute poll entries over their intervals
+ *  The k-th of n entries with interval p gets the tick offset k*p/n.
+ *  Also determines the ticker wrap: the least common multiple of 3600 and all
+ *  poll intervals of the current state, so every entry stays in its period
+ *  across the wrap (0 = no wrap, if that exceeds the ticker range).
+ */
+void OvmsVehicle::PollerUpdatePhases()
+  {
+  m_poll_phase.clear();
+  uint64_t wrap = 3600;
+  if (m_poll_plist)
+    {
+    for (const poll_pid_t* entry = m_poll_plist; entry->txmoduleid != 0 && wrap; entry++)
+      {
+      uint64_t polltime = entry->polltime[m_poll_state];
+      if (polltime == 0)
+        continue;
+      uint64_t gcd = wrap, rem = polltime;
+      while (rem)
+        {
+        uint64_t t = gcd % rem;
+        gcd = rem;
+        rem = t;
+        }
+      wrap = wrap / gcd * polltime;
+      if (wrap > UINT32_MAX)
+        wrap = 0;
+      }
+    }
+  m_poll_ticker_wrap = wrap;
+
+  if (m_poll_tick_ms >= 1000 || !m_poll_plist)
+    return;
+
+  std::map<uint16_t, uint16_t> count, index;
+  const poll_pid_t* entry;
+  for (entry = m_poll_plist; entry->txmoduleid != 0; entry++)
+    count[entry->polltime[m_poll_state]]++;
+  for (entry = m_poll_plist; entry->txmoduleid != 0; entry++)
+    {
+    uint16_t polltime = entry->polltime[m_poll_state];
+    uint32_t k = index[polltime]++;
+    m_poll_phase.push_back(polltime ? (k * polltime / count[polltime]) : 0);
+    }
+  }
+
+
+/**
+ * PollerNextTick: internal: advance the poll ticker to the next cycle
+ */
+void OvmsVehicle::PollerNextTick()
+  {
+  m_poll_ticker++;
+  if (m_poll_ticker_wrap && m_poll_ticker >= m_poll_ticker_wrap)
+    m_poll_ticker -= m_poll_ticker_wrap;
+  }
+
+
+/**
+ * PollerIsDue: internal: check if a poll entry is due at the current tick
+ */
+bool OvmsVehicle::PollerIsDue(const poll_pid_t* entry)
+  {
+  uint16_t polltime = entry->polltime[m_poll_state];
+  if (polltime == 0)
+    return false;
+  uint32_t phase = 0;
+  size_t index = entry - m_poll_plist;
+  if (index < m_poll_phase.size())
+    phase = m_poll_phase[index];
+  return ((m_poll_ticker + phase) % polltime) == 0;
+  }
+
+
+/**
+ * PollerResetSessions: internal: abort all concurrent sessions & restart the cycle
+ */
+void OvmsVehicle::PollerResetSessions()
+  {
+  for (int i = 0; i < VEHICLE_POLL_MAXSESSIONS; i++)
+    m_poll_session[i].active = false;
+  m_poll_session_cnt = 0;
+  m_poll_due.clear();
+  m_poll_due_cnt = 0;
+  m_poll_due_valid = false;
+  }
+
+
+/**
+ * PollerLoadSession / PollerSaveSession: internal: switch the current poll state
+ *  (as seen by PollerReceive() and the vehicle handlers) to/from a session
+ */
+void OvmsVehicle::PollerLoadSession(const poll_session_t* session)
+  {
+  m_poll_bus = session->bus;
+  m_poll_plcur = session->entry + 1;
+  m_poll_protocol = session->protocol;
+  m_poll_moduleid_sent = session->moduleid_sent;
+  m_poll_moduleid_low = session->moduleid_low;
+  m_poll_moduleid_high = session->moduleid_high;
+  m_poll_txmsgid = session->txmsgid;
+  m_poll_type = session->type;
+  m_poll_pid = session->pid;
+  m_poll_ml_remain = session->ml_remain;
+  m_poll_ml_offset = session->ml_offset;
+  m_poll_ml_frame = session->ml_frame;
+  m_poll_wait = session->wait;
+  m_poll_sent_us = session->sent_us;
+  }
+
+void OvmsVehicle::PollerSaveSession(poll_session_t* session)
+  {
+  session->bus = m_poll_bus;
+  session->protocol = m_poll_protocol;
+  session->moduleid_sent = m_poll_moduleid_sent;
+  session->moduleid_low = m_poll_moduleid_low;
+  session->moduleid_high = m_poll_moduleid_high;
+  session->txmsgid = m_poll_txmsgid;
+  session->type = m_poll_type;
+  session->pid = m_poll_pid;
+  session->ml_remain = m_poll_ml_remain;
+  session->ml_offset = m_poll_ml_offset;
+  session->ml_frame = m_poll_ml_frame;
+  session->wait = m_poll_wait;
+  session->sent_us = m_poll_sent_us;
+  }
+
+
+/**
+ * PollerFindSession: internal: find the active session expecting a response frame
+ */
+OvmsVehicle::poll_session_t* OvmsVehicle::PollerFindSession(const CAN_frame_t* frame, uint32_t& msgid)
+  {
+  for (int i = 0; i < VEHICLE_POLL_MAXSESSIONS; i++)
+    {
+    poll_session_t* session = &m_poll_session[i];
+    if (!session->active || session->bus != frame->origin)
+      continue;
+    if (session->protocol == ISOTP_EXTADR)
+      msgid = frame->MsgID << 8 | frame->data.u8[0];
+    else
+      msgid = frame->MsgID;
+    if (msgid >= session->moduleid_low && msgid <= session->moduleid_high)
+      return session;
+    }
+  return NULL;
+  }
+
+
+/**
+ * PollSetResponseAssembly: configure multi frame response assembly
+ *  By default, IncomingPollReply() is called for each frame of a response, and the vehicle
+ *  needs to collect the fragments itself.
+ *  
+ *  With assembly enabled, the poller copies the fragments into a buffer per response
+ *  (response ID, type & PID) and calls IncomingPollResponse() once with the complete payload.
+ *  The buffer is sized from the ISO-TP first frame length, each fragment is copied to its
+ *  final position, and the buffer capacity is kept for the next response, so no allocations
+ *  occur in the polling steady state. Single frame responses are passed through without copy.
+ *  
+ *  @param assemble
+ *    true = call IncomingPollResponse(), false = call IncomingPollReply() (default)
+ *  
+ *  The configuration is kept unchanged over calls to PollSetPidList() or PollSetState().
+ */
+void OvmsVehicle::PollSetResponseAssembly(bool assemble)
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  m_poll_assemble = assemble;
+  if (!assemble)
+    m_poll_rxbuf.clear();
+  }
+
+
+/**
+ * PollerAssembleResponse: internal: collect response fragment, deliver complete response
+ *  Called for each fragment with the poll state updated by PollerReceive(), i.e.
+ *  m_poll_ml_remain = bytes remaining after this fragment, m_poll_ml_offset = fragment offset.
+ */
+void OvmsVehicle::PollerAssembleResponse(canbus* bus, uint32_t msgid, const uint8_t* data, uint16_t length)
+  {
+  if (m_poll_ml_frame == 0 && m_poll_ml_remain == 0)
+    {
+    // Single frame response:
+    IncomingPollResponse(bus, m_poll_type, m_poll_pid, data, length);
+    return;
+    }
+
+  // Key by response ID, so responses of multiple ECUs to a broadcast request don't collide:
+  uint64_t key = (uint64_t)msgid << 32 | (uint32_t)m_poll_type << 16 | m_poll_pid;
+  std::vector<uint8_t>& buf = m_poll_rxbuf[key];
+  if (m_poll_ml_frame == 0)
+    buf.resize(length + m_poll_ml_remain);
+
+  if (m_poll_ml_offset + length > buf.size())
+    {
+    ESP_LOGW(TAG, "PollerAssembleResponse: %03X %02X(%X) fragment exceeds response length, dropping",
+             msgid, m_poll_type, m_poll_pid);
+    return;
+    }
+  memcpy(buf.data() + m_poll_ml_offset, data, length);
+
+  if (m_poll_ml_remain == 0)
+    IncomingPollResponse(bus, m_poll_type, m_poll_pid, buf.data(), buf.size());
+  }
+
+
+/**
+ * PollSetAdaptiveThrottling: enable/disable adaptive poll pacing & flow control
+ *  The static throttling limit (PollSetThrottling()) and flow control separation time
+ *  (PollSetResponseSeparationTime()) need to be chosen conservatively, leading to
+ *  idle gaps on some buses and ECU/receiver overruns on others.
+ *  
+ *  In adaptive mode, the poller measures the response latency per ECU & request, the
+ *  load of the polled buses (from the canbus frame counters), and overruns (timeouts,
+ *  aborted multi frame transfers, busyRepeatRequest NRCs, CAN RX buffer overflows).
+ *  Once per second, the throttling limit is…
+ *   - halved on overruns or if the bus load exceeds loadmax
+ *   - incremented if requests were held back and the bus load is below 3/4 of loadmax
+ *  The flow control separation time is tuned per ECU: doubled on a multi frame
+ *  transfer overrun, and relaxed back towards the configured time after 20
+ *  successful transfers.
+ *  
+ *  Achieved rates and latencies are published as metrics:
+ *   - v.poll.rate        responses per second
+ *   - v.poll.latency     average response latency [ms]
+ *   - v.poll.canload     max load of the polled buses [%]
+ *   - v.poll.throttle    current throttling limit
+ *   - v.poll.pid.rate    responses per second per poll list entry
+ *   - v.poll.pid.latency average latency [ms] per poll list entry
+ *  The metrics exist while adaptive mode is enabled.
+ *  
+ *  @param adaptive
+ *    true = enable adaptive mode, false = use static configuration (default)
+ *  @param loadmax
+ *    Max bus load to allow [%], default 50
+ *  
+ *  The configuration is kept unchanged over calls to PollSetPidList() or PollSetState().
+ */
+void OvmsVehicle::PollSetAdaptiveThrottling(bool adaptive, uint8_t loadmax /*=50*/)
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  m_poll_adaptive_loadmax = LIMIT_MAX(loadmax, 100);
+  if (adaptive == m_poll_adaptive)
+    return;
+  m_poll_adaptive = adaptive;
+  m_poll_sequence_max = m_poll_sequence_base;
+  m_poll_ecu_stats.clear();
+  m_poll_pid_stats.clear();
+  m_poll_throttled = false;
+  m_poll_overruns = 0;
+  m_poll_latency = 0;
+  if (!adaptive)
+    {
+    PollerDeleteMetrics();
+    return;
+    }
+
+  // Start bus load measurement:
+  canbus* buses[4] = { m_can1, m_can2, m_can3, m_can4 };
+  m_poll_can_rxoverflow = 0;
+  for (int i = 0; i < 4; i++)
+    {
+    if (!buses[i]) continue;
+    m_poll_can_frames[i] = buses[i]->m_status.packets_rx + buses[i]->m_status.packets_tx;
+    m_poll_can_rxoverflow += buses[i]->m_status.rxbuf_overflow;
+    }
+
+  if (!m_poll_metric_rate)
+    {
+    m_poll_metric_rate = MyMetrics.InitFloat(MS_V_POLL_RATE, SM_STALE_MIN, 0);
+    m_poll_metric_latency = MyMetrics.InitFloat(MS_V_POLL_LATENCY, SM_STALE_MIN, 0);
+    m_poll_metric_canload = MyMetrics.InitFloat(MS_V_POLL_CANLOAD, SM_STALE_MIN, 0, Percentage);
+    m_poll_metric_throttle = MyMetrics.InitInt(MS_V_POLL_THROTTLE, SM_STALE_MIN, 0);
+    m_poll_metric_pidrate = MyMetrics.InitVector<float>(MS_V_POLL_PID_RATE, SM_STALE_MIN);
+    m_poll_metric_pidlatency = MyMetrics.InitVector<float>(MS_V_POLL_PID_LATENCY, SM_STALE_MIN);
+    }
+  }
+
+
+/**
+ * PollerDeleteMetrics: internal: adaptive mode: deregister the poller metrics
+ */
+void OvmsVehicle::PollerDeleteMetrics()
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  if (!m_poll_metric_rate)
+    return;
+  MyMetrics.DeregisterMetric(m_poll_metric_rate);
+  MyMetrics.DeregisterMetric(m_poll_metric_latency);
+  MyMetrics.DeregisterMetric(m_poll_metric_canload);
+  MyMetrics.DeregisterMetric(m_poll_metric_throttle);
+  MyMetrics.DeregisterMetric(m_poll_metric_pidrate);
+  MyMetrics.DeregisterMetric(m_poll_metric_pidlatency);
+  m_poll_metric_rate = NULL;
+  m_poll_metric_latency = NULL;
+  m_poll_metric_canload = NULL;
+  m_poll_metric_throttle = NULL;
+  m_poll_metric_pidrate = NULL;
+  m_poll_metric_pidlatency = NULL;
+  }
+
+
+/**
+ * PollerRecordResponse: internal: adaptive mode: record response latency
+ *  Called on the first frame of a response for the current request.
+ */
+void OvmsVehicle::PollerRecordResponse()
+  {
+  float latency = (uint32_t)(esp_timer_get_time() - m_poll_sent_us) / 1000.0f;
+
+  poll_ecu_stat_t& ecu = m_poll_ecu_stats[m_poll_moduleid_sent];
+  ecu.latency = ecu.responses ? (ecu.latency * 7 + latency) / 8 : latency;
+  ecu.responses++;
+
+  uint64_t key = (uint64_t)m_poll_moduleid_sent << 32 | (uint32_t)m_poll_type << 16 | m_poll_pid;
+  poll_pid_stat_t& pid = m_poll_pid_stats[key];
+  pid.latency = pid.responses ? (pid.latency * 7 + latency) / 8 : latency;
+  pid.responses++;
+
+  m_poll_latency = m_poll_latency ? (m_poll_latency * 15 + latency) / 16 : latency;
+  }
+
+
+/**
+ * PollerRecordOverrun: internal: adaptive mode: record timeout / transfer abort / busy ECU
+ */
+void OvmsVehicle::PollerRecordOverrun()
+  {
+  if (m_poll_moduleid_low == 0 && m_poll_moduleid_high == 0)
+    return; // transfer has already been aborted & recorded
+  poll_ecu_stat_t& ecu = m_poll_ecu_stats[m_poll_moduleid_sent];
+  ecu.overruns++;
+  m_poll_overruns++;
+
+  if (m_poll_ml_frame > 0)
+    {
+    // Multi frame transfer failed, increase separation time for this ECU:
+    uint8_t st = PollerGetSeptime(m_poll_moduleid_sent);
+    if (st >= 0xF1) st = 0; // µs range
+    ecu.septime = (st >= 63) ? 127 : st * 2 + 1;
+    ecu.goodcnt = 0;
+    ESP_LOGD(TAG, "PollerRecordOverrun: %03X septime now %u ms", m_poll_moduleid_sent, ecu.septime);
+    }
+  }
+
+
+/**
+ * PollerRecordTransfer: internal: adaptive mode: multi frame response completed
+ *  Relaxes the ECU separation time towards the configured time after 20 good transfers.
+ */
+void OvmsVehicle::PollerRecordTransfer()
+  {
+  poll_ecu_stat_t& ecu = m_poll_ecu_stats[m_poll_moduleid_sent];
+  if (ecu.septime == 0 || ecu.septime == m_poll_fc_septime || ++ecu.goodcnt < 20)
+    return;
+  ecu.goodcnt = 0;
+  uint8_t base = (m_poll_fc_septime >= 0xF1) ? 0 : m_poll_fc_septime;
+  uint8_t st = ecu.septime - (ecu.septime - base + 3) / 4;
+  ecu.septime = (st <= base) ? m_poll_fc_septime : st;
+  }
+
+
+/**
+ * PollerGetSeptime: internal: adaptive mode: get flow control separation time for an ECU
+ */
+uint8_t OvmsVehicle::PollerGetSeptime(uint32_t txid)
+  {
+  auto it = m_poll_ecu_stats.find(txid);
+  if (it == m_poll_ecu_stats.end() || it->second.septime == 0)
+    return m_poll_fc_septime;
+  return it->second.septime;
+  }
+
+
+/**
+ * PollerAdaptiveTicker: internal: adaptive mode: per second throttling update & metrics
+ */
+void OvmsVehicle::PollerAdaptiveTicker()
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  if (!m_poll_adaptive || !m_poll_metric_rate)
+    return;
+
+  // Bus load (approximated by 125 bits per frame) & RX overflows:
+  canbus* buses[4] = { m_can1, m_can2, m_can3, m_can4 };
+  float canload = 0;
+  uint32_t rxoverflow = 0;
+  for (int i = 0; i < 4; i++)
+    {
+    if (!buses[i]) continue;
+    uint32_t frames = buses[i]->m_status.packets_rx + buses[i]->m_status.packets_tx;
+    uint32_t delta = frames - m_poll_can_frames[i];
+    m_poll_can_frames[i] = frames;
+    rxoverflow += buses[i]->m_status.rxbuf_overflow;
+    int bps = MAP_CAN_SPEED(buses[i]->m_speed);
+    if (bps > 0)
+      canload = std::max(canload, delta * 125 * 100.0f / bps);
+    }
+  bool overflow = (rxoverflow != m_poll_can_rxoverflow);
+  m_poll_can_rxoverflow = rxoverflow;
+
+  // Tune throttling:
+  uint8_t seq = m_poll_sequence_max;
+  if (m_poll_overruns || overflow || canload > m_poll_adaptive_loadmax)
+    {
+    if (seq == 0) seq = 32;
+    seq = std::max(1, seq / 2);
+    }
+  else if (m_poll_throttled && seq > 0 && seq < 32 && canload < m_poll_adaptive_loadmax * 3 / 4)
+    {
+    seq++;
+    }
+  if (seq != m_poll_sequence_max)
+    {
+    ESP_LOGD(TAG, "PollerAdaptiveTicker: load=%.1f%% overruns=%u overflow=%d => throttling %u -> %u",
+             canload, m_poll_overruns, overflow, m_poll_sequence_max, seq);
+    m_poll_sequence_max = seq;
+    }
+  m_poll_overruns = 0;
+  m_poll_throttled = false;
+
+  // Update rates & metrics:
+  float rate = 0;
+  for (auto& it : m_poll_pid_stats)
+    {
+    poll_pid_stat_t& pid = it.second;
+    pid.rate = pid.responses - pid.responses_last;
+    pid.responses_last = pid.responses;
+    rate += pid.rate;
+    }
+  m_poll_metric_rate->SetValue(rate);
+  m_poll_metric_latency->SetValue(m_poll_latency);
+  m_poll_metric_canload->SetValue(canload);
+  m_poll_metric_throttle->SetValue(m_poll_sequence_max);
+
+  std::vector<float> pidrate, pidlatency;
+  if (m_poll_plist)
+    {
+    for (const poll_pid_t* entry = m_poll_plist; entry->txmoduleid != 0; entry++)
+      {
+      uint32_t txid = entry->rxmoduleid ? entry->txmoduleid : 0x7df;
+      uint64_t key = (uint64_t)txid << 32 | (uint32_t)entry->type << 16 | entry->pid;
+      auto it = m_poll_pid_stats.find(key);
+      pidrate.push_back(it != m_poll_pid_stats.end() ? it->second.rate : 0);
+      pidlatency.push_back(it != m_poll_pid_stats.end() ? it->second.latency : 0);
+      }
+    }
+  m_poll_metric_pidrate->SetValue(pidrate);
+  m_poll_metric_pidlatency->SetValue(pidlatency);
   }
 
 
@@ -228,6 +839,143 @@ void OvmsVehicle::PollSetResponseSeparationTime(uint8_t septime)
   }
 
 
+/**
+ * PollSetResponseTimeouts: configure the response timeouts
+ *  The timeouts are converted into poll ticks (see PollSetTicker()) rounded up,
+ *  plus one tick, as the first tick may occur right after sending the request.
+ *  
+ *  @param timeout_ms
+ *    Time to wait for a response or the next frame of a multi frame response.
+ *    Default: 1000 milliseconds (1-2 seconds with the default ticker).
+ *  @param pending_ms
+ *    Time to wait after a ResponsePending NRC (UDS P2* server timing).
+ *    Default: 5000 milliseconds.
+ *  
+ *  The configuration is kept unchanged over calls to PollSetPidList() or PollSetState().
+ */
+void OvmsVehicle::PollSetResponseTimeouts(uint16_t timeout_ms, uint16_t pending_ms /*=5000*/)
+  {
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  m_poll_timeout_ms = timeout_ms;
+  m_poll_pending_ms = pending_ms;
+  }
+
+
+/**
+ * PollerWaitTicks: internal: convert a timeout into a m_poll_wait tick count
+ */
+uint16_t OvmsVehicle::PollerWaitTicks(uint32_t timeout_ms)
+  {
+  uint32_t ticks = (timeout_ms + m_poll_tick_ms - 1) / m_poll_tick_ms + 1;
+  return (ticks > UINT16_MAX) ? UINT16_MAX : ticks;
+  }
+
+
+/**
+ * PollerEntryAddress: internal: get the bus and the request & response IDs of a poll entry
+ */
+void OvmsVehicle::PollerEntryAddress(const poll_pid_t* entry, canbus*& bus,
+  uint32_t& moduleid_sent, uint32_t& moduleid_low, uint32_t& moduleid_high)
+  {
+  if (entry->rxmoduleid != 0)
+    {
+    // send to <moduleid>, listen to response from <rmoduleid>:
+    moduleid_sent = entry->txmoduleid;
+    moduleid_low = entry->rxmoduleid;
+    moduleid_high = entry->rxmoduleid;
+    }
+  else
+    {
+    // broadcast: send to 0x7df, listen to all responses:
+    moduleid_sent = 0x7df;
+    moduleid_low = 0x7e8;
+    moduleid_high = 0x7ef;
+    }
+
+  switch (entry->pollbus)
+    {
+    case 1:
+      bus = m_can1;
+      break;
+    case 2:
+      bus = m_can2;
+      break;
+    case 3:
+      bus = m_can3;
+      break;
+    case 4:
+      bus = m_can4;
+      break;
+    default:
+      bus = m_poll_bus_default;
+    }
+  }
+
+
+/**
+ * PollerPrepareFrame: internal: set up the current poll state for a poll entry
+ *  and prepare the request frame
+ */
+void OvmsVehicle::PollerPrepareFrame(const poll_pid_t* entry, CAN_frame_t* txframe)
+  {
+  m_poll_protocol = entry->protocol;
+  m_poll_type = entry->type;
+  m_poll_pid = entry->pid;
+  PollerEntryAddress(entry, m_poll_bus, m_poll_moduleid_sent, m_poll_moduleid_low, m_poll_moduleid_high);
+
+  uint8_t* txdata;
+  memset(txframe,0,sizeof(*txframe));
+  txframe->origin = m_poll_bus;
+  txframe->callback = &m_poll_txcallback;
+  txframe->FIR.B.FF = CAN_frame_std;
+  txframe->FIR.B.DLC = 8;
+
+  if (m_poll_protocol == ISOTP_EXTADR)
+    {
+    txframe->MsgID = m_poll_moduleid_sent >> 8;
+    txframe->data.u8[0] = m_poll_moduleid_sent & 0xff;
+    txdata = &txframe->data.u8[1];
+    }
+  else
+    {
+    txframe->MsgID = m_poll_moduleid_sent;
+    txdata = &txframe->data.u8[0];
+    }
+
+  if (POLL_TYPE_HAS_16BIT_PID(entry->type))
+    {
+    uint8_t datalen = LIMIT_MAX(entry->args.datalen, 4);
+    txdata[0] = (ISOTP_FT_SINGLE << 4) + 3 + datalen;
+    txdata[1] = m_poll_type;
+    txdata[2] = m_poll_pid >> 8;
+    txdata[3] = m_poll_pid & 0xff;
+    memcpy(&txdata[4], entry->args.data, datalen);
+    }
+  else if (POLL_TYPE_HAS_8BIT_PID(entry->type))
+    {
+    uint8_t datalen = LIMIT_MAX(entry->args.datalen, 5);
+    txdata[0] = (ISOTP_FT_SINGLE << 4) + 2 + datalen;
+    txdata[1] = m_poll_type;
+    txdata[2] = m_poll_pid;
+    memcpy(&txdata[3], entry->args.data, datalen);
+    }
+  else
+    {
+    uint8_t datalen = LIMIT_MAX(entry->args.datalen, 6);
+    txdata[0] = (ISOTP_FT_SINGLE << 4) + 1 + datalen;
+    txdata[1] = m_poll_type;
+    memcpy(&txdata[2], entry->args.data, datalen);
+    }
+
+  m_poll_txmsgid = txframe->MsgID;
+  m_poll_ml_frame = 0;
+  m_poll_ml_offset = 0;
+  m_poll_ml_remain = 0;
+  m_poll_wait = PollerWaitTicks(m_poll_timeout_ms);
+  m_poll_sent_us = esp_timer_get_time();
+  }
+
+
 /**
  * PollerSend: internal: start next due request
  */
@@ -238,6 +986,52 @@ void OvmsVehicle::PollerSend(bool fromTicker)
   // Don't do anything with no bus, no list or an empty list
   if (!m_poll_bus_default || !m_poll_plist || m_poll_plist->txmoduleid == 0) return;
 
+  if (m_poll_concurrency > 1)
+    {
+    if (fromTicker)
+      {
+      // Timer ticker call: reset throttling counter, check session response timeouts
+      m_poll_sequence_cnt = 0;
+      for (int i = 0; i < VEHICLE_POLL_MAXSESSIONS; i++)
+        {
+        poll_session_t* session = &m_poll_session[i];
+        if (session->active && session->wait > 0 && --session->wait == 0)
+          {
+          ESP_LOGD(TAG, "PollerSend: session %03x timeout on %02X(%X)",
+                   session->moduleid_sent, session->type, session->pid);
+          if (m_poll_adaptive)
+            {
+            PollerLoadSession(session);
+            PollerRecordOverrun();
+            }
+          session->active = false;
+          m_poll_session_cnt--;
+          }
+        }
+
+      // Advance to the next cycle once all requests of the current one have been sent:
+      if (m_poll_due_valid && m_poll_due_cnt == 0)
+        {
+        m_poll_due_valid = false;
+        PollerNextTick();
+        }
+      if (!m_poll_due_valid)
+        {
+        // Begin cycle: collect the entries due for the current m_poll_ticker
+        m_poll_due.clear();
+        for (const poll_pid_t* entry = m_poll_plist; entry->txmoduleid != 0; entry++)
+          {
+          if (PollerIsDue(entry))
+            m_poll_due.push_back(entry);
+          }
+        m_poll_due_cnt = m_poll_due.size();
+        m_poll_due_valid = true;
+        }
+      }
+    PollerDispatch();
+    return;
+    }
+
   if (m_poll_plcur == NULL) m_poll_plcur = m_poll_plist;
 
   // ESP_LOGD(TAG, "PollerSend(%d): entry at[type=%02X, pid=%X], ticker=%u, wait=%u, cnt=%u/%u",
@@ -248,106 +1042,23 @@ void OvmsVehicle::PollerSend(bool fromTicker)
     {
     // Timer ticker call: reset throttling counter, check response timeout
     m_poll_sequence_cnt = 0;
-    if (m_poll_wait > 0) m_poll_wait--;
+    if (m_poll_wait > 0 && --m_poll_wait == 0 && m_poll_adaptive)
+      PollerRecordOverrun();
     }
   if (m_poll_wait > 0) return;
 
   while (m_poll_plcur->txmoduleid != 0)
     {
-    if ((m_poll_plcur->polltime[m_poll_state] > 0) &&
-        ((m_poll_ticker % m_poll_plcur->polltime[m_poll_state]) == 0))
+    if (PollerIsDue(m_poll_plcur))
       {
       // We need to poll this one...
-      m_poll_protocol = m_poll_plcur->protocol;
-      m_poll_type = m_poll_plcur->type;
-      m_poll_pid = m_poll_plcur->pid;
-      if (m_poll_plcur->rxmoduleid != 0)
-        {
-        // send to <moduleid>, listen to response from <rmoduleid>:
-        m_poll_moduleid_sent = m_poll_plcur->txmoduleid;
-        m_poll_moduleid_low = m_poll_plcur->rxmoduleid;
-        m_poll_moduleid_high = m_poll_plcur->rxmoduleid;
-        }
-      else
-        {
-        // broadcast: send to 0x7df, listen to all responses:
-        m_poll_moduleid_sent = 0x7df;
-        m_poll_moduleid_low = 0x7e8;
-        m_poll_moduleid_high = 0x7ef;
-        }
-
-      switch (m_poll_plcur->pollbus)
-        {
-        case 1:
-          m_poll_bus = m_can1;
-          break;
-        case 2:
-          m_poll_bus = m_can2;
-          break;
-        case 3:
-          m_poll_bus = m_can3;
-          break;
-        case 4:
-          m_poll_bus = m_can4;
-          break;
-        default:
-          m_poll_bus = m_poll_bus_default;
-        }
+      CAN_frame_t txframe;
+      PollerPrepareFrame(m_poll_plcur, &txframe);
 
       ESP_LOGD(TAG, "PollerSend(%d): send [bus=%d, type=%02X, pid=%X], expecting %03x/%03x-%03x",
                fromTicker, m_poll_plcur->pollbus, m_poll_type, m_poll_pid, m_poll_moduleid_sent,
                m_poll_moduleid_low, m_poll_moduleid_high);
 
-      CAN_frame_t txframe;
-      uint8_t* txdata;
-      memset(&txframe,0,sizeof(txframe));
-      txframe.origin = m_poll_bus;
-      txframe.callback = &m_poll_txcallback;
-      txframe.FIR.B.FF = CAN_frame_std;
-      txframe.FIR.B.DLC = 8;
-
-      if (m_poll_protocol == ISOTP_EXTADR)
-        {
-        txframe.MsgID = m_poll_moduleid_sent >> 8;
-        txframe.data.u8[0] = m_poll_moduleid_sent & 0xff;
-        txdata = &txframe.data.u8[1];
-        }
-      else
-        {
-        txframe.MsgID = m_poll_moduleid_sent;
-        txdata = &txframe.data.u8[0];
-        }
-
-      if (POLL_TYPE_HAS_16BIT_PID(m_poll_plcur->type))
-        {
-        uint8_t datalen = LIMIT_MAX(m_poll_plcur->args.datalen, 4);
-        txdata[0] = (ISOTP_FT_SINGLE << 4) + 3 + datalen;
-        txdata[1] = m_poll_type;
-        txdata[2] = m_poll_pid >> 8;
-        txdata[3] = m_poll_pid & 0xff;
-        memcpy(&txdata[4], m_poll_plcur->args.data, datalen);
-        }
-      else if (POLL_TYPE_HAS_8BIT_PID(m_poll_plcur->type))
-        {
-        uint8_t datalen = LIMIT_MAX(m_poll_plcur->args.datalen, 5);
-        txdata[0] = (ISOTP_FT_SINGLE << 4) + 2 + datalen;
-        txdata[1] = m_poll_type;
-        txdata[2] = m_poll_pid;
-        memcpy(&txdata[3], m_poll_plcur->args.data, datalen);
-        }
-      else
-        {
-        uint8_t datalen = LIMIT_MAX(m_poll_plcur->args.datalen, 6);
-        txdata[0] = (ISOTP_FT_SINGLE << 4) + 1 + datalen;
-        txdata[1] = m_poll_type;
-        memcpy(&txdata[2], m_poll_plcur->args.data, datalen);
-        }
-
-      m_poll_txmsgid = txframe.MsgID;
-      m_poll_ml_frame = 0;
-      m_poll_ml_offset = 0;
-      m_poll_ml_remain = 0;
-      m_poll_wait = 2;
       m_poll_plcur++;
       m_poll_sequence_cnt++;
       m_poll_bus->Write(&txframe);
@@ -362,8 +1073,102 @@ void OvmsVehicle::PollerSend(bool fromTicker)
   // Completed checking all poll entries for the current m_poll_ticker
   // ESP_LOGD(TAG, "PollerSend(%d): cycle complete for ticker=%u", fromTicker, m_poll_ticker);
   m_poll_plcur = m_poll_plist;
-  m_poll_ticker++;
-  if (m_poll_ticker > 3600) m_poll_ticker -= 3600;
+  PollerNextTick();
+  }
+
+
+/**
+ * PollerDispatch: internal: concurrent mode: start due requests of the current
+ *  cycle on free sessions. The cycle is advanced by PollerSend() on the ticker.
+ */
+void OvmsVehicle::PollerDispatch()
+  {
+  if (!m_poll_due_valid)
+    return;
+
+  for (auto it = m_poll_due.begin(); it != m_poll_due.end() && m_poll_due_cnt > 0; it++)
+    {
+    if (*it == NULL)
+      continue; // already sent
+    if (m_poll_session_cnt >= m_poll_concurrency)
+      break;
+    if (m_poll_sequence_max && m_poll_sequence_cnt >= m_poll_sequence_max)
+      {
+      m_poll_throttled = true;
+      break;
+      }
+
+    canbus* bus;
+    uint32_t moduleid_sent, moduleid_low, moduleid_high;
+    PollerEntryAddress(*it, bus, moduleid_sent, moduleid_low, moduleid_high);
+
+    // Find a free session, skip the entry if the ECU (response ID range) is busy:
+    poll_session_t* session = NULL;
+    bool busy = false;
+    for (int i = 0; i < VEHICLE_POLL_MAXSESSIONS && !busy; i++)
+      {
+      poll_session_t* s = &m_poll_session[i];
+      if (!s->active)
+        {
+        if (!session) session = s;
+        }
+      else if (s->bus == bus &&
+               (s->moduleid_sent == moduleid_sent ||
+                (s->moduleid_low <= moduleid_high && s->moduleid_high >= moduleid_low)))
+        {
+        busy = true;
+        }
+      }
+    if (busy || !session)
+      continue;
+
+    CAN_frame_t txframe;
+    PollerPrepareFrame(*it, &txframe);
+
+    ESP_LOGD(TAG, "PollerDispatch: send [bus=%d, type=%02X, pid=%X], expecting %03x/%03x-%03x",
+             (*it)->pollbus, m_poll_type, m_poll_pid, m_poll_moduleid_sent,
+             m_poll_moduleid_low, m_poll_moduleid_high);
+
+    session->active = true;
+    session->entry = *it;
+    PollerSaveSession(session);
+    m_poll_session_cnt++;
+    m_poll_sequence_cnt++;
+    *it = NULL;
+    m_poll_due_cnt--;
+    m_poll_bus->Write(&txframe);
+    }
+  }
+
+
+/**
+ * PollerReceiveSession: internal: concurrent mode: process poll response frame
+ */
+void OvmsVehicle::PollerReceiveSession(CAN_frame_t* frame)
+  {
+  uint32_t msgid;
+
+  // Quick filter check before locking the mutex:
+  if (!PollerFindSession(frame, msgid))
+    return;
+
+  OvmsRecMutexLock lock(&m_poll_mutex);
+  poll_session_t* session = PollerFindSession(frame, msgid);
+  if (!session)
+    return;
+
+  PollerLoadSession(session);
+  PollerReceive(frame, msgid);
+  PollerSaveSession(session);
+
+  if (session->wait == 0)
+    {
+    // Response complete / aborted, free the session and send next due requests:
+    session->active = false;
+    m_poll_session_cnt--;
+    if (session->moduleid_sent != 0x7df)
+      PollerDispatch();
+    }
   }
 
 
@@ -374,8 +1179,33 @@ void OvmsVehicle::PollerTxCallback(const CAN_frame_t* frame, bool success)
   {
   OvmsRecMutexLock lock(&m_poll_mutex);
 
+  if (m_poll_concurrency > 1)
+    {
+    // Find the session of the request:
+    poll_session_t* session = NULL;
+    for (int i = 0; i < VEHICLE_POLL_MAXSESSIONS; i++)
+      {
+      poll_session_t* s = &m_poll_session[i];
+      if (s->active && s->bus == frame->origin && s->txmsgid == frame->MsgID &&
+          (s->protocol != ISOTP_EXTADR || frame->data.u8[0] == (s->moduleid_sent & 0xff)))
+        {
+        session = s;
+        break;
+        }
+      }
+    if (!session || !m_poll_plist)
+      return;
+    PollerLoadSession(session);
+    if (!success)
+      {
+      // Free the session, the next ticker will continue:
+      session->active = false;
+      m_poll_session_cnt--;
+      }
+    }
+
   // Check for a late callback:
-  if (!m_poll_wait || !m_poll_plist || frame->origin != m_poll_bus || frame->MsgID != m_poll_txmsgid)
+  else if (!m_poll_wait || !m_poll_plist || frame->origin != m_poll_bus || frame->MsgID != m_poll_txmsgid)
     return;
 
   // On failure, try to speed up the current poll timeout:
@@ -481,8 +1311,10 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
               msgid, tp_frameindex, m_poll_ml_frame & 0x0f, m_poll_type, m_poll_pid,
               hexdump ? hexdump : "-");
       if (hexdump) free(hexdump);
+      if (m_poll_adaptive)
+        PollerRecordOverrun();
       m_poll_moduleid_low = m_poll_moduleid_high = 0; // ignore further frames
-      m_poll_wait = 2; // give the bus time to let remaining frames pass
+      m_poll_wait = PollerWaitTicks(m_poll_timeout_ms); // give the bus time to let remaining frames pass
       return;
       }
     }
@@ -539,6 +1371,15 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
   // Process OBD/UDS payload
   // 
 
+  if (m_poll_adaptive && tp_frametype != ISOTP_FT_CONSECUTIVE &&
+      (response_type == 0x40+m_poll_type || (response_type == UDS_RESP_TYPE_NRC && error_type == m_poll_type)))
+    {
+    if (response_type == UDS_RESP_TYPE_NRC && error_code == UDS_RESP_NRC_BRR)
+      PollerRecordOverrun();
+    else if (!(response_type == UDS_RESP_TYPE_NRC && error_code == UDS_RESP_NRC_RCRRP))
+      PollerRecordResponse();
+    }
+
   if (response_type == UDS_RESP_TYPE_NRC && error_type == m_poll_type)
     {
     // Negative Response Code:
@@ -547,8 +1388,8 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
       // Info: requestCorrectlyReceived-ResponsePending (server busy processing the request)
       ESP_LOGD(TAG, "PollerReceive[%03X]: got OBD/UDS info %02X(%X) code=%02X (pending)",
                msgid, m_poll_type, m_poll_pid, error_code);
-      // add some wait time:
-      m_poll_wait++;
+      // extend the wait time to P2*:
+      m_poll_wait = std::max(m_poll_wait, PollerWaitTicks(m_poll_pending_ms));
       return;
       }
     else
@@ -594,6 +1435,10 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
         m_poll_single_rxdone.Give();
         }
       }
+    else if (m_poll_assemble)
+      {
+      PollerAssembleResponse(frame->origin, msgid, response_data, response_datalen);
+      }
     else
       {
       IncomingPollReply(frame->origin, m_poll_type, m_poll_pid, response_data, response_datalen, m_poll_ml_remain);
@@ -650,7 +1495,8 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
 
       txdata[0] = 0x30;                // flow control frame type
       txdata[1] = 0x00;                // request all frames available
-      txdata[2] = m_poll_fc_septime;   // with configured separation timing (default 25 ms)
+      txdata[2] = m_poll_adaptive      // with configured separation timing (default 25 ms)
+        ? PollerGetSeptime(m_poll_moduleid_sent) : m_poll_fc_septime;
       txframe.Write();
       m_poll_ml_frame = 1;
       }
@@ -660,12 +1506,14 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
       }
 
     m_poll_ml_offset += response_datalen; // next frame application payload offset
-    m_poll_wait = 2;
+    m_poll_wait = PollerWaitTicks(m_poll_timeout_ms);
     }
   else
     {
     // Request response complete:
     m_poll_wait = 0;
+    if (m_poll_adaptive && m_poll_ml_frame > 0)
+      PollerRecordTransfer();
     }
 
 
@@ -673,12 +1521,18 @@ void OvmsVehicle::PollerReceive(CAN_frame_t* frame, uint32_t msgid)
   // - we are not waiting for another frame
   // - the poll was no broadcast (with potential further responses from other devices)
   // - poll throttling is unlimited or limit isn't reached yet
-  if (m_poll_wait == 0 &&
+  // (concurrent mode: done by PollerReceiveSession())
+  if (m_poll_concurrency == 1 &&
+      m_poll_wait == 0 &&
       m_poll_moduleid_sent != 0x7df &&
       (!m_poll_sequence_max || m_poll_sequence_cnt < m_poll_sequence_max))
     {
     PollerSend(false);
     }
+  else if (m_poll_concurrency == 1 && m_poll_wait == 0 && m_poll_moduleid_sent != 0x7df)
+    {
+    m_poll_throttled = true;
+    }
   }
 
 
@@ -56,6 +56,7 @@
 #define NO_RABBIT
 #define NO_RC4
 #define SMALL_SESSION_CACHE
+#define HAVE_SESSION_TICKET
 #define ECC_SHAMIR
 #define ECC_TIMING_RESISTANT
 #define HAVE_WC_ECC_SET_RNG
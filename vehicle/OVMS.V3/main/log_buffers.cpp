@@ -33,6 +33,7 @@
 #include <string.h>
 #include <ovms_log.h>
 #include "log_buffers.h"
+#include "ovms_mempool.h"
 
 
 LogBuffers::LogBuffers() : m_refcount(0)
@@ -44,19 +45,45 @@ LogBuffers::~LogBuffers()
   // Free all the buffers in the list.
   for (iterator itr = begin(); itr != end(); ++itr)
     {
-    free(*itr);
+    MyExtRamPool.Free(*itr);
     }
   }
 
 int LogBuffers::append(const char* fmt, va_list args)
   {
   char *buffer;
-  int ret = vasprintf(&buffer, fmt, args);
+  int ret = format(&buffer, fmt, args);
   if (ret >= 0)
     append(buffer);
   return ret;
   }
 
+/**
+ * format: vasprintf() into a pool buffer
+ *  Log lines normally fit into a pool block, so they are formatted on the
+ *  stack first to avoid heap allocations. Longer lines use vasprintf().
+ *  The buffer must be released by MyExtRamPool.Free().
+ */
+int LogBuffers::format(char** buffer, const char* fmt, va_list args)
+  {
+  char tmp[256];
+  va_list args2;
+  va_copy(args2, args);
+  int ret = vsnprintf(tmp, sizeof(tmp), fmt, args2);
+  va_end(args2);
+  if (ret < 0)
+    return ret;
+  if (ret < sizeof(tmp))
+    {
+    *buffer = (char*) MyExtRamPool.Alloc(ret+1);
+    if (!*buffer)
+      return -1;
+    memcpy(*buffer, tmp, ret+1);
+    return ret;
+    }
+  return vasprintf(buffer, fmt, args);
+  }
+
 void LogBuffers::append(char* buffer)
   {  
   if (empty())
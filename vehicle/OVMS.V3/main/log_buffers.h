@@ -46,6 +46,7 @@ class LogBuffers : public std::forward_list<char*>
     void set(int count);
     void release();
     bool last();
+    static int format(char** buffer, const char* fmt, va_list args);
 
   private:
     std::atomic<int> m_refcount;
@@ -239,6 +239,13 @@
 #define MS_V_POS_ODOMETER           "v.p.odometer"
 #define MS_V_POS_TRIP               "v.p.trip"
 
+#define MS_V_POLL_RATE              "v.poll.rate"
+#define MS_V_POLL_LATENCY           "v.poll.latency"
+#define MS_V_POLL_CANLOAD           "v.poll.canload"
+#define MS_V_POLL_THROTTLE          "v.poll.throttle"
+#define MS_V_POLL_PID_RATE          "v.poll.pid.rate"
+#define MS_V_POLL_PID_LATENCY       "v.poll.pid.latency"
+
 #define MS_V_TPMS_FL_T              "v.tp.fl.t"
 #define MS_V_TPMS_FR_T              "v.tp.fr.t"
 #define MS_V_TPMS_RR_T              "v.tp.rr.t"
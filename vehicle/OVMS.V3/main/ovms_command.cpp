@@ -928,7 +928,7 @@ int OvmsCommandApp::LogPartial(const char* fmt, ...)
 int OvmsCommandApp::LogBuffer(LogBuffers* lb, const char* fmt, va_list args)
   {
   char *buffer;
-  int ret = vasprintf(&buffer, fmt, args);
+  int ret = LogBuffers::format(&buffer, fmt, args);
   if (ret < 0) return ret;
 
   // Replace CR/LF except last by "|", but don't leave '|' at the end.
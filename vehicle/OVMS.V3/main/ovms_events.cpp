@@ -41,6 +41,7 @@ static const char *TAG = "events";
 #include "ovms_script.h"
 #include "ovms_boot.h"
 #include "ovms_ota.h"
+#include "ovms_mempool.h"
 
 OvmsEvents MyEvents __attribute__ ((init_priority (1200)));
 
@@ -70,7 +71,7 @@ bool EventMap::GetCompletion(OvmsWriter* writer, const char* token) const
 
 void EventStdFree(const char* event, void* data)
   {
-  free(data);
+  MyExtRamPool.Free(data);
   }
 
 void EventLaunchTask(void *pvParameters)
@@ -314,7 +315,7 @@ void OvmsEvents::FreeQueueSignalEvent(event_queue_t* msg)
     {
     msg->body.signal.donefn(msg->body.signal.event, msg->body.signal.data);
     }
-  free(msg->body.signal.event);
+  MyIntRamPool.Free(msg->body.signal.event);
   }
 
 void OvmsEvents::RegisterEvent(std::string caller, std::string event, EventCallback callback)
@@ -462,8 +463,7 @@ void OvmsEvents::SignalEvent(std::string event, void* data, event_signal_done_fn
   memset(&msg, 0, sizeof(msg));
 
   msg.type = EVENT_signal;
-  msg.body.signal.event = (char*)ExternalRamMalloc(event.size()+1);
-  strcpy(msg.body.signal.event, event.c_str());
+  msg.body.signal.event = MyIntRamPool.Strdup(event.c_str());
   msg.body.signal.data = data;
   msg.body.signal.donefn = callback;
 
@@ -492,11 +492,10 @@ void OvmsEvents::SignalEvent(std::string event, void* data, size_t length,
   memset(&msg, 0, sizeof(msg));
 
   msg.type = EVENT_signal;
-  msg.body.signal.event = (char*)ExternalRamMalloc(event.size()+1);
-  strcpy(msg.body.signal.event, event.c_str());
+  msg.body.signal.event = MyIntRamPool.Strdup(event.c_str());
   if (data != NULL)
     {
-    msg.body.signal.data = ExternalRamMalloc(length);
+    msg.body.signal.data = MyExtRamPool.Alloc(length);
     memcpy(msg.body.signal.data, data, length);
     msg.body.signal.donefn = EventStdFree;
     }
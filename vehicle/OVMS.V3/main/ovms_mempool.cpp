@@ -0,0 +1,183 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "ovms_malloc.h"
+#include "ovms_mempool.h"
+
+// Pool configuration: { block size, block count } per size class, ascending sizes
+static const mempool_class_config_t intram_config[MEMPOOL_CLASSES] =
+  {
+  { 32, 64 }, { 64, 32 }, { 0, 0 }, { 0, 0 }
+  };
+static const mempool_class_config_t extram_config[MEMPOOL_CLASSES] =
+  {
+  { 32, 128 }, { 64, 128 }, { 128, 64 }, { 256, 32 }
+  };
+
+OvmsMemPool MyIntRamPool __attribute__ ((init_priority (160))) ("intram", false, intram_config);
+OvmsMemPool MyExtRamPool __attribute__ ((init_priority (160))) ("extram", true, extram_config);
+
+OvmsMemPool::OvmsMemPool(const char* name, bool spiram, const mempool_class_config_t* config)
+  {
+  m_name = name;
+  m_spiram = spiram;
+  m_oversize = 0;
+  m_mux = portMUX_INITIALIZER_UNLOCKED;
+
+  m_arenasize = 0;
+  for (int i = 0; i < MEMPOOL_CLASSES; i++)
+    m_arenasize += config[i].size * config[i].count;
+  if (spiram)
+    m_arena = (uint8_t*) heap_caps_malloc(m_arenasize, MALLOC_CAP_SPIRAM);
+  else
+    m_arena = (uint8_t*) heap_caps_malloc(m_arenasize, MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+  if (!m_arena)
+    m_arenasize = 0;
+
+  uint8_t* p = m_arena;
+  for (int i = 0; i < MEMPOOL_CLASSES; i++)
+    {
+    sizeclass_t& sc = m_class[i];
+    sc.size = config[i].size;
+    sc.count = m_arena ? config[i].count : 0;
+    sc.start = p;
+    sc.freelist = NULL;
+    sc.used = sc.maxused = 0;
+    sc.allocs = sc.exhausted = 0;
+    for (int k = sc.count-1; k >= 0; k--)
+      {
+      block_t* b = (block_t*)(p + k * sc.size);
+      b->next = sc.freelist;
+      sc.freelist = b;
+      }
+    p += sc.size * sc.count;
+    }
+  }
+
+OvmsMemPool::~OvmsMemPool()
+  {
+  if (m_arena)
+    heap_caps_free(m_arena);
+  }
+
+/**
+ * Alloc: allocate a buffer of at least size bytes
+ *  Uses the smallest size class fitting, falls back to the heap.
+ */
+void* OvmsMemPool::Alloc(size_t size)
+  {
+  int i;
+  for (i = 0; i < MEMPOOL_CLASSES; i++)
+    {
+    if (size <= m_class[i].size && m_class[i].count)
+      break;
+    }
+  if (i == MEMPOOL_CLASSES)
+    {
+    m_oversize++;
+    }
+  else
+    {
+    sizeclass_t& sc = m_class[i];
+    block_t* b;
+    portENTER_CRITICAL(&m_mux);
+    b = sc.freelist;
+    if (b)
+      {
+      sc.freelist = b->next;
+      if (++sc.used > sc.maxused)
+        sc.maxused = sc.used;
+      sc.allocs++;
+      }
+    else
+      {
+      sc.exhausted++;
+      }
+    portEXIT_CRITICAL(&m_mux);
+    if (b)
+      return b;
+    }
+  return m_spiram ? ExternalRamMalloc(size) : InternalRamMalloc(size);
+  }
+
+/**
+ * Free: release a pool or heap buffer
+ */
+void OvmsMemPool::Free(void* ptr)
+  {
+  if (!ptr)
+    return;
+  if (!Contains(ptr))
+    {
+    free(ptr);
+    return;
+    }
+  for (int i = MEMPOOL_CLASSES-1; i >= 0; i--)
+    {
+    sizeclass_t& sc = m_class[i];
+    if ((uint8_t*)ptr >= sc.start)
+      {
+      block_t* b = (block_t*)ptr;
+      portENTER_CRITICAL(&m_mux);
+      b->next = sc.freelist;
+      sc.freelist = b;
+      sc.used--;
+      portEXIT_CRITICAL(&m_mux);
+      return;
+      }
+    }
+  }
+
+char* OvmsMemPool::Strdup(const char* s)
+  {
+  size_t len = strlen(s) + 1;
+  char* d = (char*) Alloc(len);
+  if (d)
+    memcpy(d, s, len);
+  return d;
+  }
+
+void OvmsMemPool::Status(OvmsWriter* writer)
+  {
+  writer->printf("Pool %s: %u bytes%s\n", m_name, m_arenasize, m_arena ? "" : " (not allocated)");
+  writer->puts("  Size Count  Used   Max    Allocs Exhausted");
+  for (int i = 0; i < MEMPOOL_CLASSES; i++)
+    {
+    sizeclass_t& sc = m_class[i];
+    if (sc.count == 0)
+      continue;
+    writer->printf("  %4u %5u %5u %5u %9u %9u\n",
+      sc.size, sc.count, sc.used, sc.maxused, sc.allocs, sc.exhausted);
+    }
+  writer->printf("  Oversize allocations: %u\n", m_oversize);
+  }
@@ -0,0 +1,103 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Date:          14th March 2017
+;
+;    Changes:
+;    1.0  Initial release
+;
+;    (C) 2011       Michael Stegen / Stegen Electronics
+;    (C) 2011-2017  Mark Webb-Johnson
+;    (C) 2011        Sonny Chen @ EPRO/DX
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __OVMS_MEMPOOL_H__
+#define __OVMS_MEMPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "ovms_command.h"
+
+/**
+ * OvmsMemPool: fixed size class pool allocator
+ *
+ * Short lived message payloads (event names & data, log lines, websocket jobs)
+ * are allocated from preallocated size class pools to avoid heap fragmentation.
+ * Requests too big for the pool or exceeding a size class capacity fall back to
+ * the heap (counted as oversize / exhausted). Free() accepts both pool and heap
+ * pointers, so pool buffers can be passed to code freeing via the pool.
+ */
+
+#define MEMPOOL_CLASSES       4
+
+typedef struct
+  {
+  uint16_t size;                        // block size [bytes]
+  uint16_t count;                       // number of blocks
+  } mempool_class_config_t;
+
+class OvmsMemPool
+  {
+  public:
+    OvmsMemPool(const char* name, bool spiram, const mempool_class_config_t* config);
+    ~OvmsMemPool();
+
+  public:
+    void* Alloc(size_t size);
+    void Free(void* ptr);
+    char* Strdup(const char* s);
+    bool Contains(const void* ptr) const
+      {
+      return ((const uint8_t*)ptr >= m_arena && (const uint8_t*)ptr < m_arena + m_arenasize);
+      }
+    void Status(OvmsWriter* writer);
+
+  protected:
+    typedef struct block_s
+      {
+      struct block_s* next;
+      } block_t;
+    typedef struct
+      {
+      uint16_t size;
+      uint16_t count;
+      uint8_t* start;                   // first block in arena
+      block_t* freelist;
+      uint16_t used;                    // blocks in use
+      uint16_t maxused;                 // high water mark
+      uint32_t allocs;                  // allocations served
+      uint32_t exhausted;               // allocations failed due to exhaustion
+      } sizeclass_t;
+
+  protected:
+    const char* m_name;
+    bool m_spiram;
+    uint8_t* m_arena;
+    size_t m_arenasize;
+    sizeclass_t m_class[MEMPOOL_CLASSES];
+    uint32_t m_oversize;                // allocations bigger than the largest class
+    portMUX_TYPE m_mux;
+  };
+
+extern OvmsMemPool MyIntRamPool;
+extern OvmsMemPool MyExtRamPool;
+
+#endif //#ifndef __OVMS_MEMPOOL_H__
@@ -42,6 +42,7 @@ static const char *TAG = "metrics";
 #include "ovms_events.h"
 #include "ovms_script.h"
 #include "rom/rtc.h"
+#include "esp_timer.h"
 #include "string.h"
 
 using namespace std;
@@ -91,6 +92,8 @@ void metrics_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
     }
   int firstmetric = i;
   bool show_only = (firstmetric < argc);
+  std::string v;
+  v.reserve(128);
   for (OvmsMetric* m=MyMetrics.m_first; m != NULL; m=m->m_next)
     {
     if (only_persist && !m->m_persist)
@@ -106,13 +109,17 @@ void metrics_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
         continue;
       }
     found = true;
+    v.clear();
     if (show_set)
       {
       if (m->IsDefined())
-        writer->printf("metrics set %s %s\n", k, m->AsString().c_str());
+        {
+        m->AppendString(v);
+        writer->printf("metrics set %s %s\n", k, v.c_str());
+        }
       continue;
       }
-    std::string v = m->AsUnitString("", m->GetUnits() == TimeUTC ? TimeLocal : m->GetUnits());
+    m->AppendUnitString(v, "", m->GetUnits() == TimeUTC ? TimeLocal : m->GetUnits());
     if (show_staleness)
       {
       int age = m->Age();
@@ -132,6 +139,65 @@ void metrics_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
     writer->puts("Unrecognised metric name");
   }
 
+void metrics_bench(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int loops = (argc > 0) ? atoi(argv[0]) : 10;
+  if (loops < 1) loops = 1;
+
+  // Full metrics dump via AsJSON(), i.e. one result string per metric.
+  // Strings exceeding the inline capacity need a heap allocation, so this
+  // counts the minimum number of allocations per dump:
+  const size_t inline_capacity = std::string().capacity();
+  int count = 0, allocs = 0;
+  size_t size = 0;
+  int64_t t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    std::string dump;
+    count = allocs = 0;
+    for (OvmsMetric* m=MyMetrics.m_first; m != NULL; m=m->m_next)
+      {
+      std::string val = m->AsJSON();
+      if (val.size() > inline_capacity)
+        allocs++;
+      dump += m->m_name;
+      dump += ':';
+      dump += val;
+      dump += ',';
+      count++;
+      }
+    size = dump.size();
+    }
+  int64_t t_as = esp_timer_get_time() - t0;
+
+  // Same dump via AppendJSON() into a reused buffer,
+  // counting the buffer reallocations:
+  std::string dump;
+  int reallocs = 0;
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    dump.clear();
+    for (OvmsMetric* m=MyMetrics.m_first; m != NULL; m=m->m_next)
+      {
+      size_t cap = dump.capacity();
+      dump += m->m_name;
+      dump += ':';
+      m->AppendJSON(dump);
+      dump += ',';
+      if (dump.capacity() != cap)
+        reallocs++;
+      }
+    }
+  int64_t t_append = esp_timer_get_time() - t0;
+
+  writer->printf("Full dump of %d metrics (%u bytes JSON), %d loops:\n", count, size, loops);
+  writer->printf("  AsJSON:     %6lld us/dump, >= %d allocations/dump\n",
+    t_as / loops, allocs);
+  writer->printf("  AppendJSON: %6lld us/dump, %d buffer reallocations total\n",
+    t_append / loops, reallocs);
+  }
+
 void metrics_persist(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   if (argc > 0 && strcmp(argv[0], "-r") == 0)
@@ -327,14 +393,19 @@ static duk_ret_t DukOvmsMetricGetValues(duk_context *ctx)
   DukContext dc(ctx);
   bool decode = duk_opt_boolean(ctx, 1, true);
   duk_idx_t obj_idx = dc.PushObject();
+  std::string buf;
 
   // helper: set object property from metric
-  auto set_metric = [&dc, obj_idx, decode](OvmsMetric *m)
+  auto set_metric = [&dc, &buf, obj_idx, decode](OvmsMetric *m)
     {
     if (decode)
       m->DukPush(dc);
     else
-      dc.Push(m->AsString());
+      {
+      buf.clear();
+      m->AppendString(buf);
+      dc.Push(buf);
+      }
     dc.PutProp(obj_idx, m->m_name);
     };
 
@@ -400,6 +471,7 @@ OvmsMetrics::OvmsMetrics()
   OvmsCommand* cmd_metric = MyCommandApp.RegisterCommand("metrics","METRICS framework");
   cmd_metric->RegisterCommand("list","Show all metrics", metrics_list, "[<metric>] [-ps]", 0, 2);
   cmd_metric->RegisterCommand("persist","Show persistent metrics info", metrics_persist, "[-r]", 0, 1);
+  cmd_metric->RegisterCommand("bench","Benchmark full metrics JSON serialization", metrics_bench, "[<loops>]", 0, 1);
   cmd_metric->RegisterCommand("set","Set the value of a metric",metrics_set, "<metric> <value>", 2, 2);
   OvmsCommand* cmd_metrictrace = cmd_metric->RegisterCommand("trace","METRIC trace framework");
   cmd_metrictrace->RegisterCommand("on","Turn metric tracing ON",metrics_trace);
@@ -692,24 +764,55 @@ OvmsMetric::~OvmsMetric()
 
 std::string OvmsMetric::AsString(const char* defvalue, metric_unit_t units, int precision)
   {
-  return std::string(defvalue);
+  std::string buf;
+  AppendString(buf, defvalue, units, precision);
+  return buf;
   }
 
 std::string OvmsMetric::AsUnitString(const char* defvalue, metric_unit_t units, int precision)
   {
-  if (!IsDefined())
-    return std::string(defvalue);
-  return AsString(defvalue, units, precision) + OvmsMetricUnitLabel(units==Native ? GetUnits() : units);
+  std::string buf;
+  AppendUnitString(buf, defvalue, units, precision);
+  return buf;
   }
 
 std::string OvmsMetric::AsJSON(const char* defvalue, metric_unit_t units, int precision)
   {
-  std::string buf = "\"";
-  buf.append(json_encode(AsString(defvalue, units, precision)));
-  buf.append("\"");
+  std::string buf;
+  AppendJSON(buf, defvalue, units, precision);
   return buf;
   }
 
+/**
+ * AppendString, AppendUnitString, AppendJSON: append value representation to buf
+ *  These are the primitives of the As*String() methods. Use them to serialize
+ *  multiple metrics into a reused buffer without allocations per metric.
+ */
+void OvmsMetric::AppendString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
+  {
+  buf.append(defvalue);
+  }
+
+void OvmsMetric::AppendUnitString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
+  {
+  if (!IsDefined())
+    {
+    buf.append(defvalue);
+    return;
+    }
+  AppendString(buf, defvalue, units, precision);
+  buf.append(OvmsMetricUnitLabel(units==Native ? GetUnits() : units));
+  }
+
+void OvmsMetric::AppendJSON(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
+  {
+  std::string value;
+  AppendString(value, defvalue, units, precision);
+  buf += '"';
+  json_append(buf, value);
+  buf += '"';
+  }
+
 float OvmsMetric::AsFloat(const float defvalue, metric_unit_t units)
   {
   return defvalue;
@@ -918,39 +1021,39 @@ void OvmsMetricInt::RefreshPersist()
     *m_valuep = m_value;
   }
 
-std::string OvmsMetricInt::AsString(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricInt::AppendString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
     {
-    char buffer[33];
     int value = m_value;
     if ((units != Other)&&(units != m_units))
       value = UnitConvert(m_units,units,m_value);
     if (units == TimeUTC || units == TimeLocal)
       {
+      char buffer[33];
       int seconds = value % 60;
       value /= 60;
       int minutes = value % 60;
       value /= 60;
       int hours = value;
       snprintf(buffer, sizeof(buffer), "%02u:%02u:%02u", hours, minutes, seconds);
+      buf.append(buffer);
       }
     else
-      itoa (value,buffer,10);
-    return buffer;
+      format_int(buf, value);
     }
   else
     {
-    return std::string(defvalue);
+    buf.append(defvalue);
     }
   }
 
-std::string OvmsMetricInt::AsJSON(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricInt::AppendJSON(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
-    return AsString(defvalue, units, precision);
+    AppendString(buf, defvalue, units, precision);
   else
-    return std::string((defvalue && *defvalue) ? defvalue : "0");
+    buf.append((defvalue && *defvalue) ? defvalue : "0");
   }
 
 float OvmsMetricInt::AsFloat(const float defvalue, metric_unit_t units)
@@ -1087,37 +1190,20 @@ void OvmsMetricBool::RefreshPersist()
     *m_valuep = m_value;
   }
 
-std::string OvmsMetricBool::AsString(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricBool::AppendString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
-    {
-    if (m_value)
-      return std::string("yes");
-    else
-      return std::string("no");
-    }
+    buf.append(m_value ? "yes" : "no");
   else
-    {
-    return std::string(defvalue);
-    }
+    buf.append(defvalue);
   }
 
-std::string OvmsMetricBool::AsJSON(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricBool::AppendJSON(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
-    {
-    if (m_value)
-      return std::string("true");
-    else
-      return std::string("false");
-    }
+    buf.append(m_value ? "true" : "false");
   else
-    {
-    if (strtobool(defvalue) == true)
-      return std::string("true");
-    else
-      return std::string("false");
-    }
+    buf.append(strtobool(defvalue) ? "true" : "false");
   }
 
 float OvmsMetricBool::AsFloat(const float defvalue, metric_unit_t units)
@@ -1246,35 +1332,27 @@ void OvmsMetricFloat::RefreshPersist()
     *m_valuep = m_value;
   }
 
-std::string OvmsMetricFloat::AsString(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricFloat::AppendString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
     {
-    std::ostringstream ss;
-    if (precision >= 0)
-      {
-      ss.precision(precision); // Set desired precision
-      ss << fixed;
-      }
     if ((units != Other)&&(units != m_units))
-      ss << UnitConvert(m_units,units,m_value);
+      format_float(buf, UnitConvert(m_units,units,m_value), precision);
     else
-      ss << m_value;
-    std::string s(ss.str());
-    return s;
+      format_float(buf, m_value, precision);
     }
   else
     {
-    return std::string(defvalue);
+    buf.append(defvalue);
     }
   }
 
-std::string OvmsMetricFloat::AsJSON(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricFloat::AppendJSON(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
-    return AsString(defvalue, units, precision);
+    AppendString(buf, defvalue, units, precision);
   else
-    return std::string((defvalue && *defvalue) ? defvalue : "0");
+    buf.append((defvalue && *defvalue) ? defvalue : "0");
   }
 
 float OvmsMetricFloat::AsFloat(const float defvalue, metric_unit_t units)
@@ -1353,17 +1431,32 @@ OvmsMetricString::~OvmsMetricString()
   {
   }
 
-std::string OvmsMetricString::AsString(const char* defvalue, metric_unit_t units, int precision)
+void OvmsMetricString::AppendString(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
   {
   if (IsDefined())
     {
     OvmsMutexLock lock(&m_mutex);
-    return m_value;
+    buf.append(m_value);
+    }
+  else
+    {
+    buf.append(defvalue);
+    }
+  }
+
+void OvmsMetricString::AppendJSON(std::string& buf, const char* defvalue, metric_unit_t units, int precision)
+  {
+  buf += '"';
+  if (IsDefined())
+    {
+    OvmsMutexLock lock(&m_mutex);
+    json_append(buf, m_value);
     }
   else
     {
-    return std::string(defvalue);
+    json_append(buf, std::string(defvalue));
     }
+  buf += '"';
   }
 
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
@@ -115,6 +115,14 @@ typedef enum : uint8_t
   Defined
 } metric_defined_t;
 
+typedef enum : uint8_t
+  {
+  MetricValueOther = 0,     // string, set, vector etc.
+  MetricValueBool,          // OvmsMetricBool
+  MetricValueInt,           // OvmsMetricInt
+  MetricValueFloat          // OvmsMetricFloat
+  } metric_valuetype_t;
+
 extern const char* OvmsMetricUnitLabel(metric_unit_t units);
 extern int UnitConvert(metric_unit_t from, metric_unit_t to, int value);
 extern float UnitConvert(metric_unit_t from, metric_unit_t to, float value);
@@ -150,7 +158,11 @@ class OvmsMetric
     virtual std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     std::string AsUnitString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    virtual void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendUnitString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    virtual void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     virtual float AsFloat(const float defvalue = 0, metric_unit_t units = Other);
+    virtual metric_valuetype_t GetValueType() { return MetricValueOther; }
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
     virtual void DukPush(DukContext &dc);
 #endif
@@ -194,10 +206,11 @@ class OvmsMetricBool : public OvmsMetric
     virtual ~OvmsMetricBool();
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     float AsFloat(const float defvalue = 0, metric_unit_t units = Other);
     int AsBool(const bool defvalue = false);
+    metric_valuetype_t GetValueType() { return MetricValueBool; }
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
     void DukPush(DukContext &dc);
 #endif
@@ -221,10 +234,11 @@ class OvmsMetricInt : public OvmsMetric
     virtual ~OvmsMetricInt();
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     float AsFloat(const float defvalue = 0, metric_unit_t units = Other);
     int AsInt(const int defvalue = 0, metric_unit_t units = Other);
+    metric_valuetype_t GetValueType() { return MetricValueInt; }
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
     void DukPush(DukContext &dc);
 #endif
@@ -248,10 +262,11 @@ class OvmsMetricFloat : public OvmsMetric
     virtual ~OvmsMetricFloat();
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
     float AsFloat(const float defvalue = 0, metric_unit_t units = Other);
     int AsInt(const int defvalue = 0, metric_unit_t units = Other);
+    metric_valuetype_t GetValueType() { return MetricValueFloat; }
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
     void DukPush(DukContext &dc);
 #endif
@@ -275,7 +290,8 @@ class OvmsMetricString : public OvmsMetric
     virtual ~OvmsMetricString();
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1);
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
     void DukPush(DukContext &dc);
 #endif
@@ -289,6 +305,44 @@ class OvmsMetricString : public OvmsMetric
   };
 
 
+/**
+ * metric_append_elem: append container element in string representation
+ *  (same format as std::ostream, precision >= 0 = fixed)
+ */
+inline void metric_append_elem(std::string& buf, float value, int precision)
+  {
+  format_float(buf, value, precision);
+  }
+inline void metric_append_elem(std::string& buf, int value, int precision)
+  {
+  format_int(buf, value);
+  }
+inline void metric_append_elem(std::string& buf, long value, int precision)
+  {
+  format_int(buf, value);
+  }
+inline void metric_append_elem(std::string& buf, short value, int precision)
+  {
+  format_int(buf, value);
+  }
+inline void metric_append_elem(std::string& buf, const std::string& value, int precision)
+  {
+  buf.append(value);
+  }
+template <typename ElemType>
+void metric_append_elem(std::string& buf, const ElemType& value, int precision)
+  {
+  std::ostringstream ss;
+  if (precision >= 0)
+    {
+    ss.precision(precision);
+    ss << fixed;
+    }
+  ss << value;
+  buf.append(ss.str());
+  }
+
+
 /**
  * OvmsMetricBitset<bits>: metric wrapper for std::bitset<bits>
  *  - string representation as comma separated bit positions (beginning at startpos) of set bits
@@ -306,30 +360,31 @@ class OvmsMetricBitset : public OvmsMetric
       }
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
       if (!IsDefined())
-        return std::string(defvalue);
-      std::ostringstream ss;
+        {
+        buf.append(defvalue);
+        return;
+        }
+      size_t start = buf.size();
       OvmsMutexLock lock(&m_mutex);
       for (int i = 0; i < N; i++)
         {
         if (m_value[i])
           {
-          if (ss.tellp() > 0)
-            ss << ',';
-          ss << startpos + i;
+          if (buf.size() > start)
+            buf += ',';
+          format_int(buf, startpos + i);
           }
         }
-      return ss.str();
       }
 
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
-      std::string json = "[";
-      json += AsString(defvalue, units, precision);
-      json += "]";
-      return json;
+      buf += '[';
+      AppendString(buf, defvalue, units, precision);
+      buf += ']';
       }
 
     bool SetValue(std::string value)
@@ -421,27 +476,28 @@ class OvmsMetricSet : public OvmsMetric
       }
 
   public:
-    std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
       if (!IsDefined())
-        return std::string(defvalue);
-      std::ostringstream ss;
+        {
+        buf.append(defvalue);
+        return;
+        }
+      size_t start = buf.size();
       OvmsMutexLock lock(&m_mutex);
       for (auto i = m_value.begin(); i != m_value.end(); i++)
         {
-        if (ss.tellp() > 0)
-          ss << ',';
-        ss << *i;
+        if (buf.size() > start)
+          buf += ',';
+        metric_append_elem(buf, *i, -1);
         }
-      return ss.str();
       }
 
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
-      std::string json = "[";
-      json += AsString(defvalue, units, precision);
-      json += "]";
-      return json;
+      buf += '[';
+      AppendString(buf, defvalue, units, precision);
+      buf += ']';
       }
 
     bool SetValue(std::string value)
@@ -672,27 +728,24 @@ class OvmsMetricVector : public OvmsMetric
       }
 
   public:
-    virtual std::string AsString(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendString(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
       if (!IsDefined())
-        return std::string(defvalue);
-      std::ostringstream ss;
-      if (precision >= 0)
         {
-        ss.precision(precision);
-        ss << fixed;
+        buf.append(defvalue);
+        return;
         }
+      size_t start = buf.size();
       OvmsMutexLock lock(&m_mutex);
       for (auto i = m_value.begin(); i != m_value.end(); i++)
         {
-        if (ss.tellp() > 0)
-          ss << ',';
+        if (buf.size() > start)
+          buf += ',';
         if (units != Other && units != m_units)
-          ss << (ElemType) UnitConvert(m_units, units, (float)*i);
+          metric_append_elem(buf, (ElemType) UnitConvert(m_units, units, (float)*i), precision);
         else
-          ss << *i;
+          metric_append_elem(buf, *i, precision);
         }
-      return ss.str();
       }
 
     virtual std::string ElemAsString(size_t n, const char* defvalue = "", metric_unit_t units = Other, int precision = -1, bool addunitlabel = false)
@@ -700,19 +753,14 @@ class OvmsMetricVector : public OvmsMetric
       OvmsMutexLock lock(&m_mutex);
       if (!IsDefined() || m_value.size() <= n)
         return std::string(defvalue);
-      std::ostringstream ss;
-      if (precision >= 0)
-        {
-        ss.precision(precision);
-        ss << fixed;
-        }
+      std::string buf;
       if (units != Other && units != m_units)
-        ss << (ElemType) UnitConvert(m_units, units, (float)m_value[n]);
+        metric_append_elem(buf, (ElemType) UnitConvert(m_units, units, (float)m_value[n]), precision);
       else
-        ss << m_value[n];
+        metric_append_elem(buf, m_value[n], precision);
       if (addunitlabel)
-        ss << OvmsMetricUnitLabel(units == Native ? GetUnits() : units);
-      return ss.str();
+        buf.append(OvmsMetricUnitLabel(units == Native ? GetUnits() : units));
+      return buf;
       }
 
     std::string ElemAsUnitString(size_t n, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
@@ -720,12 +768,11 @@ class OvmsMetricVector : public OvmsMetric
       return ElemAsString(n, defvalue, units, precision, true);
       }
 
-    virtual std::string AsJSON(const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
+    void AppendJSON(std::string& buf, const char* defvalue = "", metric_unit_t units = Other, int precision = -1)
       {
-      std::string json = "[";
-      json += AsString(defvalue, units, precision);
-      json += "]";
-      return json;
+      buf += '[';
+      AppendString(buf, defvalue, units, precision);
+      buf += ']';
       }
 
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
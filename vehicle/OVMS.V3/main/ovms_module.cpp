@@ -51,6 +51,9 @@ static const char *TAG = "module";
 #include "ovms_mutex.h"
 #include "ovms_notify.h"
 #include "string_writer.h"
+#include "ovms_malloc.h"
+#include "ovms_mempool.h"
+#include <set>
 
 #define MAX_TASKS 30
 #define DUMPSIZE 1000
@@ -58,6 +61,7 @@ static const char *TAG = "module";
 #define NAMELEN 16
 #define TASKLIST 10
 #define NOT_FOUND (TaskHandle_t)0xFFFFFFFF
+#define TASKHIST_SIZE 60
 
 #ifndef CONFIG_HEAP_TASK_TRACKING
 #define NOGO 1
@@ -96,6 +100,15 @@ static void module_check(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, in
   must(writer);
   }
 
+static void module_tasks_history(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  must(writer);
+  }
+
+static void module_tasks_ticker()
+  {
+  }
+
 void AddTaskToMap(TaskHandle_t task) {}
 
 #else
@@ -885,12 +898,260 @@ static void module_tasks_data(int verbosity, OvmsWriter* writer, OvmsCommand* cm
     }
   }
 
+/**
+ * Task history: background collector for task CPU, stack & heap usage
+ *
+ * Enabled by config module tasks.sample (interval in seconds, 0 = off). Samples
+ * are kept in a ring buffer (TASKHIST_SIZE samples) and published as metrics
+ * m.tasks.*. Events module.task.cpu.high / module.task.stack.low are raised with
+ * the task name when a task exceeds the configured thresholds.
+ */
+
+typedef struct
+  {
+  uint16_t num;                         // xTaskNumber
+  uint16_t cpu;                         // CPU usage [1/10 %]
+  uint16_t stackfree;                   // stack high water mark (min free) [bytes]
+  uint32_t heap;                        // heap usage (internal + SPIRAM) [bytes]
+  } taskhist_entry_t;
+
+typedef struct
+  {
+  uint32_t time;                        // seconds since boot
+  uint8_t count;
+  taskhist_entry_t task[MAX_TASKS];
+  } taskhist_sample_t;
+
+static taskhist_sample_t* taskhist = NULL;
+static int taskhist_head = 0;           // next sample index
+static int taskhist_count = 0;          // samples in buffer
+static std::map<UBaseType_t, std::string> taskhist_names;
+static TaskStatus_t* taskhist_status = NULL;  // own task status buffer, see module_tasks_sample()
+static std::map<UBaseType_t, uint32_t> taskhist_runtime;
+static uint32_t taskhist_totalruntime = 0;
+static std::set<UBaseType_t> taskhist_cpualert, taskhist_stackalert;
+static OvmsMetricString* ms_m_tasks_list = NULL;
+static OvmsMetricVector<float>* ms_m_tasks_cpu = NULL;
+static OvmsMetricVector<int>* ms_m_tasks_stack = NULL;
+static OvmsMetricVector<int>* ms_m_tasks_heap = NULL;
+
+static void module_tasks_sample()
+  {
+  OvmsMutexLock lock(&taskstatus_mutex);
+  if (!allocate())
+    return;
+  if (!taskhist)
+    {
+    taskhist = (taskhist_sample_t*)ExternalRamMalloc(sizeof(taskhist_sample_t) * TASKHIST_SIZE);
+    taskhist_status = (TaskStatus_t*)heap_caps_malloc(sizeof(TaskStatus_t)*MAX_TASKS, MALLOC_CAP_32BIT);
+    if (!taskhist || !taskhist_status)
+      {
+      ESP_LOGE(TAG, "Can't allocate storage for task history");
+      if (taskhist)
+        free(taskhist);
+      if (taskhist_status)
+        free(taskhist_status);
+      taskhist = NULL;
+      taskhist_status = NULL;
+      return;
+      }
+    ms_m_tasks_list = MyMetrics.InitString("m.tasks.list", SM_STALE_MAX);
+    ms_m_tasks_cpu = MyMetrics.InitVector<float>("m.tasks.cpu", SM_STALE_MAX, NULL, Percentage);
+    ms_m_tasks_stack = MyMetrics.InitVector<int>("m.tasks.stack", SM_STALE_MAX, NULL, Other);
+    ms_m_tasks_heap = MyMetrics.InitVector<int>("m.tasks.heap", SM_STALE_MAX, NULL, Other);
+    }
+
+  // sample into our own buffer, so the CPU usage baseline of the
+  // module tasks commands (taskstatus/totalruntime) stays untouched:
+  uint32_t sample_totalruntime;
+  UBaseType_t n = uxTaskGetSystemState(taskhist_status, MAX_TASKS, &sample_totalruntime);
+  get_memory(tasklist, 0);
+  uint32_t diff_totalruntime = sample_totalruntime - taskhist_totalruntime;
+  std::map<UBaseType_t, uint32_t> last_runtime;
+  last_runtime.swap(taskhist_runtime);
+  taskhist_totalruntime = sample_totalruntime;
+
+  taskhist_sample_t& sample = taskhist[taskhist_head];
+  sample.time = xTaskGetTickCount() / configTICK_RATE_HZ;
+  sample.count = 0;
+
+  float cpu_alert = MyConfig.GetParamValueFloat("module", "tasks.cpu.alert", 90);
+  int stack_alert = MyConfig.GetParamValueInt("module", "tasks.stack.alert", 256);
+  std::string list;
+  std::vector<float> cpuvec;
+  std::vector<int> stackvec, heapvec;
+
+  for (UBaseType_t i = 0; i < n && sample.count < MAX_TASKS; ++i)
+    {
+    TaskStatus_t& ts = taskhist_status[i];
+    taskhist_runtime[ts.xTaskNumber] = ts.ulRunTimeCounter;
+    auto last = last_runtime.find(ts.xTaskNumber);
+    uint32_t runtime = ts.ulRunTimeCounter - ((last != last_runtime.end()) ? last->second : 0);
+    float cpu = diff_totalruntime ? ((float) runtime / diff_totalruntime * 100) : 0.0f;
+    int k = changes->find(ts.xHandle);
+    uint32_t heap = 0;
+    if (k >= 0)
+      heap = (*changes).After(k, DRAM) + (*changes).After(k, D_IRAM) + (*changes).After(k, IRAM) + (*changes).After(k, SPIRAM);
+
+    taskhist_entry_t& e = sample.task[sample.count++];
+    e.num = ts.xTaskNumber;
+    e.cpu = cpu * 10 + 0.5f;
+    e.stackfree = ts.usStackHighWaterMark;
+    e.heap = heap;
+    taskhist_names[ts.xTaskNumber] = ts.pcTaskName;
+
+    if (!list.empty()) list.append(",");
+    list.append(ts.pcTaskName);
+    cpuvec.push_back(e.cpu / 10.0f);
+    stackvec.push_back(e.stackfree);
+    heapvec.push_back(e.heap);
+
+    // threshold events (raised once per crossing):
+    if (cpu >= cpu_alert && strcmp(ts.pcTaskName, "IDLE0") != 0 && strcmp(ts.pcTaskName, "IDLE1") != 0)
+      {
+      if (taskhist_cpualert.insert(ts.xTaskNumber).second)
+        {
+        ESP_LOGW(TAG, "Task %s CPU usage %.1f%%", ts.pcTaskName, cpu);
+        MyEvents.SignalEvent("module.task.cpu.high", (void*)ts.pcTaskName, strlen(ts.pcTaskName)+1);
+        }
+      }
+    else
+      taskhist_cpualert.erase(ts.xTaskNumber);
+    if (ts.usStackHighWaterMark < stack_alert)
+      {
+      if (taskhist_stackalert.insert(ts.xTaskNumber).second)
+        {
+        ESP_LOGW(TAG, "Task %s stack low: %u bytes free", ts.pcTaskName, ts.usStackHighWaterMark);
+        MyEvents.SignalEvent("module.task.stack.low", (void*)ts.pcTaskName, strlen(ts.pcTaskName)+1);
+        }
+      }
+    }
+
+  taskhist_head = (taskhist_head + 1) % TASKHIST_SIZE;
+  if (taskhist_count < TASKHIST_SIZE)
+    taskhist_count++;
+
+  // forget names of tasks no longer in the history, and alert states of deleted tasks:
+  std::set<UBaseType_t> present;
+  for (int j = 0; j < taskhist_count; j++)
+    {
+    taskhist_sample_t& hs = taskhist[(taskhist_head - 1 - j + TASKHIST_SIZE) % TASKHIST_SIZE];
+    for (int i = 0; i < hs.count; i++)
+      present.insert(hs.task[i].num);
+    }
+  for (auto it = taskhist_names.begin(); it != taskhist_names.end(); )
+    {
+    if (present.count(it->first) == 0)
+      it = taskhist_names.erase(it);
+    else
+      ++it;
+    }
+  for (auto it = taskhist_cpualert.begin(); it != taskhist_cpualert.end(); )
+    {
+    if (taskhist_runtime.count(*it) == 0)
+      it = taskhist_cpualert.erase(it);
+    else
+      ++it;
+    }
+  for (auto it = taskhist_stackalert.begin(); it != taskhist_stackalert.end(); )
+    {
+    if (taskhist_runtime.count(*it) == 0)
+      it = taskhist_stackalert.erase(it);
+    else
+      ++it;
+    }
+
+  ms_m_tasks_list->SetValue(list);
+  ms_m_tasks_cpu->SetValue(cpuvec);
+  ms_m_tasks_stack->SetValue(stackvec);
+  ms_m_tasks_heap->SetValue(heapvec);
+  }
+
+static void module_tasks_ticker()
+  {
+  static uint32_t cnt = 0;
+  int interval = MyConfig.GetParamValueInt("module", "tasks.sample", 0);
+  if (interval <= 0)
+    return;
+  if (++cnt >= interval)
+    {
+    cnt = 0;
+    module_tasks_sample();
+    }
+  }
+
+/**
+ * module tasks history [cpu|stack|heap]: output task history as CSV
+ *  First line: sample times (seconds since boot), then one line per task.
+ */
+static void module_tasks_history(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  OvmsMutexLock lock(&taskstatus_mutex);
+  if (!taskhist || taskhist_count == 0)
+    {
+    writer->puts("No task history recorded, enable by: config set module tasks.sample <seconds>");
+    return;
+    }
+  const char* what = (argc > 0) ? argv[0] : "cpu";
+  int type;
+  if (strcmp(what, "cpu") == 0)
+    type = 0;
+  else if (strcmp(what, "stack") == 0)
+    type = 1;
+  else if (strcmp(what, "heap") == 0)
+    type = 2;
+  else
+    {
+    writer->printf("Error: unknown type '%s'\n", what);
+    return;
+    }
+
+  int first = (taskhist_head - taskhist_count + TASKHIST_SIZE) % TASKHIST_SIZE;
+  StringWriter buf;
+  buf.reserve(1024);
+  buf.append("#time");
+  for (int j = 0; j < taskhist_count; j++)
+    buf.printf(",%u", taskhist[(first + j) % TASKHIST_SIZE].time);
+  writer->puts(buf.c_str());
+
+  for (auto& it : taskhist_names)
+    {
+    buf.clear();
+    buf.append(it.second);
+    for (int j = 0; j < taskhist_count; j++)
+      {
+      taskhist_sample_t& sample = taskhist[(first + j) % TASKHIST_SIZE];
+      buf.append(",");
+      for (int i = 0; i < sample.count; i++)
+        {
+        taskhist_entry_t& e = sample.task[i];
+        if (e.num != it.first)
+          continue;
+        if (type == 0)
+          buf.printf("%.1f", e.cpu / 10.0f);
+        else if (type == 1)
+          buf.printf("%u", e.stackfree);
+        else
+          buf.printf("%u", e.heap);
+        break;
+        }
+      }
+    writer->puts(buf.c_str());
+    }
+  }
+
 static void module_check(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   heap_caps_check_integrity_all(true);
   }
 #endif // NOGO
 
+static void module_pools(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyIntRamPool.Status(writer);
+  MyExtRamPool.Status(writer);
+  }
+
 static void module_fault(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   ESP_LOGI(TAG,"Abort faulting module (on command)");
@@ -984,6 +1245,9 @@ static void module_factory_reset(int verbosity, OvmsWriter* writer, OvmsCommand*
 
 static void module_eventhandler(std::string event, void* data)
   {
+  if (event == "ticker.1")
+    module_tasks_ticker();
+
   if (event == "ticker.300")
     {
     if (MyConfig.GetParamValueBool("module", "debug.tasks", false))
@@ -1054,16 +1318,18 @@ class OvmsModuleInit
 
 #ifdef CONFIG_OVMS_COMP_SDCARD
     MyEvents.RegisterEvent(TAG, "sd.mounted", module_eventhandler);
-    MyEvents.RegisterEvent(TAG, "ticker.1", module_eventhandler);
 #endif //CONFIG_OVMS_COMP_SDCARD
+    MyEvents.RegisterEvent(TAG, "ticker.1", module_eventhandler);
     MyEvents.RegisterEvent(TAG, "ticker.300", module_eventhandler);
 
     OvmsCommand* cmd_module = MyCommandApp.RegisterCommand("module","MODULE framework");
     cmd_module->RegisterCommand("memory","Show module memory usage",module_memory,"[<task names or ids>|*|=]",0,TASKLIST);
     cmd_module->RegisterCommand("leaks","Show module memory changes",module_memory,"[<task names or ids>|*|=]",0,TASKLIST);
+    cmd_module->RegisterCommand("pools","Show memory pool usage",module_pools);
     OvmsCommand* cmd_tasks = cmd_module->RegisterCommand("tasks","Show module task usage",module_tasks);
     cmd_tasks->RegisterCommand("stack","Show module task usage with stack",module_tasks);
     cmd_tasks->RegisterCommand("data","Output module task stats record",module_tasks_data);
+    cmd_tasks->RegisterCommand("history","Output module task history (CSV)",module_tasks_history,"[cpu|stack|heap]",0,1);
     cmd_module->RegisterCommand("fault","Abort fault the module",module_fault);
     OvmsCommand* cmd_trigger = cmd_module->RegisterCommand("trigger","Trigger framework");
     cmd_trigger->RegisterCommand("twdt","Trigger task watchdog timeout",module_trigger_twdt);
@@ -33,6 +33,8 @@ static const char *TAG = "notify";
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <sstream>
 #include "ovms.h"
 #include "ovms_notify.h"
@@ -88,6 +90,8 @@ void notify_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc
         writer->printf("    %d: [%d pending] %s\n",
           ite->first, e->CountPending(), e->GetValue().c_str());
         }
+      if (mt->m_spool)
+        mt->m_spool->Status(writer);
       }
     }
   }
@@ -162,6 +166,7 @@ OvmsNotifyEntry::OvmsNotifyEntry(const char* subtype)
   m_pendingreaders = 0;
   m_id = 0;
   m_created = esp_log_timestamp();
+  m_spoolpos = NOTIFY_SPOOL_NONE;
   m_type = NULL;
   m_subtype = strdup(subtype);
   }
@@ -264,10 +269,13 @@ OvmsNotifyType::OvmsNotifyType(const char* name)
   {
   m_name = name;
   m_nextid = 1;
+  m_spool = NULL;
   }
 
 OvmsNotifyType::~OvmsNotifyType()
   {
+  if (m_spool)
+    delete m_spool;
   }
 
 uint32_t OvmsNotifyType::QueueEntry(OvmsNotifyEntry* entry)
@@ -292,9 +300,16 @@ uint32_t OvmsNotifyType::QueueEntry(OvmsNotifyEntry* entry)
   // Dispatch the callbacks...
   MyNotify.NotifyReaders(this, entry);
 
+  // Move to spool for readers with a full window...
+  if (m_spool)
+    m_spool->Offload(entry);
+
   // Check if we can cleanup...
   Cleanup(entry);
 
+  if (m_spool)
+    m_spool->Replay();
+
   return id;
   }
 
@@ -344,9 +359,14 @@ OvmsNotifyEntry* OvmsNotifyType::FindEntry(uint32_t id)
 
 void OvmsNotifyType::MarkRead(size_t reader, OvmsNotifyEntry* entry)
   {
-  OvmsRecMutexLock lock(&m_mutex);
-  entry->m_pendingreaders &= ~(1ul << reader);
-  Cleanup(entry);
+    {
+    OvmsRecMutexLock lock(&m_mutex);
+    entry->m_pendingreaders &= ~(1ul << reader);
+    Cleanup(entry);
+    }
+  // Refill reader window from spool (needs MyNotify lock first):
+  if (m_spool)
+    m_spool->Replay();
   }
 
 void OvmsNotifyType::Cleanup(OvmsNotifyEntry* entry, NotifyEntryMap_t::iterator* next /*=NULL*/)
@@ -366,6 +386,608 @@ void OvmsNotifyType::Cleanup(OvmsNotifyEntry* entry, NotifyEntryMap_t::iterator*
     }
   }
 
+////////////////////////////////////////////////////////////////////////
+// OvmsNotifySpool is an optional VFS backed append-only queue for a
+// notification type. Once a spool reader has a full window of entries
+// pending in RAM, further entries for that reader are appended to the
+// spool file and replayed into RAM as the reader catches up.
+// Spool readers are identified by their caller name, so their file
+// offsets survive a reboot. To limit flash wear, the spool file is kept
+// open during a burst of appends, and offsets are persisted at most every
+// <type>.sync seconds (new readers & rebases immediately, and on shutdown),
+// so delivery is at-least-once: after a crash, records read within the
+// last sync interval may be sent again.
+
+OvmsNotifySpool::OvmsNotifySpool(OvmsNotifyType* type)
+  {
+  m_type = type;
+  m_enabled = false;
+  m_loaded = false;
+  m_replaying = false;
+  m_maxsize = 0;
+  m_window = 0;
+  m_syncinterval = 0;
+  m_filesize = 0;
+  m_appendfp = NULL;
+  m_lastappend = 0;
+  m_lastsave = 0;
+  m_spooled = 0;
+  m_replayed = 0;
+  m_dropped = 0;
+  }
+
+OvmsNotifySpool::~OvmsNotifySpool()
+  {
+  CloseAppend();
+  }
+
+void OvmsNotifySpool::ConfigChanged()
+  {
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+  std::string prefix(m_type->m_name);
+  std::string path = MyConfig.GetParamValue("notify.spool", prefix + ".path",
+    std::string("/store/notify/") + m_type->m_name + ".spool");
+  m_enabled = MyConfig.GetParamValueBool("notify.spool", prefix + ".enable", false);
+  m_maxsize = MyConfig.GetParamValueInt("notify.spool", prefix + ".maxsize", 128) * 1024;
+  m_window = MyConfig.GetParamValueInt("notify.spool", prefix + ".window", 20);
+  if (m_window < 1)
+    m_window = 1;
+  m_syncinterval = MyConfig.GetParamValueInt("notify.spool", prefix + ".sync", 60);
+  if (m_syncinterval < 0)
+    m_syncinterval = 0;
+
+  m_readers.clear();
+  std::string readers = MyConfig.GetParamValue("notify.spool", prefix + ".readers", "ovmsv2,ovmsv3");
+  size_t start = 0;
+  while (start < readers.size())
+    {
+    size_t end = readers.find(',', start);
+    if (end == std::string::npos)
+      end = readers.size();
+    if (end > start)
+      m_readers.insert(readers.substr(start, end-start));
+    start = end + 1;
+    }
+
+  if (path != m_path)
+    {
+    CloseAppend();
+    m_path = path;
+    m_loaded = false;
+    }
+  if (m_enabled && !m_loaded)
+    LoadIndex();
+  }
+
+bool OvmsNotifySpool::IsSpoolReader(OvmsNotifyCallbackEntry* reader)
+  {
+  return (m_readers.find(reader->m_caller) != m_readers.end());
+  }
+
+int OvmsNotifySpool::CountWindow(size_t reader, OvmsNotifyEntry* except /*=NULL*/)
+  {
+  int cnt = 0;
+  for (NotifyEntryMap_t::iterator ite=m_type->m_entries.begin(); ite!=m_type->m_entries.end(); ++ite)
+    {
+    if (ite->second != except && !ite->second->IsRead(reader))
+      cnt++;
+    }
+  return cnt;
+  }
+
+/**
+ * Offload: called by OvmsNotifyType::QueueEntry() after dispatching a new entry.
+ *  Spool readers still having the entry pending while their RAM window is full
+ *  or while they still have older records in the file get the entry from the file.
+ */
+void OvmsNotifySpool::Offload(OvmsNotifyEntry* entry)
+  {
+  if (!m_enabled || !m_loaded)
+    return;
+
+  OvmsRecMutexLock slock(&MyNotify.m_mutex);
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+
+  unsigned long spool = 0;
+  std::set<std::string> callers;
+  for (OvmsNotifyCallbackMap_t::iterator itc=MyNotify.m_readers.begin(); itc!=MyNotify.m_readers.end(); ++itc)
+    {
+    OvmsNotifyCallbackEntry* mc = itc->second;
+    if (!IsSpoolReader(mc) || entry->IsRead(mc->m_reader))
+      continue;
+    auto c = m_cursor.find(mc->m_caller);
+    bool backlog = (c != m_cursor.end() && c->second < m_filesize);
+    if (backlog || CountWindow(mc->m_reader, entry) >= m_window)
+      {
+      spool |= 1ul << mc->m_reader;
+      callers.insert(mc->m_caller);
+      }
+    }
+  if (spool == 0)
+    return;
+
+  uint32_t start;
+  if (!Append(entry, start))
+    return; // keep the entry in RAM
+
+  entry->m_pendingreaders &= ~spool;
+  m_spooled++;
+
+  // Readers taking this entry from RAM skip the record, readers
+  // without backlog so far start reading from the file here:
+  bool changed = false;
+  for (auto c=m_cursor.begin(); c!=m_cursor.end(); )
+    {
+    if (c->second == start && callers.count(c->first) == 0)
+      {
+      c = m_cursor.erase(c);
+      changed = true;
+      }
+    else
+      ++c;
+    }
+  for (auto c=callers.begin(); c!=callers.end(); ++c)
+    {
+    if (m_cursor.count(*c) == 0)
+      {
+      m_cursor[*c] = start;
+      changed = true;
+      }
+    }
+  if (changed)
+    Sync();
+
+  if (MyNotify.m_trace)
+    ESP_LOGI(TAG, "Spool type %s id %d: offset %u size %u", m_type->m_name, entry->m_id, start, m_filesize);
+  }
+
+bool OvmsNotifySpool::Append(OvmsNotifyEntry* entry, uint32_t& start)
+  {
+  extram::string value = entry->GetValue();
+  const char* subtype = entry->GetSubType();
+
+  OvmsNotifySpoolRecord_t rec;
+  rec.magic = NOTIFY_SPOOL_MAGIC;
+  rec.subtypelen = strlen(subtype);
+  rec.valuelen = value.size();
+  time_t now = time(NULL);
+  if (now > 1500000000)
+    rec.time = now - (esp_log_timestamp() - entry->m_created) / 1000;
+  else
+    rec.time = 0;
+
+  uint32_t reclen = sizeof(rec) + rec.subtypelen + rec.valuelen;
+  if (reclen > m_maxsize)
+    {
+    ESP_LOGW(TAG, "Spool %s: record size %u exceeds spool size", m_path.c_str(), reclen);
+    return false;
+    }
+  if (m_filesize + reclen > m_maxsize)
+    Compact(reclen);
+
+  if (m_filesize == 0)
+    {
+    size_t dirend = m_path.rfind('/');
+    if (dirend != std::string::npos && dirend > 0)
+      mkpath(m_path.substr(0, dirend));
+    }
+
+  if (!m_appendfp)
+    {
+    m_appendfp = fopen(m_path.c_str(), "a");
+    if (!m_appendfp)
+      {
+      ESP_LOGE(TAG, "Spool %s: cannot open for writing", m_path.c_str());
+      return false;
+      }
+    }
+  FILE* fp = m_appendfp;
+  bool ok = (fwrite(&rec, sizeof(rec), 1, fp) == 1)
+    && (rec.subtypelen == 0 || fwrite(subtype, rec.subtypelen, 1, fp) == 1)
+    && (rec.valuelen == 0 || fwrite(value.data(), rec.valuelen, 1, fp) == 1);
+  m_lastappend = esp_log_timestamp();
+  if (!ok)
+    {
+    // a partial record will be detected & skipped on replay
+    ESP_LOGE(TAG, "Spool %s: write failed", m_path.c_str());
+    CloseAppend();
+    struct stat st;
+    if (stat(m_path.c_str(), &st) == 0)
+      m_filesize = st.st_size;
+    return false;
+    }
+
+  start = m_filesize;
+  m_filesize += reclen;
+  return true;
+  }
+
+void OvmsNotifySpool::CloseAppend()
+  {
+  if (m_appendfp)
+    {
+    if (fclose(m_appendfp) != 0)
+      ESP_LOGE(TAG, "Spool %s: close failed", m_path.c_str());
+    m_appendfp = NULL;
+    }
+  }
+
+bool OvmsNotifySpool::ReadRecord(FILE* fp, uint32_t pos, OvmsNotifySpoolRecord_t& rec, uint32_t& next,
+                                 extram::string* subtype /*=NULL*/, extram::string* value /*=NULL*/)
+  {
+  if (fseek(fp, pos, SEEK_SET) != 0)
+    return false;
+  if (fread(&rec, sizeof(rec), 1, fp) != 1 || rec.magic != NOTIFY_SPOOL_MAGIC)
+    return false;
+  next = pos + sizeof(rec) + rec.subtypelen + rec.valuelen;
+  if (next > m_filesize || next < pos)
+    return false;
+  if (subtype)
+    {
+    subtype->resize(rec.subtypelen);
+    if (rec.subtypelen && fread(&(*subtype)[0], rec.subtypelen, 1, fp) != 1)
+      return false;
+    }
+  if (value)
+    {
+    if (!subtype && fseek(fp, rec.subtypelen, SEEK_CUR) != 0)
+      return false;
+    value->resize(rec.valuelen);
+    if (rec.valuelen && fread(&(*value)[0], rec.valuelen, 1, fp) != 1)
+      return false;
+    }
+  return true;
+  }
+
+/**
+ * Replay: refill the RAM windows of all spool readers from the file
+ */
+void OvmsNotifySpool::Replay()
+  {
+  if (!m_enabled || !m_loaded || m_replaying)
+    return;
+
+  OvmsRecMutexLock slock(&MyNotify.m_mutex);
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+  if (m_cursor.empty())
+    return;
+
+  m_replaying = true;
+  for (OvmsNotifyCallbackMap_t::iterator itc=MyNotify.m_readers.begin(); itc!=MyNotify.m_readers.end(); ++itc)
+    {
+    if (IsSpoolReader(itc->second))
+      ReplayReader(itc->second);
+    }
+  Sync();
+  m_replaying = false;
+  }
+
+void OvmsNotifySpool::ReplayReader(OvmsNotifyCallbackEntry* reader)
+  {
+  auto c = m_cursor.find(reader->m_caller);
+  if (c == m_cursor.end() || c->second >= m_filesize)
+    return;
+  int room = m_window - CountWindow(reader->m_reader);
+  if (room <= 0)
+    return;
+
+  CloseAppend();
+  FILE* fp = fopen(m_path.c_str(), "r");
+  if (!fp)
+    {
+    ESP_LOGE(TAG, "Spool %s: cannot open for reading, discarding %u bytes", m_path.c_str(), m_filesize - c->second);
+    c->second = m_filesize;
+    return;
+    }
+
+  OvmsNotifySpoolRecord_t rec;
+  extram::string subtype, value;
+  while (room > 0 && c->second < m_filesize)
+    {
+    uint32_t pos = c->second, next;
+    if (!ReadRecord(fp, pos, rec, next, &subtype, &value))
+      {
+      ESP_LOGE(TAG, "Spool %s: invalid record at offset %u, discarding %u bytes",
+        m_path.c_str(), pos, m_filesize - pos);
+      c->second = m_filesize;
+      break;
+      }
+    c->second = next;
+    if (!reader->Accepts(m_type, subtype.c_str(), value.size()))
+      continue;
+
+    OvmsNotifyEntry* e = new OvmsNotifyEntryString(subtype.c_str(), value.c_str());
+    time_t now = time(NULL);
+    if (rec.time && now > (time_t)rec.time)
+      e->m_created -= (now - rec.time) * 1000;
+    e->m_spoolpos = pos;
+    e->m_pendingreaders = 1ul << reader->m_reader;
+    e->m_id = m_type->m_nextid++;
+    e->m_type = m_type;
+    m_type->m_entries[e->m_id] = e;
+    m_replayed++;
+    room--;
+
+    if (MyNotify.m_trace)
+      ESP_LOGI(TAG, "Replay type %s id %d for %s: offset %u", m_type->m_name, e->m_id, reader->m_caller, pos);
+
+    if (reader->m_callback(m_type, e) == true)
+      e->m_pendingreaders &= ~(1ul << reader->m_reader);
+    m_type->Cleanup(e);
+    }
+
+  fclose(fp);
+  }
+
+/**
+ * Ticker: called once per second; closes the spool file after a burst
+ *  and persists pending reader offsets once the sync interval has passed
+ */
+void OvmsNotifySpool::Ticker()
+  {
+  OvmsRecMutexLock slock(&MyNotify.m_mutex);
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+  if (m_appendfp && (!m_enabled || esp_log_timestamp() - m_lastappend >= 2000))
+    CloseAppend();
+  if (m_enabled && m_loaded)
+    Sync();
+  }
+
+/**
+ * Shutdown: flush the spool file and reader offsets
+ */
+void OvmsNotifySpool::Shutdown()
+  {
+  OvmsRecMutexLock slock(&MyNotify.m_mutex);
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+  CloseAppend();
+  if (m_enabled && m_loaded)
+    Sync(true);
+  }
+
+/**
+ * ReaderPos: get the file offset a reader needs to restart from
+ *  (its cursor, or the oldest loaded entry it has not yet marked read)
+ */
+uint32_t OvmsNotifySpool::ReaderPos(const std::string& caller)
+  {
+  auto c = m_cursor.find(caller);
+  uint32_t pos = (c == m_cursor.end()) ? m_filesize : c->second;
+  for (OvmsNotifyCallbackMap_t::iterator itc=MyNotify.m_readers.begin(); itc!=MyNotify.m_readers.end(); ++itc)
+    {
+    OvmsNotifyCallbackEntry* mc = itc->second;
+    if (caller != mc->m_caller)
+      continue;
+    for (NotifyEntryMap_t::iterator ite=m_type->m_entries.begin(); ite!=m_type->m_entries.end(); ++ite)
+      {
+      OvmsNotifyEntry* e = ite->second;
+      if (e->m_spoolpos < pos && !e->IsRead(mc->m_reader))
+        pos = e->m_spoolpos;
+      }
+    }
+  return pos;
+  }
+
+void OvmsNotifySpool::GetPositions(OvmsNotifySpoolPosMap_t& positions)
+  {
+  positions.clear();
+  for (auto c=m_cursor.begin(); c!=m_cursor.end(); ++c)
+    {
+    uint32_t pos = ReaderPos(c->first);
+    if (pos < m_filesize)
+      positions[c->first] = pos;
+    }
+  for (OvmsNotifyCallbackMap_t::iterator itc=MyNotify.m_readers.begin(); itc!=MyNotify.m_readers.end(); ++itc)
+    {
+    OvmsNotifyCallbackEntry* mc = itc->second;
+    if (!IsSpoolReader(mc) || positions.count(mc->m_caller))
+      continue;
+    uint32_t pos = ReaderPos(mc->m_caller);
+    if (pos < m_filesize)
+      positions[mc->m_caller] = pos;
+    }
+  }
+
+/**
+ * Compact: make room for a new record by removing the records all readers
+ *  are through with, and if that's not sufficient, by dropping the oldest records
+ */
+void OvmsNotifySpool::Compact(uint32_t needed)
+  {
+  OvmsNotifySpoolPosMap_t positions;
+  GetPositions(positions);
+  uint32_t head = m_filesize;
+  for (auto p=positions.begin(); p!=positions.end(); ++p)
+    {
+    if (p->second < head)
+      head = p->second;
+    }
+
+  CloseAppend();
+  if (m_filesize - head + needed > m_maxsize)
+    {
+    FILE* fp = fopen(m_path.c_str(), "r");
+    OvmsNotifySpoolRecord_t rec;
+    uint32_t next;
+    int dropped = 0;
+    while (head < m_filesize && m_filesize - head + needed > m_maxsize)
+      {
+      if (!fp || !ReadRecord(fp, head, rec, next))
+        {
+        head = m_filesize;
+        break;
+        }
+      head = next;
+      dropped++;
+      }
+    if (fp) fclose(fp);
+    m_dropped += dropped;
+    ESP_LOGW(TAG, "Spool %s: size limit reached, dropped %d oldest records", m_path.c_str(), dropped);
+    }
+
+  Rebase(head);
+  }
+
+void OvmsNotifySpool::Rebase(uint32_t head)
+  {
+  if (head == 0)
+    return;
+
+  CloseAppend();
+  if (head >= m_filesize)
+    {
+    unlink(m_path.c_str());
+    m_filesize = 0;
+    }
+  else
+    {
+    std::string tmppath = m_path + ".tmp";
+    FILE* src = fopen(m_path.c_str(), "r");
+    FILE* dst = fopen(tmppath.c_str(), "w");
+    char* buf = (char*) ExternalRamMalloc(512);
+    bool ok = (src && dst && buf && fseek(src, head, SEEK_SET) == 0);
+    size_t len;
+    while (ok && (len = fread(buf, 1, 512, src)) > 0)
+      ok = (fwrite(buf, len, 1, dst) == 1);
+    if (buf) free(buf);
+    if (src) fclose(src);
+    if (dst && fclose(dst) != 0) ok = false;
+    if (ok)
+      {
+      unlink(m_path.c_str());
+      ok = (rename(tmppath.c_str(), m_path.c_str()) == 0);
+      }
+    if (!ok)
+      {
+      ESP_LOGE(TAG, "Spool %s: compaction failed, discarding spool", m_path.c_str());
+      unlink(tmppath.c_str());
+      unlink(m_path.c_str());
+      head = m_filesize;
+      m_filesize = 0;
+      }
+    else
+      {
+      m_filesize -= head;
+      }
+    }
+
+  for (auto c=m_cursor.begin(); c!=m_cursor.end(); ++c)
+    c->second = (c->second > head) ? c->second - head : 0;
+  for (NotifyEntryMap_t::iterator ite=m_type->m_entries.begin(); ite!=m_type->m_entries.end(); ++ite)
+    {
+    OvmsNotifyEntry* e = ite->second;
+    if (e->m_spoolpos != NOTIFY_SPOOL_NONE)
+      e->m_spoolpos = (e->m_spoolpos >= head && m_filesize > 0) ? e->m_spoolpos - head : NOTIFY_SPOOL_NONE;
+    }
+  m_synced.clear();
+  Sync(true);
+  }
+
+/**
+ * Sync: persist changed reader offsets, reset the spool when all readers are through.
+ *  Offset progress is only written every m_syncinterval seconds (unless forced),
+ *  new readers and a spool reset are written immediately, as the old index
+ *  would lose records on a crash.
+ */
+void OvmsNotifySpool::Sync(bool force /*=false*/)
+  {
+  OvmsNotifySpoolPosMap_t positions;
+  GetPositions(positions);
+  if (positions.empty() && m_filesize > 0)
+    {
+    CloseAppend();
+    unlink(m_path.c_str());
+    m_filesize = 0;
+    m_cursor.clear();
+    for (NotifyEntryMap_t::iterator ite=m_type->m_entries.begin(); ite!=m_type->m_entries.end(); ++ite)
+      ite->second->m_spoolpos = NOTIFY_SPOOL_NONE;
+    force = true;
+    }
+  if (positions == m_synced)
+    return;
+  for (auto p=positions.begin(); !force && p!=positions.end(); ++p)
+    {
+    if (m_synced.count(p->first) == 0)
+      force = true;
+    }
+  uint32_t now = esp_log_timestamp();
+  if (force || now - m_lastsave >= (uint32_t)m_syncinterval * 1000)
+    {
+    m_synced = positions;
+    m_lastsave = now;
+    SaveIndex();
+    }
+  }
+
+void OvmsNotifySpool::LoadIndex()
+  {
+  CloseAppend();
+  m_cursor.clear();
+  m_synced.clear();
+  m_filesize = 0;
+  for (NotifyEntryMap_t::iterator ite=m_type->m_entries.begin(); ite!=m_type->m_entries.end(); ++ite)
+    ite->second->m_spoolpos = NOTIFY_SPOOL_NONE;
+
+  struct stat st;
+  if (stat(m_path.c_str(), &st) == 0)
+    m_filesize = st.st_size;
+
+  FILE* fp = fopen((m_path + ".idx").c_str(), "r");
+  if (fp)
+    {
+    char caller[32];
+    unsigned int pos;
+    while (fscanf(fp, "%31s %u", caller, &pos) == 2)
+      {
+      if (pos > m_filesize)
+        pos = m_filesize;
+      m_cursor[caller] = m_synced[caller] = pos;
+      }
+    fclose(fp);
+    }
+  else if (m_filesize > 0)
+    {
+    // lost index: replay everything to all spool readers
+    for (auto r=m_readers.begin(); r!=m_readers.end(); ++r)
+      m_cursor[*r] = 0;
+    }
+
+  m_loaded = true;
+  ESP_LOGI(TAG, "Spool %s: %u bytes, %d readers with backlog", m_path.c_str(), m_filesize, m_cursor.size());
+  }
+
+void OvmsNotifySpool::SaveIndex()
+  {
+  std::string idxpath = m_path + ".idx";
+  if (m_synced.empty())
+    {
+    unlink(idxpath.c_str());
+    return;
+    }
+  FILE* fp = fopen(idxpath.c_str(), "w");
+  if (!fp)
+    {
+    ESP_LOGE(TAG, "Spool %s: cannot write index", m_path.c_str());
+    return;
+    }
+  for (auto p=m_synced.begin(); p!=m_synced.end(); ++p)
+    fprintf(fp, "%s %u\n", p->first.c_str(), p->second);
+  fclose(fp);
+  }
+
+void OvmsNotifySpool::Status(OvmsWriter* writer)
+  {
+  OvmsRecMutexLock slock(&MyNotify.m_mutex);
+  OvmsRecMutexLock lock(&m_type->m_mutex);
+  writer->printf("    spool %s: %s, %u/%u bytes, window %d, %u spooled, %u replayed, %u dropped\n",
+    m_path.c_str(), m_enabled ? "enabled" : "disabled", m_filesize, m_maxsize, m_window,
+    m_spooled, m_replayed, m_dropped);
+  OvmsNotifySpoolPosMap_t positions;
+  GetPositions(positions);
+  for (auto p=positions.begin(); p!=positions.end(); ++p)
+    writer->printf("      %s: offset %u, %u bytes pending\n", p->first.c_str(), p->second, m_filesize - p->second);
+  }
+
 ////////////////////////////////////////////////////////////////////////
 // OvmsNotifyCallbackEntry contains the callback function for a
 // particular reader
@@ -438,6 +1060,14 @@ OvmsNotify::OvmsNotify()
 #endif // #ifdef CONFIG_OVMS_DEV_DEBUGNOTIFICATIONS
 
   MyConfig.RegisterParam("notify", "Notification filters", true, true);
+  MyConfig.RegisterParam("notify.spool", "Notification spool configuration", true, true);
+  // Spool instances (per type, only "data" supports spooling):
+  //  <type>.enable         yes = spool entries exceeding the RAM window (default no)
+  //  <type>.path           spool file path (default /store/notify/<type>.spool)
+  //  <type>.maxsize        spool file size limit in KB (default 128)
+  //  <type>.window         max entries kept in RAM per spool reader (default 20)
+  //  <type>.readers        spool reader callers (default "ovmsv2,ovmsv3")
+  //  <type>.sync           min seconds between reader offset writes (default 60)
 
   // Register our commands
   OvmsCommand* cmd_notify = MyCommandApp.RegisterCommand("notify","NOTIFICATION framework", notify_status, "", 0, 0, false);
@@ -456,9 +1086,17 @@ OvmsNotify::OvmsNotify()
   RegisterType("info");     // payload: human readable text message
   RegisterType("error");    // payload: "<vehicletype>,<errorcode>,<errordata>"
   RegisterType("alert");    // payload: human readable text message
-  RegisterType("data");     // payload: MP historical data record (tagged CSV, see MP documentation)
+  RegisterType("data", true); // payload: MP historical data record (tagged CSV, see MP documentation)
   RegisterType("stream");   // payload: subtype specific, use for high volume / short latency data streams
 
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG,"config.mounted", std::bind(&OvmsNotify::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG,"config.changed", std::bind(&OvmsNotify::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG,"ticker.1", std::bind(&OvmsNotify::Ticker1, this, _1, _2));
+  MyEvents.RegisterEvent(TAG,"system.shuttingdown", std::bind(&OvmsNotify::ShuttingDown, this, _1, _2));
+
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
   ESP_LOGI(TAG, "Expanding DUKTAPE javascript engine");
   DuktapeObjectRegistration* dto = new DuktapeObjectRegistration("OvmsNotify");
@@ -471,6 +1109,41 @@ OvmsNotify::~OvmsNotify()
   {
   }
 
+void OvmsNotify::EventListener(std::string event, void* data)
+  {
+  OvmsConfigParam* param = (OvmsConfigParam*) data;
+  if (event == "config.changed" && param && param->GetName() != "notify.spool")
+    return;
+
+  for (OvmsNotifyTypeMap_t::iterator itt=m_types.begin(); itt!=m_types.end(); ++itt)
+    {
+    OvmsNotifySpool* spool = itt->second->m_spool;
+    if (spool)
+      {
+      spool->ConfigChanged();
+      spool->Replay();
+      }
+    }
+  }
+
+void OvmsNotify::Ticker1(std::string event, void* data)
+  {
+  for (OvmsNotifyTypeMap_t::iterator itt=m_types.begin(); itt!=m_types.end(); ++itt)
+    {
+    if (itt->second->m_spool)
+      itt->second->m_spool->Ticker();
+    }
+  }
+
+void OvmsNotify::ShuttingDown(std::string event, void* data)
+  {
+  for (OvmsNotifyTypeMap_t::iterator itt=m_types.begin(); itt!=m_types.end(); ++itt)
+    {
+    if (itt->second->m_spool)
+      itt->second->m_spool->Shutdown();
+    }
+  }
+
 size_t OvmsNotify::RegisterReader(const char* caller, int verbosity, OvmsNotifyCallback_t callback,
                                   bool configfiltered/*=false*/, OvmsNotifyFilterCallback_t filtercallback/*=NULL*/)
   {
@@ -478,6 +1151,7 @@ size_t OvmsNotify::RegisterReader(const char* caller, int verbosity, OvmsNotifyC
   size_t reader = m_nextreader++;
 
   m_readers[reader] = new OvmsNotifyCallbackEntry(caller, reader, verbosity, callback, configfiltered, filtercallback);
+  ReplaySpools();
 
   return reader;
   }
@@ -487,6 +1161,16 @@ void OvmsNotify::RegisterReader(size_t reader, const char* caller, int verbosity
   {
   OvmsRecMutexLock lock(&m_mutex);
   m_readers[reader] = new OvmsNotifyCallbackEntry(caller, reader, verbosity, callback, configfiltered, filtercallback);
+  ReplaySpools();
+  }
+
+void OvmsNotify::ReplaySpools()
+  {
+  for (OvmsNotifyTypeMap_t::iterator itt=m_types.begin(); itt!=m_types.end(); ++itt)
+    {
+    if (itt->second->m_spool)
+      itt->second->m_spool->Replay();
+    }
   }
 
 void OvmsNotify::ClearReader(size_t reader)
@@ -554,12 +1238,14 @@ bool OvmsNotify::HasReader(const char* type, const char* subtype, size_t size)
   return false;
   }
 
-void OvmsNotify::RegisterType(const char* type)
+void OvmsNotify::RegisterType(const char* type, bool spool /*=false*/)
   {
   OvmsNotifyType* mt = GetType(type);
   if (mt == NULL)
     {
     mt = new OvmsNotifyType(type);
+    if (spool)
+      mt->m_spool = new OvmsNotifySpool(mt);
     m_types[type] = mt;
     ESP_LOGI(TAG,"Registered notification type %s",type);
     }
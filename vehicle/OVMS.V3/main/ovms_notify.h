@@ -33,21 +33,27 @@
 
 #include <functional>
 #include <map>
+#include <set>
 #include <list>
 #include <string>
 #include <bitset>
 #include <atomic>
 #include <stdint.h>
+#include <stdio.h>
 #include "ovms.h"
 #include "ovms_utils.h"
 #include "ovms_mutex.h"
 
 #define NOTIFY_MAX_READERS 32
 #define NOTIFY_ERROR_AUTOSUPPRESS 120 // Auto-suppress for 120 seconds
+#define NOTIFY_SPOOL_NONE 0xffffffff    // Entry not loaded from spool file
+#define NOTIFY_SPOOL_MAGIC 0x4e53       // Spool record header magic "NS"
 
 using namespace std;
 
 class OvmsNotifyType;
+class OvmsNotifyCallbackEntry;
+class OvmsWriter;
 
 class OvmsNotifyEntry : public ExternalRamAllocated
   {
@@ -68,6 +74,7 @@ class OvmsNotifyEntry : public ExternalRamAllocated
     std::atomic_ulong m_pendingreaders;
     uint32_t m_id;
     uint32_t m_created;
+    uint32_t m_spoolpos;
     OvmsNotifyType* m_type;
     char* m_subtype;
   };
@@ -104,8 +111,74 @@ class OvmsNotifyEntryCommand : public OvmsNotifyEntry
 typedef std::map<uint32_t, OvmsNotifyEntry*, std::less<uint32_t>,
   ExtRamAllocator<std::pair<const uint32_t, OvmsNotifyEntry*>>> NotifyEntryMap_t;
 
+typedef struct
+  {
+  uint16_t magic;                   // NOTIFY_SPOOL_MAGIC
+  uint16_t subtypelen;              // length of subtype following the header
+  uint32_t valuelen;                // length of value following the subtype
+  uint32_t time;                    // UTC creation time, 0 = unknown
+  } OvmsNotifySpoolRecord_t;
+
+typedef std::map<std::string, uint32_t> OvmsNotifySpoolPosMap_t;
+
+class OvmsNotifySpool : public ExternalRamAllocated
+  {
+  friend class OvmsNotifyType;
+
+  public:
+    OvmsNotifySpool(OvmsNotifyType* type);
+    virtual ~OvmsNotifySpool();
+
+  public:
+    void ConfigChanged();
+    bool IsEnabled() { return m_enabled; }
+    void Offload(OvmsNotifyEntry* entry);
+    void Replay();
+    void Ticker();
+    void Shutdown();
+    void Status(OvmsWriter* writer);
+
+  protected:
+    bool IsSpoolReader(OvmsNotifyCallbackEntry* reader);
+    int CountWindow(size_t reader, OvmsNotifyEntry* except=NULL);
+    bool Append(OvmsNotifyEntry* entry, uint32_t& start);
+    void CloseAppend();
+    void ReplayReader(OvmsNotifyCallbackEntry* reader);
+    bool ReadRecord(FILE* fp, uint32_t pos, OvmsNotifySpoolRecord_t& rec, uint32_t& next,
+                    extram::string* subtype=NULL, extram::string* value=NULL);
+    uint32_t ReaderPos(const std::string& caller);
+    void GetPositions(OvmsNotifySpoolPosMap_t& positions);
+    void Compact(uint32_t needed);
+    void Rebase(uint32_t head);
+    void LoadIndex();
+    void SaveIndex();
+    void Sync(bool force=false);
+
+  public:
+    OvmsNotifyType* m_type;
+    bool m_enabled;
+    bool m_loaded;
+    bool m_replaying;
+    std::string m_path;
+    std::set<std::string> m_readers;
+    uint32_t m_maxsize;
+    int m_window;
+    int m_syncinterval;                   // min seconds between index writes
+    uint32_t m_filesize;
+    FILE* m_appendfp;                     // kept open during a spool burst
+    uint32_t m_lastappend;                // esp_log_timestamp() of last append
+    uint32_t m_lastsave;                  // esp_log_timestamp() of last index write
+    OvmsNotifySpoolPosMap_t m_cursor;     // per reader: next record to load into RAM
+    OvmsNotifySpoolPosMap_t m_synced;     // per reader: last persisted offset
+    uint32_t m_spooled;
+    uint32_t m_replayed;
+    uint32_t m_dropped;
+  };
+
 class OvmsNotifyType
   {
+  friend class OvmsNotifySpool;
+
   public:
     OvmsNotifyType(const char* name);
     virtual ~OvmsNotifyType();
@@ -126,6 +199,7 @@ class OvmsNotifyType
     uint32_t m_nextid;
     NotifyEntryMap_t m_entries;
     OvmsRecMutex m_mutex;
+    OvmsNotifySpool* m_spool;
   };
 
 typedef std::function<bool(OvmsNotifyType*,OvmsNotifyEntry*)> OvmsNotifyCallback_t;
@@ -182,13 +256,19 @@ class OvmsNotify : public ExternalRamAllocated
     void NotifyReaders(OvmsNotifyType* type, OvmsNotifyEntry* entry);
 
   public:
-    void RegisterType(const char* type);
+    void RegisterType(const char* type, bool spool=false);
     uint32_t NotifyString(const char* type, const char* subtype, const char* value);
     uint32_t NotifyStringf(const char* type, const char* subtype, const char* fmt, ...);
     uint32_t NotifyCommand(const char* type, const char* subtype, const char* cmd);
     uint32_t NotifyCommandf(const char* type, const char* subtype, const char* fmt, ...);
     void NotifyErrorCode(uint32_t code, uint32_t data, bool raised, bool force=false);
 
+  protected:
+    void EventListener(std::string event, void* data);
+    void Ticker1(std::string event, void* data);
+    void ShuttingDown(std::string event, void* data);
+    void ReplaySpools();
+
   public:
     OvmsNotifyCallbackMap_t m_readers;
     OvmsRecMutex m_mutex;
@@ -30,6 +30,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <fstream>
@@ -606,6 +607,117 @@ double float2double(float f)
   return atof(buf);
   }
 
+/**
+ * format_int: append integer in decimal representation
+ */
+void format_int(std::string& buf, long value)
+  {
+  char tmp[24];
+  char* p = tmp + sizeof(tmp);
+  unsigned long uval = (value < 0) ? -(unsigned long)value : value;
+  do
+    {
+    *--p = '0' + (uval % 10);
+    uval /= 10;
+    } while (uval);
+  if (value < 0)
+    *--p = '-';
+  buf.append(p, tmp + sizeof(tmp) - p);
+  }
+
+/**
+ * format_float: append float formatted like std::ostream
+ *  Values in the common ranges are rounded to an integer of the scaled value.
+ *  As float values have at most 24 significant bits, scaling by up to 10^9
+ *  is exact in double precision, so rounding (to nearest/even) gives the same
+ *  result as printf. Everything else is passed on to snprintf().
+ */
+static const double s_pow10[] =
+  { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+static void format_fixed(std::string& buf, bool neg, int64_t scaled, int decimals, bool strip)
+  {
+  char tmp[32];
+  char* end = tmp + sizeof(tmp);
+  char* p = end;
+  int64_t div = (int64_t) s_pow10[decimals];
+  uint64_t ipart = scaled / div, fpart = scaled % div;
+  if (decimals > 0 && !(strip && fpart == 0))
+    {
+    for (int i = 0; i < decimals; i++)
+      {
+      *--p = '0' + (fpart % 10);
+      fpart /= 10;
+      }
+    if (strip)
+      {
+      while (end[-1] == '0')
+        end--;
+      }
+    *--p = '.';
+    }
+  do
+    {
+    *--p = '0' + (ipart % 10);
+    ipart /= 10;
+    } while (ipart);
+  if (neg)
+    *--p = '-';
+  buf.append(p, end - p);
+  }
+
+void format_float(std::string& buf, float value, int precision /*=-1*/)
+  {
+  double av = fabs((double)value);
+  bool neg = signbit(value);
+
+  if (precision >= 0)
+    {
+    // fixed "%.<precision>f":
+    if (precision <= 9 && av < 1e9)
+      {
+      format_fixed(buf, neg, llrint(av * s_pow10[precision]), precision, false);
+      return;
+      }
+    }
+  else if (av == 0)
+    {
+    buf.append(neg ? "-0" : "0");
+    return;
+    }
+  else if (av >= 1e-4 && av < 1e6)
+    {
+    // "%g" = 6 significant digits, trailing zeros removed:
+    int exp = -4;
+    while (exp < 5 && av >= s_pow10[exp+5] / 1e4)
+      exp++;
+    int decimals = 5 - exp;
+    int64_t scaled = llrint(av * s_pow10[decimals]);
+    if (scaled >= 1000000)
+      {
+      // rounded up to the next magnitude:
+      decimals--;
+      scaled = llrint(av * s_pow10[decimals]);
+      }
+    if (decimals >= 0)
+      {
+      format_fixed(buf, neg, scaled, decimals, true);
+      return;
+      }
+    }
+
+  char tmp[48];
+  int len;
+  if (precision >= 0)
+    len = snprintf(tmp, sizeof(tmp), "%.*f", precision, value);
+  else
+    len = snprintf(tmp, sizeof(tmp), "%g", value);
+  if (len >= (int)sizeof(tmp))
+    len = sizeof(tmp)-1;
+  if (len > 0)
+    buf.append(tmp, len);
+  }
+
 /**
  * idtag: create object instance tag for registrations
  */
@@ -183,14 +183,12 @@ std::string hexdecode(const std::string encval);
 
 
 /**
- * json_encode: encode string for JSON transport (see http://www.json.org/)
+ * json_append: append string JSON encoded to buffer (see http://www.json.org/)
  */
-template <class src_string>
-std::string json_encode(const src_string text)
+template <class dst_string, class src_string>
+void json_append(dst_string& buf, const src_string& text)
   {
-  std::string buf;
   char hex[10];
-  buf.reserve(text.size() + (text.size() >> 3));
   for (int i=0; i<text.size(); i++)
     {
     switch(text[i])
@@ -215,10 +213,30 @@ std::string json_encode(const src_string text)
         break;
       }
     }
+  }
+
+/**
+ * json_encode: encode string for JSON transport (see http://www.json.org/)
+ */
+template <class src_string>
+std::string json_encode(const src_string text)
+  {
+  std::string buf;
+  buf.reserve(text.size() + (text.size() >> 3));
+  json_append(buf, text);
 	return buf;
   }
 
 
+/**
+ * format_int, format_float: append number to string, formatted like std::ostream
+ *  does (float: precision < 0 = "%g", else fixed "%.<precision>f")
+ *  These avoid the stream & printf overhead for the common value ranges.
+ */
+void format_int(std::string& buf, long value);
+void format_float(std::string& buf, float value, int precision=-1);
+
+
 /**
  * mqtt_topic: convert dotted string (e.g. notification subtype) to MQTT topic
  *  - replace '.' by '/'
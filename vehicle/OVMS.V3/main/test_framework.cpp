@@ -45,7 +45,10 @@ static const char *TAG = "test";
 #include "metrics_standard.h"
 #include "ovms_config.h"
 #include "can.h"
+#include "canisotp.h"
 #include "strverscmp.h"
+#include "crypt_rc4.h"
+#include "crypt_base64.h"
 
 void test_deepsleep(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
@@ -362,6 +365,262 @@ void test_string(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
     (int)((esp_timer_get_time() - time_start_us) / 1000));
   }
 
+// Reference byte-at-a-time RC4 & base64 encoder as used up to now,
+// to benchmark the word/block oriented kernels against:
+static void test_crypto_rc4_ref(RC4_CTX1 *ctx1, RC4_CTX2 *ctx2, uint8_t *msg, int length)
+  {
+  uint8_t *m = ctx2->m, x = ctx1->x, y = ctx1->y, a, b;
+  for (int i = 0; i < length; i++)
+    {
+    a = m[++x];
+    y += a;
+    m[x] = b = m[y];
+    m[y] = a;
+    msg[i] ^= m[(uint8_t)(a + b)];
+    }
+  ctx1->x = x;
+  ctx1->y = y;
+  }
+
+static void test_crypto_b64_ref(const uint8_t *in, int len, uint8_t *out)
+  {
+  uint8_t blk[3];
+  for (int k = 0; k < len; k += 3)
+    {
+    int n = (len-k > 3) ? 3 : len-k;
+    for (int i = 0; i < 3; i++) blk[i] = (i < n) ? in[k+i] : 0;
+    *out++ = cb64[blk[0] >> 2];
+    *out++ = cb64[((blk[0] & 0x03) << 4) | ((blk[1] & 0xf0) >> 4)];
+    *out++ = (n > 1) ? cb64[((blk[1] & 0x0f) << 2) | ((blk[2] & 0xc0) >> 6)] : '=';
+    *out++ = (n > 2) ? cb64[blk[2] & 0x3f] : '=';
+    }
+  *out = 0;
+  }
+
+void test_crypto(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int size = (argc > 0) ? atoi(argv[0]) : 200;
+  int loops = (argc > 1) ? atoi(argv[1]) : 1000;
+  if (size < 1 || size > 8192 || loops < 1)
+    {
+    writer->puts("Error: size must be 1..8192, loops >= 1");
+    return;
+    }
+
+  int blen = howmany(size,3)*4;
+  uint8_t* plain = (uint8_t*) malloc(size);
+  uint8_t* buf1 = (uint8_t*) malloc(blen+1);
+  uint8_t* buf2 = (uint8_t*) malloc(blen+1);
+  RC4_CTX1* c1 = new RC4_CTX1[2];
+  RC4_CTX2* c2 = new RC4_CTX2[2];
+  if (!plain || !buf1 || !buf2)
+    {
+    writer->puts("Error: out of memory");
+    free(plain); free(buf1); free(buf2);
+    delete [] c1; delete [] c2;
+    return;
+    }
+  for (int k = 0; k < size; k++) plain[k] = esp_random();
+  RC4_setup(&c1[0], &c2[0], plain, 16);
+  RC4_setup(&c1[1], &c2[1], plain, 16);
+
+  int64_t t0, t_ref, t_new;
+  double kb = (double)size * loops / 1024;
+  bool ok = true;
+
+  // RC4:
+  memcpy(buf1, plain, size);
+  memcpy(buf2+blen-size, plain, size);
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++) test_crypto_rc4_ref(&c1[0], &c2[0], buf1, size);
+  t_ref = esp_timer_get_time() - t0;
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++) RC4_crypt(&c1[1], &c2[1], buf2+blen-size, size);
+  t_new = esp_timer_get_time() - t0;
+  ok = ok && (memcmp(buf1, buf2+blen-size, size) == 0);
+  writer->printf("RC4 crypt      : ref %8.1f KB/s, new %8.1f KB/s\n",
+    kb * 1000000 / (t_ref ? t_ref : 1), kb * 1000000 / (t_new ? t_new : 1));
+
+  // base64 encode (new: in place):
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++) test_crypto_b64_ref(plain, size, buf1);
+  t_ref = esp_timer_get_time() - t0;
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    memcpy(buf2+blen-size, plain, size);
+    base64encode(buf2+blen-size, size, buf2);
+    }
+  t_new = esp_timer_get_time() - t0;
+  ok = ok && (memcmp(buf1, buf2, blen+1) == 0);
+  writer->printf("base64 encode  : ref %8.1f KB/s, new %8.1f KB/s (in place)\n",
+    kb * 1000000 / (t_ref ? t_ref : 1), kb * 1000000 / (t_new ? t_new : 1));
+
+  // base64 decode (in place):
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    memcpy(buf2, buf1, blen+1);
+    if (base64decode((char*)buf2, buf2) != size) ok = false;
+    }
+  t_new = esp_timer_get_time() - t0;
+  ok = ok && (memcmp(buf2, plain, size) == 0);
+  writer->printf("base64 decode  : %8.1f KB/s (in place)\n", kb * 1000000 / (t_new ? t_new : 1));
+
+  // Paranoid cipher priming: setup + 1024 byte discard vs. state clone:
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    RC4_setup(&c1[0], &c2[0], plain, 16);
+    for (int i = 0; i < 1024; i++)
+      {
+      uint8_t zero = 0;
+      test_crypto_rc4_ref(&c1[0], &c2[0], &zero, 1);
+      }
+    }
+  t_ref = esp_timer_get_time() - t0;
+  t0 = esp_timer_get_time();
+  for (int k = 0; k < loops; k++)
+    {
+    c1[1] = c1[0];
+    c2[1] = c2[0];
+    }
+  t_new = esp_timer_get_time() - t0;
+  writer->printf("Paranoid prime : ref %8.1f us/msg, clone %8.1f us/msg\n",
+    (double)t_ref / loops, (double)t_new / loops);
+
+  writer->printf("%d bytes x %d loops, results %s\n", size, loops, ok ? "match" : "MISMATCH");
+
+  free(plain);
+  free(buf1);
+  free(buf2);
+  delete [] c1;
+  delete [] c2;
+  }
+
+/**
+ * test isotp: ISO-TP engine throughput on a loopback transport
+ *  The sender and receiver channels share one engine, frames are passed through
+ *  a small queue instead of a CAN bus. This measures the engine overhead and
+ *  the STmin pacing; on a real bus, add the frame transmission times.
+ */
+#define TEST_ISOTP_QUEUESIZE 32
+
+class test_isotp_loopback : public canisotp
+  {
+  public:
+    test_isotp_loopback() : m_head(0), m_tail(0), m_overflow(0) {}
+
+  public:
+    void Pump()
+      {
+      while (m_tail != m_head)
+        {
+        CAN_frame_t frame = m_queue[m_tail];
+        m_tail = (m_tail + 1) % TEST_ISOTP_QUEUESIZE;
+        IncomingFrame(&frame);
+        }
+      }
+
+  protected:
+    esp_err_t TransmitFrame(CAN_frame_t* frame)
+      {
+      int next = (m_head + 1) % TEST_ISOTP_QUEUESIZE;
+      if (next == m_tail)
+        {
+        m_overflow++;
+        return ESP_FAIL;
+        }
+      m_queue[m_head] = *frame;
+      m_head = next;
+      return ESP_OK;
+      }
+
+  public:
+    CAN_frame_t m_queue[TEST_ISOTP_QUEUESIZE];
+    int m_head, m_tail;
+    uint32_t m_overflow;
+  };
+
+void test_isotp(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int size = (argc > 0) ? atoi(argv[0]) : 1024;
+  int blocksize = (argc > 1) ? atoi(argv[1]) : 0;
+  if (size < 1 || size > ISOTP_MAX_LENGTH || blocksize < 0 || blocksize > 255)
+    {
+    writer->printf("Error: size must be 1..%d, blocksize 0..255\n", ISOTP_MAX_LENGTH);
+    return;
+    }
+
+  uint8_t* txbuf = (uint8_t*) ExternalRamMalloc(size);
+  uint8_t* rxbuf = (uint8_t*) ExternalRamMalloc(size);
+  if (!txbuf || !rxbuf)
+    {
+    writer->puts("Error: out of memory");
+    free(txbuf); free(rxbuf);
+    return;
+    }
+  for (int k = 0; k < size; k++) txbuf[k] = esp_random();
+
+  test_isotp_loopback* engine = new test_isotp_loopback();
+  canisotp_channel tester, ecu;
+  tester.Configure(NULL, 0x7e0, 0x7e8);
+  ecu.Configure(NULL, 0x7e8, 0x7e0);
+  ecu.SetRxBuffer(rxbuf, size);
+  engine->Attach(&tester);
+  engine->Attach(&ecu);
+
+  volatile int txresult, rxresult;
+  tester.SetCallback([&txresult](canisotp_channel* ch, canisotp_event_t ev, int res)
+    { if (ev == ISOTP_EVENT_TXDONE) txresult = res; });
+  ecu.SetCallback([&rxresult](canisotp_channel* ch, canisotp_event_t ev, int res)
+    { if (ev == ISOTP_EVENT_RXDONE) rxresult = res; });
+
+  static const uint8_t stmin[] = { 0x00, 0xf1, 0xf5, 0x01, 0x05, 0x0a, 0x19 };
+  writer->printf("Message size %d bytes, block size %d:\n", size, blocksize);
+  writer->puts("STmin     Frames   Time [ms]      KB/s  Result");
+  for (int i = 0; i < sizeof(stmin); i++)
+    {
+    ecu.SetFlowControl(blocksize, stmin[i]);
+    memset(rxbuf, 0, size);
+    txresult = rxresult = 1;
+    uint32_t frames = tester.m_tx_frames + ecu.m_tx_frames;
+    int64_t t0 = esp_timer_get_time();
+    int res = tester.Send(txbuf, size);
+    while (res == ISOTP_OK && (txresult > 0 || rxresult > 0))
+      {
+      engine->Pump();
+      engine->Process();
+      if (engine->m_head != engine->m_tail)
+        continue;
+      TickType_t wait = engine->NextDueTicks();
+      if (wait == portMAX_DELAY)
+        break;
+      if (wait > 0)
+        vTaskDelay(wait);
+      }
+    int64_t t = esp_timer_get_time() - t0;
+    frames = tester.m_tx_frames + ecu.m_tx_frames - frames;
+    if (res == ISOTP_OK)
+      res = (txresult != ISOTP_OK) ? txresult : rxresult;
+    bool ok = (res == ISOTP_OK && ecu.GetRxLength() == size && memcmp(txbuf, rxbuf, size) == 0);
+    char label[8];
+    if (stmin[i] <= 0x7f)
+      snprintf(label, sizeof(label), "%ums", stmin[i]);
+    else
+      snprintf(label, sizeof(label), "%uus", (stmin[i] - 0xf0) * 100);
+    writer->printf("%-6s %9u %11.1f %9.1f  %s (%d)\n", label, frames, (double)t / 1000, (double)size * 1000000 / 1024 / (t ? t : 1), ok ? "OK" : "FAIL", res);
+    }
+
+  engine->Detach(&tester);
+  engine->Detach(&ecu);
+  if (engine->m_overflow)
+    writer->printf("Loopback queue overflows: %u\n", engine->m_overflow);
+  delete engine;
+  free(txbuf);
+  free(rxbuf);
+  }
+
 void test_command(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   MyCommandApp.Display(writer);
@@ -394,4 +653,6 @@ TestFrameworkInit::TestFrameworkInit()
   cmd_test->RegisterCommand("string", "Test std::string memory corruption", test_string, "<loopcnt> <mode>\n"
     "mode: 1=m.AsJSON, 2=m.AsString, 3=m.name, 4=const cfg string, 5=const local cstr, 6=const local string", 2, 2);
   cmd_test->RegisterCommand("commands", "List command tree", test_command);
+  cmd_test->RegisterCommand("crypto", "Benchmark RC4 & base64 kernels", test_crypto, "[<size>] [<loops>]", 0, 2);
+  cmd_test->RegisterCommand("isotp", "Benchmark ISO-TP engine on loopback", test_isotp, "[<size>] [<blocksize>]", 0, 2);
   }
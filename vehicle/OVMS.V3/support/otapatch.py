@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+# otapatch.py: create OVMS delta firmware update files
+#
+# Usage: otapatch.py <old-image.bin> <new-image.bin> <patch-file>
+#
+# The patch file is applied by "ota flash vfs" and "ota flash http" to the
+# running firmware. The old image must exactly match the firmware running on
+# the module (i.e. the ovms3.bin previously flashed).
+#
+# To provide delta updates via the OTA server, place the patch next to the
+# ovms3.bin file as "ovms3-<oldversion>.pat", i.e. for 3.2.015 running on the
+# module: ".../v3.1/main/ovms3-3.2.015.pat". Enable delta updates on the module
+# by "config set ota delta yes".
+#
+# Patch format: see OvmsOTAPatch in components/ovms_ota/src/ovms_ota.cpp
+
+import hashlib
+import struct
+import sys
+
+BLOCK = 64          # source index block size
+MINMATCH = 32       # minimum copy length (shorter matches cost more than they save)
+
+def make_patch(src, tgt):
+  # Index source blocks:
+  index = {}
+  for pos in range(0, len(src) - BLOCK + 1, BLOCK):
+    index.setdefault(src[pos:pos+BLOCK], pos)
+
+  out = bytearray()
+  out += b"OVDP"
+  out += struct.pack("<III", 1, len(src), len(tgt))
+  out += hashlib.md5(src).digest()
+  out += hashlib.md5(tgt).digest()
+
+  literal = bytearray()
+  def flush_literal():
+    if literal:
+      out.extend(b"I" + struct.pack("<I", len(literal)) + literal)
+      literal.clear()
+
+  i = 0
+  copied = 0
+  while i < len(tgt):
+    spos = index.get(tgt[i:i+BLOCK]) if i + BLOCK <= len(tgt) else None
+    if spos is None:
+      literal.append(tgt[i])
+      i += 1
+      continue
+    # Extend match backwards into pending literal & forwards:
+    back = 0
+    while back < len(literal) and spos - back > 0 and src[spos-back-1] == literal[-back-1]:
+      back += 1
+    n = BLOCK
+    while i + n < len(tgt) and spos + n < len(src) and tgt[i+n] == src[spos+n]:
+      n += 1
+    if back:
+      del literal[-back:]
+    if n + back < MINMATCH:
+      literal.extend(tgt[i:i+n])
+    else:
+      flush_literal()
+      out.extend(b"C" + struct.pack("<II", spos - back, n + back))
+      copied += n + back
+    i += n
+
+  flush_literal()
+  out += b"E"
+  return bytes(out), copied
+
+def main():
+  if len(sys.argv) != 4:
+    sys.exit("Usage: %s <old-image.bin> <new-image.bin> <patch-file>" % sys.argv[0])
+  with open(sys.argv[1], "rb") as f:
+    src = f.read()
+  with open(sys.argv[2], "rb") as f:
+    tgt = f.read()
+  patch, copied = make_patch(src, tgt)
+  with open(sys.argv[3], "wb") as f:
+    f.write(patch)
+  print("Patch: %d bytes (%.1f%% of image), %d bytes copied from old image"
+        % (len(patch), 100.0 * len(patch) / len(tgt), copied))
+
+if __name__ == "__main__":
+  main()